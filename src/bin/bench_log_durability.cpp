@@ -0,0 +1,144 @@
+#include "base/init.h"
+#include "base/common.h"
+#include "common/time.h"
+#include "utils/bench.h"
+#include "utils/fs.h"
+#include "log/journal.h"
+#include "log/db.h"
+
+ABSL_FLAG(std::string, durability, "fsync", "Durability level: memory, written or fsync");
+ABSL_FLAG(std::string, journal_path, "/tmp/boki_bench_journal",
+          "Directory for journal segments");
+ABSL_FLAG(std::string, db_path, "",
+          "If not empty, also persist entries to RocksDB at this path");
+ABSL_FLAG(bool, disable_wal, false, "Skip RocksDB WAL for memory durability");
+ABSL_FLAG(size_t, record_size, 1024, "Size of log data");
+ABSL_FLAG(size_t, max_inflight, 256,
+          "Max entries waiting to become durable, as from concurrent engines");
+ABSL_FLAG(absl::Duration, duration, absl::Seconds(10), "Duration to run");
+
+using namespace faas;
+
+static constexpr size_t kBufferSizeForSamples = 1<<24;
+static constexpr uint32_t kLogSpaceId = 1;
+static constexpr size_t kJournalSegmentSize = size_t{64} << 20;
+
+void BenchMain(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+
+    log::DurabilityLevel level;
+    CHECK(log::ParseDurabilityLevel(absl::GetFlag(FLAGS_durability), &level))
+        << "Unknown durability level " << absl::GetFlag(FLAGS_durability);
+    size_t max_inflight = absl::GetFlag(FLAGS_max_inflight);
+    CHECK_GT(max_inflight, 0U);
+    std::string data(absl::GetFlag(FLAGS_record_size), 'x');
+
+    // Entries in flight are indexed by localid modulo max_inflight
+    std::vector<int64_t> start_timestamps(max_inflight, 0);
+    bench_utils::Samples<int32_t> ack_delay(kBufferSizeForSamples);
+    absl::Mutex mu;
+    absl::CondVar cv;
+    size_t num_inflight = 0;
+
+    std::unique_ptr<log::LogJournal> journal;
+    if (level != log::DurabilityLevel::kMemory) {
+        std::string journal_path = absl::GetFlag(FLAGS_journal_path);
+        if (fs_utils::Exists(journal_path)) {
+            CHECK(fs_utils::RemoveDirectoryRecursively(journal_path));
+        }
+        journal.reset(new log::LogJournal(
+            journal_path, kJournalSegmentSize,
+            [&] (const log::LogJournal::EntryKeyVec& entries) {
+                int64_t current_timestamp = GetMonotonicMicroTimestamp();
+                absl::MutexLock lk(&mu);
+                for (const auto& [_, localid] : entries) {
+                    int64_t start_timestamp = start_timestamps[localid % max_inflight];
+                    ack_delay.Add(gsl::narrow_cast<int32_t>(
+                        current_timestamp - start_timestamp));
+                }
+                num_inflight -= entries.size();
+                cv.Signal();
+            }));
+        journal->Start();
+    }
+
+    std::unique_ptr<log::DBInterface> db;
+    bench_utils::Samples<int32_t> db_put_delay(kBufferSizeForSamples);
+    if (!absl::GetFlag(FLAGS_db_path).empty()) {
+        db.reset(new log::RocksDBBackend(absl::GetFlag(FLAGS_db_path)));
+        db->InstallLogSpace(kLogSpaceId);
+    }
+    bool disable_wal = absl::GetFlag(FLAGS_disable_wal)
+                       && level == log::DurabilityLevel::kMemory;
+
+    log::LogMetaData metadata = {
+        .user_logspace = 0,
+        .seqnum = 0,
+        .localid = 0,
+        .num_tags = 0,
+        .data_size = data.size(),
+        .cond_append = false,
+        .cond_tail_seqnum = log::kInvalidLogSeqNum
+    };
+    bench_utils::BenchLoop bench_loop(absl::GetFlag(FLAGS_duration), [&] () -> bool {
+        int64_t start_timestamp = GetMonotonicMicroTimestamp();
+        if (journal != nullptr) {
+            {
+                absl::MutexLock lk(&mu);
+                while (num_inflight >= max_inflight) {
+                    cv.Wait(&mu);
+                }
+                start_timestamps[metadata.localid % max_inflight] = start_timestamp;
+                num_inflight++;
+            }
+            journal->Append(kLogSpaceId, metadata, /* user_tags= */ {},
+                            STRING_AS_SPAN(data),
+                            /* sync= */ level == log::DurabilityLevel::kFsync);
+        } else {
+            // Acknowledged once stored in memory
+            ack_delay.Add(gsl::narrow_cast<int32_t>(
+                GetMonotonicMicroTimestamp() - start_timestamp));
+        }
+        if (db != nullptr) {
+            start_timestamp = GetMonotonicMicroTimestamp();
+            db->Put(kLogSpaceId, gsl::narrow_cast<uint32_t>(metadata.localid),
+                    STRING_AS_SPAN(data), disable_wal);
+            db_put_delay.Add(gsl::narrow_cast<int32_t>(
+                GetMonotonicMicroTimestamp() - start_timestamp));
+        }
+        metadata.localid++;
+        return true;
+    });
+
+    if (journal != nullptr) {
+        absl::MutexLock lk(&mu);
+        while (num_inflight > 0) {
+            cv.Wait(&mu);
+        }
+    }
+    double elapsed_sec = absl::ToDoubleSeconds(bench_loop.elapsed_time());
+    size_t loop_count = bench_loop.loop_count();
+    LOG(INFO) << "Durability level: " << log::DurabilityLevelName(level);
+    LOG(INFO) << "Elapsed milliseconds: "
+              << absl::ToInt64Milliseconds(bench_loop.elapsed_time());
+    LOG(INFO) << "Throughput: " << static_cast<double>(loop_count) / elapsed_sec
+              << " entries/s, "
+              << static_cast<double>(loop_count * data.size()) / elapsed_sec / (1 << 20)
+              << " MB/s";
+    {
+        absl::MutexLock lk(&mu);
+        ack_delay.ReportStatistics("Ack delay (us)");
+    }
+    if (db != nullptr) {
+        db_put_delay.ReportStatistics(
+            fmt::format("DB put delay (us), disable_wal={}", disable_wal));
+    }
+    if (journal != nullptr) {
+        journal->Stop();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    BenchMain(argc, argv);
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include "base/init.h"
+#include "base/common.h"
+#include "utils/fs.h"
+#include "log/archive.h"
+
+ABSL_FLAG(std::string, test_dir, "/tmp", "Directory for temporary files");
+
+using namespace faas;
+
+static constexpr uint32_t kLogSpaceId = 1;
+static constexpr uint32_t kOtherLogSpaceId = 2;
+// Small blocks, so that segments span many of them
+static constexpr size_t kBlockSize = 256;
+static constexpr int kCompressionLevel = 3;
+
+static std::string EntryData(uint32_t key) {
+    return fmt::format("entry_{:08d}_{}", key, std::string(key % 64, 'x'));
+}
+
+static log::DBInterface::KeyValueVec MakeRecords(uint32_t start_key, uint32_t end_key,
+                                                 uint32_t step) {
+    log::DBInterface::KeyValueVec records;
+    for (uint32_t key = start_key; key < end_key; key += step) {
+        records.emplace_back(key, EntryData(key));
+    }
+    return records;
+}
+
+static std::vector<uint32_t> ScanKeys(log::LogArchive* archive, uint32_t logspace_id,
+                                      uint32_t start_key, size_t max_entries) {
+    log::DBInterface::KeyValueVec results;
+    archive->Scan(logspace_id, start_key, max_entries, &results);
+    std::vector<uint32_t> keys;
+    for (const auto& [key, data] : results) {
+        CHECK_EQ(data, EntryData(key));
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+static std::vector<uint32_t> KeyRange(uint32_t start_key, uint32_t end_key, uint32_t step) {
+    std::vector<uint32_t> keys;
+    for (uint32_t key = start_key; key < end_key; key += step) {
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+// Entries of the log space are in two segments: even keys in [0, 100),
+// then all keys in [150, 250). Keys in between belong to other shards.
+static void CheckArchivedEntries(log::LogArchive* archive) {
+    CHECK_EQ(archive->archived_position(kLogSpaceId), 250U);
+    CHECK_EQ(archive->archived_position(kOtherLogSpaceId), 0U);
+
+    CHECK_EQ(archive->Get(kLogSpaceId, 10).value_or(""), EntryData(10));
+    CHECK_EQ(archive->Get(kLogSpaceId, 98).value_or(""), EntryData(98));
+    CHECK_EQ(archive->Get(kLogSpaceId, 249).value_or(""), EntryData(249));
+    CHECK(!archive->Get(kLogSpaceId, 11).has_value());
+    CHECK(!archive->Get(kLogSpaceId, 120).has_value());
+    CHECK(!archive->Get(kLogSpaceId, 250).has_value());
+    CHECK(!archive->Get(kOtherLogSpaceId, 10).has_value());
+
+    // Scans continue into following segments
+    std::vector<uint32_t> expected = KeyRange(90, 100, 2);
+    for (uint32_t key : KeyRange(150, 155, 1)) {
+        expected.push_back(key);
+    }
+    CHECK(ScanKeys(archive, kLogSpaceId, 90, 10) == expected);
+    CHECK(ScanKeys(archive, kLogSpaceId, 91, 9)
+          == std::vector<uint32_t>(expected.begin() + 1, expected.end()));
+    // Also when starting between segments
+    CHECK(ScanKeys(archive, kLogSpaceId, 120, 3) == KeyRange(150, 153, 1));
+    std::vector<uint32_t> all_keys = KeyRange(0, 100, 2);
+    for (uint32_t key : KeyRange(150, 250, 1)) {
+        all_keys.push_back(key);
+    }
+    CHECK(ScanKeys(archive, kLogSpaceId, 0, 1000) == all_keys);
+    CHECK(ScanKeys(archive, kLogSpaceId, 250, 10).empty());
+    CHECK(ScanKeys(archive, kOtherLogSpaceId, 0, 10).empty());
+}
+
+void TestWriteAndScan(const std::string& dir_path) {
+    {
+        // A single open file, so that scans across segments reopen them
+        log::LogArchive archive(dir_path, kBlockSize, /* max_open_files= */ 1,
+                                kCompressionLevel);
+        archive.Start();
+        CHECK_EQ(archive.archived_position(kLogSpaceId), 0U);
+        CHECK(archive.WriteSegment(kLogSpaceId, MakeRecords(0, 100, 2)));
+        CHECK_EQ(archive.archived_position(kLogSpaceId), 99U);
+        CHECK(archive.WriteSegment(kLogSpaceId, MakeRecords(150, 250, 1)));
+        CheckArchivedEntries(&archive);
+    }
+    // Segments not completed before crash are removed on start
+    std::string tmp_path = fs_utils::JoinPath(dir_path, "1_c8.seg.tmp");
+    auto fd = fs_utils::Create(tmp_path);
+    CHECK(fd.has_value());
+    close(*fd);
+    {
+        log::LogArchive archive(dir_path, kBlockSize, /* max_open_files= */ 4,
+                                kCompressionLevel);
+        archive.Start();
+        CHECK(!fs_utils::Exists(tmp_path));
+        CheckArchivedEntries(&archive);
+    }
+    LOG(INFO) << "TestWriteAndScan passed";
+}
+
+int main(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+    std::string dir_path = fs_utils::JoinPath(
+        absl::GetFlag(FLAGS_test_dir), fmt::format("boki_test_archive_{}", getpid()));
+    TestWriteAndScan(dir_path);
+    CHECK(fs_utils::RemoveDirectoryRecursively(dir_path));
+    return 0;
+}
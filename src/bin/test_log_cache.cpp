@@ -0,0 +1,129 @@
+#include "base/init.h"
+#include "base/common.h"
+#include "log/cache.h"
+#include "utils/bits.h"
+
+using namespace faas;
+
+static constexpr uint32_t kUserLogSpace = 1;
+// Matches per-entry bookkeeping of LRUCache, so that exactly
+// kEntriesPerMB entries fit in each MB of capacity
+static constexpr size_t kEntrySize = 128 * 1024;
+static constexpr size_t kEntryOverhead = 64;
+static constexpr size_t kEntriesPerMB = (size_t{1} << 20) / kEntrySize;
+
+static bool PutEntry(log::LRUCache* cache, uint64_t seqnum, bool force = false) {
+    std::string data(kEntrySize - kEntryOverhead - sizeof(log::LogMetaData),
+                     static_cast<char>('a' + seqnum % 26));
+    log::LogMetaData metadata = {
+        .user_logspace = kUserLogSpace,
+        .seqnum = seqnum,
+        .localid = 0,
+        .num_tags = 0,
+        .data_size = data.size(),
+        .cond_append = false,
+        .cond_tail_seqnum = log::kInvalidLogSeqNum
+    };
+    return cache->Put(metadata, std::span<const uint64_t>(), STRING_AS_SPAN(data), force);
+}
+
+static bool Contains(log::LRUCache* cache, uint64_t seqnum) {
+    auto log_entry = cache->Get(kUserLogSpace, seqnum, /* touch= */ false);
+    if (log_entry.has_value()) {
+        CHECK_EQ(log_entry->metadata.seqnum, seqnum);
+        CHECK_EQ(log_entry->data.front(), static_cast<char>('a' + seqnum % 26));
+    }
+    return log_entry.has_value();
+}
+
+void TestEviction() {
+    log::LRUCache cache(/* mem_cap_mb= */ 1);
+    std::vector<uint64_t> evicted;
+    cache.SetEvictCallback([&evicted] (uint64_t seqnum, std::string encoded) {
+        evicted.push_back(seqnum);
+    });
+    for (uint64_t seqnum = 0; seqnum < kEntriesPerMB; seqnum++) {
+        CHECK(PutEntry(&cache, seqnum));
+    }
+    CHECK(evicted.empty());
+    // Accessed entries become most recently used
+    CHECK(cache.Get(kUserLogSpace, 0).has_value());
+    CHECK(PutEntry(&cache, kEntriesPerMB));
+    CHECK_EQ(evicted.size(), 1U);
+    CHECK_EQ(evicted.front(), 1U);
+    CHECK(!Contains(&cache, 1));
+    CHECK(Contains(&cache, 0));
+    CHECK(Contains(&cache, kEntriesPerMB));
+    // Lookups without touch keep the LRU order
+    CHECK(Contains(&cache, 2));
+    CHECK(PutEntry(&cache, kEntriesPerMB + 1));
+    CHECK_EQ(evicted.back(), 2U);
+    LOG(INFO) << "TestEviction passed";
+}
+
+void TestAdmission() {
+    log::LRUCache cache(/* mem_cap_mb= */ 1, /* num_partitions= */ 1, /* admission= */ true);
+    for (uint64_t seqnum = 0; seqnum < kEntriesPerMB; seqnum++) {
+        CHECK(PutEntry(&cache, seqnum));
+    }
+    // Cached entries are read a few times each
+    for (int i = 0; i < 3; i++) {
+        for (uint64_t seqnum = 0; seqnum < kEntriesPerMB; seqnum++) {
+            CHECK(cache.Get(kUserLogSpace, seqnum).has_value());
+        }
+    }
+    // One-pass scans cannot flush them
+    for (uint64_t seqnum = 100; seqnum < 100 + kEntriesPerMB; seqnum++) {
+        CHECK(!PutEntry(&cache, seqnum));
+        CHECK(!Contains(&cache, seqnum));
+    }
+    for (uint64_t seqnum = 0; seqnum < kEntriesPerMB; seqnum++) {
+        CHECK(Contains(&cache, seqnum));
+    }
+    // Missed reads count as accesses, letting the entry in once more frequent
+    for (int i = 0; i < 5; i++) {
+        CHECK(!cache.Get(kUserLogSpace, 200).has_value());
+    }
+    CHECK(PutEntry(&cache, 200));
+    CHECK(Contains(&cache, 200));
+    // Forced puts bypass admission
+    CHECK(PutEntry(&cache, 300, /* force= */ true));
+    CHECK(Contains(&cache, 300));
+    LOG(INFO) << "TestAdmission passed";
+}
+
+void TestPartitions() {
+    // Each user log space gets its own share of capacity
+    log::LRUCache cache(/* mem_cap_mb= */ 2, /* num_partitions= */ 0);
+    std::string data(kEntrySize - kEntryOverhead - sizeof(log::LogMetaData), 'x');
+    for (uint32_t user_logspace = 1; user_logspace <= 2; user_logspace++) {
+        for (uint64_t seqnum = 0; seqnum < kEntriesPerMB; seqnum++) {
+            log::LogMetaData metadata = {
+                .user_logspace = user_logspace,
+                .seqnum = bits::JoinTwo32(user_logspace, gsl::narrow_cast<uint32_t>(seqnum)),
+                .localid = 0,
+                .num_tags = 0,
+                .data_size = data.size(),
+                .cond_append = false,
+                .cond_tail_seqnum = log::kInvalidLogSeqNum
+            };
+            CHECK(cache.Put(metadata, std::span<const uint64_t>(), STRING_AS_SPAN(data)));
+        }
+    }
+    // Appends to the second log space do not evict entries of the first one
+    for (uint32_t user_logspace = 1; user_logspace <= 2; user_logspace++) {
+        for (uint64_t seqnum = 0; seqnum < kEntriesPerMB; seqnum++) {
+            CHECK(cache.Get(user_logspace, bits::JoinTwo32(
+                user_logspace, gsl::narrow_cast<uint32_t>(seqnum)), false).has_value());
+        }
+    }
+    LOG(INFO) << "TestPartitions passed";
+}
+
+int main(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+    TestEviction();
+    TestAdmission();
+    TestPartitions();
+    return 0;
+}
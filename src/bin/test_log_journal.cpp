@@ -0,0 +1,183 @@
+#include "base/init.h"
+#include "base/common.h"
+#include "utils/fs.h"
+#include "log/journal.h"
+
+#include <fcntl.h>
+
+ABSL_FLAG(std::string, test_dir, "/tmp", "Directory for temporary files");
+
+using namespace faas;
+
+static constexpr uint32_t kLogSpaceId = 1;
+static constexpr uint32_t kOtherLogSpaceId = 2;
+static constexpr size_t kNumEntries = 10;
+
+static std::string EntryData(uint32_t logspace_id, uint64_t localid) {
+    return fmt::format("entry_{}_{}", logspace_id, localid);
+}
+
+// Waits for each append to become durable before the next one, thus
+// every entry forms its own group
+class JournalWriter {
+public:
+    explicit JournalWriter(std::string_view dir_path)
+        : journal_(dir_path, /* segment_size= */ 1,
+                   absl::bind_front(&JournalWriter::OnDurable, this)),
+          num_durable_(0) {}
+
+    log::LogJournal* journal() { return &journal_; }
+
+    void Append(uint32_t logspace_id, uint64_t localid) {
+        std::string data = EntryData(logspace_id, localid);
+        uint64_t user_tag = localid + 1;
+        log::LogMetaData metadata = {
+            .user_logspace = 0,
+            .seqnum = log::kInvalidLogSeqNum,
+            .localid = localid,
+            .num_tags = 1,
+            .data_size = data.size(),
+            .cond_append = false,
+            .cond_tail_seqnum = log::kInvalidLogSeqNum
+        };
+        absl::MutexLock lk(&mu_);
+        size_t target = num_durable_ + 1;
+        journal_.Append(logspace_id, metadata, std::span<const uint64_t>(&user_tag, 1),
+                        STRING_AS_SPAN(data), /* sync= */ true);
+        while (num_durable_ < target) {
+            cv_.Wait(&mu_);
+        }
+    }
+
+private:
+    log::LogJournal journal_;
+    absl::Mutex mu_;
+    absl::CondVar cv_;
+    size_t num_durable_ ABSL_GUARDED_BY(mu_);
+
+    void OnDurable(const log::LogJournal::EntryKeyVec& entries) {
+        absl::MutexLock lk(&mu_);
+        num_durable_ += entries.size();
+        cv_.Signal();
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(JournalWriter);
+};
+
+static std::vector<log::LogJournal::EntryKey> RecoverEntries(log::LogJournal* journal) {
+    std::vector<log::LogJournal::EntryKey> recovered;
+    journal->Recover([&recovered] (uint32_t logspace_id, const log::LogMetaData& metadata,
+                                   std::span<const uint64_t> user_tags,
+                                   std::span<const char> log_data) {
+        CHECK_EQ(user_tags.size(), 1U);
+        CHECK_EQ(user_tags[0], metadata.localid + 1);
+        CHECK_EQ(std::string(log_data.data(), log_data.size()),
+                 EntryData(logspace_id, metadata.localid));
+        recovered.emplace_back(logspace_id, metadata.localid);
+    });
+    std::sort(recovered.begin(), recovered.end());
+    return recovered;
+}
+
+void TestRecoverAndRelease(const std::string& dir_path) {
+    {
+        JournalWriter writer(dir_path);
+        log::LogJournal* journal = writer.journal();
+        journal->Start();
+        CHECK(RecoverEntries(journal).empty());
+        for (uint64_t localid = 0; localid < kNumEntries; localid++) {
+            writer.Append(kLogSpaceId, localid);
+        }
+        writer.Append(kOtherLogSpaceId, 0);
+        // Released entries at the head of the journal free their segments
+        for (uint64_t localid = 0; localid < kNumEntries / 2; localid++) {
+            journal->Release(log::LogJournal::EntryKey(kLogSpaceId, localid));
+        }
+        CHECK(journal->HasReclaimableSegments());
+        journal->ReclaimSegments();
+        CHECK(!journal->HasReclaimableSegments());
+        journal->Stop();
+    }
+    {
+        JournalWriter writer(dir_path);
+        log::LogJournal* journal = writer.journal();
+        journal->Start();
+        std::vector<log::LogJournal::EntryKey> recovered = RecoverEntries(journal);
+        CHECK_EQ(recovered.size(), kNumEntries / 2 + 1);
+        for (size_t i = 0; i < kNumEntries / 2; i++) {
+            CHECK(recovered[i] == log::LogJournal::EntryKey(kLogSpaceId, kNumEntries / 2 + i));
+        }
+        CHECK(recovered.back() == log::LogJournal::EntryKey(kOtherLogSpaceId, 0));
+        // Recovered entries are kept until released
+        journal->ReleaseLogSpace(kLogSpaceId);
+        CHECK(journal->HasReclaimableSegments());
+        journal->ReclaimSegments();
+        // The segment of the other log space is still live
+        CHECK(!journal->HasReclaimableSegments());
+        // Later appends of a released log space are not registered either
+        writer.Append(kLogSpaceId, kNumEntries);
+        journal->Release(log::LogJournal::EntryKey(kOtherLogSpaceId, 0));
+        journal->ReclaimSegments();
+        journal->Stop();
+    }
+    {
+        JournalWriter writer(dir_path);
+        log::LogJournal* journal = writer.journal();
+        journal->Start();
+        std::vector<log::LogJournal::EntryKey> recovered = RecoverEntries(journal);
+        // The entry appended after release stays in the last segment
+        CHECK_EQ(recovered.size(), 1U);
+        CHECK(recovered.front() == log::LogJournal::EntryKey(kLogSpaceId, kNumEntries));
+        journal->Stop();
+    }
+    LOG(INFO) << "TestRecoverAndRelease passed";
+}
+
+void TestTornWrite(const std::string& dir_path) {
+    {
+        JournalWriter writer(dir_path);
+        writer.journal()->Start();
+        for (uint64_t localid = 0; localid < 3; localid++) {
+            writer.Append(kLogSpaceId, localid);
+        }
+        writer.journal()->Stop();
+    }
+    // Garbage after the last complete record, as left by a crash
+    std::string last_segment;
+    uint32_t last_id = 0;
+    for (uint32_t id = 0; id < 16; id++) {
+        std::string path = fs_utils::JoinPath(dir_path, fmt::format("segment_{}", id));
+        if (fs_utils::Exists(path)) {
+            std::string contents;
+            CHECK(fs_utils::ReadContents(path, &contents));
+            if (!contents.empty()) {
+                last_segment = path;
+                last_id = id;
+            }
+        }
+    }
+    CHECK(!last_segment.empty());
+    auto fd = fs_utils::Open(last_segment, O_WRONLY | O_APPEND);
+    CHECK(fd.has_value());
+    CHECK_EQ(write(*fd, "torn", 4), 4);
+    close(*fd);
+    {
+        JournalWriter writer(dir_path);
+        writer.journal()->Start();
+        std::vector<log::LogJournal::EntryKey> recovered = RecoverEntries(writer.journal());
+        CHECK_EQ(recovered.size(), 3U);
+        writer.journal()->Stop();
+    }
+    LOG(INFO) << "TestTornWrite passed (torn segment " << last_id << ")";
+}
+
+int main(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+    std::string dir_path = fs_utils::JoinPath(
+        absl::GetFlag(FLAGS_test_dir), fmt::format("boki_test_journal_{}", getpid()));
+    CHECK(fs_utils::MakeDirectory(dir_path));
+    TestRecoverAndRelease(fs_utils::JoinPath(dir_path, "recover"));
+    TestTornWrite(fs_utils::JoinPath(dir_path, "torn"));
+    CHECK(fs_utils::RemoveDirectoryRecursively(dir_path));
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include "base/init.h"
+#include "base/common.h"
+#include "utils/bits.h"
+#include "log/log_space.h"
+
+using namespace faas;
+
+static constexpr uint16_t kSequencerId = 1;
+static constexpr uint16_t kEngineId = 2;
+static constexpr uint16_t kStorageId = 3;
+static constexpr uint32_t kNumEntries = 10;
+
+static log::ViewProto MakeViewProto() {
+    log::ViewProto view_proto;
+    view_proto.set_view_id(1);
+    view_proto.set_metalog_replicas(1);
+    view_proto.set_userlog_replicas(1);
+    view_proto.set_index_replicas(1);
+    view_proto.set_num_phylogs(1);
+    view_proto.add_sequencer_nodes(kSequencerId);
+    view_proto.add_engine_nodes(kEngineId);
+    view_proto.add_storage_nodes(kStorageId);
+    view_proto.add_index_plan(kEngineId);
+    view_proto.add_storage_plan(kStorageId);
+    view_proto.add_log_space_hash_tokens(kSequencerId);
+    return view_proto;
+}
+
+static log::LogEntry MakeLogEntry(uint32_t localid_lowhalf) {
+    log::LogEntry log_entry;
+    log_entry.data = fmt::format("entry_{}", localid_lowhalf);
+    log_entry.metadata = {
+        .user_logspace = 0,
+        .seqnum = log::kInvalidLogSeqNum,
+        .localid = bits::JoinTwo32(kEngineId, localid_lowhalf),
+        .num_tags = 0,
+        .data_size = log_entry.data.size(),
+        .cond_append = false,
+        .cond_tail_seqnum = log::kInvalidLogSeqNum
+    };
+    return log_entry;
+}
+
+static log::MetaLogProto MakeNewLogs(uint32_t logspace_id, uint32_t metalog_seqnum,
+                                     uint32_t start_seqnum, uint32_t shard_start,
+                                     uint32_t delta) {
+    log::MetaLogProto meta_log;
+    meta_log.set_logspace_id(logspace_id);
+    meta_log.set_metalog_seqnum(metalog_seqnum);
+    meta_log.set_type(log::MetaLogProto::NEW_LOGS);
+    auto* new_logs = meta_log.mutable_new_logs_proto();
+    new_logs->set_start_seqnum(start_seqnum);
+    new_logs->add_shard_starts(shard_start);
+    new_logs->add_shard_deltas(delta);
+    return meta_log;
+}
+
+// Returns the data of the entry if read from memory, or "DB" if it is
+// to be read from DB
+static std::string ReadAt(log::LogStorage* storage, uint32_t seqnum_lowhalf) {
+    storage->ReadAt(protocol::SharedLogMessageHelper::NewReadAtMessage(
+        storage->identifier(), seqnum_lowhalf));
+    log::LogStorage::ReadResultVec results;
+    storage->PollReadResults(&results);
+    CHECK_EQ(results.size(), 1U);
+    const log::LogStorage::ReadResult& result = results.front();
+    switch (result.status) {
+    case log::LogStorage::ReadResult::kOK:
+        CHECK_EQ(bits::LowHalf64(result.log_entry->metadata.seqnum), seqnum_lowhalf);
+        return std::string(result.log_entry->data.data(), result.log_entry->data.size());
+    case log::LogStorage::ReadResult::kLookupDB:
+        return "DB";
+    default:
+        LOG(FATAL) << "Failed to read seqnum " << seqnum_lowhalf;
+    }
+}
+
+void TestRestoreFromCheckpoint() {
+    log::View view(MakeViewProto());
+    log::StorageCheckpointProto checkpoint;
+    {
+        log::LogStorage storage(kStorageId, &view, kSequencerId);
+        for (uint32_t i = 0; i < kNumEntries; i++) {
+            log::LogEntry log_entry = MakeLogEntry(i);
+            CHECK(storage.Store(log_entry.metadata, VECTOR_AS_SPAN(log_entry.user_tags),
+                                STRING_AS_SPAN(log_entry.data)));
+        }
+        // Entries 0-5 get seqnums, and entries 0-2 are persisted
+        CHECK(storage.ProvideMetaLog(MakeNewLogs(storage.identifier(), 0, 0, 0, 6)));
+        std::vector<log::LogEntryView> log_entries;
+        uint64_t new_position;
+        CHECK(storage.GrabLogEntriesForPersistence(&log_entries, &new_position));
+        CHECK_EQ(log_entries.size(), 6U);
+        size_t persisted_bytes = 0;
+        for (size_t i = 0; i < 3; i++) {
+            persisted_bytes += log_entries[i].data.size();
+        }
+        storage.LogEntriesPersisted(bits::JoinTwo32(storage.identifier(), 3), persisted_bytes);
+        checkpoint = storage.MakeCheckpoint();
+    }
+    CHECK_EQ(checkpoint.metalog_position(), 1U);
+    CHECK_EQ(checkpoint.seqnum_position(), 6U);
+    CHECK_EQ(checkpoint.persisted_seqnum_position(), 3U);
+    CHECK_EQ(checkpoint.shard_cuts_size(), 1);
+    CHECK_EQ(checkpoint.shard_cuts(0), 6U);
+    CHECK_EQ(checkpoint.shard_progresses(0), kNumEntries);
+    // A single run of entries with seqnums 3-5
+    CHECK_EQ(checkpoint.unpersisted_lengths_size(), 1);
+    CHECK_EQ(checkpoint.unpersisted_seqnums(0), 3U);
+    CHECK_EQ(checkpoint.unpersisted_localids(0), bits::JoinTwo32(kEngineId, 3));
+    CHECK_EQ(checkpoint.unpersisted_lengths(0), 3U);
+
+    log::LogStorage storage(kStorageId, &view, kSequencerId);
+    // Entry 3 got into DB after the checkpoint was written
+    storage.RestoreFromCheckpoint(
+        checkpoint, bits::JoinTwo32(storage.identifier(), 4));
+    CHECK(storage.restored());
+    CHECK_EQ(storage.metalog_position(), 1U);
+    for (uint32_t i = 0; i < kNumEntries; i++) {
+        // Persisted entries are not recovered
+        CHECK_EQ(storage.RecoverFromJournal(MakeLogEntry(i)), i >= 4);
+    }
+    // Live entries are recovered at most once
+    CHECK(!storage.RecoverFromJournal(MakeLogEntry(4)));
+    storage.FinishRecovery();
+
+    // Entries 4-5 are live with seqnums recorded by the checkpoint
+    CHECK_EQ(ReadAt(&storage, 2), "DB");
+    CHECK_EQ(ReadAt(&storage, 3), "DB");
+    CHECK_EQ(ReadAt(&storage, 4), "entry_4");
+    CHECK_EQ(ReadAt(&storage, 5), "entry_5");
+    CHECK_EQ(storage.unpersisted_bytes(), std::string("entry_4").size() * 2);
+    std::vector<log::LogEntryView> log_entries;
+    uint64_t new_position;
+    CHECK(storage.GrabLogEntriesForPersistence(&log_entries, &new_position));
+    CHECK_EQ(log_entries.size(), 2U);
+    CHECK_EQ(new_position, bits::JoinTwo32(storage.identifier(), 6));
+
+    // Entries 6-9 are pending again, and get seqnums from later meta logs
+    CHECK(storage.ProvideMetaLog(MakeNewLogs(storage.identifier(), 1, 6, 6, 4)));
+    for (uint32_t seqnum = 6; seqnum < 10; seqnum++) {
+        CHECK_EQ(ReadAt(&storage, seqnum), fmt::format("entry_{}", seqnum));
+    }
+    LOG(INFO) << "TestRestoreFromCheckpoint passed";
+}
+
+int main(int argc, char* argv[]) {
+    base::InitMain(argc, argv);
+    TestRestoreFromCheckpoint();
+    return 0;
+}
@@ -85,20 +85,27 @@ enum class MessageType : uint16_t {
 };
 
 enum class SharedLogOpType : uint16_t {
-    INVALID     = 0x00,
-    APPEND      = 0x01,  // FuncWorker to Engine
-    READ_NEXT   = 0x02,  // FuncWorker to Engine, Engine to Index
-    READ_PREV   = 0x03,  // FuncWorker to Engine, Engine to Index
-    TRIM        = 0x04,  // FuncWorker to Engine, Engine to Sequencer
-    SET_AUXDATA = 0x05,  // FuncWorker to Engine, Engine to Storage
-    READ_NEXT_B = 0x06,  // FuncWorker to Engine, Engine to Index
-    READ_AT     = 0x10,  // Index to Storage
-    REPLICATE   = 0x11,  // Engine to Storage
-    INDEX_DATA  = 0x12,  // Engine to Index
-    SHARD_PROG  = 0x13,  // Storage to Sequencer
-    METALOGS    = 0x14,  // Sequencer to Sequencer, Engine, Storage, Index
-    META_PROG   = 0x15,  // Sequencer to Sequencer
-    RESPONSE    = 0x20
+    INVALID         = 0x00,
+    APPEND          = 0x01,  // FuncWorker to Engine
+    READ_NEXT       = 0x02,  // FuncWorker to Engine, Engine to Index
+    READ_PREV       = 0x03,  // FuncWorker to Engine, Engine to Index
+    TRIM            = 0x04,  // FuncWorker to Engine, Engine to Sequencer
+    SET_AUXDATA     = 0x05,  // FuncWorker to Engine, Engine to Storage
+    READ_NEXT_B     = 0x06,  // FuncWorker to Engine, Engine to Index
+    ASYNC_APPEND    = 0x07,  // FuncWorker to Engine
+    RESOLVE_LOCALID = 0x08,  // FuncWorker to Engine
+    COND_APPEND     = 0x09,  // FuncWorker to Engine
+    SUBSCRIBE       = 0x0a,  // FuncWorker to Engine
+    UNSUBSCRIBE     = 0x0b,  // FuncWorker to Engine
+    SUB_CREDITS     = 0x0c,  // FuncWorker to Engine
+    READ_AT         = 0x10,  // Index to Storage
+    REPLICATE       = 0x11,  // Engine to Storage
+    INDEX_DATA      = 0x12,  // Engine to Index
+    SHARD_PROG      = 0x13,  // Storage to Sequencer, Engine
+    METALOGS        = 0x14,  // Sequencer to Sequencer, Engine, Storage, Index
+    META_PROG       = 0x15,  // Sequencer to Sequencer
+    TAG_SUMMARY     = 0x16,  // Engine to Engine
+    RESPONSE        = 0x20
 };
 
 enum class SharedLogResultType : uint16_t {
@@ -114,7 +121,15 @@ enum class SharedLogResultType : uint16_t {
     DISCARDED   = 0x31,  // Log to append is discarded
     EMPTY       = 0x32,  // Cannot find log entries satisfying requirements
     DATA_LOST   = 0x33,  // Failed to extract log data
-    TRIM_FAILED = 0x34
+    TRIM_FAILED = 0x34,
+    COND_FAILED = 0x35   // Condition of conditional append not satisfied
+};
+
+enum class ReadConsistency : uint16_t {
+    STRICT            = 0,  // Wait for index to catch up with the function
+    BOUNDED_POSITIONS = 1,  // Allow index to lag behind by metalog positions
+    BOUNDED_MICROS    = 2,  // Allow index to lag behind by microseconds
+    LOCAL_LATEST      = 3   // Use whatever index has
 };
 
 constexpr uint64_t kInvalidLogTag     = std::numeric_limits<uint64_t>::max();
@@ -126,6 +141,8 @@ constexpr uint32_t kFuncWorkerUseEngineSocketFlag = (1 << 0);
 constexpr uint32_t kUseFifoForNestedCallFlag      = (1 << 1);
 constexpr uint32_t kAsyncInvokeFuncFlag           = (1 << 2);
 constexpr uint32_t kUseAuxBufferFlag              = (1 << 3);
+constexpr uint32_t kSubscribeWithDataFlag         = (1 << 4);
+constexpr uint32_t kReadNoCacheFlag               = (1 << 5);
 
 struct Message {
     struct {
@@ -164,7 +181,15 @@ struct Message {
     uint64_t log_tag;             // [40:48]
     uint64_t log_client_data;     // [48:56] will be preserved for response to clients
 
-    uint64_t _8_padding_8_;
+    union {
+        struct {
+            uint16_t log_read_consistency;  // [56:58] Used in SHARED_LOG_OP (reads)
+            uint16_t _2_padding_2_;
+            uint32_t log_staleness_bound;   // [60:64] Used in SHARED_LOG_OP (reads)
+        } __attribute__ ((packed));
+        uint32_t log_sub_credits;           // [56:60] Used in SHARED_LOG_OP (subscriptions)
+        uint64_t log_metalog_progress;      // [56:64] Used in SHARED_LOG_OP (responses)
+    };
 
     char inline_data[__FAAS_MESSAGE_SIZE - __FAAS_CACHE_LINE_SIZE]
         __attribute__ ((aligned (__FAAS_CACHE_LINE_SIZE)));
@@ -237,7 +262,12 @@ struct GatewayMessage {
 
 static_assert(sizeof(GatewayMessage) == 16, "Unexpected GatewayMessage size");
 
-constexpr uint16_t kReadInitialFlag = (1 << 0);
+constexpr uint16_t kReadInitialFlag    = (1 << 0);
+constexpr uint16_t kFlatMetaLogsFlag   = (1 << 1);
+constexpr uint16_t kReplicateBatchFlag = (1 << 2);
+constexpr uint16_t kCondAppendFlag     = (1 << 3);
+constexpr uint16_t kReadCondCheckFlag  = (1 << 4);
+constexpr uint16_t kReadTagSetFlag     = (1 << 5);
 
 struct SharedLogMessage {
     uint16_t op_type;         // [0:2]
@@ -289,7 +319,10 @@ struct SharedLogMessage {
     };
     uint64_t client_data;       // [48:56]
 
-    uint64_t prev_found_seqnum; // [56:64]
+    union {
+        uint64_t prev_found_seqnum; // [56:64]
+        uint64_t cond_tail_seqnum;  // [56:64] (only used by REPLICATE)
+    };
 
 } __attribute__ (( packed, aligned(__FAAS_CACHE_LINE_SIZE) ));
 
@@ -635,6 +668,13 @@ public:
         return message;
     }
 
+    static SharedLogMessage NewTagSummaryMessage(uint32_t logspace_id) {
+        NEW_EMPTY_SHAREDLOG_MESSAGE(message);
+        message.op_type = static_cast<uint16_t>(SharedLogOpType::TAG_SUMMARY);
+        message.logspace_id = logspace_id;
+        return message;
+    }
+
     static SharedLogMessage NewReadMessage(SharedLogOpType op_type) {
         NEW_EMPTY_SHAREDLOG_MESSAGE(message);
         message.op_type = static_cast<uint16_t>(op_type);
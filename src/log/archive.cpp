@@ -0,0 +1,476 @@
+#include "log/archive.h"
+
+#include "utils/bits.h"
+#include "utils/fs.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+__BEGIN_THIRD_PARTY_HEADERS
+#include <zstd.h>
+__END_THIRD_PARTY_HEADERS
+
+#define log_header_ "LogArchive: "
+
+namespace faas {
+namespace log {
+
+namespace {
+static constexpr uint32_t kSegmentMagic = 0x41524348;  // "ARCH"
+static constexpr std::string_view kSegmentSuffix = ".seg";
+static constexpr std::string_view kTmpSuffix = ".tmp";
+
+// Block contents are records of {key, size, data}, ordered by key
+struct RecordHeader {
+    uint32_t key;
+    uint32_t size;
+};
+
+// At the end of the segment file, following the block index
+struct SegmentFooter {
+    uint64_t index_offset;
+    uint32_t logspace_id;
+    uint32_t start_key;
+    uint32_t end_key;
+    uint32_t num_blocks;
+    uint32_t num_entries;
+    uint32_t magic;
+};
+
+static ZSTD_CCtx* ThreadLocalCCtx() {
+    static thread_local std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)>
+        cctx(ZSTD_createCCtx(), &ZSTD_freeCCtx);
+    return cctx.get();
+}
+
+static ZSTD_DCtx* ThreadLocalDCtx() {
+    static thread_local std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)>
+        dctx(ZSTD_createDCtx(), &ZSTD_freeDCtx);
+    return dctx.get();
+}
+
+static bool WriteAll(int fd, std::span<const char> data) {
+    while (!data.empty()) {
+        ssize_t ret = write(fd, data.data(), data.size());
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            PLOG(ERROR) << "Failed to write segment file";
+            return false;
+        }
+        data = data.subspan(static_cast<size_t>(ret));
+    }
+    return true;
+}
+
+static bool ReadAll(int fd, uint64_t offset, size_t size, std::string* data) {
+    data->resize(size);
+    size_t pos = 0;
+    while (pos < size) {
+        ssize_t ret = pread(fd, data->data() + pos, size - pos,
+                            static_cast<off_t>(offset + pos));
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            PLOG(ERROR) << "Failed to read segment file";
+            return false;
+        }
+        pos += static_cast<size_t>(ret);
+    }
+    return true;
+}
+
+static std::string SegmentFileName(uint32_t logspace_id, uint32_t start_key) {
+    return fmt::format("{}_{}{}", bits::HexStr(logspace_id),
+                       bits::HexStr(start_key), kSegmentSuffix);
+}
+}  // namespace
+
+LogArchive::SegmentFile::~SegmentFile() {
+    PCHECK(close(fd) == 0) << "Failed to close segment file";
+}
+
+LogArchive::LogArchive(std::string_view dir_path, size_t block_size,
+                       size_t max_open_files, int level)
+    : dir_path_(dir_path),
+      block_size_(block_size),
+      max_open_files_(max_open_files),
+      level_(level),
+      archived_entries_(0),
+      archived_raw_bytes_(0),
+      archived_file_bytes_(0),
+      num_reads_(0),
+      read_file_bytes_(0),
+      read_block_bytes_(0),
+      returned_bytes_(0) {
+    DCHECK_GT(block_size, 0U);
+    DCHECK_GT(max_open_files, 0U);
+}
+
+LogArchive::~LogArchive() {}
+
+void LogArchive::Start() {
+    if (!fs_utils::IsDirectory(dir_path_)) {
+        CHECK(fs_utils::MakeDirectory(dir_path_))
+            << "Failed to create archive directory " << dir_path_;
+    }
+    std::vector<std::string> paths;
+    DIR* dir = opendir(dir_path_.c_str());
+    PCHECK(dir != nullptr) << "Failed to open archive directory " << dir_path_;
+    while (struct dirent* entry = readdir(dir)) {
+        std::string_view name(entry->d_name);
+        if (absl::EndsWith(name, kSegmentSuffix)) {
+            paths.push_back(fs_utils::JoinPath(dir_path_, name));
+        } else if (absl::EndsWith(name, kTmpSuffix)) {
+            // Segment not completed before crash, its entries are still in DB
+            fs_utils::Remove(fs_utils::JoinPath(dir_path_, name));
+        }
+    }
+    closedir(dir);
+    size_t num_segments = 0;
+    absl::MutexLock lk(&mu_);
+    for (const std::string& path : paths) {
+        std::shared_ptr<const Segment> segment = LoadSegment(path);
+        if (segment == nullptr) {
+            continue;
+        }
+        segments_[segment->logspace_id][segment->start_key] = std::move(segment);
+        num_segments++;
+    }
+    HLOG_F(INFO, "Loaded {} segments of {} log spaces from {}",
+           num_segments, segments_.size(), dir_path_);
+}
+
+std::shared_ptr<const LogArchive::Segment> LogArchive::LoadSegment(const std::string& path) {
+    auto fd = fs_utils::Open(path, O_RDONLY);
+    if (!fd.has_value()) {
+        HLOG_F(ERROR, "Failed to open segment file {}", path);
+        return nullptr;
+    }
+    // Closed on return, reads open the file again
+    SegmentFile file = { .fd = *fd };
+    auto segment = std::make_shared<Segment>();
+    segment->path = path;
+    struct stat st;
+    PCHECK(fstat(*fd, &st) == 0) << "Failed to stat segment file " << path;
+    uint64_t file_size = static_cast<uint64_t>(st.st_size);
+    std::string buf;
+    SegmentFooter footer;
+    if (file_size < sizeof(SegmentFooter)
+            || !ReadAll(*fd, file_size - sizeof(SegmentFooter), sizeof(SegmentFooter), &buf)) {
+        HLOG_F(ERROR, "Segment file {} too short", path);
+        return nullptr;
+    }
+    memcpy(&footer, buf.data(), sizeof(SegmentFooter));
+    size_t index_size = footer.num_blocks * sizeof(BlockIndex);
+    if (footer.magic != kSegmentMagic
+            || footer.index_offset + index_size + sizeof(SegmentFooter) != file_size
+            || !ReadAll(*fd, footer.index_offset, index_size, &buf)) {
+        HLOG_F(ERROR, "Corrupted segment file {}", path);
+        return nullptr;
+    }
+    segment->logspace_id = footer.logspace_id;
+    segment->start_key = footer.start_key;
+    segment->end_key = footer.end_key;
+    segment->blocks.resize(footer.num_blocks);
+    memcpy(segment->blocks.data(), buf.data(), index_size);
+    return segment;
+}
+
+uint32_t LogArchive::archived_position(uint32_t logspace_id) {
+    absl::MutexLock lk(&mu_);
+    if (auto iter = segments_.find(logspace_id);
+            iter != segments_.end() && !iter->second.empty()) {
+        return iter->second.rbegin()->second->end_key;
+    }
+    return 0;
+}
+
+bool LogArchive::WriteSegment(uint32_t logspace_id,
+                              const DBInterface::KeyValueVec& records) {
+    DCHECK(!records.empty());
+    uint32_t start_key = records.front().first;
+    uint32_t end_key = records.back().first + 1;
+    DCHECK_GE(start_key, archived_position(logspace_id));
+    std::string path = fs_utils::JoinPath(dir_path_, SegmentFileName(logspace_id, start_key));
+    std::string tmp_path = absl::StrCat(path, kTmpSuffix);
+    auto fd = fs_utils::Create(tmp_path);
+    if (!fd.has_value()) {
+        HLOG_F(ERROR, "Failed to create segment file {}", tmp_path);
+        return false;
+    }
+
+    auto segment = std::make_shared<Segment>();
+    segment->path = path;
+    segment->logspace_id = logspace_id;
+    segment->start_key = start_key;
+    segment->end_key = end_key;
+    uint64_t offset = 0;
+    uint64_t raw_bytes = 0;
+    std::string block;
+    std::string compressed;
+    bool success = true;
+    for (size_t i = 0; i < records.size() && success; i++) {
+        const auto& [key, data] = records[i];
+        DCHECK(i == 0 || key > records[i - 1].first);
+        if (block.empty()) {
+            segment->blocks.push_back(BlockIndex {
+                .offset = offset, .first_key = key, .size = 0
+            });
+        }
+        RecordHeader header = {
+            .key = key,
+            .size = gsl::narrow_cast<uint32_t>(data.size())
+        };
+        block.append(reinterpret_cast<const char*>(&header), sizeof(RecordHeader));
+        block.append(data);
+        raw_bytes += data.size();
+        if (block.size() < block_size_ && i + 1 < records.size()) {
+            continue;
+        }
+        compressed.resize(ZSTD_compressBound(block.size()));
+        size_t ret = ZSTD_compressCCtx(ThreadLocalCCtx(), compressed.data(), compressed.size(),
+                                       block.data(), block.size(), level_);
+        if (ZSTD_isError(ret)) {
+            HLOG_F(ERROR, "Failed to compress block: {}", ZSTD_getErrorName(ret));
+            success = false;
+            break;
+        }
+        segment->blocks.back().size = gsl::narrow_cast<uint32_t>(ret);
+        success = WriteAll(*fd, std::span<const char>(compressed.data(), ret));
+        offset += ret;
+        block.clear();
+    }
+    SegmentFooter footer = {
+        .index_offset = offset,
+        .logspace_id = logspace_id,
+        .start_key = start_key,
+        .end_key = end_key,
+        .num_blocks = gsl::narrow_cast<uint32_t>(segment->blocks.size()),
+        .num_entries = gsl::narrow_cast<uint32_t>(records.size()),
+        .magic = kSegmentMagic
+    };
+    success = success
+           && WriteAll(*fd, VECTOR_AS_CHAR_SPAN(segment->blocks))
+           && WriteAll(*fd, std::span<const char>(reinterpret_cast<const char*>(&footer),
+                                                  sizeof(SegmentFooter)));
+    if (success && fdatasync(*fd) != 0) {
+        PLOG(ERROR) << "Failed to sync segment file";
+        success = false;
+    }
+    PCHECK(close(*fd) == 0) << "Failed to close segment file";
+    if (success && rename(tmp_path.c_str(), path.c_str()) != 0) {
+        PLOG(ERROR) << "Failed to rename segment file " << tmp_path;
+        success = false;
+    }
+    if (!success) {
+        fs_utils::Remove(tmp_path);
+        return false;
+    }
+    // Make the rename durable before entries are removed from DB
+    if (auto dir_fd = fs_utils::Open(dir_path_, O_RDONLY); dir_fd.has_value()) {
+        PCHECK(fsync(*dir_fd) == 0) << "Failed to sync archive directory";
+        PCHECK(close(*dir_fd) == 0);
+    }
+    uint64_t file_bytes = offset + footer.num_blocks * sizeof(BlockIndex)
+                          + sizeof(SegmentFooter);
+    HVLOG_F(1, "Archive {} entries of log space {} in [{}, {}), "
+               "raw_bytes={}, file_bytes={}",
+            records.size(), bits::HexStr0x(logspace_id), bits::HexStr0x(start_key),
+            bits::HexStr0x(end_key), raw_bytes, file_bytes);
+    archived_entries_.fetch_add(records.size(), std::memory_order_relaxed);
+    archived_raw_bytes_.fetch_add(raw_bytes, std::memory_order_relaxed);
+    archived_file_bytes_.fetch_add(file_bytes, std::memory_order_relaxed);
+    {
+        absl::MutexLock lk(&mu_);
+        segments_[logspace_id][start_key] = std::move(segment);
+    }
+    ReportStatIfNeeded();
+    return true;
+}
+
+std::shared_ptr<const LogArchive::Segment> LogArchive::FindSegment(uint32_t logspace_id,
+                                                                   uint32_t key) {
+    absl::MutexLock lk(&mu_);
+    auto iter = segments_.find(logspace_id);
+    if (iter == segments_.end()) {
+        return nullptr;
+    }
+    const auto& logspace_segments = iter->second;
+    auto segment_iter = logspace_segments.upper_bound(key);
+    if (segment_iter == logspace_segments.begin()) {
+        return nullptr;
+    }
+    --segment_iter;
+    if (key >= segment_iter->second->end_key) {
+        return nullptr;
+    }
+    return segment_iter->second;
+}
+
+std::shared_ptr<const LogArchive::Segment> LogArchive::FindNextSegment(uint32_t logspace_id,
+                                                                       uint32_t key) {
+    absl::MutexLock lk(&mu_);
+    auto iter = segments_.find(logspace_id);
+    if (iter == segments_.end()) {
+        return nullptr;
+    }
+    auto segment_iter = iter->second.lower_bound(key);
+    if (segment_iter == iter->second.end()) {
+        return nullptr;
+    }
+    return segment_iter->second;
+}
+
+std::shared_ptr<const LogArchive::SegmentFile> LogArchive::OpenSegmentFile(
+        const Segment& segment) {
+    {
+        absl::MutexLock lk(&files_mu_);
+        if (auto iter = open_file_index_.find(segment.path); iter != open_file_index_.end()) {
+            open_files_.splice(open_files_.begin(), open_files_, iter->second);
+            return iter->second->second;
+        }
+    }
+    auto fd = fs_utils::Open(segment.path, O_RDONLY);
+    if (!fd.has_value()) {
+        HLOG_F(ERROR, "Failed to open segment file {}", segment.path);
+        return nullptr;
+    }
+    auto file = std::make_shared<SegmentFile>();
+    file->fd = *fd;
+    absl::MutexLock lk(&files_mu_);
+    if (auto iter = open_file_index_.find(segment.path); iter != open_file_index_.end()) {
+        // Opened concurrently, ours is closed on return
+        return iter->second->second;
+    }
+    open_files_.emplace_front(segment.path, file);
+    open_file_index_[segment.path] = open_files_.begin();
+    while (open_files_.size() > max_open_files_) {
+        open_file_index_.erase(open_files_.back().first);
+        open_files_.pop_back();
+    }
+    return file;
+}
+
+bool LogArchive::ReadBlock(const Segment& segment, const SegmentFile& file, size_t block_idx,
+                           std::string* data) {
+    const BlockIndex& block = segment.blocks.at(block_idx);
+    std::string compressed;
+    if (!ReadAll(file.fd, block.offset, block.size, &compressed)) {
+        return false;
+    }
+    unsigned long long size = ZSTD_getFrameContentSize(compressed.data(), compressed.size());
+    if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR) {
+        HLOG_F(ERROR, "Invalid block {} of segment file {}", block_idx, segment.path);
+        return false;
+    }
+    data->resize(static_cast<size_t>(size));
+    size_t ret = ZSTD_decompressDCtx(ThreadLocalDCtx(), data->data(), data->size(),
+                                     compressed.data(), compressed.size());
+    if (ZSTD_isError(ret)) {
+        HLOG_F(ERROR, "Failed to decompress block {} of segment file {}: {}",
+               block_idx, segment.path, ZSTD_getErrorName(ret));
+        return false;
+    }
+    num_reads_.fetch_add(1, std::memory_order_relaxed);
+    read_file_bytes_.fetch_add(block.size, std::memory_order_relaxed);
+    read_block_bytes_.fetch_add(ret, std::memory_order_relaxed);
+    return true;
+}
+
+std::optional<std::string> LogArchive::Get(uint32_t logspace_id, uint32_t key) {
+    DBInterface::KeyValueVec results;
+    Scan(logspace_id, key, 1, &results);
+    if (results.empty() || results.front().first != key) {
+        return std::nullopt;
+    }
+    return std::move(results.front().second);
+}
+
+void LogArchive::Scan(uint32_t logspace_id, uint32_t start_key, size_t max_entries,
+                      DBInterface::KeyValueVec* results) {
+    results->clear();
+    uint64_t returned_bytes = 0;
+    std::shared_ptr<const Segment> segment = FindSegment(logspace_id, start_key);
+    if (segment == nullptr) {
+        segment = FindNextSegment(logspace_id, start_key);
+    }
+    while (segment != nullptr && results->size() < max_entries) {
+        if (!ScanSegment(*segment, start_key, max_entries, results, &returned_bytes)) {
+            break;
+        }
+        // Keys between segments belong to other storage shards
+        segment = FindNextSegment(logspace_id, segment->end_key);
+    }
+    returned_bytes_.fetch_add(returned_bytes, std::memory_order_relaxed);
+    ReportStatIfNeeded();
+}
+
+bool LogArchive::ScanSegment(const Segment& segment, uint32_t start_key, size_t max_entries,
+                             DBInterface::KeyValueVec* results, uint64_t* returned_bytes) {
+    std::shared_ptr<const SegmentFile> file = OpenSegmentFile(segment);
+    if (file == nullptr) {
+        return false;
+    }
+    const std::vector<BlockIndex>& blocks = segment.blocks;
+    auto iter = absl::c_upper_bound(
+        blocks, start_key,
+        [] (uint32_t key, const BlockIndex& block) { return key < block.first_key; });
+    size_t block_idx = iter == blocks.begin()
+                       ? 0 : static_cast<size_t>(iter - blocks.begin()) - 1;
+    std::string data;
+    for (; block_idx < blocks.size() && results->size() < max_entries; block_idx++) {
+        if (!ReadBlock(segment, *file, block_idx, &data)) {
+            return false;
+        }
+        std::span<const char> remaining = STRING_AS_SPAN(data);
+        while (remaining.size() >= sizeof(RecordHeader) && results->size() < max_entries) {
+            RecordHeader header;
+            memcpy(&header, remaining.data(), sizeof(RecordHeader));
+            if (remaining.size() < sizeof(RecordHeader) + header.size) {
+                HLOG_F(ERROR, "Truncated block {} of segment file {}",
+                       block_idx, segment.path);
+                return false;
+            }
+            if (header.key >= start_key) {
+                results->emplace_back(
+                    header.key, std::string(remaining.data() + sizeof(RecordHeader),
+                                            header.size));
+                *returned_bytes += header.size;
+            }
+            remaining = remaining.subspan(sizeof(RecordHeader) + header.size);
+        }
+    }
+    return true;
+}
+
+void LogArchive::ReportStatIfNeeded() {
+    absl::MutexLock lk(&stat_mu_);
+    if (!stat_timer_.Check()) {
+        return;
+    }
+    int duration_ms;
+    stat_timer_.MarkReport(&duration_ms);
+    uint64_t archived_raw_bytes = archived_raw_bytes_.exchange(0, std::memory_order_relaxed);
+    uint64_t archived_file_bytes = archived_file_bytes_.exchange(0, std::memory_order_relaxed);
+    uint64_t read_block_bytes = read_block_bytes_.exchange(0, std::memory_order_relaxed);
+    uint64_t returned_bytes = returned_bytes_.exchange(0, std::memory_order_relaxed);
+    // Read amplification is decompressed block bytes per returned entry byte
+    HLOG_F(INFO, "Archive statistics in last {}ms: archived_entries={}, "
+                 "archived_raw_bytes={}, archived_file_bytes={}, compression_ratio={:.2f}, "
+                 "block_reads={}, read_file_bytes={}, read_amplification={:.2f}",
+           duration_ms, archived_entries_.exchange(0, std::memory_order_relaxed),
+           archived_raw_bytes, archived_file_bytes,
+           archived_file_bytes > 0
+               ? static_cast<double>(archived_raw_bytes) / archived_file_bytes : 0.0,
+           num_reads_.exchange(0, std::memory_order_relaxed),
+           read_file_bytes_.exchange(0, std::memory_order_relaxed),
+           returned_bytes > 0
+               ? static_cast<double>(read_block_bytes) / returned_bytes : 0.0);
+}
+
+}  // namespace log
+}  // namespace faas
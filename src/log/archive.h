@@ -0,0 +1,100 @@
+#pragma once
+
+#include "log/common.h"
+#include "log/db.h"
+#include "common/stat.h"
+
+namespace faas {
+namespace log {
+
+// Archive of cold log entries of storage nodes, on a secondary path.
+// Persisted entries of a log space are moved out of DB in key order, into
+// immutable segment files. A segment holds consecutive entries in zstd
+// compressed blocks, followed by a sparse index of the first key of each
+// block, so that reading one entry decompresses one block. At most
+// `max_open_files` segment files are kept open for reads, in LRU order.
+class LogArchive {
+public:
+    LogArchive(std::string_view dir_path, size_t block_size, size_t max_open_files,
+               int level);
+    ~LogArchive();
+
+    // Loads segments written by previous runs
+    void Start();
+
+    // Entries of the log space below the returned key are archived
+    uint32_t archived_position(uint32_t logspace_id);
+
+    // `records` are ordered by key, starting at or above archived_position.
+    // Returns false if the segment is not durable, when entries stay in DB.
+    bool WriteSegment(uint32_t logspace_id, const DBInterface::KeyValueVec& records);
+
+    std::optional<std::string> Get(uint32_t logspace_id, uint32_t key);
+    // Scans entries from `start_key`, continuing into following segments
+    void Scan(uint32_t logspace_id, uint32_t start_key, size_t max_entries,
+              DBInterface::KeyValueVec* results);
+
+private:
+    const std::string dir_path_;
+    const size_t block_size_;
+    const size_t max_open_files_;
+    const int level_;
+
+    struct BlockIndex {
+        uint64_t offset;
+        uint32_t first_key;
+        uint32_t size;
+    };
+    struct Segment {
+        std::string path;
+        uint32_t logspace_id;
+        uint32_t start_key;
+        uint32_t end_key;  // Following the last entry
+        std::vector<BlockIndex> blocks;
+    };
+    // Closed once evicted from open_files_ and done with by readers
+    struct SegmentFile {
+        int fd;
+
+        ~SegmentFile();
+    };
+
+    absl::Mutex mu_;
+    absl::flat_hash_map</* logspace_id */ uint32_t,
+                        std::map</* start_key */ uint32_t, std::shared_ptr<const Segment>>>
+        segments_ ABSL_GUARDED_BY(mu_);
+
+    using FileList = std::list<std::pair</* path */ std::string,
+                                         std::shared_ptr<const SegmentFile>>>;
+    absl::Mutex files_mu_;
+    FileList open_files_ ABSL_GUARDED_BY(files_mu_);  // Most recently used first
+    absl::flat_hash_map</* path */ std::string, FileList::iterator>
+        open_file_index_ ABSL_GUARDED_BY(files_mu_);
+
+    std::atomic<uint64_t> archived_entries_;
+    std::atomic<uint64_t> archived_raw_bytes_;
+    std::atomic<uint64_t> archived_file_bytes_;
+    std::atomic<uint64_t> num_reads_;
+    std::atomic<uint64_t> read_file_bytes_;
+    std::atomic<uint64_t> read_block_bytes_;
+    std::atomic<uint64_t> returned_bytes_;
+    absl::Mutex stat_mu_;
+    stat::ReportTimer stat_timer_ ABSL_GUARDED_BY(stat_mu_);
+
+    std::shared_ptr<const Segment> LoadSegment(const std::string& path);
+    std::shared_ptr<const Segment> FindSegment(uint32_t logspace_id, uint32_t key);
+    // Returns the first segment starting at or above `key`
+    std::shared_ptr<const Segment> FindNextSegment(uint32_t logspace_id, uint32_t key);
+    std::shared_ptr<const SegmentFile> OpenSegmentFile(const Segment& segment);
+    bool ReadBlock(const Segment& segment, const SegmentFile& file, size_t block_idx,
+                   std::string* data);
+    // Appends entries of the segment from `start_key`. Returns false on read errors.
+    bool ScanSegment(const Segment& segment, uint32_t start_key, size_t max_entries,
+                     DBInterface::KeyValueVec* results, uint64_t* returned_bytes);
+    void ReportStatIfNeeded();
+
+    DISALLOW_COPY_AND_ASSIGN(LogArchive);
+};
+
+}  // namespace log
+}  // namespace faas
@@ -1,23 +1,17 @@
 #include "log/cache.h"
 
-__BEGIN_THIRD_PARTY_HEADERS
-#include <tkrzw_dbm_cache.h>
-__END_THIRD_PARTY_HEADERS
+#include "utils/bits.h"
+#include "utils/fs.h"
+
+#include <fcntl.h>
+#include <dirent.h>
 
 namespace faas {
 namespace log {
 
-LRUCache::LRUCache(int mem_cap_mb) {
-    int64_t cap_mem_size = -1;
-    if (mem_cap_mb > 0) {
-        cap_mem_size = int64_t{mem_cap_mb} << 20;
-    }
-    dbm_.reset(new tkrzw::CacheDBM(/* cap_rec_num= */ -1, cap_mem_size));
-}
-
-LRUCache::~LRUCache() {}
-
 namespace {
+static constexpr std::string_view kSegmentPrefix = "segment_";
+
 static inline std::string EncodeLogEntry(const LogMetaData& log_metadata,
                                          std::span<const uint64_t> user_tags,
                                          std::span<const char> log_data) {
@@ -63,20 +57,234 @@ static inline void DecodeLogEntry(std::string encoded, LogEntry* log_entry) {
 }
 }  // namespace
 
-void LRUCache::Put(const LogMetaData& log_metadata, std::span<const uint64_t> user_tags,
-                   std::span<const char> log_data) {
-    std::string key_str = fmt::format("0_{:016x}", log_metadata.seqnum);
+namespace {
+// Rough cost of bookkeeping a cached entry
+static constexpr size_t kEntryOverhead = 64;
+// Used to size frequency sketches
+static constexpr size_t kAverageEntrySize = 1024;
+static constexpr size_t kMinSketchWidth = size_t{1} << 10;
+static constexpr size_t kMaxSketchWidth = size_t{1} << 22;
+}  // namespace
+
+// Count-min sketch of access frequencies, with 4 rows of counters saturated
+// at 15. All counters are halved once the number of recorded accesses
+// reaches 10 times the width, so that estimates follow recent history.
+class LRUCache::FrequencySketch {
+public:
+    explicit FrequencySketch(size_t width)
+        : mask_(width - 1),
+          counters_(kDepth * width, 0),
+          num_accesses_(0),
+          reset_threshold_(10 * width) {
+        DCHECK_EQ(width & mask_, 0U);
+    }
+
+    void Record(uint64_t seqnum) {
+        uint64_t hash = Hash(seqnum);
+        for (size_t row = 0; row < kDepth; row++) {
+            uint8_t& counter = counters_[Index(hash, row)];
+            if (counter < kMaxFrequency) {
+                counter++;
+            }
+        }
+        if (++num_accesses_ >= reset_threshold_) {
+            for (uint8_t& counter : counters_) {
+                counter >>= 1;
+            }
+            num_accesses_ /= 2;
+        }
+    }
+
+    uint8_t Estimate(uint64_t seqnum) const {
+        uint64_t hash = Hash(seqnum);
+        uint8_t result = kMaxFrequency;
+        for (size_t row = 0; row < kDepth; row++) {
+            result = std::min(result, counters_[Index(hash, row)]);
+        }
+        return result;
+    }
+
+private:
+    static constexpr size_t kDepth = 4;
+    static constexpr uint8_t kMaxFrequency = 15;
+
+    const size_t mask_;
+    std::vector<uint8_t> counters_;
+    size_t num_accesses_;
+    const size_t reset_threshold_;
+
+    static uint64_t Hash(uint64_t seqnum) {
+        return absl::Hash<uint64_t>{}(seqnum);
+    }
+
+    size_t Index(uint64_t hash, size_t row) const {
+        // Double hashing
+        uint64_t h = hash + row * ((hash >> 32) | 1);
+        return row * (mask_ + 1) + gsl::narrow_cast<size_t>(h & mask_);
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(FrequencySketch);
+};
+
+struct LRUCache::Partition {
+    using Key = std::pair</* seqnum */ uint64_t, /* aux_data */ bool>;
+    using EntryList = std::list<std::pair<Key, std::string>>;
+
+    absl::Mutex mu;
+    size_t size ABSL_GUARDED_BY(mu);
+    EntryList entries ABSL_GUARDED_BY(mu);  // Most recently used first
+    absl::flat_hash_map<Key, EntryList::iterator> entry_map ABSL_GUARDED_BY(mu);
+    FrequencySketch sketch ABSL_GUARDED_BY(mu);
+
+    uint64_t hits ABSL_GUARDED_BY(mu);
+    uint64_t misses ABSL_GUARDED_BY(mu);
+    uint64_t evictions ABSL_GUARDED_BY(mu);
+    uint64_t rejections ABSL_GUARDED_BY(mu);
+
+    explicit Partition(size_t sketch_width)
+        : size(0),
+          sketch(sketch_width),
+          hits(0), misses(0), evictions(0), rejections(0) {}
+
+    static size_t EntrySize(const std::string& data) {
+        return data.size() + kEntryOverhead;
+    }
+
+    // `capacity` in bytes, 0 for unlimited. Evicted log entries are moved
+    // into `evicted` if not nullptr.
+    bool Insert(const Key& key, std::string data, size_t capacity, bool admission,
+                EvictedVec* evicted) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu);
+    std::optional<std::string> Lookup(const Key& key, bool touch)
+        ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu);
+};
+
+bool LRUCache::Partition::Insert(const Key& key, std::string data, size_t capacity,
+                                 bool admission, EvictedVec* evicted) {
+    if (auto iter = entry_map.find(key); iter != entry_map.end()) {
+        if (!key.second) {
+            // Log entries never change
+            return true;
+        }
+        size -= EntrySize(iter->second->second);
+        entries.erase(iter->second);
+        entry_map.erase(iter);
+    }
+    size_t entry_size = EntrySize(data);
+    if (admission && capacity > 0 && size + entry_size > capacity && !entries.empty()) {
+        const Key& victim = entries.back().first;
+        if (sketch.Estimate(key.first) < sketch.Estimate(victim.first)) {
+            rejections++;
+            return false;
+        }
+    }
+    entries.emplace_front(key, std::move(data));
+    entry_map[key] = entries.begin();
+    size += entry_size;
+    while (capacity > 0 && size > capacity && entries.size() > 1) {
+        auto& [victim, victim_data] = entries.back();
+        size -= EntrySize(victim_data);
+        entry_map.erase(victim);
+        if (evicted != nullptr && !victim.second) {
+            evicted->emplace_back(victim.first, std::move(victim_data));
+        }
+        entries.pop_back();
+        evictions++;
+    }
+    return true;
+}
+
+std::optional<std::string> LRUCache::Partition::Lookup(const Key& key, bool touch) {
+    auto iter = entry_map.find(key);
+    if (iter == entry_map.end()) {
+        return std::nullopt;
+    }
+    if (touch) {
+        entries.splice(entries.begin(), entries, iter->second);
+    }
+    return iter->second->second;
+}
+
+LRUCache::LRUCache(int mem_cap_mb, size_t num_partitions, bool admission)
+    : capacity_(mem_cap_mb > 0 ? static_cast<size_t>(mem_cap_mb) << 20 : 0),
+      num_partitions_(num_partitions),
+      admission_(admission),
+      partition_capacity_(num_partitions > 0 ? capacity_ / num_partitions : capacity_) {}
+
+LRUCache::~LRUCache() {}
+
+LRUCache::Partition* LRUCache::GetPartition(uint32_t user_logspace) {
+    uint32_t key = user_logspace;
+    if (num_partitions_ > 0) {
+        key = gsl::narrow_cast<uint32_t>(
+            absl::Hash<uint32_t>{}(user_logspace) % num_partitions_);
+    }
+    {
+        absl::ReaderMutexLock lk(&partitions_mu_);
+        if (auto iter = partitions_.find(key); iter != partitions_.end()) {
+            return iter->second.get();
+        }
+    }
+    absl::MutexLock lk(&partitions_mu_);
+    std::unique_ptr<Partition>& partition = partitions_[key];
+    if (partition == nullptr) {
+        size_t capacity = capacity_;
+        if (capacity_ > 0) {
+            // Existing partitions shrink to their new share on next insert
+            capacity /= (num_partitions_ > 0 ? num_partitions_ : partitions_.size());
+            partition_capacity_.store(capacity, std::memory_order_relaxed);
+        }
+        size_t sketch_width = kMinSketchWidth;
+        while (sketch_width < kMaxSketchWidth && sketch_width * kAverageEntrySize < capacity) {
+            sketch_width *= 2;
+        }
+        partition = std::make_unique<Partition>(sketch_width);
+    }
+    return partition.get();
+}
+
+bool LRUCache::Put(const LogMetaData& log_metadata, std::span<const uint64_t> user_tags,
+                   std::span<const char> log_data, bool force) {
     std::string data = EncodeLogEntry(log_metadata, user_tags, log_data);
-    dbm_->Set(key_str, data, /* overwrite= */ false);
+    Partition* partition = GetPartition(log_metadata.user_logspace);
+    EvictedVec evicted;
+    bool admitted;
+    {
+        absl::MutexLock lk(&partition->mu);
+        admitted = partition->Insert(
+            std::make_pair(log_metadata.seqnum, false), std::move(data),
+            partition_capacity_.load(std::memory_order_relaxed),
+            admission_ && !force, evict_cb_ ? &evicted : nullptr);
+    }
+    DemoteEvicted(&evicted);
+    return admitted;
 }
 
-std::optional<LogEntry> LRUCache::Get(uint64_t seqnum) {
-    std::string key_str = fmt::format("0_{:016x}", seqnum);
-    std::string data;
-    auto status = dbm_->Get(key_str, &data);
-    if (status.IsOK()) {
+void LRUCache::DemoteEvicted(EvictedVec* evicted) {
+    for (auto& [seqnum, data] : *evicted) {
+        evict_cb_(seqnum, std::move(data));
+    }
+}
+
+std::optional<LogEntry> LRUCache::Get(uint32_t user_logspace, uint64_t seqnum, bool touch) {
+    Partition* partition = GetPartition(user_logspace);
+    std::optional<std::string> data;
+    {
+        absl::MutexLock lk(&partition->mu);
+        data = partition->Lookup(std::make_pair(seqnum, false), touch);
+        if (touch) {
+            // Misses count as well, which lets entries read again earn admission
+            partition->sketch.Record(seqnum);
+            if (data.has_value()) {
+                partition->hits++;
+            } else {
+                partition->misses++;
+            }
+        }
+    }
+    ReportStatIfNeeded();
+    if (data.has_value()) {
         LogEntry log_entry;
-        DecodeLogEntry(std::move(data), &log_entry);
+        DecodeLogEntry(std::move(*data), &log_entry);
         DCHECK_EQ(seqnum, log_entry.metadata.seqnum);
         return log_entry;
     } else {
@@ -84,21 +292,344 @@ std::optional<LogEntry> LRUCache::Get(uint64_t seqnum) {
     }
 }
 
-void LRUCache::PutAuxData(uint64_t seqnum, std::span<const char> data) {
-    std::string key_str = fmt::format("1_{:016x}", seqnum);
-    dbm_->Set(key_str, std::string_view(data.data(), data.size()),
-              /* overwrite= */ true);
+void LRUCache::PutAuxData(uint32_t user_logspace, uint64_t seqnum,
+                          std::span<const char> data) {
+    Partition* partition = GetPartition(user_logspace);
+    EvictedVec evicted;
+    {
+        absl::MutexLock lk(&partition->mu);
+        partition->Insert(std::make_pair(seqnum, true), std::string(data.data(), data.size()),
+                          partition_capacity_.load(std::memory_order_relaxed),
+                          /* admission= */ false, evict_cb_ ? &evicted : nullptr);
+    }
+    DemoteEvicted(&evicted);
+}
+
+std::optional<std::string> LRUCache::GetAuxData(uint32_t user_logspace, uint64_t seqnum) {
+    Partition* partition = GetPartition(user_logspace);
+    absl::MutexLock lk(&partition->mu);
+    return partition->Lookup(std::make_pair(seqnum, true), /* touch= */ true);
+}
+
+void LRUCache::ReportStatIfNeeded() {
+    int duration_ms;
+    {
+        absl::MutexLock lk(&stat_mu_);
+        if (!stat_timer_.Check()) {
+            return;
+        }
+        stat_timer_.MarkReport(&duration_ms);
+    }
+    absl::ReaderMutexLock partitions_lk(&partitions_mu_);
+    for (const auto& [key, partition_ptr] : partitions_) {
+        Partition* partition = partition_ptr.get();
+        absl::MutexLock lk(&partition->mu);
+        uint64_t lookups = partition->hits + partition->misses;
+        if (lookups > 0 || partition->evictions > 0 || partition->rejections > 0) {
+            LOG_F(INFO, "LRUCache partition {} in last {}ms: hits={}, misses={}, "
+                        "hit_ratio={:.2f}, evictions={}, rejections={}, entries={}, "
+                        "size={}KB",
+                  key, duration_ms, partition->hits, partition->misses,
+                  lookups > 0 ? static_cast<double>(partition->hits) / lookups : 0.0,
+                  partition->evictions, partition->rejections,
+                  partition->entries.size(), partition->size >> 10);
+        }
+        partition->hits = 0;
+        partition->misses = 0;
+        partition->evictions = 0;
+        partition->rejections = 0;
+    }
+}
+
+DiskLogCache::DiskLogCache(std::string_view dir_path, size_t cap_bytes, size_t segment_size)
+    : dir_path_(dir_path),
+      cap_bytes_(cap_bytes),
+      segment_size_(segment_size),
+      next_segment_id_(0),
+      total_bytes_(0),
+      queued_write_bytes_(0),
+      writer_thread_("DiskCacheW", [this] { this->WriterThreadMain(); }),
+      reader_thread_("DiskCache", [this] { this->ReaderThreadMain(); }) {
+    DCHECK_GT(segment_size, 0U);
 }
 
-std::optional<std::string> LRUCache::GetAuxData(uint64_t seqnum) {
-    std::string key_str = fmt::format("1_{:016x}", seqnum);
+DiskLogCache::~DiskLogCache() {}
+
+DiskLogCache::Segment::~Segment() {
+    PCHECK(close(write_fd) == 0) << "Failed to close segment file";
+    PCHECK(close(read_fd) == 0) << "Failed to close segment file";
+    if (!fs_utils::Remove(path)) {
+        LOG_F(ERROR, "Failed to remove segment file {}", path);
+    }
+}
+
+void DiskLogCache::Start() {
+    if (!fs_utils::IsDirectory(dir_path_)) {
+        CHECK(fs_utils::MakeDirectory(dir_path_))
+            << "Failed to create disk cache directory " << dir_path_;
+    }
+    // Entries left by previous runs are not indexed, other files in the
+    // directory are not ours
+    DIR* dir = opendir(dir_path_.c_str());
+    PCHECK(dir != nullptr) << "Failed to open disk cache directory " << dir_path_;
+    while (struct dirent* entry = readdir(dir)) {
+        std::string_view name(entry->d_name);
+        uint32_t id;
+        if (absl::StartsWith(name, kSegmentPrefix)
+                && absl::SimpleAtoi(name.substr(kSegmentPrefix.size()), &id)) {
+            std::string path = fs_utils::JoinPath(dir_path_, name);
+            if (!fs_utils::Remove(path)) {
+                LOG_F(ERROR, "Failed to remove segment file {}", path);
+            }
+        }
+    }
+    closedir(dir);
+    {
+        absl::MutexLock lk(&mu_);
+        CHECK(NewSegment());
+    }
+    writer_thread_.Start();
+    reader_thread_.Start();
+}
+
+void DiskLogCache::Stop() {
+    write_queue_.Stop();
+    read_queue_.Stop();
+    writer_thread_.Join();
+    reader_thread_.Join();
+}
+
+void DiskLogCache::Put(uint64_t seqnum, std::string encoded) {
+    // Bounds memory of queued entries to one segment
+    size_t size = encoded.size();
+    size_t queued_bytes = queued_write_bytes_.fetch_add(size, std::memory_order_relaxed);
+    if (queued_bytes + size > segment_size_) {
+        queued_write_bytes_.fetch_sub(size, std::memory_order_relaxed);
+        VLOG_F(1, "Disk cache writer falls behind, drop log entry (seqnum {})",
+               bits::HexStr0x(seqnum));
+        return;
+    }
+    write_queue_.Push(std::make_pair(seqnum, std::move(encoded)));
+}
+
+void DiskLogCache::WriterThreadMain() {
+    WriteRequest request;
+    while (write_queue_.Pop(&request)) {
+        const auto& [seqnum, data] = request;
+        Write(seqnum, data);
+        queued_write_bytes_.fetch_sub(data.size(), std::memory_order_relaxed);
+    }
+}
+
+void DiskLogCache::Write(uint64_t seqnum, const std::string& data) {
+    // Segments are only appended and dropped by the writer thread, thus the
+    // current segment stays valid while writing without the lock
+    std::shared_ptr<Segment> segment;
+    {
+        absl::MutexLock lk(&mu_);
+        if (index_.contains(seqnum) || segments_.empty()) {
+            return;
+        }
+        if (segments_.back()->size + data.size() > segment_size_
+                && segments_.back()->size > 0) {
+            if (!NewSegment()) {
+                return;
+            }
+        }
+        segment = segments_.back();
+    }
+    ssize_t ret = pwrite(segment->write_fd, data.data(), data.size(),
+                         static_cast<off_t>(segment->size));
+    if (ret != static_cast<ssize_t>(data.size())) {
+        PLOG_F(ERROR, "Failed to write segment file {}", segment->path);
+        return;
+    }
+    absl::MutexLock lk(&mu_);
+    index_[seqnum] = IndexEntry {
+        .segment_id = segment->id,
+        .offset = gsl::narrow_cast<uint32_t>(segment->size),
+        .size = gsl::narrow_cast<uint32_t>(data.size())
+    };
+    segment->size += data.size();
+    segment->seqnums.push_back(seqnum);
+    total_bytes_ += data.size();
+    while (total_bytes_ > cap_bytes_ && segments_.size() > 1) {
+        DropOldestSegment();
+    }
+}
+
+bool DiskLogCache::Contains(uint64_t seqnum) {
+    absl::MutexLock lk(&mu_);
+    return index_.contains(seqnum);
+}
+
+void DiskLogCache::ReadAsync(uint64_t seqnum, ReadCallback cb) {
+    read_queue_.Push(std::make_pair(seqnum, std::move(cb)));
+}
+
+bool DiskLogCache::NewSegment() {
+    uint32_t id = next_segment_id_++;
+    std::string path = fs_utils::JoinPath(dir_path_, fmt::format("{}{}", kSegmentPrefix, id));
+    auto write_fd = fs_utils::Create(path);
+    if (!write_fd.has_value()) {
+        return false;
+    }
+    auto read_fd = fs_utils::Open(path, O_RDONLY);
+    if (!read_fd.has_value()) {
+        close(*write_fd);
+        return false;
+    }
+    auto segment = std::make_shared<Segment>();
+    segment->id = id;
+    segment->path = std::move(path);
+    segment->write_fd = *write_fd;
+    segment->read_fd = *read_fd;
+    segment->size = 0;
+    segments_.push_back(std::move(segment));
+    return true;
+}
+
+void DiskLogCache::DropOldestSegment() {
+    DCHECK(!segments_.empty());
+    const Segment& segment = *segments_.front();
+    for (uint64_t seqnum : segment.seqnums) {
+        index_.erase(seqnum);
+    }
+    DCHECK_GE(total_bytes_, segment.size);
+    total_bytes_ -= segment.size;
+    // The file is removed once inflight reads finish
+    segments_.pop_front();
+}
+
+void DiskLogCache::ReaderThreadMain() {
+    ReadRequest request;
+    while (read_queue_.Pop(&request)) {
+        auto& [seqnum, cb] = request;
+        cb(Read(seqnum));
+    }
+}
+
+std::optional<LogEntry> DiskLogCache::Read(uint64_t seqnum) {
+    std::shared_ptr<Segment> segment;
+    IndexEntry entry;
+    {
+        absl::MutexLock lk(&mu_);
+        auto iter = index_.find(seqnum);
+        if (iter == index_.end()) {
+            return std::nullopt;
+        }
+        entry = iter->second;
+        DCHECK(!segments_.empty());
+        size_t idx = entry.segment_id - segments_.front()->id;
+        DCHECK_LT(idx, segments_.size());
+        segment = segments_.at(idx);
+    }
     std::string data;
-    auto status = dbm_->Get(key_str, &data);
-    if (status.IsOK()) {
-        return data;
-    } else {
+    data.resize(entry.size);
+    ssize_t ret = pread(segment->read_fd, data.data(), data.size(),
+                        static_cast<off_t>(entry.offset));
+    if (ret != static_cast<ssize_t>(data.size())) {
+        PLOG_F(ERROR, "Failed to read segment file {}", segment->path);
         return std::nullopt;
     }
+    LogEntry log_entry;
+    DecodeLogEntry(std::move(data), &log_entry);
+    return log_entry;
+}
+
+IndexResultCache::IndexResultCache(size_t capacity)
+    : capacity_(capacity) {
+    DCHECK_GT(capacity, 0U);
+}
+
+IndexResultCache::~IndexResultCache() {}
+
+bool IndexResultCache::IsStable(const Key& key, const Result& result) const {
+    // All seqnums before a found one are already assigned
+    protocol::SharedLogOpType op_type = static_cast<protocol::SharedLogOpType>(key.op_type);
+    return result.seqnum != kInvalidLogSeqNum
+        && (op_type == protocol::SharedLogOpType::READ_NEXT
+              || op_type == protocol::SharedLogOpType::READ_NEXT_B);
+}
+
+void IndexResultCache::Put(const Key& key, const Result& result) {
+    absl::MutexLock lk(&mu_);
+    if (auto iter = entry_map_.find(key); iter != entry_map_.end()) {
+        entries_.erase(iter->second);
+        entry_map_.erase(iter);
+    }
+    entries_.emplace_front(key, result);
+    entry_map_[key] = entries_.begin();
+    while (entries_.size() > capacity_) {
+        entry_map_.erase(entries_.back().first);
+        entries_.pop_back();
+    }
+}
+
+std::optional<IndexResultCache::Result> IndexResultCache::Get(
+        const Key& key, uint32_t logspace_id, uint64_t min_metalog_progress) {
+    absl::MutexLock lk(&mu_);
+    auto iter = entry_map_.find(key);
+    if (iter == entry_map_.end()) {
+        return std::nullopt;
+    }
+    const Result& result = iter->second->second;
+    if (!IsStable(key, result)) {
+        uint32_t position = 0;
+        if (auto pos_iter = metalog_positions_.find(logspace_id);
+                pos_iter != metalog_positions_.end()) {
+            position = pos_iter->second;
+        }
+        if (result.metalog_progress < bits::JoinTwo32(logspace_id, position)) {
+            // Newer logs may exist
+            entries_.erase(iter->second);
+            entry_map_.erase(iter);
+            return std::nullopt;
+        }
+        if (result.metalog_progress < min_metalog_progress) {
+            return std::nullopt;
+        }
+    }
+    entries_.splice(entries_.begin(), entries_, iter->second);
+    return result;
+}
+
+void IndexResultCache::OnMetaLogsApplied(uint32_t logspace_id, uint32_t metalog_position) {
+    absl::MutexLock lk(&mu_);
+    uint32_t& position = metalog_positions_[logspace_id];
+    position = std::max(position, metalog_position);
+}
+
+DecodedLogCache::DecodedLogCache(size_t capacity)
+    : capacity_(capacity) {
+    DCHECK_GT(capacity, 0U);
+}
+
+DecodedLogCache::~DecodedLogCache() {}
+
+void DecodedLogCache::Put(std::shared_ptr<const LogEntryProto> log_entry) {
+    uint64_t seqnum = log_entry->seqnum();
+    absl::MutexLock lk(&mu_);
+    if (auto iter = entry_map_.find(seqnum); iter != entry_map_.end()) {
+        entries_.erase(iter->second);
+        entry_map_.erase(iter);
+    }
+    entries_.push_front(std::move(log_entry));
+    entry_map_[seqnum] = entries_.begin();
+    while (entries_.size() > capacity_) {
+        entry_map_.erase(entries_.back()->seqnum());
+        entries_.pop_back();
+    }
+}
+
+std::shared_ptr<const LogEntryProto> DecodedLogCache::Get(uint64_t seqnum) {
+    absl::MutexLock lk(&mu_);
+    auto iter = entry_map_.find(seqnum);
+    if (iter == entry_map_.end()) {
+        return nullptr;
+    }
+    entries_.splice(entries_.begin(), entries_, iter->second);
+    return *iter->second;
 }
 
 }  // namespace log
@@ -1,30 +1,213 @@
 #pragma once
 
 #include "log/common.h"
-
-// Forward declarations
-namespace tkrzw { class CacheDBM; }
+#include "common/stat.h"
+#include "base/thread.h"
+#include "utils/blocking_queue.h"
 
 namespace faas {
 namespace log {
 
+// In-memory cache of log entries, split into partitions of equal capacity
+// shares, so that tenants do not evict each other. Either each user log
+// space gets its own partition, with capacity shared equally among log
+// spaces seen so far, or user log spaces are hashed into a fixed number of
+// partitions.
+// With admission enabled, a new entry enters a full partition only if it is
+// accessed at least as frequently as the LRU victim, as estimated by a
+// TinyLFU-style sketch. Thus one-pass scans cannot flush hot entries.
 class LRUCache {
 public:
-    explicit LRUCache(int mem_cap_mb);
+    // `num_partitions` of 0 gives each user log space its own partition
+    explicit LRUCache(int mem_cap_mb, size_t num_partitions = 1, bool admission = false);
     ~LRUCache();
 
-    void Put(const LogMetaData& log_metadata, std::span<const uint64_t> user_tags,
-             std::span<const char> log_data);
-    std::optional<LogEntry> Get(uint64_t seqnum);
+    // Called with evicted log entries, encoded as DiskLogCache::Put expects.
+    // Must be set before any Put.
+    using EvictCallback = std::function<void(/* seqnum */ uint64_t,
+                                             std::string /* encoded */)>;
+    void SetEvictCallback(EvictCallback cb) { evict_cb_ = cb; }
+
+    // Returns false if the entry is not admitted. `force` bypasses admission
+    bool Put(const LogMetaData& log_metadata, std::span<const uint64_t> user_tags,
+             std::span<const char> log_data, bool force = false);
+    // With `touch` false, the lookup does not count as an access of the entry
+    std::optional<LogEntry> Get(uint32_t user_logspace, uint64_t seqnum, bool touch = true);
 
-    void PutAuxData(uint64_t seqnum, std::span<const char> data);
-    std::optional<std::string> GetAuxData(uint64_t seqnum);
+    void PutAuxData(uint32_t user_logspace, uint64_t seqnum, std::span<const char> data);
+    std::optional<std::string> GetAuxData(uint32_t user_logspace, uint64_t seqnum);
 
 private:
-    std::unique_ptr<tkrzw::CacheDBM> dbm_;
+    const size_t capacity_;  // In bytes, 0 for unlimited
+    const size_t num_partitions_;
+    const bool admission_;
+    EvictCallback evict_cb_;
+
+    class FrequencySketch;
+    struct Partition;
+    using EvictedVec = std::vector<std::pair</* seqnum */ uint64_t, std::string>>;
+
+    absl::Mutex partitions_mu_;
+    // Keyed by user log space, or by hash with a fixed number of partitions.
+    // Partitions are created on first use and never removed.
+    absl::flat_hash_map</* key */ uint32_t, std::unique_ptr<Partition>>
+        partitions_ ABSL_GUARDED_BY(partitions_mu_);
+    std::atomic<size_t> partition_capacity_;
+
+    absl::Mutex stat_mu_;
+    stat::ReportTimer stat_timer_ ABSL_GUARDED_BY(stat_mu_);
+
+    Partition* GetPartition(uint32_t user_logspace);
+    void DemoteEvicted(EvictedVec* evicted);
+    void ReportStatIfNeeded();
 
     DISALLOW_COPY_AND_ASSIGN(LRUCache);
 };
 
+// Second tier of LRUCache on local disk. Log entries evicted from LRUCache are
+// appended to segment files, and indexed in memory by seqnum. Once over the
+// disk budget, the oldest segment is dropped together with its entries.
+// Writes and reads are served by background threads.
+class DiskLogCache {
+public:
+    DiskLogCache(std::string_view dir_path, size_t cap_bytes, size_t segment_size);
+    ~DiskLogCache();
+
+    void Start();
+    void Stop();
+
+    // `encoded` as evicted from LRUCache. The entry is written asynchronously,
+    // and dropped if the writer thread falls behind.
+    void Put(uint64_t seqnum, std::string encoded);
+    bool Contains(uint64_t seqnum);
+
+    // `cb` is called from the background thread, with std::nullopt if
+    // the entry is dropped or fails to read
+    using ReadCallback = std::function<void(std::optional<LogEntry>)>;
+    void ReadAsync(uint64_t seqnum, ReadCallback cb);
+
+private:
+    std::string dir_path_;
+    size_t cap_bytes_;
+    size_t segment_size_;
+
+    struct Segment {
+        uint32_t id;
+        std::string path;
+        int write_fd;
+        int read_fd;
+        size_t size;
+        std::vector</* seqnum */ uint64_t> seqnums;
+
+        ~Segment();
+    };
+    struct IndexEntry {
+        uint32_t segment_id;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    absl::Mutex mu_;
+    uint32_t next_segment_id_ ABSL_GUARDED_BY(mu_);
+    size_t total_bytes_ ABSL_GUARDED_BY(mu_);
+    // Ordered by id, the last one being appended
+    std::deque<std::shared_ptr<Segment>> segments_ ABSL_GUARDED_BY(mu_);
+    absl::flat_hash_map</* seqnum */ uint64_t, IndexEntry> index_ ABSL_GUARDED_BY(mu_);
+
+    using WriteRequest = std::pair</* seqnum */ uint64_t, /* encoded */ std::string>;
+    utils::BlockingQueue<WriteRequest> write_queue_;
+    std::atomic<size_t> queued_write_bytes_;
+    base::Thread writer_thread_;
+
+    using ReadRequest = std::pair</* seqnum */ uint64_t, ReadCallback>;
+    utils::BlockingQueue<ReadRequest> read_queue_;
+    base::Thread reader_thread_;
+
+    bool NewSegment() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+    void DropOldestSegment() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+    void WriterThreadMain();
+    void Write(uint64_t seqnum, const std::string& data);
+    void ReaderThreadMain();
+    std::optional<LogEntry> Read(uint64_t seqnum);
+
+    DISALLOW_COPY_AND_ASSIGN(DiskLogCache);
+};
+
+// Results of index queries sent to remote index engines. A result stays
+// valid until newer metalogs of its log space are applied, except found
+// results of READ_NEXT, which cannot change.
+class IndexResultCache {
+public:
+    explicit IndexResultCache(size_t capacity);
+    ~IndexResultCache();
+
+    struct Key {
+        uint32_t user_logspace;
+        uint64_t user_tag;
+        uint16_t op_type;
+        uint64_t query_seqnum;
+
+        bool operator==(const Key& other) const {
+            return user_logspace == other.user_logspace && user_tag == other.user_tag
+                && op_type == other.op_type && query_seqnum == other.query_seqnum;
+        }
+        template <typename H>
+        friend H AbslHashValue(H h, const Key& key) {
+            return H::combine(std::move(h), key.user_logspace, key.user_tag,
+                              key.op_type, key.query_seqnum);
+        }
+    };
+
+    struct Result {
+        uint64_t seqnum;            // kInvalidLogSeqNum if empty
+        uint16_t engine_id;
+        uint64_t metalog_progress;  // Of the index answering the query
+    };
+
+    void Put(const Key& key, const Result& result);
+    // Returns a result no older than min_metalog_progress, and not affected
+    // by metalogs of logspace_id applied so far
+    std::optional<Result> Get(const Key& key, uint32_t logspace_id,
+                              uint64_t min_metalog_progress);
+
+    void OnMetaLogsApplied(uint32_t logspace_id, uint32_t metalog_position);
+
+private:
+    size_t capacity_;
+
+    absl::Mutex mu_;
+    using EntryList = std::list<std::pair<Key, Result>>;
+    EntryList entries_ ABSL_GUARDED_BY(mu_);  // Most recently used first
+    absl::flat_hash_map<Key, EntryList::iterator> entry_map_ ABSL_GUARDED_BY(mu_);
+    absl::flat_hash_map</* logspace_id */ uint32_t,
+                        /* metalog_position */ uint32_t>
+        metalog_positions_ ABSL_GUARDED_BY(mu_);
+
+    bool IsStable(const Key& key, const Result& result) const;
+
+    DISALLOW_COPY_AND_ASSIGN(IndexResultCache);
+};
+
+// Log entries read from storage DB, kept decoded for subsequent reads
+class DecodedLogCache {
+public:
+    explicit DecodedLogCache(size_t capacity);
+    ~DecodedLogCache();
+
+    void Put(std::shared_ptr<const LogEntryProto> log_entry);
+    std::shared_ptr<const LogEntryProto> Get(uint64_t seqnum);
+
+private:
+    size_t capacity_;
+
+    absl::Mutex mu_;
+    using EntryList = std::list<std::shared_ptr<const LogEntryProto>>;
+    EntryList entries_ ABSL_GUARDED_BY(mu_);  // Most recently used first
+    absl::flat_hash_map</* seqnum */ uint64_t, EntryList::iterator>
+        entry_map_ ABSL_GUARDED_BY(mu_);
+
+    DISALLOW_COPY_AND_ASSIGN(DecodedLogCache);
+};
+
 }  // namespace log
 }  // namespace faas
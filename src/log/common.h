@@ -42,6 +42,10 @@ struct LogMetaData {
     uint64_t localid;
     size_t   num_tags;
     size_t   data_size;
+    // Conditional append: the first user tag is required to have
+    // `cond_tail_seqnum` as its tail (kInvalidLogSeqNum for no entries)
+    bool     cond_append;
+    uint64_t cond_tail_seqnum;
 };
 
 struct LogEntry {
@@ -50,5 +54,59 @@ struct LogEntry {
     std::string data;
 };
 
+// Fixed-layout little-endian encoding of NEW_LOGS meta logs, read in place
+// from message payloads. All fields are uint32:
+//   logspace_id, metalog_seqnum, start_seqnum, num_shards,
+//   shard_starts[num_shards], shard_deltas[num_shards]
+class FlatNewLogs {
+public:
+    static constexpr size_t kHeaderFields = 4;
+
+    explicit FlatNewLogs(const char* data) : data_(data) {}
+
+    static size_t EncodedSize(size_t num_shards) {
+        return (kHeaderFields + 2 * num_shards) * sizeof(uint32_t);
+    }
+    size_t encoded_size() const { return EncodedSize(num_shards()); }
+
+    uint32_t logspace_id() const    { return Load(0); }
+    uint32_t metalog_seqnum() const { return Load(1); }
+    uint32_t start_seqnum() const   { return Load(2); }
+    size_t   num_shards() const     { return Load(3); }
+
+    // Same accessors as MetaLogProto::NewLogsProto
+    uint32_t shard_starts(int i) const {
+        return Load(kHeaderFields + static_cast<size_t>(i));
+    }
+    uint32_t shard_deltas(int i) const {
+        return Load(kHeaderFields + num_shards() + static_cast<size_t>(i));
+    }
+
+    void CopyTo(MetaLogProto* meta_log) const {
+        meta_log->Clear();
+        meta_log->set_logspace_id(logspace_id());
+        meta_log->set_metalog_seqnum(metalog_seqnum());
+        meta_log->set_type(MetaLogProto::NEW_LOGS);
+        auto* new_logs_proto = meta_log->mutable_new_logs_proto();
+        new_logs_proto->set_start_seqnum(start_seqnum());
+        for (size_t i = 0; i < num_shards(); i++) {
+            new_logs_proto->add_shard_starts(shard_starts(static_cast<int>(i)));
+            new_logs_proto->add_shard_deltas(shard_deltas(static_cast<int>(i)));
+        }
+    }
+
+private:
+    const char* data_;
+
+    uint32_t Load(size_t idx) const {
+        uint32_t value;
+        memcpy(&value, data_ + idx * sizeof(uint32_t), sizeof(uint32_t));
+        return value;
+    }
+};
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "FlatNewLogs assumes little-endian hosts");
+
 }  // namespace log
 }  // namespace faas
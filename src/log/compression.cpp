@@ -0,0 +1,260 @@
+#include "log/compression.h"
+
+#include "common/time.h"
+#include "utils/bits.h"
+
+__BEGIN_THIRD_PARTY_HEADERS
+#include <zstd.h>
+#include <zdict.h>
+__END_THIRD_PARTY_HEADERS
+
+#define log_header_ "LogCompressor: "
+
+namespace faas {
+namespace log {
+
+struct LogCompressor::Dict {
+    ZSTD_CDict* cdict;
+    ZSTD_DDict* ddict;
+
+    Dict(std::span<const char> dict, int level)
+        : cdict(ZSTD_createCDict(dict.data(), dict.size(), level)),
+          ddict(ZSTD_createDDict(dict.data(), dict.size())) {
+        CHECK(cdict != nullptr && ddict != nullptr) << "Failed to load zstd dictionary";
+    }
+
+    ~Dict() {
+        ZSTD_freeCDict(cdict);
+        ZSTD_freeDDict(ddict);
+    }
+};
+
+namespace {
+// zstd contexts are not thread-safe, while dictionaries can be shared
+static ZSTD_CCtx* ThreadLocalCCtx() {
+    static thread_local std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)>
+        cctx(ZSTD_createCCtx(), &ZSTD_freeCCtx);
+    return cctx.get();
+}
+
+static ZSTD_DCtx* ThreadLocalDCtx() {
+    static thread_local std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)>
+        dctx(ZSTD_createDCtx(), &ZSTD_freeDCtx);
+    return dctx.get();
+}
+}  // namespace
+
+LogCompressor::LogCompressor(int level, size_t dict_size, size_t sample_size,
+                             PersistDictCallback cb)
+    : level_(level),
+      dict_size_(dict_size),
+      sample_size_(sample_size),
+      persist_dict_cb_(cb),
+      train_thread_("DictTrain", [this] { this->TrainThreadMain(); }),
+      raw_bytes_(0),
+      compressed_bytes_(0),
+      compress_time_us_(0),
+      decompress_time_us_(0) {}
+
+LogCompressor::~LogCompressor() {}
+
+void LogCompressor::Start() {
+    train_thread_.Start();
+}
+
+void LogCompressor::Stop() {
+    train_queue_.Stop();
+    train_thread_.Join();
+}
+
+uint32_t LogCompressor::Compress(uint32_t logspace_id, std::span<const char> data,
+                                 std::string* output) {
+    std::shared_ptr<Dict> dict;
+    uint32_t dict_version = 0;
+    {
+        absl::MutexLock lk(&mu_);
+        if (logspaces_.contains(logspace_id)) {
+            const LogSpaceState& state = logspaces_.at(logspace_id);
+            if (state.current_version > 0) {
+                dict_version = state.current_version;
+                dict = state.dicts.at(dict_version);
+            }
+        }
+    }
+    raw_bytes_.fetch_add(data.size(), std::memory_order_relaxed);
+    if (dict == nullptr) {
+        compressed_bytes_.fetch_add(data.size(), std::memory_order_relaxed);
+        return 0;
+    }
+    int64_t start_timestamp = GetMonotonicMicroTimestamp();
+    output->resize(ZSTD_compressBound(data.size()));
+    size_t ret = ZSTD_compress_usingCDict(
+        ThreadLocalCCtx(), output->data(), output->size(),
+        data.data(), data.size(), dict->cdict);
+    compress_time_us_.fetch_add(
+        gsl::narrow_cast<uint64_t>(GetMonotonicMicroTimestamp() - start_timestamp),
+        std::memory_order_relaxed);
+    ReportStatIfNeeded();
+    if (ZSTD_isError(ret)) {
+        HLOG_F(ERROR, "Failed to compress log data: {}", ZSTD_getErrorName(ret));
+        compressed_bytes_.fetch_add(data.size(), std::memory_order_relaxed);
+        return 0;
+    }
+    if (ret >= data.size()) {
+        // Not worth it
+        compressed_bytes_.fetch_add(data.size(), std::memory_order_relaxed);
+        return 0;
+    }
+    output->resize(ret);
+    compressed_bytes_.fetch_add(ret, std::memory_order_relaxed);
+    return dict_version;
+}
+
+bool LogCompressor::Decompress(uint32_t logspace_id, uint32_t dict_version,
+                               std::span<const char> data, std::string* output) {
+    std::shared_ptr<Dict> dict = GetDict(logspace_id, dict_version);
+    if (dict == nullptr) {
+        HLOG_F(ERROR, "Dictionary version {} of log space {} not installed",
+               dict_version, bits::HexStr0x(logspace_id));
+        return false;
+    }
+    unsigned long long size = ZSTD_getFrameContentSize(data.data(), data.size());
+    if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR) {
+        HLOG(ERROR) << "Cannot get decompressed size of log data";
+        return false;
+    }
+    int64_t start_timestamp = GetMonotonicMicroTimestamp();
+    output->resize(gsl::narrow_cast<size_t>(size));
+    size_t ret = ZSTD_decompress_usingDDict(
+        ThreadLocalDCtx(), output->data(), output->size(),
+        data.data(), data.size(), dict->ddict);
+    decompress_time_us_.fetch_add(
+        gsl::narrow_cast<uint64_t>(GetMonotonicMicroTimestamp() - start_timestamp),
+        std::memory_order_relaxed);
+    if (ZSTD_isError(ret)) {
+        HLOG_F(ERROR, "Failed to decompress log data: {}", ZSTD_getErrorName(ret));
+        return false;
+    }
+    DCHECK_EQ(ret, output->size());
+    return true;
+}
+
+void LogCompressor::AddSample(uint32_t logspace_id, std::span<const char> data) {
+    TrainRequest request;
+    {
+        absl::MutexLock lk(&mu_);
+        LogSpaceState& state = logspaces_[logspace_id];
+        if (state.current_version > 0 || state.training
+                || state.training_failed || data.empty()) {
+            return;
+        }
+        state.sample_data.append(data.data(), data.size());
+        state.sample_sizes.push_back(data.size());
+        if (state.sample_data.size() < sample_size_) {
+            return;
+        }
+        request.logspace_id = logspace_id;
+        request.sample_data.swap(state.sample_data);
+        request.sample_sizes.swap(state.sample_sizes);
+        // Blocks further samples while training
+        state.training = true;
+    }
+    train_queue_.Push(std::move(request));
+}
+
+void LogCompressor::TrainThreadMain() {
+    TrainRequest request;
+    while (train_queue_.Pop(&request)) {
+        TrainDict(request);
+    }
+}
+
+void LogCompressor::TrainDict(const TrainRequest& request) {
+    uint32_t logspace_id = request.logspace_id;
+    int64_t start_timestamp = GetMonotonicMicroTimestamp();
+    std::string dict;
+    dict.resize(dict_size_);
+    size_t ret = ZDICT_trainFromBuffer(
+        dict.data(), dict.size(), request.sample_data.data(), request.sample_sizes.data(),
+        gsl::narrow_cast<unsigned>(request.sample_sizes.size()));
+    if (ZDICT_isError(ret)) {
+        HLOG_F(WARNING, "Failed to train dictionary for log space {}: {}",
+               bits::HexStr0x(logspace_id), ZDICT_getErrorName(ret));
+        absl::MutexLock lk(&mu_);
+        LogSpaceState& state = logspaces_[logspace_id];
+        state.training = false;
+        state.training_failed = true;
+        return;
+    }
+    dict.resize(ret);
+    HLOG_F(INFO, "Trained dictionary of size {} for log space {} from {} samples, "
+                 "took {}ms", dict.size(), bits::HexStr0x(logspace_id),
+           request.sample_sizes.size(),
+           (GetMonotonicMicroTimestamp() - start_timestamp) / 1000);
+    auto new_dict = std::make_shared<Dict>(STRING_AS_SPAN(dict), level_);
+    uint32_t dict_version;
+    {
+        absl::MutexLock lk(&mu_);
+        const LogSpaceState& state = logspaces_[logspace_id];
+        dict_version = state.current_version + 1;
+        for (const auto& [version, _] : state.dicts) {
+            dict_version = std::max(dict_version, version + 1);
+        }
+    }
+    persist_dict_cb_(logspace_id, dict_version, STRING_AS_SPAN(dict));
+    absl::MutexLock lk(&mu_);
+    LogSpaceState& state = logspaces_[logspace_id];
+    state.training = false;
+    state.dicts[dict_version] = std::move(new_dict);
+    state.current_version = std::max(state.current_version, dict_version);
+}
+
+bool LogCompressor::HasDict(uint32_t logspace_id, uint32_t dict_version) {
+    return GetDict(logspace_id, dict_version) != nullptr;
+}
+
+void LogCompressor::InstallDict(uint32_t logspace_id, uint32_t dict_version,
+                                std::span<const char> dict, bool current) {
+    DCHECK_GT(dict_version, 0U);
+    auto new_dict = std::make_shared<Dict>(dict, level_);
+    absl::MutexLock lk(&mu_);
+    LogSpaceState& state = logspaces_[logspace_id];
+    state.dicts[dict_version] = std::move(new_dict);
+    if (current) {
+        state.current_version = std::max(state.current_version, dict_version);
+    }
+}
+
+std::shared_ptr<LogCompressor::Dict> LogCompressor::GetDict(uint32_t logspace_id,
+                                                            uint32_t dict_version) {
+    absl::MutexLock lk(&mu_);
+    if (!logspaces_.contains(logspace_id)) {
+        return nullptr;
+    }
+    const LogSpaceState& state = logspaces_.at(logspace_id);
+    if (!state.dicts.contains(dict_version)) {
+        return nullptr;
+    }
+    return state.dicts.at(dict_version);
+}
+
+void LogCompressor::ReportStatIfNeeded() {
+    absl::MutexLock lk(&stat_mu_);
+    if (!stat_timer_.Check()) {
+        return;
+    }
+    int duration_ms;
+    stat_timer_.MarkReport(&duration_ms);
+    uint64_t raw_bytes = raw_bytes_.exchange(0, std::memory_order_relaxed);
+    uint64_t compressed_bytes = compressed_bytes_.exchange(0, std::memory_order_relaxed);
+    uint64_t compress_time_us = compress_time_us_.exchange(0, std::memory_order_relaxed);
+    uint64_t decompress_time_us = decompress_time_us_.exchange(0, std::memory_order_relaxed);
+    HLOG_F(INFO, "Compression statistics in last {}ms: raw_bytes={}, compressed_bytes={}, "
+                 "ratio={:.2f}, compress_time={}us, decompress_time={}us",
+           duration_ms, raw_bytes, compressed_bytes,
+           compressed_bytes > 0 ? static_cast<double>(raw_bytes) / compressed_bytes : 0.0,
+           compress_time_us, decompress_time_us);
+}
+
+}  // namespace log
+}  // namespace faas
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "log/common.h"
+#include "common/stat.h"
+#include "base/thread.h"
+#include "utils/blocking_queue.h"
+
+namespace faas {
+namespace log {
+
+// Compresses log data of storage nodes with zstd dictionaries, one per log
+// space. The dictionary of a log space is trained from a sample of its first
+// persisted entries, on a separate training thread. Compressed entries record
+// the version of their dictionary, where version 0 means uncompressed.
+class LogCompressor {
+public:
+    // Called from the training thread, the dictionary is used only after
+    // the callback returns
+    using PersistDictCallback = std::function<void(/* logspace_id */ uint32_t,
+                                                   /* dict_version */ uint32_t,
+                                                   std::span<const char> /* dict */)>;
+
+    LogCompressor(int level, size_t dict_size, size_t sample_size, PersistDictCallback cb);
+    ~LogCompressor();
+
+    void Start();
+    void Stop();
+
+    // Returns the dictionary version used, or 0 if `data` is not compressed
+    uint32_t Compress(uint32_t logspace_id, std::span<const char> data,
+                      std::string* output);
+    bool Decompress(uint32_t logspace_id, uint32_t dict_version,
+                    std::span<const char> data, std::string* output);
+
+    // Adds `data` to the training sample of the log space. Once the sample
+    // is large enough, it is handed to the training thread.
+    void AddSample(uint32_t logspace_id, std::span<const char> data);
+
+    bool HasDict(uint32_t logspace_id, uint32_t dict_version);
+    // Dictionaries of previous runs. With `current`, the dictionary is also
+    // used for compressing, and no new one gets trained.
+    void InstallDict(uint32_t logspace_id, uint32_t dict_version,
+                     std::span<const char> dict, bool current = false);
+
+private:
+    const int level_;
+    const size_t dict_size_;
+    const size_t sample_size_;
+    PersistDictCallback persist_dict_cb_;
+
+    struct Dict;
+    struct LogSpaceState {
+        uint32_t current_version;  // 0 before any dictionary is trained
+        bool     training;         // Sample handed to the training thread
+        bool     training_failed;
+        absl::flat_hash_map</* version */ uint32_t, std::shared_ptr<Dict>> dicts;
+        std::string         sample_data;
+        std::vector<size_t> sample_sizes;
+    };
+
+    absl::Mutex mu_;
+    absl::flat_hash_map</* logspace_id */ uint32_t, LogSpaceState>
+        logspaces_ ABSL_GUARDED_BY(mu_);
+
+    struct TrainRequest {
+        uint32_t            logspace_id;
+        std::string         sample_data;
+        std::vector<size_t> sample_sizes;
+    };
+    utils::BlockingQueue<TrainRequest> train_queue_;
+    base::Thread train_thread_;
+
+    std::atomic<uint64_t> raw_bytes_;
+    std::atomic<uint64_t> compressed_bytes_;
+    std::atomic<uint64_t> compress_time_us_;
+    std::atomic<uint64_t> decompress_time_us_;
+    absl::Mutex stat_mu_;
+    stat::ReportTimer stat_timer_ ABSL_GUARDED_BY(stat_mu_);
+
+    std::shared_ptr<Dict> GetDict(uint32_t logspace_id, uint32_t dict_version);
+    void TrainThreadMain();
+    void TrainDict(const TrainRequest& request);
+    void ReportStatIfNeeded();
+
+    DISALLOW_COPY_AND_ASSIGN(LogCompressor);
+};
+
+}  // namespace log
+}  // namespace faas
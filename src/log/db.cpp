@@ -5,6 +5,7 @@
 __BEGIN_THIRD_PARTY_HEADERS
 
 #include <rocksdb/db.h>
+#include <rocksdb/write_batch.h>
 
 #include <tkrzw_dbm.h>
 #include <tkrzw_dbm_hash.h>
@@ -38,37 +39,93 @@ ABSL_FLAG(bool, rocksdb_enable_compression, false, "");
 namespace faas {
 namespace log {
 
+namespace {
+static rocksdb::ColumnFamilyOptions LogSpaceCFOptions() {
+    rocksdb::ColumnFamilyOptions options;
+    if (absl::GetFlag(FLAGS_rocksdb_enable_compression)) {
+        options.compression = rocksdb::kZSTD;
+    } else {
+        options.compression = rocksdb::kNoCompression;
+    }
+    options.OptimizeForPointLookup(
+        absl::GetFlag(FLAGS_rocksdb_block_cache_size_mb));
+    return options;
+}
+
+static constexpr std::string_view kAuxCFSuffix = "_aux";
+}  // namespace
+
 RocksDBBackend::RocksDBBackend(std::string_view db_path) {
     rocksdb::Options options;
     options.create_if_missing = true;
     options.max_background_jobs = absl::GetFlag(FLAGS_rocksdb_max_background_jobs);
+    // Column families of log spaces created by previous runs have to be
+    // opened together with the DB
+    std::vector<std::string> cf_names;
+    auto status = rocksdb::DB::ListColumnFamilies(options, std::string(db_path), &cf_names);
+    if (!status.ok()) {
+        cf_names = { rocksdb::kDefaultColumnFamilyName };
+    }
+    std::vector<rocksdb::ColumnFamilyDescriptor> cf_descriptors;
+    for (const std::string& name : cf_names) {
+        if (name == rocksdb::kDefaultColumnFamilyName) {
+            cf_descriptors.emplace_back(name, options);
+        } else {
+            cf_descriptors.emplace_back(name, LogSpaceCFOptions());
+        }
+    }
     rocksdb::DB* db;
-    HLOG_F(INFO, "Open RocksDB at path {}", db_path);
-    auto status = rocksdb::DB::Open(options, std::string(db_path), &db);
+    std::vector<rocksdb::ColumnFamilyHandle*> cf_handles;
+    HLOG_F(INFO, "Open RocksDB at path {}, with {} column families",
+           db_path, cf_names.size());
+    status = rocksdb::DB::Open(options, std::string(db_path),
+                               cf_descriptors, &cf_handles, &db);
     ROCKSDB_CHECK_OK(status, Open);
     db_.reset(db);
+    DCHECK_EQ(cf_handles.size(), cf_names.size());
+    for (size_t i = 0; i < cf_handles.size(); i++) {
+        std::string_view name = cf_names[i];
+        if (name == rocksdb::kDefaultColumnFamilyName) {
+            delete cf_handles[i];
+            continue;
+        }
+        bool aux_data = absl::EndsWith(name, kAuxCFSuffix);
+        if (aux_data) {
+            name.remove_suffix(kAuxCFSuffix.size());
+        }
+        uint32_t logspace_id = gsl::narrow_cast<uint32_t>(
+            std::stoul(std::string(name), nullptr, 16));
+        auto& cfs = aux_data ? aux_column_families_ : column_families_;
+        cfs[logspace_id].reset(cf_handles[i]);
+    }
 }
 
 RocksDBBackend::~RocksDBBackend() {}
 
 void RocksDBBackend::InstallLogSpace(uint32_t logspace_id) {
-    HLOG_F(INFO, "Install log space {}", bits::HexStr0x(logspace_id));
-    rocksdb::ColumnFamilyOptions options;
-    if (absl::GetFlag(FLAGS_rocksdb_enable_compression)) {
-        options.compression = rocksdb::kZSTD;
-    } else {
-        options.compression = rocksdb::kNoCompression;
+    {
+        absl::MutexLock lk(&mu_);
+        if (column_families_.contains(logspace_id)
+                && aux_column_families_.contains(logspace_id)) {
+            HLOG_F(INFO, "Log space {} exists in DB", bits::HexStr0x(logspace_id));
+            return;
+        }
     }
-    options.OptimizeForPointLookup(
-        absl::GetFlag(FLAGS_rocksdb_block_cache_size_mb));
+    HLOG_F(INFO, "Install log space {}", bits::HexStr0x(logspace_id));
+    rocksdb::ColumnFamilyOptions options = LogSpaceCFOptions();
     rocksdb::ColumnFamilyHandle* cf_handle = nullptr;
     auto status = db_->CreateColumnFamily(
         options, bits::HexStr(logspace_id), &cf_handle);
     ROCKSDB_CHECK_OK(status, CreateColumnFamily);
+    rocksdb::ColumnFamilyHandle* aux_cf_handle = nullptr;
+    status = db_->CreateColumnFamily(
+        options, bits::HexStr(logspace_id) + std::string(kAuxCFSuffix), &aux_cf_handle);
+    ROCKSDB_CHECK_OK(status, CreateColumnFamily);
     {
         absl::MutexLock lk(&mu_);
         DCHECK(!column_families_.contains(logspace_id));
         column_families_[logspace_id].reset(DCHECK_NOTNULL(cf_handle));
+        aux_column_families_[logspace_id].reset(DCHECK_NOTNULL(aux_cf_handle));
     }
 }
 
@@ -88,25 +145,143 @@ std::optional<std::string> RocksDBBackend::Get(uint32_t logspace_id, uint32_t ke
     return data;
 }
 
-void RocksDBBackend::Put(uint32_t logspace_id, uint32_t key, std::span<const char> data) {
+void RocksDBBackend::Put(uint32_t logspace_id, uint32_t key, std::span<const char> data,
+                         bool disable_wal) {
+    rocksdb::ColumnFamilyHandle* cf_handle = GetCFHandle(logspace_id);
+    if (cf_handle == nullptr) {
+        HLOG_F(ERROR, "Log space {} not created", bits::HexStr0x(logspace_id));
+        return;
+    }
+    std::string key_str = bits::HexStr(key);
+    rocksdb::WriteOptions options;
+    options.disableWAL = disable_wal;
+    auto status = db_->Put(
+        options, cf_handle, key_str, rocksdb::Slice(data.data(), data.size()));
+    ROCKSDB_CHECK_OK(status, Put);
+}
+
+void RocksDBBackend::Sync() {
+    auto status = db_->SyncWAL();
+    ROCKSDB_CHECK_OK(status, SyncWAL);
+}
+
+void RocksDBBackend::Flush(uint32_t logspace_id) {
+    rocksdb::ColumnFamilyHandle* cf_handle = GetCFHandle(logspace_id);
+    if (cf_handle == nullptr) {
+        HLOG_F(WARNING, "Log space {} not created", bits::HexStr0x(logspace_id));
+        return;
+    }
+    auto status = db_->Flush(rocksdb::FlushOptions(), cf_handle);
+    ROCKSDB_CHECK_OK(status, Flush);
+}
+
+bool RocksDBBackend::Scan(uint32_t logspace_id, uint32_t start_key, size_t max_entries,
+                          KeyValueVec* results) {
+    results->clear();
+    rocksdb::ColumnFamilyHandle* cf_handle = GetCFHandle(logspace_id);
+    if (cf_handle == nullptr) {
+        HLOG_F(WARNING, "Log space {} not created", bits::HexStr0x(logspace_id));
+        return true;
+    }
+    rocksdb::ReadOptions options;
+    // Column families are optimized for point lookups with hash index
+    options.total_order_seek = true;
+    std::unique_ptr<rocksdb::Iterator> iter(db_->NewIterator(options, cf_handle));
+    for (iter->Seek(bits::HexStr(start_key));
+            iter->Valid() && results->size() < max_entries; iter->Next()) {
+        uint32_t key = gsl::narrow_cast<uint32_t>(
+            std::stoul(iter->key().ToString(), nullptr, 16));
+        results->emplace_back(key, iter->value().ToString());
+    }
+    auto status = iter->status();
+    ROCKSDB_CHECK_OK(status, Iterator);
+    return true;
+}
+
+void RocksDBBackend::DeleteRange(uint32_t logspace_id, uint32_t start_key,
+                                 uint32_t end_key) {
     rocksdb::ColumnFamilyHandle* cf_handle = GetCFHandle(logspace_id);
     if (cf_handle == nullptr) {
         HLOG_F(ERROR, "Log space {} not created", bits::HexStr0x(logspace_id));
         return;
     }
+    // Hex keys of fixed width are ordered as numbers
+    auto status = db_->DeleteRange(rocksdb::WriteOptions(), cf_handle,
+                                   bits::HexStr(start_key), bits::HexStr(end_key));
+    ROCKSDB_CHECK_OK(status, DeleteRange);
+}
+
+std::optional<std::string> RocksDBBackend::GetAuxData(uint32_t logspace_id, uint32_t key) {
+    rocksdb::ColumnFamilyHandle* cf_handle = GetCFHandle(logspace_id, /* aux_data= */ true);
+    if (cf_handle == nullptr) {
+        HLOG_F(WARNING, "Log space {} not created", bits::HexStr0x(logspace_id));
+        return std::nullopt;
+    }
     std::string key_str = bits::HexStr(key);
+    std::string data;
+    auto status = db_->Get(rocksdb::ReadOptions(), cf_handle, key_str, &data);
+    if (status.IsNotFound()) {
+        return std::nullopt;
+    }
+    ROCKSDB_CHECK_OK(status, Get);
+    return data;
+}
+
+bool RocksDBBackend::PutAuxDataBatch(uint32_t logspace_id, const AuxDataBatch& batch) {
+    rocksdb::ColumnFamilyHandle* cf_handle = GetCFHandle(logspace_id, /* aux_data= */ true);
+    if (cf_handle == nullptr) {
+        return false;
+    }
+    rocksdb::WriteBatch write_batch;
+    for (const auto& [key, data] : batch) {
+        auto status = write_batch.Put(cf_handle, bits::HexStr(key), data);
+        ROCKSDB_CHECK_OK(status, WriteBatchPut);
+    }
+    auto status = db_->Write(rocksdb::WriteOptions(), &write_batch);
+    ROCKSDB_CHECK_OK(status, Write);
+    return true;
+}
+
+// Metadata shares the column family with aux data, names of metadata never
+// collide with hex keys of aux data
+std::optional<std::string> RocksDBBackend::GetMeta(uint32_t logspace_id,
+                                                   std::string_view name) {
+    rocksdb::ColumnFamilyHandle* cf_handle = GetCFHandle(logspace_id, /* aux_data= */ true);
+    if (cf_handle == nullptr) {
+        HLOG_F(WARNING, "Log space {} not created", bits::HexStr0x(logspace_id));
+        return std::nullopt;
+    }
+    std::string data;
+    auto status = db_->Get(rocksdb::ReadOptions(), cf_handle,
+                           fmt::format("meta_{}", name), &data);
+    if (status.IsNotFound()) {
+        return std::nullopt;
+    }
+    ROCKSDB_CHECK_OK(status, Get);
+    return data;
+}
+
+void RocksDBBackend::PutMeta(uint32_t logspace_id, std::string_view name,
+                             std::span<const char> data) {
+    rocksdb::ColumnFamilyHandle* cf_handle = GetCFHandle(logspace_id, /* aux_data= */ true);
+    if (cf_handle == nullptr) {
+        HLOG_F(ERROR, "Log space {} not created", bits::HexStr0x(logspace_id));
+        return;
+    }
     auto status = db_->Put(
         rocksdb::WriteOptions(), cf_handle,
-        key_str, rocksdb::Slice(data.data(), data.size()));
+        fmt::format("meta_{}", name), rocksdb::Slice(data.data(), data.size()));
     ROCKSDB_CHECK_OK(status, Put);
 }
 
-rocksdb::ColumnFamilyHandle* RocksDBBackend::GetCFHandle(uint32_t logspace_id) {
+rocksdb::ColumnFamilyHandle* RocksDBBackend::GetCFHandle(uint32_t logspace_id,
+                                                         bool aux_data) {
     absl::ReaderMutexLock lk(&mu_);
-    if (!column_families_.contains(logspace_id)) {
+    const auto& cfs = aux_data ? aux_column_families_ : column_families_;
+    if (!cfs.contains(logspace_id)) {
         return nullptr;
     }
-    return column_families_.at(logspace_id).get();
+    return cfs.at(logspace_id).get();
 }
 
 TkrzwDBMBackend::TkrzwDBMBackend(Type type, std::string_view db_path)
@@ -118,50 +293,58 @@ TkrzwDBMBackend::~TkrzwDBMBackend() {
         auto status = dbm->Close();
         TKRZW_CHECK_OK(status, Close);
     }
+    for (const auto& [logspace_id, dbm] : aux_dbs_) {
+        auto status = dbm->Close();
+        TKRZW_CHECK_OK(status, Close);
+    }
 }
 
 void TkrzwDBMBackend::InstallLogSpace(uint32_t logspace_id) {
     HLOG_F(INFO, "Install log space {}", bits::HexStr0x(logspace_id));
-    tkrzw::DBM* db_ptr = nullptr;
+    tkrzw::DBM* db_ptr = OpenDBM(bits::HexStr(logspace_id));
+    tkrzw::DBM* aux_db_ptr = OpenDBM(bits::HexStr(logspace_id) + "_aux");
+    {
+        absl::MutexLock lk(&mu_);
+        DCHECK(!dbs_.contains(logspace_id));
+        dbs_[logspace_id].reset(DCHECK_NOTNULL(db_ptr));
+        aux_dbs_[logspace_id].reset(DCHECK_NOTNULL(aux_db_ptr));
+    }
+}
+
+tkrzw::DBM* TkrzwDBMBackend::OpenDBM(std::string_view name) {
     if (type_ == kHashDBM) {
         tkrzw::HashDBM* db = new tkrzw::HashDBM();
         tkrzw::HashDBM::TuningParameters params;
         auto status = db->OpenAdvanced(
-            /* path= */ fmt::format("{}/{}.tkh", db_path_, bits::HexStr(logspace_id)),
+            /* path= */ fmt::format("{}/{}.tkh", db_path_, name),
             /* writable= */ true,
             /* options= */ tkrzw::File::OPEN_DEFAULT,
             /* tuning_params= */ params);
         TKRZW_CHECK_OK(status, Open);
-        db_ptr = db;
+        return db;
     } else if (type_ == kTreeDBM) {
         tkrzw::TreeDBM* db = new tkrzw::TreeDBM();
         tkrzw::TreeDBM::TuningParameters params;
         auto status = db->OpenAdvanced(
-            /* path= */ fmt::format("{}/{}.tkt", db_path_, bits::HexStr(logspace_id)),
+            /* path= */ fmt::format("{}/{}.tkt", db_path_, name),
             /* writable= */ true,
             /* options= */ tkrzw::File::OPEN_DEFAULT,
             /* tuning_params= */ params);
         TKRZW_CHECK_OK(status, Open);
-        db_ptr = db;
+        return db;
     } else if (type_ == kSkipDBM) {
         tkrzw::SkipDBM* db = new tkrzw::SkipDBM();
         tkrzw::SkipDBM::TuningParameters params;
         auto status = db->OpenAdvanced(
-            /* path= */ fmt::format("{}/{}.tks", db_path_, bits::HexStr(logspace_id)),
+            /* path= */ fmt::format("{}/{}.tks", db_path_, name),
             /* writable= */ true,
             /* options= */ tkrzw::File::OPEN_DEFAULT,
             /* tuning_params= */ params);
         TKRZW_CHECK_OK(status, Open);
-        db_ptr = db;
+        return db;
     } else {
         UNREACHABLE();
     }
-
-    {
-        absl::MutexLock lk(&mu_);
-        DCHECK(!dbs_.contains(logspace_id));
-        dbs_[logspace_id].reset(DCHECK_NOTNULL(db_ptr));
-    }
 }
 
 std::optional<std::string> TkrzwDBMBackend::Get(uint32_t logspace_id, uint32_t key) {
@@ -180,7 +363,9 @@ std::optional<std::string> TkrzwDBMBackend::Get(uint32_t logspace_id, uint32_t k
     }
 }
 
-void TkrzwDBMBackend::Put(uint32_t logspace_id, uint32_t key, std::span<const char> data) {
+void TkrzwDBMBackend::Put(uint32_t logspace_id, uint32_t key, std::span<const char> data,
+                          bool disable_wal) {
+    // tkrzw DBMs have no write-ahead log
     tkrzw::DBM* dbm = GetDBM(logspace_id);
     if (dbm == nullptr) {
         HLOG_F(FATAL, "Log space {} not created", bits::HexStr0x(logspace_id));
@@ -190,12 +375,144 @@ void TkrzwDBMBackend::Put(uint32_t logspace_id, uint32_t key, std::span<const ch
     TKRZW_CHECK_OK(status, Set);
 }
 
-tkrzw::DBM* TkrzwDBMBackend::GetDBM(uint32_t logspace_id) {
+void TkrzwDBMBackend::Sync() {
+    absl::MutexLock lk(&mu_);
+    for (const auto& [logspace_id, dbm] : dbs_) {
+        auto status = dbm->Synchronize(/* hard= */ true);
+        TKRZW_CHECK_OK(status, Synchronize);
+    }
+}
+
+void TkrzwDBMBackend::Flush(uint32_t logspace_id) {
+    // Writes go to files without any WAL, thus survive process crashes
+}
+
+bool TkrzwDBMBackend::Scan(uint32_t logspace_id, uint32_t start_key, size_t max_entries,
+                           KeyValueVec* results) {
+    results->clear();
+    tkrzw::DBM* dbm = GetDBM(logspace_id);
+    if (dbm == nullptr) {
+        HLOG_F(WARNING, "Log space {} not created", bits::HexStr0x(logspace_id));
+        return true;
+    }
+    if (!dbm->IsOrdered()) {
+        return false;
+    }
+    std::unique_ptr<tkrzw::DBM::Iterator> iter = dbm->MakeIterator();
+    auto status = iter->Jump(bits::HexStr(start_key));
+    while (status.IsOK() && results->size() < max_entries) {
+        std::string key_str;
+        std::string data;
+        status = iter->Get(&key_str, &data);
+        if (!status.IsOK()) {
+            break;
+        }
+        uint32_t key = gsl::narrow_cast<uint32_t>(std::stoul(key_str, nullptr, 16));
+        results->emplace_back(key, std::move(data));
+        status = iter->Next();
+    }
+    return true;
+}
+
+void TkrzwDBMBackend::DeleteRange(uint32_t logspace_id, uint32_t start_key,
+                                  uint32_t end_key) {
+    tkrzw::DBM* dbm = GetDBM(logspace_id);
+    if (dbm == nullptr) {
+        HLOG_F(FATAL, "Log space {} not created", bits::HexStr0x(logspace_id));
+    }
+    std::vector<std::string> keys;
+    if (dbm->IsOrdered()) {
+        std::unique_ptr<tkrzw::DBM::Iterator> iter = dbm->MakeIterator();
+        std::string end_key_str = bits::HexStr(end_key);
+        auto status = iter->Jump(bits::HexStr(start_key));
+        while (status.IsOK()) {
+            std::string key_str;
+            if (!iter->Get(&key_str).IsOK() || key_str >= end_key_str) {
+                break;
+            }
+            keys.push_back(std::move(key_str));
+            status = iter->Next();
+        }
+    } else {
+        for (uint32_t key = start_key; key < end_key; key++) {
+            keys.push_back(bits::HexStr(key));
+        }
+    }
+    for (const std::string& key_str : keys) {
+        auto status = dbm->Remove(key_str);
+        if (!status.IsOK() && status.GetCode() != tkrzw::Status::NOT_FOUND_ERROR) {
+            TKRZW_CHECK_OK(status, Remove);
+        }
+    }
+}
+
+std::optional<std::string> TkrzwDBMBackend::GetAuxData(uint32_t logspace_id, uint32_t key) {
+    tkrzw::DBM* dbm = GetDBM(logspace_id, /* aux_data= */ true);
+    if (dbm == nullptr) {
+        HLOG_F(WARNING, "Log space {} not created", bits::HexStr0x(logspace_id));
+        return std::nullopt;
+    }
+    std::string key_str = bits::HexStr(key);
+    std::string data;
+    auto status = dbm->Get(key_str, &data);
+    if (status.IsOK()) {
+        return data;
+    } else {
+        return std::nullopt;
+    }
+}
+
+bool TkrzwDBMBackend::PutAuxDataBatch(uint32_t logspace_id, const AuxDataBatch& batch) {
+    tkrzw::DBM* dbm = GetDBM(logspace_id, /* aux_data= */ true);
+    if (dbm == nullptr) {
+        return false;
+    }
+    std::map<std::string_view, std::string_view> records;
+    std::vector<std::string> keys;
+    keys.reserve(batch.size());
+    for (const auto& [key, data] : batch) {
+        keys.push_back(bits::HexStr(key));
+        records[keys.back()] = data;
+    }
+    auto status = dbm->SetMulti(records);
+    TKRZW_CHECK_OK(status, SetMulti);
+    return true;
+}
+
+std::optional<std::string> TkrzwDBMBackend::GetMeta(uint32_t logspace_id,
+                                                    std::string_view name) {
+    tkrzw::DBM* dbm = GetDBM(logspace_id, /* aux_data= */ true);
+    if (dbm == nullptr) {
+        HLOG_F(WARNING, "Log space {} not created", bits::HexStr0x(logspace_id));
+        return std::nullopt;
+    }
+    std::string data;
+    auto status = dbm->Get(fmt::format("meta_{}", name), &data);
+    if (status.IsOK()) {
+        return data;
+    } else {
+        return std::nullopt;
+    }
+}
+
+void TkrzwDBMBackend::PutMeta(uint32_t logspace_id, std::string_view name,
+                              std::span<const char> data) {
+    tkrzw::DBM* dbm = GetDBM(logspace_id, /* aux_data= */ true);
+    if (dbm == nullptr) {
+        HLOG_F(FATAL, "Log space {} not created", bits::HexStr0x(logspace_id));
+    }
+    auto status = dbm->Set(fmt::format("meta_{}", name),
+                           std::string_view(data.data(), data.size()));
+    TKRZW_CHECK_OK(status, Set);
+}
+
+tkrzw::DBM* TkrzwDBMBackend::GetDBM(uint32_t logspace_id, bool aux_data) {
     absl::ReaderMutexLock lk(&mu_);
-    if (!dbs_.contains(logspace_id)) {
+    const auto& dbs = aux_data ? aux_dbs_ : dbs_;
+    if (!dbs.contains(logspace_id)) {
         return nullptr;
     }
-    return dbs_.at(logspace_id).get();
+    return dbs.at(logspace_id).get();
 }
 
 }  // namespace log
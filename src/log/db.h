@@ -15,7 +15,33 @@ public:
 
     virtual void InstallLogSpace(uint32_t logspace_id) = 0;
     virtual std::optional<std::string> Get(uint32_t logspace_id, uint32_t key) = 0;
-    virtual void Put(uint32_t logspace_id, uint32_t key, std::span<const char> data) = 0;
+    // With `disable_wal`, the write may be lost on crashes before the backend
+    // flushes it, which is fine for entries durable through replication
+    virtual void Put(uint32_t logspace_id, uint32_t key, std::span<const char> data,
+                     bool disable_wal) = 0;
+    // Makes all writes so far durable
+    virtual void Sync() = 0;
+    // Persists writes of the log space made with `disable_wal`, so that
+    // writes following it cannot survive crashes without them
+    virtual void Flush(uint32_t logspace_id) = 0;
+    // Up to `max_entries` entries with keys >= `start_key`, in key order.
+    // Returns false if the backend does not support ordered scans.
+    using KeyValueVec = std::vector<std::pair</* key */ uint32_t, std::string>>;
+    virtual bool Scan(uint32_t logspace_id, uint32_t start_key, size_t max_entries,
+                      KeyValueVec* results) = 0;
+    // Removes entries with keys in [start_key, end_key)
+    virtual void DeleteRange(uint32_t logspace_id, uint32_t start_key, uint32_t end_key) = 0;
+
+    // Auxiliary data of log entries lives in a key space separate from entries
+    using AuxDataBatch = std::vector<std::pair</* key */ uint32_t, std::string>>;
+    virtual std::optional<std::string> GetAuxData(uint32_t logspace_id, uint32_t key) = 0;
+    // Returns false if the log space is not installed
+    virtual bool PutAuxDataBatch(uint32_t logspace_id, const AuxDataBatch& batch) = 0;
+
+    // Named metadata of the log space, e.g. compression dictionaries
+    virtual std::optional<std::string> GetMeta(uint32_t logspace_id, std::string_view name) = 0;
+    virtual void PutMeta(uint32_t logspace_id, std::string_view name,
+                         std::span<const char> data) = 0;
 };
 
 class RocksDBBackend final : public DBInterface {
@@ -25,7 +51,18 @@ public:
 
     void InstallLogSpace(uint32_t logspace_id) override;
     std::optional<std::string> Get(uint32_t logspace_id, uint32_t key) override;
-    void Put(uint32_t logspace_id, uint32_t key, std::span<const char> data) override;
+    void Put(uint32_t logspace_id, uint32_t key, std::span<const char> data,
+             bool disable_wal) override;
+    void Sync() override;
+    void Flush(uint32_t logspace_id) override;
+    bool Scan(uint32_t logspace_id, uint32_t start_key, size_t max_entries,
+              KeyValueVec* results) override;
+    void DeleteRange(uint32_t logspace_id, uint32_t start_key, uint32_t end_key) override;
+    std::optional<std::string> GetAuxData(uint32_t logspace_id, uint32_t key) override;
+    bool PutAuxDataBatch(uint32_t logspace_id, const AuxDataBatch& batch) override;
+    std::optional<std::string> GetMeta(uint32_t logspace_id, std::string_view name) override;
+    void PutMeta(uint32_t logspace_id, std::string_view name,
+                 std::span<const char> data) override;
 
 private:
     std::unique_ptr<rocksdb::DB> db_;
@@ -33,8 +70,11 @@ private:
     absl::flat_hash_map</* logspace_id */ uint32_t,
                         std::unique_ptr<rocksdb::ColumnFamilyHandle>>
         column_families_ ABSL_GUARDED_BY(mu_);
+    absl::flat_hash_map</* logspace_id */ uint32_t,
+                        std::unique_ptr<rocksdb::ColumnFamilyHandle>>
+        aux_column_families_ ABSL_GUARDED_BY(mu_);
 
-    rocksdb::ColumnFamilyHandle* GetCFHandle(uint32_t logspace_id);
+    rocksdb::ColumnFamilyHandle* GetCFHandle(uint32_t logspace_id, bool aux_data = false);
 
     DISALLOW_COPY_AND_ASSIGN(RocksDBBackend);
 };
@@ -47,7 +87,18 @@ public:
 
     void InstallLogSpace(uint32_t logspace_id) override;
     std::optional<std::string> Get(uint32_t logspace_id, uint32_t key) override;
-    void Put(uint32_t logspace_id, uint32_t key, std::span<const char> data) override;
+    void Put(uint32_t logspace_id, uint32_t key, std::span<const char> data,
+             bool disable_wal) override;
+    void Sync() override;
+    void Flush(uint32_t logspace_id) override;
+    bool Scan(uint32_t logspace_id, uint32_t start_key, size_t max_entries,
+              KeyValueVec* results) override;
+    void DeleteRange(uint32_t logspace_id, uint32_t start_key, uint32_t end_key) override;
+    std::optional<std::string> GetAuxData(uint32_t logspace_id, uint32_t key) override;
+    bool PutAuxDataBatch(uint32_t logspace_id, const AuxDataBatch& batch) override;
+    std::optional<std::string> GetMeta(uint32_t logspace_id, std::string_view name) override;
+    void PutMeta(uint32_t logspace_id, std::string_view name,
+                 std::span<const char> data) override;
 
 private:
     Type type_;
@@ -57,8 +108,12 @@ private:
     absl::flat_hash_map</* logspace_id */ uint32_t,
                         std::unique_ptr<tkrzw::DBM>>
         dbs_ ABSL_GUARDED_BY(mu_);
+    absl::flat_hash_map</* logspace_id */ uint32_t,
+                        std::unique_ptr<tkrzw::DBM>>
+        aux_dbs_ ABSL_GUARDED_BY(mu_);
 
-    tkrzw::DBM* GetDBM(uint32_t logspace_id);
+    tkrzw::DBM* OpenDBM(std::string_view name);
+    tkrzw::DBM* GetDBM(uint32_t logspace_id, bool aux_data = false);
 
     DISALLOW_COPY_AND_ASSIGN(TkrzwDBMBackend);
 };
@@ -1,5 +1,6 @@
 #include "log/engine.h"
 
+#include "common/time.h"
 #include "engine/engine.h"
 #include "log/flags.h"
 #include "utils/bits.h"
@@ -19,7 +20,15 @@ Engine::Engine(engine::Engine* engine)
     : EngineBase(engine),
       log_header_(fmt::format("LogEngine[{}-N]: ", my_node_id())),
       current_view_(nullptr),
-      current_view_active_(false) {}
+      current_view_active_(false),
+      prefetch_max_depth_(absl::GetFlag(FLAGS_slog_engine_enable_cache)
+                            ? gsl::narrow_cast<size_t>(
+                                  absl::GetFlag(FLAGS_slog_engine_prefetch_max_depth))
+                            : 0) {
+    if (size_t cap = absl::GetFlag(FLAGS_slog_engine_index_result_cache); cap > 0) {
+        index_result_cache_.emplace(cap);
+    }
+}
 
 Engine::~Engine() {}
 
@@ -63,17 +72,25 @@ void Engine::OnViewCreated(const View* view) {
             }
         );
     }
+    // Records of the previous view go to its storage nodes
+    FlushReplicateBatch();
+    // Tag watches are bound to indices of the previous view
+    WakeUpSubscriptions();
 }
 
 void Engine::OnViewFrozen(const View* view) {
     DCHECK(zk_session()->WithinMyEventLoopThread());
     HLOG_F(INFO, "View {} frozen", view->id());
-    absl::MutexLock view_lk(&view_mu_);
-    DCHECK_EQ(view->id(), current_view_->id());
-    if (view->contains_engine_node(my_node_id())) {
-        DCHECK(current_view_active_);
-        current_view_active_ = false;
+    {
+        absl::MutexLock view_lk(&view_mu_);
+        DCHECK_EQ(view->id(), current_view_->id());
+        if (view->contains_engine_node(my_node_id())) {
+            DCHECK(current_view_active_);
+            current_view_active_ = false;
+        }
     }
+    // Records appended before the freeze are not left to the timer
+    FlushReplicateBatch();
 }
 
 void Engine::OnViewFinalized(const FinalizedView* finalized_view) {
@@ -81,6 +98,7 @@ void Engine::OnViewFinalized(const FinalizedView* finalized_view) {
     HLOG_F(INFO, "View {} finalized", finalized_view->view()->id());
     LogProducer::AppendResultVec append_results;
     Index::QueryResultVec query_results;
+    std::vector<TagSummaryProto> tag_summaries;
     {
         absl::MutexLock view_lk(&view_mu_);
         DCHECK_EQ(finalized_view->view()->id(), current_view_->id());
@@ -98,12 +116,15 @@ void Engine::OnViewFinalized(const FinalizedView* finalized_view) {
         );
         index_collection_.ForEachActiveLogSpace(
             finalized_view->view(),
-            [finalized_view, &query_results] (uint32_t logspace_id,
-                                              LockablePtr<Index> index_ptr) {
+            [finalized_view, &query_results, &tag_summaries] (uint32_t logspace_id,
+                                                              LockablePtr<Index> index_ptr) {
                 log_utils::FinalizedLogSpace<Index>(
                     index_ptr, finalized_view);
                 auto locked_index = index_ptr.Lock();
                 locked_index->PollQueryResults(&query_results);
+                if (auto summary = locked_index->PollTagSummary(); summary.has_value()) {
+                    tag_summaries.push_back(std::move(*summary));
+                }
             }
         );
     }
@@ -121,6 +142,13 @@ void Engine::OnViewFinalized(const FinalizedView* finalized_view) {
             }
         );
     }
+    if (!tag_summaries.empty()) {
+        SomeIOWorker()->ScheduleFunction(
+            nullptr, [this, summaries = std::move(tag_summaries)] {
+                ProcessTagSummaries(summaries);
+            }
+        );
+    }
 }
 
 namespace {
@@ -186,9 +214,34 @@ static Message BuildLocalReadOKResponse(const LogEntry& log_entry) {
     } while (0)
 
 void Engine::HandleLocalAppend(LocalOp* op) {
-    DCHECK(op->type == SharedLogOpType::APPEND);
+    DCHECK(  op->type == SharedLogOpType::APPEND
+          || op->type == SharedLogOpType::ASYNC_APPEND
+          || op->type == SharedLogOpType::COND_APPEND);
     HVLOG_F(1, "Handle local append: op_id={}, logspace={}, num_tags={}, size={}",
             op->id, op->user_logspace, op->user_tags.size(), op->data.length());
+    if (op->type == SharedLogOpType::COND_APPEND) {
+        if (absl::GetFlag(FLAGS_slog_partition_index)) {
+            HLOG(WARNING) << "Conditional append is not supported by partitioned index";
+            FinishLocalOpWithFailure(op, SharedLogResultType::BAD_ARGS);
+            return;
+        }
+        // The tag of the condition goes first
+        auto iter = absl::c_find(op->user_tags, op->query_tag);
+        if (iter == op->user_tags.end()) {
+            HLOG_F(WARNING, "Tag {} of the condition is not a tag of the log",
+                   op->query_tag);
+            FinishLocalOpWithFailure(op, SharedLogResultType::BAD_ARGS);
+            return;
+        }
+        std::iter_swap(op->user_tags.begin(), iter);
+        if (ReadCondTailOfEarlierViews(op)) {
+            return;
+        }
+    }
+    AppendLocalOp(op);
+}
+
+void Engine::AppendLocalOp(LocalOp* op) {
     const View* view = nullptr;
     LogMetaData log_metadata = MetaDataFromAppendOp(op);
     {
@@ -204,12 +257,65 @@ void Engine::HandleLocalAppend(LocalOp* op) {
         auto producer_ptr = producer_collection_.GetLogSpaceChecked(logspace_id);
         {
             auto locked_producer = producer_ptr.Lock();
-            locked_producer->LocalAppend(op, &log_metadata.localid);
+            locked_producer->LocalAppend(
+                op, &log_metadata.localid,
+                /* async= */ op->type == SharedLogOpType::ASYNC_APPEND);
         }
     }
     ReplicateLogEntry(view, log_metadata, VECTOR_AS_SPAN(op->user_tags), op->data.to_span());
 }
 
+bool Engine::ReadCondTailOfEarlierViews(LocalOp* op) {
+    DCHECK(op->type == SharedLogOpType::COND_APPEND);
+    uint16_t view_id;
+    {
+        absl::ReaderMutexLock view_lk(&view_mu_);
+        if (current_view_ == nullptr) {
+            return false;
+        }
+        view_id = current_view_->id();
+    }
+    uint64_t expected = op->seqnum;
+    if (view_id == 0
+            || (expected != kInvalidLogSeqNum && log_utils::GetViewId(expected) >= view_id)) {
+        // The index can check the condition within the current view
+        return false;
+    }
+    // Index checks only see entries of their own view, so the tail of the tag
+    // in earlier views is verified here, by reading backward from the end of
+    // the previous view
+    uint64_t seqnum = bits::JoinTwo32(bits::JoinTwo16(view_id, 0), 0) - 1;
+    HVLOG_F(1, "Read tail of tag {} before view {} for conditional append op {}",
+            op->query_tag, view_id, op->id);
+    HandleLocalRead(NewCondTailReadOp(op, seqnum));
+    return true;
+}
+
+void Engine::OnCondTailReadFinished(const LocalOp* op, const Message& response) {
+    LocalOp* cond_op = DCHECK_NOTNULL(op->cond_append_op);
+    uint16_t view_id = gsl::narrow_cast<uint16_t>(log_utils::GetViewId(op->seqnum) + 1);
+    uint64_t tail_seqnum;
+    SharedLogResultType result = MessageHelper::GetSharedLogResultType(response);
+    if (result == SharedLogResultType::READ_OK) {
+        tail_seqnum = response.log_seqnum;
+    } else if (result == SharedLogResultType::EMPTY) {
+        tail_seqnum = kInvalidLogSeqNum;
+    } else {
+        FinishLocalOpWithFailure(cond_op, result);
+        return;
+    }
+    if (tail_seqnum != cond_op->seqnum) {
+        HVLOG_F(1, "Conditional append op {} expects tail {}, while the tail is {}",
+                cond_op->id, bits::HexStr0x(cond_op->seqnum), bits::HexStr0x(tail_seqnum));
+        FinishLocalOpWithFailure(cond_op, SharedLogResultType::COND_FAILED);
+        return;
+    }
+    // The index of `view_id` accepts the anchor if the tag has no entry there,
+    // later views reject it as entries may be appended in between
+    cond_op->seqnum = log_utils::CondAnchorSeqNum(view_id);
+    AppendLocalOp(cond_op);
+}
+
 void Engine::HandleLocalTrim(LocalOp* op) {
     DCHECK(op->type == SharedLogOpType::TRIM);
     NOT_IMPLEMENTED();
@@ -222,6 +328,9 @@ void Engine::HandleLocalRead(LocalOp* op) {
     HVLOG_F(1, "Handle local read: op_id={}, logspace={}, tag={}, seqnum={}",
             op->id, op->user_logspace, op->query_tag, bits::HexStr0x(op->seqnum));
     onging_reads_.PutChecked(op->id, op);
+    if (op->type == SharedLogOpType::READ_NEXT && ReadFromPrefetchedStream(op)) {
+        return;
+    }
     const View::Sequencer* sequencer_node = nullptr;
     LockablePtr<Index> index_ptr;
     {
@@ -229,15 +338,64 @@ void Engine::HandleLocalRead(LocalOp* op) {
         ONHOLD_IF_SEEN_FUTURE_VIEW(op);
         uint32_t logspace_id = current_view_->LogSpaceIdentifier(op->user_logspace);
         sequencer_node = current_view_->GetSequencerNode(bits::LowHalf32(logspace_id));
-        if (sequencer_node->IsIndexEngineNode(my_node_id())) {
+        if (!InSameIndexPartition(sequencer_node, op->user_logspace, op->user_tags)) {
+            sequencer_node = nullptr;
+        } else if (HasIndexFor(sequencer_node, op->user_logspace, op->query_tag)) {
             index_ptr = index_collection_.GetLogSpaceChecked(logspace_id);
         }
+        if (op->read_consistency != protocol::ReadConsistency::STRICT) {
+            RelaxReadMetaLogProgress(op, logspace_id);
+        }
+    }
+    if (sequencer_node == nullptr) {
+        HLOG_F(WARNING, "Tags of multi-tag read op {} span index partitions", op->id);
+        onging_reads_.RemoveChecked(op->id);
+        FinishLocalOpWithFailure(op, SharedLogResultType::BAD_ARGS);
+        return;
+    }
+    QueryIndex(op, sequencer_node, std::move(index_ptr));
+}
+
+void Engine::RelaxReadMetaLogProgress(LocalOp* op, uint32_t logspace_id) {
+    uint64_t progress = op->metalog_progress;
+    switch (op->read_consistency) {
+    case protocol::ReadConsistency::BOUNDED_POSITIONS:
+        {
+            uint32_t position = bits::LowHalf64(progress);
+            position -= std::min(position, op->staleness_bound);
+            progress = bits::JoinTwo32(bits::HighHalf64(progress), position);
+        }
+        break;
+    case protocol::ReadConsistency::BOUNDED_MICROS:
+        {
+            int64_t timestamp = GetMonotonicMicroTimestamp() - op->staleness_bound;
+            auto producer_ptr = producer_collection_.GetLogSpaceChecked(logspace_id);
+            uint32_t position = producer_ptr.ReaderLock()->MetaLogPositionAt(timestamp);
+            progress = std::min(progress, bits::JoinTwo32(logspace_id, position));
+        }
+        break;
+    case protocol::ReadConsistency::LOCAL_LATEST:
+        progress = 0;
+        break;
+    default:
+        HLOG_F(WARNING, "Unknown read consistency {}, use strict one",
+               static_cast<uint16_t>(op->read_consistency));
+        return;
     }
+    HVLOG_F(1, "Relax metalog progress of read op {}: {} -> {}", op->id,
+            bits::HexStr0x(op->metalog_progress), bits::HexStr0x(progress));
+    op->metalog_progress = progress;
+}
+
+void Engine::QueryIndex(LocalOp* op, const View::Sequencer* sequencer_node,
+                        LockablePtr<Index> index_ptr) {
     bool use_local_index = true;
-    if (absl::GetFlag(FLAGS_slog_engine_force_remote_index)) {
+    // Partitioned index has a single index engine node for the query
+    bool partitioned = absl::GetFlag(FLAGS_slog_partition_index);
+    if (!partitioned && absl::GetFlag(FLAGS_slog_engine_force_remote_index)) {
         use_local_index = false;
     }
-    if (absl::GetFlag(FLAGS_slog_engine_prob_remote_index) > 0.0f) {
+    if (!partitioned && absl::GetFlag(FLAGS_slog_engine_prob_remote_index) > 0.0f) {
         float coin = utils::GetRandomFloat(0.0f, 1.0f);
         if (coin < absl::GetFlag(FLAGS_slog_engine_prob_remote_index)) {
             use_local_index = false;
@@ -247,18 +405,24 @@ void Engine::HandleLocalRead(LocalOp* op) {
         // Use local index
         IndexQuery query = BuildIndexQuery(op);
         Index::QueryResultVec query_results;
-        {
-            auto locked_index = index_ptr.Lock();
-            locked_index->MakeQuery(query);
-            locked_index->PollQueryResults(&query_results);
-        }
+        MakeIndexQuery(index_ptr, query, &query_results);
         ProcessIndexQueryResults(query_results);
     } else {
+        uint32_t logspace_id = bits::JoinTwo16(sequencer_node->view()->id(),
+                                               sequencer_node->node_id());
+        if (QueryIndexResultCache(op, logspace_id)) {
+            return;
+        }
         HVLOG_F(1, "There is no local index for sequencer {}, "
                    "will send request to remote engine node",
                 DCHECK_NOTNULL(sequencer_node)->node_id());
         SharedLogMessage request = BuildReadRequestMessage(op);
-        bool send_success = SendIndexReadRequest(DCHECK_NOTNULL(sequencer_node), &request);
+        std::span<const char> payload = EMPTY_CHAR_SPAN;
+        if ((request.flags & protocol::kReadTagSetFlag) != 0) {
+            payload = VECTOR_AS_CHAR_SPAN(op->user_tags);
+        }
+        bool send_success = SendIndexReadRequest(DCHECK_NOTNULL(sequencer_node), &request,
+                                                 payload);
         if (!send_success) {
             onging_reads_.RemoveChecked(op->id);
             FinishLocalOpWithFailure(op, SharedLogResultType::DATA_LOST);
@@ -268,15 +432,17 @@ void Engine::HandleLocalRead(LocalOp* op) {
 
 void Engine::HandleLocalSetAuxData(LocalOp* op) {
     uint64_t seqnum = op->seqnum;
-    LogCachePutAuxData(seqnum, op->data.to_span());
+    LogCachePutAuxData(op->user_logspace, seqnum, op->data.to_span());
     Message response = MessageHelper::NewSharedLogOpSucceeded(
         SharedLogResultType::AUXDATA_OK, seqnum);
     FinishLocalOpWithResponse(op, &response, /* metalog_progress= */ 0);
     if (!absl::GetFlag(FLAGS_slog_engine_propagate_auxdata)) {
         return;
     }
-    if (auto log_entry = LogCacheGet(seqnum); log_entry.has_value()) {
-        if (auto aux_data = LogCacheGetAuxData(seqnum); aux_data.has_value()) {
+    if (auto log_entry = LogCacheGet(op->user_logspace, seqnum, /* touch= */ false);
+            log_entry.has_value()) {
+        if (auto aux_data = LogCacheGetAuxData(op->user_logspace, seqnum);
+                aux_data.has_value()) {
             uint16_t view_id = log_utils::GetViewId(seqnum);
             absl::ReaderMutexLock view_lk(&view_mu_);
             if (view_id < views_.size()) {
@@ -287,6 +453,82 @@ void Engine::HandleLocalSetAuxData(LocalOp* op) {
     }
 }
 
+void Engine::HandleLocalResolveLocalId(LocalOp* op) {
+    DCHECK(op->type == SharedLogOpType::RESOLVE_LOCALID);
+    uint64_t localid = op->localid;
+    HVLOG_F(1, "Resolve localid {}", bits::HexStr0x(localid));
+    AsyncAppendResult result;
+    {
+        absl::MutexLock lk(&async_append_mu_);
+        if (pending_async_appends_.contains(localid)) {
+            // Wait until the seqnum is known
+            resolve_localid_ops_[localid].push_back(op);
+            return;
+        }
+        if (!async_append_results_.contains(localid)) {
+            HLOG_F(WARNING, "Unknown or expired localid {}", bits::HexStr0x(localid));
+            FinishLocalOpWithFailure(op, SharedLogResultType::BAD_ARGS);
+            return;
+        }
+        result = async_append_results_.at(localid);
+    }
+    FinishResolveLocalIdOp(op, result);
+}
+
+void Engine::HandleLocalSubscription(LocalOp* op) {
+    SubscriptionKey key(op->client_id, op->client_data);
+    LocalOp* read_op = nullptr;
+    bool duplicated = false;
+    {
+        absl::MutexLock lk(&subscription_mu_);
+        switch (op->type) {
+        case SharedLogOpType::SUBSCRIBE:
+            if (subscriptions_.contains(key)) {
+                duplicated = true;
+                break;
+            }
+            HVLOG_F(1, "New subscription on tag {} from seqnum {}: client_id={}, client_data={}",
+                    op->query_tag, bits::HexStr0x(op->seqnum), op->client_id, op->client_data);
+            subscriptions_[key] = Subscription {
+                .op = op,
+                .state = Subscription::kIdle,
+                .woken = false,
+                .next_seqnum = op->seqnum,
+                .credits = op->sub_credits
+            };
+            func_call_subscriptions_[op->func_call_id].insert(key);
+            read_op = NextSubscriptionRead(key, &subscriptions_[key]);
+            break;
+        case SharedLogOpType::SUB_CREDITS:
+            if (auto iter = subscriptions_.find(key); iter != subscriptions_.end()) {
+                iter->second.credits += op->sub_credits;
+                read_op = NextSubscriptionRead(key, &iter->second);
+            }
+            ReleaseLocalOp(op);
+            break;
+        case SharedLogOpType::UNSUBSCRIBE:
+            if (subscriptions_.contains(key)) {
+                HVLOG_F(1, "Remove subscription: client_id={}, client_data={}",
+                        op->client_id, op->client_data);
+                RemoveSubscription(key);
+            }
+            ReleaseLocalOp(op);
+            break;
+        default:
+            UNREACHABLE();
+        }
+    }
+    if (duplicated) {
+        HLOG_F(WARNING, "Subscription already exists: client_id={}, client_data={}",
+               op->client_id, op->client_data);
+        FinishLocalOpWithFailure(op, SharedLogResultType::BAD_ARGS);
+        return;
+    }
+    if (read_op != nullptr) {
+        DispatchSubscriptionReads({read_op});
+    }
+}
+
 #undef ONHOLD_IF_SEEN_FUTURE_VIEW
 
 // Start handlers for remote messages
@@ -312,7 +554,8 @@ void Engine::HandleLocalSetAuxData(LocalOp* op) {
         }                                                           \
     } while (0)
 
-void Engine::HandleRemoteRead(const SharedLogMessage& request) {
+void Engine::HandleRemoteRead(const SharedLogMessage& request,
+                              std::span<const char> payload) {
     SharedLogOpType op_type = SharedLogMessageHelper::GetOpType(request);
     DCHECK(  op_type == SharedLogOpType::READ_NEXT
           || op_type == SharedLogOpType::READ_PREV
@@ -320,26 +563,24 @@ void Engine::HandleRemoteRead(const SharedLogMessage& request) {
     LockablePtr<Index> index_ptr;
     {
         absl::ReaderMutexLock view_lk(&view_mu_);
-        ONHOLD_IF_FROM_FUTURE_VIEW(request, EMPTY_CHAR_SPAN);
+        ONHOLD_IF_FROM_FUTURE_VIEW(request, payload);
         index_ptr = index_collection_.GetLogSpaceChecked(request.logspace_id);
     }
-    IndexQuery query = BuildIndexQuery(request);
+    IndexQuery query = BuildIndexQuery(request, payload);
     Index::QueryResultVec query_results;
-    {
-        auto locked_index = index_ptr.Lock();
-        locked_index->MakeQuery(query);
-        locked_index->PollQueryResults(&query_results);
-    }
+    MakeIndexQuery(index_ptr, query, &query_results);
     ProcessIndexQueryResults(query_results);
 }
 
 void Engine::OnRecvNewMetaLogs(const SharedLogMessage& message,
                                std::span<const char> payload) {
     DCHECK(SharedLogMessageHelper::GetOpType(message) == SharedLogOpType::METALOGS);
-    MetaLogsProto metalogs_proto = log_utils::MetaLogsFromPayload(payload);
-    DCHECK_EQ(metalogs_proto.logspace_id(), message.logspace_id);
+    log_utils::MetaLogsPayload metalogs(message, payload);
+    DCHECK_EQ(metalogs.logspace_id(), message.logspace_id);
     LogProducer::AppendResultVec append_results;
     Index::QueryResultVec query_results;
+    Index::TagWatchVec fired_watches;
+    uint32_t metalog_position = 0;
     {
         absl::ReaderMutexLock view_lk(&view_mu_);
         ONHOLD_IF_FROM_FUTURE_VIEW(message, payload);
@@ -347,24 +588,26 @@ void Engine::OnRecvNewMetaLogs(const SharedLogMessage& message,
         auto producer_ptr = producer_collection_.GetLogSpaceChecked(message.logspace_id);
         {
             auto locked_producer = producer_ptr.Lock();
-            for (const MetaLogProto& metalog_proto : metalogs_proto.metalogs()) {
-                locked_producer->ProvideMetaLog(metalog_proto);
-            }
+            locked_producer->ProvideMetaLogs(metalogs);
             locked_producer->PollAppendResults(&append_results);
+            metalog_position = locked_producer->metalog_position();
         }
         if (current_view_->GetEngineNode(my_node_id())->HasIndexFor(message.sequencer_id)) {
             auto index_ptr = index_collection_.GetLogSpaceChecked(message.logspace_id);
             {
                 auto locked_index = index_ptr.Lock();
-                for (const MetaLogProto& metalog_proto : metalogs_proto.metalogs()) {
-                    locked_index->ProvideMetaLog(metalog_proto);
-                }
+                locked_index->ProvideMetaLogs(metalogs);
                 locked_index->PollQueryResults(&query_results);
+                locked_index->PollFiredTagWatches(&fired_watches);
             }
         }
     }
+    if (index_result_cache_.has_value()) {
+        index_result_cache_->OnMetaLogsApplied(message.logspace_id, metalog_position);
+    }
     ProcessAppendResults(append_results);
     ProcessIndexQueryResults(query_results);
+    OnTagWatchesFired(fired_watches);
 }
 
 void Engine::OnRecvNewIndexData(const SharedLogMessage& message,
@@ -376,6 +619,8 @@ void Engine::OnRecvNewIndexData(const SharedLogMessage& message,
         LOG(FATAL) << "Failed to parse IndexDataProto";
     }
     Index::QueryResultVec query_results;
+    Index::TagWatchVec fired_watches;
+    std::optional<TagSummaryProto> tag_summary;
     {
         absl::ReaderMutexLock view_lk(&view_mu_);
         ONHOLD_IF_FROM_FUTURE_VIEW(message, payload);
@@ -394,14 +639,57 @@ void Engine::OnRecvNewIndexData(const SharedLogMessage& message,
             auto locked_index = index_ptr.Lock();
             locked_index->ProvideIndexData(index_data_proto);
             locked_index->PollQueryResults(&query_results);
+            locked_index->PollFiredTagWatches(&fired_watches);
+            tag_summary = locked_index->PollTagSummary();
         }
     }
     ProcessIndexQueryResults(query_results);
+    OnTagWatchesFired(fired_watches);
+    if (tag_summary.has_value()) {
+        ProcessTagSummaries({std::move(*tag_summary)});
+    }
+}
+
+void Engine::OnRecvShardProgress(const SharedLogMessage& message,
+                                 std::span<const char> payload) {
+    DCHECK(SharedLogMessageHelper::GetOpType(message) == SharedLogOpType::SHARD_PROG);
+    if (payload.size() != sizeof(uint32_t)) {
+        HLOG_F(FATAL, "Invalid shard progress payload size: {}", payload.size());
+    }
+    uint32_t progress;
+    memcpy(&progress, payload.data(), sizeof(uint32_t));
+    LogProducer::AppendResultVec append_results;
+    {
+        absl::ReaderMutexLock view_lk(&view_mu_);
+        ONHOLD_IF_FROM_FUTURE_VIEW(message, payload);
+        IGNORE_IF_FROM_PAST_VIEW(message);
+        auto producer_ptr = producer_collection_.GetLogSpaceChecked(message.logspace_id);
+        {
+            auto locked_producer = producer_ptr.Lock();
+            locked_producer->UpdateStorageProgress(message.origin_node_id, progress);
+            locked_producer->PollAppendResults(&append_results);
+        }
+    }
+    ProcessAppendResults(append_results);
 }
 
 #undef ONHOLD_IF_FROM_FUTURE_VIEW
 #undef IGNORE_IF_FROM_PAST_VIEW
 
+void Engine::OnRecvTagSummary(const SharedLogMessage& message,
+                              std::span<const char> payload) {
+    DCHECK(SharedLogMessageHelper::GetOpType(message) == SharedLogOpType::TAG_SUMMARY);
+    if (!absl::GetFlag(FLAGS_slog_engine_tag_summary)) {
+        return;
+    }
+    TagSummaryProto summary;
+    if (!summary.ParseFromArray(payload.data(), static_cast<int>(payload.size()))) {
+        LOG(FATAL) << "Failed to parse TagSummaryProto";
+    }
+    DCHECK_EQ(summary.logspace_id(), message.logspace_id);
+    AddTagSummary(summary);
+}
+
 void Engine::OnRecvResponse(const SharedLogMessage& message,
                             std::span<const char> payload) {
     DCHECK(SharedLogMessageHelper::GetOpType(message) == SharedLogOpType::RESPONSE);
@@ -425,11 +713,6 @@ void Engine::OnRecvResponse(const SharedLogMessage& message,
             Message response;
             utils::AppendableBuffer aux_buffer;
             SerializeLogEntry(&response, &aux_buffer, seqnum, user_tags, log_data, aux_data);
-            if (!aux_buffer.empty()) {
-                uint64_t buf_id = NextAuxBufferId();
-                MessageHelper::FillAuxBufferId(&response, buf_id);
-                SendFuncWorkerAuxBuffer(op->client_id, buf_id, aux_buffer.to_span());
-            }
 /*
             Message response = BuildLocalReadOKResponse(seqnum, user_tags, log_data);
             if (aux_data.size() > 0) {
@@ -437,14 +720,26 @@ void Engine::OnRecvResponse(const SharedLogMessage& message,
                 MessageHelper::AppendInlineData(&response, aux_data);
             }
 */
-            FinishLocalOpWithResponse(op, &response, message.user_metalog_progress);
-            // Put the received log entry into log cache
+            PutIndexResultCache(op, seqnum, gsl::narrow_cast<uint16_t>(
+                                    bits::HighHalf64(message.localid)),
+                                message.user_metalog_progress);
+            bool prefetch = op->prefetch;
+            bool no_cache = op->no_cache;
+            FinishLocalOpWithResponse(op, &response, message.user_metalog_progress,
+                                      aux_buffer.to_span());
+            // Put the received log entry into log cache, where prefetched
+            // entries bypass admission as they are about to be read
             LogMetaData log_metadata = log_utils::GetMetaDataFromMessage(message);
-            LogCachePut(log_metadata, user_tags, log_data);
+            if (!no_cache) {
+                LogCachePut(log_metadata, user_tags, log_data, /* force= */ prefetch);
+            }
             if (aux_data.size() > 0) {
-                LogCachePutAuxData(seqnum, aux_data);
+                LogCachePutAuxData(log_metadata.user_logspace, seqnum, aux_data);
             }
         } else if (result == SharedLogResultType::EMPTY) {
+            if (op->type != SharedLogOpType::READ_NEXT_B) {
+                PutIndexResultCache(op, kInvalidLogSeqNum, 0, message.user_metalog_progress);
+            }
             FinishLocalOpWithFailure(
                 op, SharedLogResultType::EMPTY, message.user_metalog_progress);
         } else if (result == SharedLogResultType::DATA_LOST) {
@@ -454,6 +749,18 @@ void Engine::OnRecvResponse(const SharedLogMessage& message,
         } else {
             UNREACHABLE();
         }
+    } else if (result == SharedLogResultType::APPEND_OK
+                 || result == SharedLogResultType::COND_FAILED) {
+        // Result of checking conditional append from remote index
+        uint64_t op_id = message.client_data;
+        LocalOp* op;
+        if (!onging_reads_.Poll(op_id, &op)) {
+            HLOG_F(WARNING, "Cannot find conditional append op with id {}", op_id);
+            return;
+        }
+        DCHECK(op->type == SharedLogOpType::COND_APPEND);
+        FinishCondAppendOp(op, result == SharedLogResultType::APPEND_OK,
+                           message.user_metalog_progress);
     } else {
         HLOG(FATAL) << "Unknown result type: " << message.op_result;
     }
@@ -462,11 +769,29 @@ void Engine::OnRecvResponse(const SharedLogMessage& message,
 void Engine::ProcessAppendResults(const LogProducer::AppendResultVec& results) {
     for (const LogProducer::AppendResult& result : results) {
         LocalOp* op = reinterpret_cast<LocalOp*>(result.caller_data);
+        if (result.replicated) {
+            OnAsyncAppendReplicated(DCHECK_NOTNULL(op), result.localid);
+            continue;
+        }
+        if (op == nullptr) {
+            OnAsyncAppendFinished(result.localid, result.seqnum, result.metalog_progress);
+            continue;
+        }
         if (result.seqnum != kInvalidLogSeqNum) {
+            if (op->type == SharedLogOpType::COND_APPEND) {
+                // Cached once the condition is known to hold
+                op->seqnum = result.seqnum;
+                op->localid = result.localid;
+                op->metalog_progress = result.metalog_progress;
+                CheckCondAppendResult(op);
+                continue;
+            }
             LogMetaData log_metadata = MetaDataFromAppendOp(op);
             log_metadata.seqnum = result.seqnum;
             log_metadata.localid = result.localid;
-            LogCachePut(log_metadata, VECTOR_AS_SPAN(op->user_tags), op->data.to_span());
+            // Fresh appends have no access history, thus bypass admission
+            LogCachePut(log_metadata, VECTOR_AS_SPAN(op->user_tags), op->data.to_span(),
+                        /* force= */ true);
             Message response = MessageHelper::NewSharedLogOpSucceeded(
                 SharedLogResultType::APPEND_OK, result.seqnum);
             FinishLocalOpWithResponse(op, &response, result.metalog_progress);
@@ -476,16 +801,150 @@ void Engine::ProcessAppendResults(const LogProducer::AppendResultVec& results) {
     }
 }
 
-void Engine::ProcessIndexFoundResult(const IndexQueryResult& query_result) {
+void Engine::CheckCondAppendResult(LocalOp* op) {
+    DCHECK(op->type == SharedLogOpType::COND_APPEND);
+    HVLOG_F(1, "Check result of conditional append: op_id={}, seqnum={}, tag={}",
+            op->id, bits::HexStr0x(op->seqnum), op->query_tag);
+    onging_reads_.PutChecked(op->id, op);
+    const View::Sequencer* sequencer_node = nullptr;
+    LockablePtr<Index> index_ptr;
+    {
+        absl::ReaderMutexLock view_lk(&view_mu_);
+        uint16_t view_id = log_utils::GetViewId(op->seqnum);
+        if (view_id >= views_.size()) {
+            HLOG_F(FATAL, "Cannot find view {}", view_id);
+        }
+        uint32_t logspace_id = bits::HighHalf64(op->seqnum);
+        sequencer_node = views_.at(view_id)->GetSequencerNode(bits::LowHalf32(logspace_id));
+        if (HasIndexFor(sequencer_node, op->user_logspace, op->query_tag)) {
+            index_ptr = index_collection_.GetLogSpaceChecked(logspace_id);
+        }
+    }
+    QueryIndex(op, sequencer_node, std::move(index_ptr));
+}
+
+void Engine::OnAsyncAppendReplicated(LocalOp* op, uint64_t localid) {
+    DCHECK(op->type == SharedLogOpType::ASYNC_APPEND);
+    {
+        absl::MutexLock lk(&async_append_mu_);
+        if (!finished_before_replicated_.erase(localid)) {
+            pending_async_appends_.insert(localid);
+        }
+    }
+    Message response = MessageHelper::NewSharedLogOpSucceeded(
+        SharedLogResultType::LOCALID);
+    response.log_localid = localid;
+    FinishLocalOpWithResponse(op, &response, /* metalog_progress= */ 0);
+}
+
+void Engine::OnAsyncAppendFinished(uint64_t localid, uint64_t seqnum,
+                                   uint64_t metalog_progress) {
+    HVLOG_F(1, "Async append with localid {} finished: seqnum={}",
+            bits::HexStr0x(localid), bits::HexStr0x(seqnum));
+    AsyncAppendResult result = {
+        .seqnum = seqnum,
+        .metalog_progress = metalog_progress
+    };
+    std::vector<LocalOp*> resolve_ops;
+    {
+        absl::MutexLock lk(&async_append_mu_);
+        if (!pending_async_appends_.erase(localid)) {
+            finished_before_replicated_.insert(localid);
+        }
+        async_append_results_[localid] = result;
+        async_append_results_order_.push_back(localid);
+        size_t max_results = absl::GetFlag(FLAGS_slog_engine_async_append_history);
+        while (async_append_results_order_.size() > max_results) {
+            async_append_results_.erase(async_append_results_order_.front());
+            async_append_results_order_.pop_front();
+        }
+        if (auto iter = resolve_localid_ops_.find(localid);
+                iter != resolve_localid_ops_.end()) {
+            resolve_ops = std::move(iter->second);
+            resolve_localid_ops_.erase(iter);
+        }
+    }
+    for (LocalOp* op : resolve_ops) {
+        FinishResolveLocalIdOp(op, result);
+    }
+}
+
+void Engine::FinishResolveLocalIdOp(LocalOp* op, const AsyncAppendResult& result) {
+    if (result.seqnum != kInvalidLogSeqNum) {
+        Message response = MessageHelper::NewSharedLogOpSucceeded(
+            SharedLogResultType::APPEND_OK, result.seqnum);
+        FinishLocalOpWithResponse(op, &response, result.metalog_progress);
+    } else {
+        FinishLocalOpWithFailure(op, SharedLogResultType::DISCARDED);
+    }
+}
+
+void Engine::ProcessCondCheckResult(const IndexQueryResult& query_result) {
+    const IndexQuery& query = query_result.original_query;
+    DCHECK(query.cond_check);
+    // The conditional append succeeded iff it is the tail of the tag at its seqnum
+    bool success = query_result.state == IndexQueryResult::kFound
+                && query_result.found_result.seqnum == query.query_seqnum;
+    if (query.origin_node_id == my_node_id()) {
+        LocalOp* op = onging_reads_.PollChecked(query.client_data);
+        FinishCondAppendOp(op, success, query_result.metalog_progress);
+    } else {
+        SharedLogMessage response = SharedLogMessageHelper::NewResponse(
+            success ? SharedLogResultType::APPEND_OK : SharedLogResultType::COND_FAILED);
+        response.user_metalog_progress = query_result.metalog_progress;
+        SendReadResponse(query, &response);
+    }
+}
+
+void Engine::FinishCondAppendOp(LocalOp* op, bool success, uint64_t metalog_progress) {
+    DCHECK(op->type == SharedLogOpType::COND_APPEND);
+    if (!success) {
+        FinishLocalOpWithFailure(op, SharedLogResultType::COND_FAILED, metalog_progress);
+        return;
+    }
+    LogMetaData log_metadata = MetaDataFromAppendOp(op);
+    log_metadata.seqnum = op->seqnum;
+    log_metadata.localid = op->localid;
+    LogCachePut(log_metadata, VECTOR_AS_SPAN(op->user_tags), op->data.to_span(),
+                /* force= */ true);
+    Message response = MessageHelper::NewSharedLogOpSucceeded(
+        SharedLogResultType::APPEND_OK, op->seqnum);
+    FinishLocalOpWithResponse(op, &response, metalog_progress);
+}
+
+void Engine::ProcessIndexFoundResult(const IndexQueryResult& query_result,
+                                     bool disk_cache_checked) {
     DCHECK(query_result.state == IndexQueryResult::kFound);
     const IndexQuery& query = query_result.original_query;
+    if (query.cond_check) {
+        ProcessCondCheckResult(query_result);
+        return;
+    }
     bool local_request = (query.origin_node_id == my_node_id());
     uint64_t seqnum = query_result.found_result.seqnum;
-    if (auto cached_log_entry = LogCacheGet(seqnum); cached_log_entry.has_value()) {
+    if (local_request && query.seqnum_only) {
+        LocalOp* op = onging_reads_.PollChecked(query.client_data);
+        Message response = MessageHelper::NewSharedLogOpSucceeded(
+            SharedLogResultType::READ_OK, seqnum);
+        FinishLocalOpWithResponse(op, &response, query_result.metalog_progress);
+        return;
+    }
+    std::optional<LogEntry> cached_log_entry = LogCacheGet(
+        query.user_logspace, seqnum, /* touch= */ !query.no_cache);
+    if (!cached_log_entry.has_value() && !disk_cache_checked) {
+        bool reading = LogCacheReadFromDisk(seqnum, [this, query_result] {
+            ProcessIndexFoundResult(query_result, /* disk_cache_checked= */ true);
+        });
+        if (reading) {
+            return;
+        }
+    }
+    if (cached_log_entry.has_value()) {
         // Cache hits
         HVLOG_F(1, "Cache hits for log entry (seqnum {})", bits::HexStr0x(seqnum));
         const LogEntry& log_entry = cached_log_entry.value();
-        std::optional<std::string> cached_aux_data = LogCacheGetAuxData(seqnum);
+        std::optional<std::string> cached_aux_data = LogCacheGetAuxData(
+            query.user_logspace, seqnum);
         std::span<const char> aux_data;
         if (cached_aux_data.has_value()) {
 /*
@@ -512,17 +971,13 @@ void Engine::ProcessIndexFoundResult(const IndexQueryResult& query_result) {
                 &response, &aux_buffer,
                 seqnum, VECTOR_AS_SPAN(log_entry.user_tags),
                 STRING_AS_SPAN(log_entry.data), aux_data);
-            if (!aux_buffer.empty()) {
-                uint64_t buf_id = NextAuxBufferId();
-                MessageHelper::FillAuxBufferId(&response, buf_id);
-                SendFuncWorkerAuxBuffer(op->client_id, buf_id, aux_buffer.to_span());
-            }
 /*
             Message response = BuildLocalReadOKResponse(log_entry);
             response.log_aux_data_size = gsl::narrow_cast<uint16_t>(aux_data.size());
             MessageHelper::AppendInlineData(&response, aux_data);
 */
-            FinishLocalOpWithResponse(op, &response, query_result.metalog_progress);
+            FinishLocalOpWithResponse(op, &response, query_result.metalog_progress,
+                                      aux_buffer.to_span());
         } else {
             HVLOG_F(1, "Send read response for log (seqnum {})", bits::HexStr0x(seqnum));
             SharedLogMessage response = SharedLogMessageHelper::NewReadOkResponse();
@@ -573,23 +1028,39 @@ void Engine::ProcessIndexContinueResult(const IndexQueryResult& query_result,
         if (view_id >= views_.size()) {
             HLOG_F(FATAL, "Cannot find view {}", view_id);
         }
+        // Skip views known to have no log with the tag
+        uint16_t min_view_id = (query.direction == IndexQuery::kReadPrev)
+                                 ? 0 : log_utils::GetViewId(query.query_seqnum);
+        while (!ViewMayContainQueryTags(views_.at(view_id), query)) {
+            if (view_id <= min_view_id) {
+                HVLOG_F(1, "No earlier views contain tag {}", query.user_tag);
+                IndexQueryResult final_result = query_result;
+                final_result.state = (query_result.found_result.seqnum != kInvalidLogSeqNum)
+                                       ? IndexQueryResult::kFound : IndexQueryResult::kEmpty;
+                more_results->push_back(std::move(final_result));
+                return;
+            }
+            view_id--;
+        }
+        if (view_id != query_result.next_view_id) {
+            HVLOG_F(1, "Skip to view {}", view_id);
+        }
         const View* view = views_.at(view_id);
         uint32_t logspace_id = view->LogSpaceIdentifier(query.user_logspace);
         sequencer_node = view->GetSequencerNode(bits::LowHalf32(logspace_id));
-        if (sequencer_node->IsIndexEngineNode(my_node_id())) {
+        if (HasIndexFor(sequencer_node, query.user_logspace, query.user_tag)) {
             index_ptr = index_collection_.GetLogSpaceChecked(logspace_id);
         }
     }
     if (index_ptr != nullptr) {
         HVLOG(1) << "Use local index";
         IndexQuery query = BuildIndexQuery(query_result);
-        auto locked_index = index_ptr.Lock();
-        locked_index->MakeQuery(query);
-        locked_index->PollQueryResults(more_results);
+        MakeIndexQuery(index_ptr, query, more_results);
     } else {
         HVLOG(1) << "Send to remote index";
         SharedLogMessage request = BuildReadRequestMessage(query_result);
-        bool send_success = SendIndexReadRequest(DCHECK_NOTNULL(sequencer_node), &request);
+        bool send_success = SendIndexReadRequest(DCHECK_NOTNULL(sequencer_node), &request,
+                                                 VECTOR_AS_CHAR_SPAN(query.user_tags));
         if (!send_success) {
             uint32_t logspace_id = bits::JoinTwo16(sequencer_node->view()->id(),
                                                    sequencer_node->node_id());
@@ -599,6 +1070,397 @@ void Engine::ProcessIndexContinueResult(const IndexQueryResult& query_result,
     }
 }
 
+bool Engine::ReadFromPrefetchedStream(LocalOp* op) {
+    if (prefetch_max_depth_ == 0 || op->prefetch || op->subscription
+            || !op->user_tags.empty()) {
+        return false;
+    }
+    uint64_t seqnum;
+    {
+        absl::MutexLock lk(&read_stream_mu_);
+        auto iter = read_streams_.find(
+            ReadStreamKey(op->user_logspace, op->query_tag, op->client_id));
+        if (iter == read_streams_.end()) {
+            return false;
+        }
+        const ReadStream& stream = iter->second;
+        if (stream.prefetched_seqnums.empty() || op->seqnum != stream.last_seqnum + 1) {
+            return false;
+        }
+        // Found results of READ_NEXT do not change
+        seqnum = stream.prefetched_seqnums.front();
+    }
+    // Counted as an access when the read is served below
+    std::optional<LogEntry> log_entry = LogCacheGet(op->user_logspace, seqnum,
+                                                    /* touch= */ false);
+    if (!log_entry.has_value()) {
+        return false;
+    }
+    HVLOG_F(1, "Read prefetched log (seqnum {}) for op_id={}", bits::HexStr0x(seqnum), op->id);
+    IndexQueryResult query_result = {
+        .state = IndexQueryResult::kFound,
+        .metalog_progress = op->metalog_progress,
+        .next_view_id = 0,
+        .original_query = BuildIndexQuery(op),
+        .found_result = IndexFoundResult {
+            .view_id = log_utils::GetViewId(seqnum),
+            .engine_id = gsl::narrow_cast<uint16_t>(
+                bits::HighHalf64(log_entry->metadata.localid)),
+            .seqnum = seqnum
+        }
+    };
+    ProcessIndexFoundResult(query_result);
+    return true;
+}
+
+void Engine::OnLocalReadFinished(const LocalOp* op, const Message& response) {
+    if (prefetch_max_depth_ == 0 || !op->user_tags.empty() || op->no_cache) {
+        return;
+    }
+    bool found = (MessageHelper::GetSharedLogResultType(response) == SharedLogResultType::READ_OK);
+    uint64_t seqnum = response.log_seqnum;
+    ReadStreamKey key(op->user_logspace, op->query_tag, op->client_id);
+    LocalOp* prefetch_op = nullptr;
+    {
+        absl::MutexLock lk(&read_stream_mu_);
+        auto iter = read_streams_.find(key);
+        if (op->prefetch) {
+            if (iter == read_streams_.end() || iter->second.generation != op->client_data) {
+                // Cancelled
+                return;
+            }
+            ReadStream& stream = iter->second;
+            stream.prefetching = false;
+            if (!found) {
+                return;
+            }
+            stream.prefetched_seqnums.push_back(seqnum);
+            prefetch_op = MaybePrefetch(op, &stream);
+        } else {
+            if (!found) {
+                return;
+            }
+            int64_t now = GetMonotonicMicroTimestamp();
+            if (iter == read_streams_.end()) {
+                if (read_streams_.size() >= kMaxReadStreams) {
+                    absl::erase_if(read_streams_, [now] (const auto& item) {
+                        return now - item.second.last_access_timestamp > kReadStreamIdleTimeoutUs;
+                    });
+                    if (read_streams_.size() >= kMaxReadStreams) {
+                        return;
+                    }
+                }
+                read_streams_[key] = ReadStream {
+                    .last_seqnum = seqnum,
+                    .depth = 0,
+                    .generation = 0,
+                    .prefetching = false,
+                    .last_access_timestamp = now,
+                    .prefetched_seqnums = {}
+                };
+                return;
+            }
+            ReadStream& stream = iter->second;
+            stream.last_access_timestamp = now;
+            if (op->seqnum == stream.last_seqnum + 1) {
+                while (!stream.prefetched_seqnums.empty()
+                         && stream.prefetched_seqnums.front() <= seqnum) {
+                    stream.prefetched_seqnums.pop_front();
+                }
+                if (stream.prefetched_seqnums.empty()) {
+                    // Client catches up with prefetching
+                    stream.depth = std::min(std::max<size_t>(stream.depth * 2, 1),
+                                            prefetch_max_depth_);
+                }
+            } else {
+                HVLOG_F(1, "Sequential reads on tag {} broken, cancel prefetching",
+                        op->query_tag);
+                stream.generation++;
+                stream.prefetching = false;
+                stream.prefetched_seqnums.clear();
+                stream.depth = 0;
+            }
+            stream.last_seqnum = seqnum;
+            prefetch_op = MaybePrefetch(op, &stream);
+        }
+    }
+    if (prefetch_op != nullptr) {
+        SomeIOWorker()->ScheduleFunction(
+            nullptr, [this, prefetch_op] {
+                HandleLocalRead(prefetch_op);
+            }
+        );
+    }
+}
+
+EngineBase::LocalOp* Engine::MaybePrefetch(const LocalOp* op, ReadStream* stream) {
+    if (stream->prefetching || stream->prefetched_seqnums.size() >= stream->depth) {
+        return nullptr;
+    }
+    uint64_t last_seqnum = stream->prefetched_seqnums.empty()
+                             ? stream->last_seqnum
+                             : stream->prefetched_seqnums.back();
+    LocalOp* prefetch_op = NewPrefetchReadOp(op, last_seqnum + 1);
+    prefetch_op->client_data = stream->generation;
+    stream->prefetching = true;
+    HVLOG_F(1, "Prefetch log of tag {} after seqnum {}",
+            op->query_tag, bits::HexStr0x(last_seqnum));
+    return prefetch_op;
+}
+
+EngineBase::LocalOp* Engine::NextSubscriptionRead(const SubscriptionKey& key,
+                                                  Subscription* sub) {
+    if (sub->state != Subscription::kIdle || sub->credits == 0) {
+        return nullptr;
+    }
+    sub->state = Subscription::kReading;
+    sub->woken = false;
+    // Watch the tag before reading, so that logs indexed after the read
+    // cannot be missed
+    tag_watchers_[Index::TagWatch(sub->op->user_logspace, sub->op->query_tag)].insert(key);
+    return NewSubscriptionReadOp(sub->op, SharedLogOpType::READ_NEXT, sub->next_seqnum);
+}
+
+void Engine::RemoveSubscription(const SubscriptionKey& key) {
+    auto iter = subscriptions_.find(key);
+    DCHECK(iter != subscriptions_.end());
+    LocalOp* sub_op = iter->second.op;
+    Index::TagWatch watch(sub_op->user_logspace, sub_op->query_tag);
+    if (auto watchers = tag_watchers_.find(watch); watchers != tag_watchers_.end()) {
+        watchers->second.erase(key);
+        if (watchers->second.empty()) {
+            tag_watchers_.erase(watchers);
+        }
+    }
+    if (auto keys = func_call_subscriptions_.find(sub_op->func_call_id);
+            keys != func_call_subscriptions_.end()) {
+        keys->second.erase(key);
+        if (keys->second.empty()) {
+            func_call_subscriptions_.erase(keys);
+        }
+    }
+    subscriptions_.erase(iter);
+    ReleaseLocalOp(sub_op);
+}
+
+void Engine::DispatchSubscriptionReads(const std::vector<LocalOp*>& ops) {
+    if (ops.empty()) {
+        return;
+    }
+    SomeIOWorker()->ScheduleFunction(
+        nullptr, [this, ops] {
+            for (LocalOp* op : ops) {
+                {
+                    absl::ReaderMutexLock view_lk(&view_mu_);
+                    if (current_view_ != nullptr) {
+                        uint32_t logspace_id = current_view_->LogSpaceIdentifier(
+                            op->user_logspace);
+                        const View::Sequencer* sequencer_node =
+                            current_view_->GetSequencerNode(bits::LowHalf32(logspace_id));
+                        if (HasIndexFor(sequencer_node, op->user_logspace, op->query_tag)) {
+                            auto index_ptr = index_collection_.GetLogSpaceChecked(logspace_id);
+                            index_ptr.Lock()->WatchTag(op->user_logspace, op->query_tag);
+                        } else {
+                            // Remote index cannot be watched, block on it instead
+                            op->type = SharedLogOpType::READ_NEXT_B;
+                        }
+                    }
+                }
+                HandleLocalRead(op);
+            }
+        }
+    );
+}
+
+void Engine::OnSubscriptionReadFinished(const LocalOp* op, Message* response,
+                                        std::span<const char> aux_buffer) {
+    SubscriptionKey key(op->client_id, op->client_data);
+    LocalOp* read_op = nullptr;
+    {
+        absl::MutexLock lk(&subscription_mu_);
+        auto iter = subscriptions_.find(key);
+        if (iter == subscriptions_.end()) {
+            // Already unsubscribed
+            return;
+        }
+        Subscription& sub = iter->second;
+        DCHECK_EQ(sub.state, Subscription::kReading);
+        sub.state = Subscription::kIdle;
+        switch (MessageHelper::GetSharedLogResultType(*response)) {
+        case SharedLogResultType::READ_OK:
+            DCHECK_GT(sub.credits, 0U);
+            sub.next_seqnum = response->log_seqnum + 1;
+            sub.credits--;
+            // Sent within the lock to keep deliveries in order
+            SendFuncWorkerMessage(op->client_id, response, aux_buffer);
+            read_op = NextSubscriptionRead(key, &sub);
+            break;
+        case SharedLogResultType::EMPTY:
+            if (sub.woken || op->type == SharedLogOpType::READ_NEXT_B) {
+                read_op = NextSubscriptionRead(key, &sub);
+            } else {
+                sub.state = Subscription::kWatching;
+            }
+            break;
+        default:
+            HLOG_F(WARNING, "Subscription on tag {} failed with result {}",
+                   op->query_tag, static_cast<uint16_t>(response->log_result));
+            SendFuncWorkerMessage(op->client_id, response);
+            RemoveSubscription(key);
+        }
+    }
+    if (read_op != nullptr) {
+        DispatchSubscriptionReads({read_op});
+    }
+}
+
+void Engine::OnTagWatchesFired(const Index::TagWatchVec& watches) {
+    if (watches.empty()) {
+        return;
+    }
+    std::vector<LocalOp*> read_ops;
+    {
+        absl::MutexLock lk(&subscription_mu_);
+        for (const Index::TagWatch& watch : watches) {
+            auto iter = tag_watchers_.find(watch);
+            if (iter == tag_watchers_.end()) {
+                continue;
+            }
+            absl::flat_hash_set<SubscriptionKey> keys = std::move(iter->second);
+            tag_watchers_.erase(iter);
+            for (const SubscriptionKey& key : keys) {
+                Subscription& sub = subscriptions_.at(key);
+                if (sub.state == Subscription::kWatching) {
+                    sub.state = Subscription::kIdle;
+                    if (LocalOp* op = NextSubscriptionRead(key, &sub); op != nullptr) {
+                        read_ops.push_back(op);
+                    }
+                } else if (sub.state == Subscription::kReading) {
+                    sub.woken = true;
+                }
+            }
+        }
+    }
+    DispatchSubscriptionReads(read_ops);
+}
+
+void Engine::WakeUpSubscriptions() {
+    std::vector<LocalOp*> read_ops;
+    {
+        absl::MutexLock lk(&subscription_mu_);
+        for (auto& [key, sub] : subscriptions_) {
+            if (sub.state == Subscription::kWatching) {
+                sub.state = Subscription::kIdle;
+                if (LocalOp* op = NextSubscriptionRead(key, &sub); op != nullptr) {
+                    read_ops.push_back(op);
+                }
+            } else if (sub.state == Subscription::kReading) {
+                sub.woken = true;
+            }
+        }
+    }
+    DispatchSubscriptionReads(read_ops);
+}
+
+void Engine::OnFuncCallDone(uint64_t func_call_id) {
+    absl::MutexLock lk(&subscription_mu_);
+    auto iter = func_call_subscriptions_.find(func_call_id);
+    if (iter == func_call_subscriptions_.end()) {
+        return;
+    }
+    // RemoveSubscription erases the entry of the function call
+    absl::flat_hash_set<SubscriptionKey> keys = iter->second;
+    for (const SubscriptionKey& key : keys) {
+        HVLOG_F(1, "Remove subscription of finished function call: "
+                   "client_id={}, client_data={}", key.first, key.second);
+        RemoveSubscription(key);
+    }
+}
+
+void Engine::OnStorageReadTimeout(uint64_t op_id) {
+    LocalOp* op;
+    if (!onging_reads_.Poll(op_id, &op)) {
+        return;
+    }
+    HLOG_F(WARNING, "Storage read timed out: seqnum={}, tag={}",
+           bits::HexStr0x(op->seqnum), op->query_tag);
+    FinishLocalOpWithFailure(op, SharedLogResultType::DATA_LOST);
+}
+
+bool Engine::QueryIndexResultCache(LocalOp* op, uint32_t logspace_id) {
+    if (!index_result_cache_.has_value() || op->type == SharedLogOpType::COND_APPEND
+            || !op->user_tags.empty()) {
+        return false;
+    }
+    IndexResultCache::Key key = {
+        .user_logspace = op->user_logspace,
+        .user_tag = op->query_tag,
+        .op_type = static_cast<uint16_t>(op->type),
+        .query_seqnum = op->seqnum
+    };
+    auto result = index_result_cache_->Get(key, logspace_id, op->metalog_progress);
+    if (!result.has_value()) {
+        return false;
+    }
+    uint64_t metalog_progress = std::max(result->metalog_progress, op->metalog_progress);
+    if (result->seqnum == kInvalidLogSeqNum) {
+        HVLOG_F(1, "Cached index result is empty: op_id={}", op->id);
+        onging_reads_.RemoveChecked(op->id);
+        FinishLocalOpWithFailure(op, SharedLogResultType::EMPTY, metalog_progress);
+        return true;
+    }
+    HVLOG_F(1, "Cached index result for op_id={}: seqnum={}",
+            op->id, bits::HexStr0x(result->seqnum));
+    IndexQueryResult query_result = {
+        .state = IndexQueryResult::kFound,
+        .metalog_progress = metalog_progress,
+        .next_view_id = 0,
+        .original_query = BuildIndexQuery(op),
+        .found_result = IndexFoundResult {
+            .view_id = log_utils::GetViewId(result->seqnum),
+            .engine_id = result->engine_id,
+            .seqnum = result->seqnum
+        }
+    };
+    ProcessIndexFoundResult(query_result);
+    return true;
+}
+
+void Engine::PutIndexResultCache(LocalOp* op, uint64_t seqnum, uint16_t engine_id,
+                                 uint64_t metalog_progress) {
+    if (!index_result_cache_.has_value() || op->type == SharedLogOpType::COND_APPEND
+            || !op->user_tags.empty()) {
+        return;
+    }
+    IndexResultCache::Key key = {
+        .user_logspace = op->user_logspace,
+        .user_tag = op->query_tag,
+        .op_type = static_cast<uint16_t>(op->type),
+        .query_seqnum = op->seqnum
+    };
+    index_result_cache_->Put(key, IndexResultCache::Result {
+        .seqnum = seqnum,
+        .engine_id = engine_id,
+        .metalog_progress = metalog_progress
+    });
+}
+
+void Engine::MakeIndexQuery(LockablePtr<Index> index_ptr, const IndexQuery& query,
+                            Index::QueryResultVec* results) {
+    {
+        // Most queries are answered under shared access, concurrently
+        // with each other
+        auto locked_index = index_ptr.ReaderLock();
+        if (auto result = locked_index->TryProcessQuery(query); result.has_value()) {
+            results->push_back(std::move(*result));
+            return;
+        }
+    }
+    auto locked_index = index_ptr.Lock();
+    locked_index->MakeQuery(query);
+    locked_index->PollQueryResults(results);
+}
+
 void Engine::ProcessIndexQueryResults(const Index::QueryResultVec& results) {
     Index::QueryResultVec more_results;
     for (const IndexQueryResult& result : results) {
@@ -608,7 +1470,9 @@ void Engine::ProcessIndexQueryResults(const Index::QueryResultVec& results) {
             ProcessIndexFoundResult(result);
             break;
         case IndexQueryResult::kEmpty:
-            if (query.origin_node_id == my_node_id()) {
+            if (query.cond_check) {
+                ProcessCondCheckResult(result);
+            } else if (query.origin_node_id == my_node_id()) {
                 FinishLocalOpWithFailure(
                     onging_reads_.PollChecked(query.client_data),
                     SharedLogResultType::EMPTY, result.metalog_progress);
@@ -629,6 +1493,84 @@ void Engine::ProcessIndexQueryResults(const Index::QueryResultVec& results) {
     }
 }
 
+void Engine::ProcessTagSummaries(const std::vector<TagSummaryProto>& summaries) {
+    if (!absl::GetFlag(FLAGS_slog_engine_tag_summary)) {
+        return;
+    }
+    for (const TagSummaryProto& summary : summaries) {
+        AddTagSummary(summary);
+        // Only the index engine node of the partition shares the summary
+        std::vector<uint16_t> engine_nodes;
+        {
+            absl::ReaderMutexLock view_lk(&view_mu_);
+            uint16_t view_id = bits::HighHalf32(summary.logspace_id());
+            DCHECK_LT(view_id, views_.size());
+            const View::Sequencer* sequencer_node = views_.at(view_id)->GetSequencerNode(
+                bits::LowHalf32(summary.logspace_id()));
+            if (sequencer_node->GetIndexEngineNodes().at(summary.partition()) != my_node_id()) {
+                continue;
+            }
+            const View::NodeIdVec& current_engines = current_view_->GetEngineNodes();
+            engine_nodes.assign(current_engines.begin(), current_engines.end());
+        }
+        std::string payload;
+        CHECK(summary.SerializeToString(&payload));
+        for (uint16_t engine_id : engine_nodes) {
+            if (engine_id == my_node_id()) {
+                continue;
+            }
+            SharedLogMessage message = SharedLogMessageHelper::NewTagSummaryMessage(
+                summary.logspace_id());
+            if (!SendEngineMessage(engine_id, &message, STRING_AS_SPAN(payload))) {
+                HLOG_F(WARNING, "Failed to send tag summary to engine {}", engine_id);
+            }
+        }
+    }
+}
+
+void Engine::AddTagSummary(const TagSummaryProto& summary) {
+    DCHECK_EQ(summary.user_logspaces_size(), summary.tag_filters_size());
+    HVLOG_F(1, "Add tag summary of log space {}", bits::HexStr0x(summary.logspace_id()));
+    absl::MutexLock lk(&tag_summary_mu_);
+    auto& filters = tag_summaries_[bits::JoinTwo32(summary.logspace_id(),
+                                                   summary.partition())];
+    for (int i = 0; i < summary.user_logspaces_size(); i++) {
+        filters[summary.user_logspaces(i)] = summary.tag_filters(i);
+    }
+}
+
+bool Engine::ViewMayContainTag(const View* view, uint32_t user_logspace, uint64_t user_tag) {
+    uint32_t logspace_id = view->LogSpaceIdentifier(user_logspace);
+    uint32_t partition = 0;
+    if (absl::GetFlag(FLAGS_slog_partition_index)) {
+        const View::Sequencer* sequencer_node = view->GetSequencerNode(
+            bits::LowHalf32(logspace_id));
+        partition = gsl::narrow_cast<uint32_t>(log_utils::IndexPartitionOf(
+            user_logspace, user_tag, sequencer_node->GetIndexEngineNodes().size()));
+    }
+    uint64_t key = bits::JoinTwo32(logspace_id, partition);
+    absl::MutexLock lk(&tag_summary_mu_);
+    if (!tag_summaries_.contains(key)) {
+        // No summary yet
+        return true;
+    }
+    const auto& filters = tag_summaries_.at(key);
+    if (!filters.contains(user_logspace)) {
+        return false;
+    }
+    return user_tag == kEmptyLogTag
+        || log_utils::TagFilterMayContain(filters.at(user_logspace), user_tag);
+}
+
+bool Engine::ViewMayContainQueryTags(const View* view, const IndexQuery& query) {
+    if (query.user_tags.empty()) {
+        return ViewMayContainTag(view, query.user_logspace, query.user_tag);
+    }
+    return absl::c_any_of(query.user_tags, [this, view, &query] (uint64_t user_tag) {
+        return ViewMayContainTag(view, query.user_logspace, user_tag);
+    });
+}
+
 void Engine::ProcessRequests(const std::vector<SharedLogRequest>& requests) {
     for (const SharedLogRequest& request : requests) {
         if (request.local_op == nullptr) {
@@ -642,8 +1584,11 @@ void Engine::ProcessRequests(const std::vector<SharedLogRequest>& requests) {
 SharedLogMessage Engine::BuildReadRequestMessage(LocalOp* op) {
     DCHECK(  op->type == SharedLogOpType::READ_NEXT
           || op->type == SharedLogOpType::READ_PREV
-          || op->type == SharedLogOpType::READ_NEXT_B);
-    SharedLogMessage request = SharedLogMessageHelper::NewReadMessage(op->type);
+          || op->type == SharedLogOpType::READ_NEXT_B
+          || op->type == SharedLogOpType::COND_APPEND);
+    bool cond_check = (op->type == SharedLogOpType::COND_APPEND);
+    SharedLogMessage request = SharedLogMessageHelper::NewReadMessage(
+        cond_check ? SharedLogOpType::READ_PREV : op->type);
     request.origin_node_id = my_node_id();
     request.hop_times = 1;
     request.client_data = op->id;
@@ -652,6 +1597,11 @@ SharedLogMessage Engine::BuildReadRequestMessage(LocalOp* op) {
     request.query_seqnum = op->seqnum;
     request.user_metalog_progress = op->metalog_progress;
     request.flags |= protocol::kReadInitialFlag;
+    if (cond_check) {
+        request.flags |= protocol::kReadCondCheckFlag;
+    } else if (!op->user_tags.empty()) {
+        request.flags |= protocol::kReadTagSetFlag;
+    }
     request.prev_view_id = 0;
     request.prev_engine_id = 0;
     request.prev_found_seqnum = kInvalidLogSeqNum;
@@ -670,6 +1620,9 @@ SharedLogMessage Engine::BuildReadRequestMessage(const IndexQueryResult& result)
     request.query_tag = query.user_tag;
     request.query_seqnum = query.query_seqnum;
     request.user_metalog_progress = result.metalog_progress;
+    if (!query.user_tags.empty()) {
+        request.flags |= protocol::kReadTagSetFlag;
+    }
     request.prev_view_id = result.found_result.view_id;
     request.prev_engine_id = result.found_result.engine_id;
     request.prev_found_seqnum = result.found_result.seqnum;
@@ -677,14 +1630,21 @@ SharedLogMessage Engine::BuildReadRequestMessage(const IndexQueryResult& result)
 }
 
 IndexQuery Engine::BuildIndexQuery(LocalOp* op) {
+    bool cond_check = (op->type == SharedLogOpType::COND_APPEND);
     return IndexQuery {
-        .direction = IndexQuery::DirectionFromOpType(op->type),
+        .direction = cond_check ? IndexQuery::kReadPrev
+                                : IndexQuery::DirectionFromOpType(op->type),
         .origin_node_id = my_node_id(),
         .hop_times = 0,
         .initial = true,
+        .cond_check = cond_check,
+        .seqnum_only = (op->subscription && !op->sub_with_data)
+                       || op->cond_append_op != nullptr,
+        .no_cache = op->no_cache,
         .client_data = op->id,
         .user_logspace = op->user_logspace,
         .user_tag = op->query_tag,
+        .user_tags = cond_check ? UserTagVec() : op->user_tags,
         .query_seqnum = op->seqnum,
         .metalog_progress = op->metalog_progress,
         .prev_found_result = {
@@ -695,16 +1655,27 @@ IndexQuery Engine::BuildIndexQuery(LocalOp* op) {
     };
 }
 
-IndexQuery Engine::BuildIndexQuery(const SharedLogMessage& message) {
+IndexQuery Engine::BuildIndexQuery(const SharedLogMessage& message,
+                                   std::span<const char> payload) {
     SharedLogOpType op_type = SharedLogMessageHelper::GetOpType(message);
+    UserTagVec user_tags;
+    if ((message.flags & protocol::kReadTagSetFlag) != 0) {
+        DCHECK_EQ(payload.size() % sizeof(uint64_t), 0U);
+        user_tags.resize(payload.size() / sizeof(uint64_t));
+        memcpy(user_tags.data(), payload.data(), payload.size());
+    }
     return IndexQuery {
         .direction = IndexQuery::DirectionFromOpType(op_type),
         .origin_node_id = message.origin_node_id,
         .hop_times = message.hop_times,
         .initial = (message.flags | protocol::kReadInitialFlag) != 0,
+        .cond_check = (message.flags & protocol::kReadCondCheckFlag) != 0,
+        .seqnum_only = false,
+        .no_cache = false,
         .client_data = message.client_data,
         .user_logspace = message.user_logspace,
         .user_tag = message.query_tag,
+        .user_tags = std::move(user_tags),
         .query_seqnum = message.query_seqnum,
         .metalog_progress = message.user_metalog_progress,
         .prev_found_result = IndexFoundResult {
@@ -32,39 +32,160 @@ private:
     log_utils::FutureRequests       future_requests_;
     log_utils::ThreadedMap<LocalOp> onging_reads_;
 
+    // Async appends already acknowledged with localids
+    struct AsyncAppendResult {
+        uint64_t seqnum;  // kInvalidLogSeqNum if discarded
+        uint64_t metalog_progress;
+    };
+    absl::Mutex async_append_mu_;
+    absl::flat_hash_set</* localid */ uint64_t>
+        pending_async_appends_       ABSL_GUARDED_BY(async_append_mu_);
+    // Results of producers can be processed out of order by IO workers
+    absl::flat_hash_set</* localid */ uint64_t>
+        finished_before_replicated_  ABSL_GUARDED_BY(async_append_mu_);
+    absl::flat_hash_map</* localid */ uint64_t, AsyncAppendResult>
+        async_append_results_        ABSL_GUARDED_BY(async_append_mu_);
+    std::deque</* localid */ uint64_t>
+        async_append_results_order_  ABSL_GUARDED_BY(async_append_mu_);
+    absl::flat_hash_map</* localid */ uint64_t, std::vector<LocalOp*>>
+        resolve_localid_ops_         ABSL_GUARDED_BY(async_append_mu_);
+
+    // Tag filters of finalized log spaces, keyed by user logspace
+    absl::Mutex tag_summary_mu_;
+    absl::flat_hash_map</* logspace_id, partition */ uint64_t,
+                        absl::flat_hash_map</* user_logspace */ uint32_t, std::string>>
+        tag_summaries_               ABSL_GUARDED_BY(tag_summary_mu_);
+
+    std::optional<IndexResultCache> index_result_cache_;
+
+    // Sequential READ_NEXT of clients on a tag, with logs of the tag
+    // prefetched into log cache
+    static constexpr size_t kMaxReadStreams = 4096;
+    static constexpr int64_t kReadStreamIdleTimeoutUs = 1000000;
+    using ReadStreamKey = std::tuple</* user_logspace */ uint32_t,
+                                     /* user_tag */ uint64_t,
+                                     /* client_id */ uint16_t>;
+    struct ReadStream {
+        uint64_t last_seqnum;      // Last seqnum read by the client
+        size_t   depth;            // Adapted to consumption of prefetched logs
+        uint64_t generation;       // Bumped to cancel inflight prefetch
+        bool     prefetching;
+        int64_t  last_access_timestamp;
+        std::deque<uint64_t> prefetched_seqnums;
+    };
+    size_t prefetch_max_depth_;
+    absl::Mutex read_stream_mu_;
+    absl::flat_hash_map<ReadStreamKey, ReadStream>
+        read_streams_                ABSL_GUARDED_BY(read_stream_mu_);
+
+    // Subscriptions of function workers on tags, keyed by the client and
+    // its client_data. At most one read op of a subscription is inflight.
+    // Once caught up with the local index, a subscription waits on a tag
+    // watch and costs nothing until logs with the tag get indexed.
+    using SubscriptionKey = std::pair</* client_id */ uint16_t,
+                                      /* client_data */ uint64_t>;
+    struct Subscription {
+        enum State { kIdle, kReading, kWatching };
+        LocalOp* op;  // The SUBSCRIBE op, kept until unsubscribed
+        State    state;
+        bool     woken;  // Tag watch fired while reading
+        uint64_t next_seqnum;
+        uint32_t credits;
+    };
+    absl::Mutex subscription_mu_;
+    absl::flat_hash_map<SubscriptionKey, Subscription>
+        subscriptions_               ABSL_GUARDED_BY(subscription_mu_);
+    absl::flat_hash_map<Index::TagWatch, absl::flat_hash_set<SubscriptionKey>>
+        tag_watchers_                ABSL_GUARDED_BY(subscription_mu_);
+    absl::flat_hash_map</* func_call_id */ uint64_t, absl::flat_hash_set<SubscriptionKey>>
+        func_call_subscriptions_     ABSL_GUARDED_BY(subscription_mu_);
+
     void OnViewCreated(const View* view) override;
     void OnViewFrozen(const View* view) override;
     void OnViewFinalized(const FinalizedView* finalized_view) override;
 
     void HandleLocalAppend(LocalOp* op) override;
+    void AppendLocalOp(LocalOp* op);
+    bool ReadCondTailOfEarlierViews(LocalOp* op);
+    void OnCondTailReadFinished(const LocalOp* op, const protocol::Message& response) override;
     void HandleLocalTrim(LocalOp* op) override;
     void HandleLocalRead(LocalOp* op) override;
     void HandleLocalSetAuxData(LocalOp* op) override;
-
-    void HandleRemoteRead(const protocol::SharedLogMessage& request) override;
+    void HandleLocalResolveLocalId(LocalOp* op) override;
+    void HandleLocalSubscription(LocalOp* op) override;
+    void OnLocalReadFinished(const LocalOp* op, const protocol::Message& response) override;
+    void OnSubscriptionReadFinished(const LocalOp* op, protocol::Message* response,
+                                    std::span<const char> aux_buffer) override;
+    void OnFuncCallDone(uint64_t func_call_id) override;
+    void OnStorageReadTimeout(uint64_t op_id) override;
+
+    void HandleRemoteRead(const protocol::SharedLogMessage& request,
+                          std::span<const char> payload) override;
     void OnRecvNewMetaLogs(const protocol::SharedLogMessage& message,
                            std::span<const char> payload) override;
     void OnRecvNewIndexData(const protocol::SharedLogMessage& message,
                             std::span<const char> payload) override;
     void OnRecvResponse(const protocol::SharedLogMessage& message,
                         std::span<const char> payload) override;
+    void OnRecvShardProgress(const protocol::SharedLogMessage& message,
+                             std::span<const char> payload) override;
+    void OnRecvTagSummary(const protocol::SharedLogMessage& message,
+                          std::span<const char> payload) override;
 
     void ProcessAppendResults(const LogProducer::AppendResultVec& results);
+    void OnAsyncAppendReplicated(LocalOp* op, uint64_t localid);
+    void OnAsyncAppendFinished(uint64_t localid, uint64_t seqnum,
+                               uint64_t metalog_progress);
+    void FinishResolveLocalIdOp(LocalOp* op, const AsyncAppendResult& result);
+    void CheckCondAppendResult(LocalOp* op);
+    void FinishCondAppendOp(LocalOp* op, bool success, uint64_t metalog_progress);
+    void RelaxReadMetaLogProgress(LocalOp* op, uint32_t logspace_id)
+        ABSL_SHARED_LOCKS_REQUIRED(view_mu_);
+    void QueryIndex(LocalOp* op, const View::Sequencer* sequencer_node,
+                    LockablePtr<Index> index_ptr);
+    bool ReadFromPrefetchedStream(LocalOp* op);
+    LocalOp* MaybePrefetch(const LocalOp* op, ReadStream* stream)
+        ABSL_EXCLUSIVE_LOCKS_REQUIRED(read_stream_mu_);
+    bool QueryIndexResultCache(LocalOp* op, uint32_t logspace_id);
+    void PutIndexResultCache(LocalOp* op, uint64_t seqnum, uint16_t engine_id,
+                             uint64_t metalog_progress);
+    void MakeIndexQuery(LockablePtr<Index> index_ptr, const IndexQuery& query,
+                        Index::QueryResultVec* results);
     void ProcessIndexQueryResults(const Index::QueryResultVec& results);
     void ProcessRequests(const std::vector<SharedLogRequest>& requests);
 
-    void ProcessIndexFoundResult(const IndexQueryResult& query_result);
+    LocalOp* NextSubscriptionRead(const SubscriptionKey& key, Subscription* sub)
+        ABSL_EXCLUSIVE_LOCKS_REQUIRED(subscription_mu_);
+    void RemoveSubscription(const SubscriptionKey& key)
+        ABSL_EXCLUSIVE_LOCKS_REQUIRED(subscription_mu_);
+    void DispatchSubscriptionReads(const std::vector<LocalOp*>& ops);
+    void OnTagWatchesFired(const Index::TagWatchVec& watches);
+    void WakeUpSubscriptions();
+
+    void ProcessTagSummaries(const std::vector<TagSummaryProto>& summaries);
+    void AddTagSummary(const TagSummaryProto& summary);
+    bool ViewMayContainTag(const View* view, uint32_t user_logspace, uint64_t user_tag);
+    bool ViewMayContainQueryTags(const View* view, const IndexQuery& query);
+
+    void ProcessIndexFoundResult(const IndexQueryResult& query_result,
+                                 bool disk_cache_checked = false);
+    void ProcessCondCheckResult(const IndexQueryResult& query_result);
     void ProcessIndexContinueResult(const IndexQueryResult& query_result,
                                     Index::QueryResultVec* more_results);
 
     inline LogMetaData MetaDataFromAppendOp(LocalOp* op) {
-        DCHECK(op->type == protocol::SharedLogOpType::APPEND);
+        DCHECK(op->type == protocol::SharedLogOpType::APPEND
+               || op->type == protocol::SharedLogOpType::ASYNC_APPEND
+               || op->type == protocol::SharedLogOpType::COND_APPEND);
+        bool cond_append = (op->type == protocol::SharedLogOpType::COND_APPEND);
         return LogMetaData {
             .user_logspace = op->user_logspace,
             .seqnum = kInvalidLogSeqNum,
             .localid = 0,
             .num_tags = op->user_tags.size(),
-            .data_size = op->data.length()
+            .data_size = op->data.length(),
+            .cond_append = cond_append,
+            .cond_tail_seqnum = cond_append ? op->seqnum : kInvalidLogSeqNum
         };
     }
 
@@ -72,7 +193,8 @@ private:
     protocol::SharedLogMessage BuildReadRequestMessage(const IndexQueryResult& result);
 
     IndexQuery BuildIndexQuery(LocalOp* op);
-    IndexQuery BuildIndexQuery(const protocol::SharedLogMessage& message);
+    IndexQuery BuildIndexQuery(const protocol::SharedLogMessage& message,
+                               std::span<const char> payload);
     IndexQuery BuildIndexQuery(const IndexQueryResult& result);
 
     DISALLOW_COPY_AND_ASSIGN(Engine);
@@ -21,10 +21,28 @@ using protocol::SharedLogMessageHelper;
 using protocol::SharedLogOpType;
 using protocol::SharedLogResultType;
 
+namespace {
+static constexpr size_t kDiskCacheSegmentSize = size_t{64} << 20;
+}  // namespace
+
 EngineBase::EngineBase(engine::Engine* engine)
     : node_id_(engine->node_id_),
       engine_(engine),
-      next_local_op_id_(0) {}
+      next_local_op_id_(0),
+      enable_replicate_batch_(absl::GetFlag(FLAGS_slog_engine_replicate_batch_us) > 0),
+      replicate_batch_max_bytes_(gsl::narrow_cast<size_t>(
+          absl::GetFlag(FLAGS_slog_engine_replicate_batch_max_bytes))),
+      hedged_read_percentile_(absl::GetFlag(FLAGS_slog_engine_hedged_read_percentile)),
+      enable_hedged_read_(hedged_read_percentile_ > 0) {
+    for (size_t i = 0; i < kNumStorageReadShards; i++) {
+        auto shard = std::make_unique<StorageReadShard>();
+        absl::MutexLock lk(&shard->mu);
+        shard->next_latency_sample = 0;
+        shard->new_latency_samples = 0;
+        shard->hedged_read_delay_us = absl::GetFlag(FLAGS_slog_engine_hedged_read_min_delay_us);
+        storage_read_shards_.push_back(std::move(shard));
+    }
+}
 
 EngineBase::~EngineBase() {}
 
@@ -33,15 +51,43 @@ zk::ZKSession* EngineBase::zk_session() {
 }
 
 void EngineBase::Start() {
+    if (enable_replicate_batch_) {
+        engine_->ForEachIOWorker([this] (server::IOWorker* io_worker) {
+            auto batcher = std::make_unique<ReplicateBatcher>();
+            absl::MutexLock lk(&batcher->mu);
+            batcher->batch.view = nullptr;
+            batcher->batch.num_records = 0;
+            replicate_batchers_[io_worker] = std::move(batcher);
+        });
+    }
     SetupZKWatchers();
     SetupTimers();
     // Setup cache
     if (absl::GetFlag(FLAGS_slog_engine_enable_cache)) {
-        log_cache_.emplace(absl::GetFlag(FLAGS_slog_engine_cache_cap_mb));
+        log_cache_.emplace(absl::GetFlag(FLAGS_slog_engine_cache_cap_mb),
+                           absl::GetFlag(FLAGS_slog_engine_cache_partitions),
+                           absl::GetFlag(FLAGS_slog_engine_cache_admission));
+        std::string disk_cache_path = absl::GetFlag(FLAGS_slog_engine_disk_cache_path);
+        if (!disk_cache_path.empty()) {
+            size_t cap_bytes = static_cast<size_t>(
+                absl::GetFlag(FLAGS_slog_engine_disk_cache_cap_mb)) << 20;
+            disk_log_cache_.reset(new DiskLogCache(
+                disk_cache_path, cap_bytes, kDiskCacheSegmentSize));
+            disk_log_cache_->Start();
+            log_cache_->SetEvictCallback(
+                [this] (uint64_t seqnum, std::string encoded) {
+                    disk_log_cache_->Put(seqnum, std::move(encoded));
+                }
+            );
+        }
     }
 }
 
-void EngineBase::Stop() {}
+void EngineBase::Stop() {
+    if (disk_log_cache_ != nullptr) {
+        disk_log_cache_->Stop();
+    }
+}
 
 void EngineBase::SetupZKWatchers() {
     view_watcher_.SetViewCreatedCallback(
@@ -63,6 +109,20 @@ void EngineBase::SetupZKWatchers() {
 }
 
 void EngineBase::SetupTimers() {
+    if (enable_replicate_batch_) {
+        engine_->CreatePeriodicTimer(
+            kReplicateBatchTimerId,
+            absl::Microseconds(absl::GetFlag(FLAGS_slog_engine_replicate_batch_us)),
+            [this] () { this->FlushReplicateBatch(); }
+        );
+    }
+    if (enable_hedged_read_) {
+        engine_->CreatePeriodicTimer(
+            kHedgedReadTimerId,
+            kHedgedReadCheckInterval,
+            [this] () { this->CheckHedgedReads(); }
+        );
+    }
 }
 
 void EngineBase::OnNewExternalFuncCall(const FuncCall& func_call, uint32_t log_space) {
@@ -95,17 +155,22 @@ void EngineBase::OnNewInternalFuncCall(const FuncCall& func_call,
 }
 
 void EngineBase::OnFuncCallCompleted(const FuncCall& func_call) {
-    absl::MutexLock fn_ctx_lk(&fn_ctx_mu_);
-    if (!fn_call_ctx_.contains(func_call.full_call_id)) {
-        HLOG(FATAL) << "Cannot find FuncCall: "
-                    << FuncCallHelper::DebugString(func_call);
+    {
+        absl::MutexLock fn_ctx_lk(&fn_ctx_mu_);
+        if (!fn_call_ctx_.contains(func_call.full_call_id)) {
+            HLOG(FATAL) << "Cannot find FuncCall: "
+                        << FuncCallHelper::DebugString(func_call);
+        }
+        fn_call_ctx_.erase(func_call.full_call_id);
     }
-    fn_call_ctx_.erase(func_call.full_call_id);
+    OnFuncCallDone(func_call.full_call_id);
 }
 
 void EngineBase::LocalOpHandler(LocalOp* op) {
     switch (op->type) {
     case SharedLogOpType::APPEND:
+    case SharedLogOpType::ASYNC_APPEND:
+    case SharedLogOpType::COND_APPEND:
         HandleLocalAppend(op);
         break;
     case SharedLogOpType::READ_NEXT:
@@ -119,6 +184,14 @@ void EngineBase::LocalOpHandler(LocalOp* op) {
     case SharedLogOpType::SET_AUXDATA:
         HandleLocalSetAuxData(op);
         break;
+    case SharedLogOpType::RESOLVE_LOCALID:
+        HandleLocalResolveLocalId(op);
+        break;
+    case SharedLogOpType::SUBSCRIBE:
+    case SharedLogOpType::UNSUBSCRIBE:
+    case SharedLogOpType::SUB_CREDITS:
+        HandleLocalSubscription(op);
+        break;
     default:
         UNREACHABLE();
     }
@@ -130,7 +203,7 @@ void EngineBase::MessageHandler(const SharedLogMessage& message,
     case SharedLogOpType::READ_NEXT:
     case SharedLogOpType::READ_PREV:
     case SharedLogOpType::READ_NEXT_B:
-        HandleRemoteRead(message);
+        HandleRemoteRead(message, payload);
         break;
     case SharedLogOpType::INDEX_DATA:
         OnRecvNewIndexData(message, payload);
@@ -139,7 +212,15 @@ void EngineBase::MessageHandler(const SharedLogMessage& message,
         OnRecvNewMetaLogs(message, payload);
         break;
     case SharedLogOpType::RESPONSE:
-        OnRecvResponse(message, payload);
+        if (OnStorageReadResponse(message)) {
+            OnRecvResponse(message, payload);
+        }
+        break;
+    case SharedLogOpType::SHARD_PROG:
+        OnRecvShardProgress(message, payload);
+        break;
+    case SharedLogOpType::TAG_SUMMARY:
+        OnRecvTagSummary(message, payload);
         break;
     default:
         UNREACHABLE();
@@ -147,7 +228,9 @@ void EngineBase::MessageHandler(const SharedLogMessage& message,
 }
 
 void EngineBase::PopulateLogTagsAndData(LocalOp* op, std::span<const char> data) {
-    DCHECK(op->type == SharedLogOpType::APPEND);
+    DCHECK(  op->type == SharedLogOpType::APPEND
+          || op->type == SharedLogOpType::ASYNC_APPEND
+          || op->type == SharedLogOpType::COND_APPEND);
     size_t num_tags = op->user_tags.size();
     if (num_tags > 0) {
         memcpy(op->user_tags.data(), data.data(), num_tags * sizeof(uint64_t));
@@ -155,6 +238,23 @@ void EngineBase::PopulateLogTagsAndData(LocalOp* op, std::span<const char> data)
     op->data.AppendData(data.subspan(num_tags * sizeof(uint64_t)));
 }
 
+bool EngineBase::PopulateQueryTags(LocalOp* op, std::span<const char> data) {
+    DCHECK(  op->type == SharedLogOpType::READ_NEXT
+          || op->type == SharedLogOpType::READ_PREV);
+    size_t num_tags = op->user_tags.size();
+    if (num_tags == 0) {
+        return true;
+    }
+    if (data.size() < num_tags * sizeof(uint64_t)) {
+        HLOG_F(ERROR, "Read with {} tags carries only {} bytes of data",
+               num_tags, data.size());
+        return false;
+    }
+    memcpy(op->user_tags.data(), data.data(), num_tags * sizeof(uint64_t));
+    op->query_tag = op->user_tags.at(0);
+    return true;
+}
+
 void EngineBase::OnMessageFromFuncWorker(const Message& message) {
     protocol::FuncCall func_call = MessageHelper::GetFuncCall(message);
     FnCallContext ctx;
@@ -178,20 +278,43 @@ void EngineBase::OnMessageFromFuncWorker(const Message& message) {
     op->metalog_progress = ctx.metalog_progress;
     op->type = MessageHelper::GetSharedLogOpType(message);
     op->seqnum = kInvalidLogSeqNum;
+    op->localid = protocol::kInvalidLogLocalId;
     op->query_tag = kInvalidLogTag;
+    op->read_consistency = protocol::ReadConsistency::STRICT;
+    op->staleness_bound = 0;
+    op->prefetch = false;
+    op->subscription = false;
+    op->sub_with_data = false;
+    op->sub_credits = 0;
+    op->no_cache = false;
+    op->cond_append_op = nullptr;
     op->user_tags.clear();
     op->data.Reset();
 
     switch (op->type) {
     case SharedLogOpType::APPEND:
+    case SharedLogOpType::ASYNC_APPEND:
         DCHECK_EQ(message.log_aux_data_size, 0U);
         op->user_tags.resize(message.log_num_tags);
         break;
+    case SharedLogOpType::COND_APPEND:
+        DCHECK_EQ(message.log_aux_data_size, 0U);
+        op->user_tags.resize(message.log_num_tags);
+        op->query_tag = message.log_tag;
+        op->seqnum = message.log_seqnum;
+        break;
     case SharedLogOpType::READ_NEXT:
     case SharedLogOpType::READ_PREV:
+        // Multi-tag reads carry the tag set as data
+        op->user_tags.resize(message.log_num_tags);
+        [[fallthrough]];
     case SharedLogOpType::READ_NEXT_B:
         op->query_tag = message.log_tag;
         op->seqnum = message.log_seqnum;
+        op->read_consistency = static_cast<protocol::ReadConsistency>(
+            message.log_read_consistency);
+        op->staleness_bound = message.log_staleness_bound;
+        op->no_cache = (message.flags & protocol::kReadNoCacheFlag) != 0;
         break;
     case SharedLogOpType::TRIM:
         op->seqnum = message.log_seqnum;
@@ -199,6 +322,20 @@ void EngineBase::OnMessageFromFuncWorker(const Message& message) {
     case SharedLogOpType::SET_AUXDATA:
         op->seqnum = message.log_seqnum;
         break;
+    case SharedLogOpType::RESOLVE_LOCALID:
+        op->localid = message.log_localid;
+        break;
+    case SharedLogOpType::SUBSCRIBE:
+        op->query_tag = message.log_tag;
+        op->seqnum = message.log_seqnum;
+        op->sub_with_data = (message.flags & protocol::kSubscribeWithDataFlag) != 0;
+        op->sub_credits = message.log_sub_credits;
+        break;
+    case SharedLogOpType::SUB_CREDITS:
+        op->sub_credits = message.log_sub_credits;
+        break;
+    case SharedLogOpType::UNSUBSCRIBE:
+        break;
     default:
         HLOG(FATAL) << "Unknown shared log op type: " << message.log_op;
     }
@@ -230,11 +367,20 @@ void EngineBase::OnMessageFromFuncWorker(const Message& message) {
     }
     switch (op->type) {
     case SharedLogOpType::APPEND:
+    case SharedLogOpType::ASYNC_APPEND:
+    case SharedLogOpType::COND_APPEND:
         PopulateLogTagsAndData(op, data);
         break;
     case SharedLogOpType::SET_AUXDATA:
         op->data.AppendData(data);
         break;
+    case SharedLogOpType::READ_NEXT:
+    case SharedLogOpType::READ_PREV:
+        if (!PopulateQueryTags(op, data)) {
+            FinishLocalOpWithFailure(op, SharedLogResultType::BAD_ARGS);
+            return;
+        }
+        break;
     default:
         break;
     }
@@ -263,11 +409,20 @@ void EngineBase::OnAuxBufferFromFuncWorker(uint64_t id) {
     std::span<const char> data = STRING_AS_SPAN(aux_buf);
     switch (op->type) {
     case SharedLogOpType::APPEND:
+    case SharedLogOpType::ASYNC_APPEND:
+    case SharedLogOpType::COND_APPEND:
         PopulateLogTagsAndData(op, data);
         break;
     case SharedLogOpType::SET_AUXDATA:
         op->data.AppendData(data);
         break;
+    case SharedLogOpType::READ_NEXT:
+    case SharedLogOpType::READ_PREV:
+        if (!PopulateQueryTags(op, data)) {
+            FinishLocalOpWithFailure(op, SharedLogResultType::BAD_ARGS);
+            return;
+        }
+        break;
     default:
         break;
     }
@@ -283,7 +438,9 @@ void EngineBase::OnRecvSharedLogMessage(int conn_type, uint16_t src_node_id,
      || (conn_type == kEngineIngressTypeId && op_type == SharedLogOpType::READ_NEXT)
      || (conn_type == kEngineIngressTypeId && op_type == SharedLogOpType::READ_PREV)
      || (conn_type == kEngineIngressTypeId && op_type == SharedLogOpType::READ_NEXT_B)
+     || (conn_type == kEngineIngressTypeId && op_type == SharedLogOpType::TAG_SUMMARY)
      || (conn_type == kStorageIngressTypeId && op_type == SharedLogOpType::INDEX_DATA)
+     || (conn_type == kStorageIngressTypeId && op_type == SharedLogOpType::SHARD_PROG)
      || op_type == SharedLogOpType::RESPONSE
     ) << fmt::format("Invalid combination: conn_type={:#x}, op_type={:#x}",
                      conn_type, message.op_type);
@@ -298,6 +455,14 @@ void EngineBase::ReplicateLogEntry(const View* view, const LogMetaData& log_meta
     message.origin_node_id = node_id_;
     message.payload_size = gsl::narrow_cast<uint32_t>(
         user_tags.size() * sizeof(uint64_t) + log_data.size());
+    if (enable_replicate_batch_) {
+        // Entries replicated off IO workers are sent right away
+        if (auto iter = replicate_batchers_.find(server::IOWorker::current());
+                iter != replicate_batchers_.end()) {
+            AddToReplicateBatch(iter->second.get(), view, message, user_tags, log_data);
+            return;
+        }
+    }
     const View::Engine* engine_node = view->GetEngineNode(node_id_);
     for (uint16_t storage_id : engine_node->GetStorageNodes()) {
         engine_->SendSharedLogMessage(protocol::ConnType::ENGINE_TO_STORAGE,
@@ -306,6 +471,76 @@ void EngineBase::ReplicateLogEntry(const View* view, const LogMetaData& log_meta
     }
 }
 
+void EngineBase::AddToReplicateBatch(ReplicateBatcher* batcher, const View* view,
+                                     const SharedLogMessage& message,
+                                     std::span<const uint64_t> user_tags,
+                                     std::span<const char> log_data) {
+    absl::InlinedVector<ReplicateBatch, 2> ready_batches;
+    {
+        absl::MutexLock lk(&batcher->mu);
+        ReplicateBatch& batch = batcher->batch;
+        if (batch.num_records > 0 && batch.view != view) {
+            // Records in one batch must belong to the same view
+            ready_batches.push_back(std::move(batch));
+            batch.num_records = 0;
+            batch.payload.clear();
+        }
+        if (batch.num_records == 0) {
+            batch.view = view;
+            batch.logspace_id = message.logspace_id;
+        }
+        log_utils::AppendReplicateRecord(message, user_tags, log_data, &batch.payload);
+        batch.num_records++;
+        if (batch.payload.size() >= replicate_batch_max_bytes_) {
+            ready_batches.push_back(std::move(batch));
+            batch.num_records = 0;
+            batch.payload.clear();
+        }
+    }
+    for (const ReplicateBatch& batch : ready_batches) {
+        SendReplicateBatch(batch);
+    }
+}
+
+void EngineBase::FlushReplicateBatch() {
+    if (!enable_replicate_batch_) {
+        return;
+    }
+    if (server::IOWorker::current() == nullptr) {
+        // Messages can only be sent from IO workers
+        SomeIOWorker()->ScheduleFunction(nullptr, [this] () { FlushReplicateBatch(); });
+        return;
+    }
+    for (const auto& [io_worker, batcher] : replicate_batchers_) {
+        ReplicateBatch batch;
+        {
+            absl::MutexLock lk(&batcher->mu);
+            if (batcher->batch.num_records == 0) {
+                continue;
+            }
+            batch = std::move(batcher->batch);
+            batcher->batch.num_records = 0;
+            batcher->batch.payload.clear();
+        }
+        SendReplicateBatch(batch);
+    }
+}
+
+void EngineBase::SendReplicateBatch(const ReplicateBatch& batch) {
+    HVLOG_F(1, "Send replicate batch: num_records={}, size={}",
+            batch.num_records, batch.payload.size());
+    SharedLogMessage message = SharedLogMessageHelper::NewReplicateMessage();
+    message.flags |= protocol::kReplicateBatchFlag;
+    message.logspace_id = batch.logspace_id;
+    message.origin_node_id = node_id_;
+    message.payload_size = gsl::narrow_cast<uint32_t>(batch.payload.size());
+    const View::Engine* engine_node = batch.view->GetEngineNode(node_id_);
+    for (uint16_t storage_id : engine_node->GetStorageNodes()) {
+        engine_->SendSharedLogMessage(protocol::ConnType::ENGINE_TO_STORAGE,
+                                      storage_id, message, STRING_AS_SPAN(batch.payload));
+    }
+}
+
 void EngineBase::PropagateAuxData(const View* view, const LogMetaData& log_metadata, 
                                   std::span<const char> aux_data) {
     uint16_t engine_id = gsl::narrow_cast<uint16_t>(
@@ -315,6 +550,7 @@ void EngineBase::PropagateAuxData(const View* view, const LogMetaData& log_metad
     SharedLogMessage message = SharedLogMessageHelper::NewSetAuxDataMessage(
         log_metadata.seqnum);
     message.origin_node_id = node_id_;
+    message.user_logspace = log_metadata.user_logspace;
     message.payload_size = gsl::narrow_cast<uint32_t>(aux_data.size());
     for (uint16_t storage_id : engine_node->GetStorageNodes()) {
         engine_->SendSharedLogMessage(protocol::ConnType::ENGINE_TO_STORAGE,
@@ -323,7 +559,8 @@ void EngineBase::PropagateAuxData(const View* view, const LogMetaData& log_metad
 }
 
 void EngineBase::FinishLocalOpWithResponse(LocalOp* op, Message* response,
-                                           uint64_t metalog_progress) {
+                                           uint64_t metalog_progress,
+                                           std::span<const char> aux_buffer) {
     if (metalog_progress > 0) {
         absl::MutexLock fn_ctx_lk(&fn_ctx_mu_);
         if (fn_call_ctx_.contains(op->func_call_id)) {
@@ -333,8 +570,112 @@ void EngineBase::FinishLocalOpWithResponse(LocalOp* op, Message* response,
             }
         }
     }
+    if (op->type == SharedLogOpType::READ_NEXT && !op->subscription) {
+        OnLocalReadFinished(op, *response);
+    }
+    if (op->prefetch) {
+        log_op_pool_.Return(op);
+        return;
+    }
+    if (op->cond_append_op != nullptr) {
+        OnCondTailReadFinished(op, *response);
+        log_op_pool_.Return(op);
+        return;
+    }
     response->log_client_data = op->client_data;
-    engine_->SendFuncWorkerMessage(op->client_id, response);
+    response->log_metalog_progress = metalog_progress;
+    if (op->subscription) {
+        OnSubscriptionReadFinished(op, response, aux_buffer);
+    } else {
+        SendFuncWorkerMessage(op->client_id, response, aux_buffer);
+    }
+    log_op_pool_.Return(op);
+}
+
+EngineBase::LocalOp* EngineBase::NewPrefetchReadOp(const LocalOp* op, uint64_t seqnum) {
+    LocalOp* prefetch_op = log_op_pool_.Get();
+    prefetch_op->id = next_local_op_id_.fetch_add(1, std::memory_order_acq_rel);
+    prefetch_op->start_timestamp = GetMonotonicMicroTimestamp();
+    prefetch_op->client_id = op->client_id;
+    prefetch_op->client_data = 0;
+    prefetch_op->func_call_id = protocol::kInvalidFuncCallId;
+    prefetch_op->user_logspace = op->user_logspace;
+    prefetch_op->metalog_progress = op->metalog_progress;
+    prefetch_op->type = SharedLogOpType::READ_NEXT;
+    prefetch_op->seqnum = seqnum;
+    prefetch_op->localid = protocol::kInvalidLogLocalId;
+    prefetch_op->query_tag = op->query_tag;
+    prefetch_op->read_consistency = protocol::ReadConsistency::STRICT;
+    prefetch_op->staleness_bound = 0;
+    prefetch_op->prefetch = true;
+    prefetch_op->subscription = false;
+    prefetch_op->sub_with_data = false;
+    prefetch_op->sub_credits = 0;
+    prefetch_op->no_cache = false;
+    prefetch_op->cond_append_op = nullptr;
+    prefetch_op->user_tags.clear();
+    prefetch_op->data.Reset();
+    return prefetch_op;
+}
+
+EngineBase::LocalOp* EngineBase::NewSubscriptionReadOp(const LocalOp* sub_op,
+                                                       SharedLogOpType type,
+                                                       uint64_t seqnum) {
+    DCHECK(sub_op->type == SharedLogOpType::SUBSCRIBE);
+    LocalOp* op = log_op_pool_.Get();
+    op->id = next_local_op_id_.fetch_add(1, std::memory_order_acq_rel);
+    op->start_timestamp = GetMonotonicMicroTimestamp();
+    op->client_id = sub_op->client_id;
+    op->client_data = sub_op->client_data;
+    op->func_call_id = sub_op->func_call_id;
+    op->user_logspace = sub_op->user_logspace;
+    // Subscriptions follow whatever the index has
+    op->metalog_progress = 0;
+    op->type = type;
+    op->seqnum = seqnum;
+    op->localid = protocol::kInvalidLogLocalId;
+    op->query_tag = sub_op->query_tag;
+    op->read_consistency = protocol::ReadConsistency::LOCAL_LATEST;
+    op->staleness_bound = 0;
+    op->prefetch = false;
+    op->subscription = true;
+    op->sub_with_data = sub_op->sub_with_data;
+    op->sub_credits = 0;
+    op->no_cache = false;
+    op->cond_append_op = nullptr;
+    op->user_tags.clear();
+    op->data.Reset();
+    return op;
+}
+
+EngineBase::LocalOp* EngineBase::NewCondTailReadOp(LocalOp* cond_op, uint64_t seqnum) {
+    DCHECK(cond_op->type == SharedLogOpType::COND_APPEND);
+    LocalOp* op = log_op_pool_.Get();
+    op->id = next_local_op_id_.fetch_add(1, std::memory_order_acq_rel);
+    op->start_timestamp = GetMonotonicMicroTimestamp();
+    op->client_id = cond_op->client_id;
+    op->client_data = 0;
+    op->func_call_id = cond_op->func_call_id;
+    op->user_logspace = cond_op->user_logspace;
+    op->metalog_progress = cond_op->metalog_progress;
+    op->type = SharedLogOpType::READ_PREV;
+    op->seqnum = seqnum;
+    op->localid = protocol::kInvalidLogLocalId;
+    op->query_tag = cond_op->query_tag;
+    op->read_consistency = protocol::ReadConsistency::STRICT;
+    op->staleness_bound = 0;
+    op->prefetch = false;
+    op->subscription = false;
+    op->sub_with_data = false;
+    op->sub_credits = 0;
+    op->no_cache = true;
+    op->cond_append_op = cond_op;
+    op->user_tags.clear();
+    op->data.Reset();
+    return op;
+}
+
+void EngineBase::ReleaseLocalOp(LocalOp* op) {
     log_op_pool_.Return(op);
 }
 
@@ -344,6 +685,16 @@ void EngineBase::FinishLocalOpWithFailure(LocalOp* op, SharedLogResultType resul
     FinishLocalOpWithResponse(op, &response, metalog_progress);
 }
 
+bool EngineBase::SendFuncWorkerMessage(uint16_t client_id, Message* message,
+                                       std::span<const char> aux_buffer) {
+    if (!aux_buffer.empty()) {
+        uint64_t buf_id = NextAuxBufferId();
+        MessageHelper::FillAuxBufferId(message, buf_id);
+        SendFuncWorkerAuxBuffer(client_id, buf_id, aux_buffer);
+    }
+    return engine_->SendFuncWorkerMessage(client_id, message);
+}
+
 bool EngineBase::SendFuncWorkerAuxBuffer(uint16_t client_id,
                                          uint64_t buf_id, std::span<const char> data) {
     VLOG(1) << "Will send aux buffer with ID " << bits::HexStr0x(buf_id);
@@ -352,41 +703,104 @@ bool EngineBase::SendFuncWorkerAuxBuffer(uint16_t client_id,
 
 void EngineBase::LogCachePut(const LogMetaData& log_metadata,
                              std::span<const uint64_t> user_tags,
-                             std::span<const char> log_data) {
+                             std::span<const char> log_data, bool force) {
     if (!log_cache_.has_value()) {
         return;
     }
+    if (!log_cache_->Put(log_metadata, user_tags, log_data, force)) {
+        HVLOG_F(1, "Log entry (seqnum {}) not admitted into cache",
+                bits::HexStr0x(log_metadata.seqnum));
+        return;
+    }
     HVLOG_F(1, "Store cache for log entry (seqnum {})", bits::HexStr0x(log_metadata.seqnum));
-    log_cache_->Put(log_metadata, user_tags, log_data);
 }
 
-std::optional<LogEntry> EngineBase::LogCacheGet(uint64_t seqnum) {
-    return log_cache_.has_value() ? log_cache_->Get(seqnum) : std::nullopt;
+std::optional<LogEntry> EngineBase::LogCacheGet(uint32_t user_logspace, uint64_t seqnum,
+                                                bool touch) {
+    return log_cache_.has_value() ? log_cache_->Get(user_logspace, seqnum, touch)
+                                  : std::nullopt;
 }
 
-void EngineBase::LogCachePutAuxData(uint64_t seqnum, std::span<const char> data) {
+void EngineBase::LogCachePutAuxData(uint32_t user_logspace, uint64_t seqnum,
+                                    std::span<const char> data) {
     if (log_cache_.has_value()) {
-        log_cache_->PutAuxData(seqnum, data);
+        log_cache_->PutAuxData(user_logspace, seqnum, data);
+    }
+}
+
+std::optional<std::string> EngineBase::LogCacheGetAuxData(uint32_t user_logspace,
+                                                          uint64_t seqnum) {
+    return log_cache_.has_value() ? log_cache_->GetAuxData(user_logspace, seqnum)
+                                  : std::nullopt;
+}
+
+bool EngineBase::LogCacheReadFromDisk(uint64_t seqnum, std::function<void()> done) {
+    if (disk_log_cache_ == nullptr || !disk_log_cache_->Contains(seqnum)) {
+        return false;
     }
+    HVLOG_F(1, "Read log entry (seqnum {}) from disk cache", bits::HexStr0x(seqnum));
+    disk_log_cache_->ReadAsync(
+        seqnum,
+        [this, done = std::move(done)] (std::optional<LogEntry> log_entry) {
+            if (log_entry.has_value()) {
+                log_cache_->Put(log_entry->metadata, VECTOR_AS_SPAN(log_entry->user_tags),
+                                STRING_AS_SPAN(log_entry->data), /* force= */ true);
+            }
+            SomeIOWorker()->ScheduleFunction(nullptr, std::move(done));
+        }
+    );
+    return true;
 }
 
-std::optional<std::string> EngineBase::LogCacheGetAuxData(uint64_t seqnum) {
-    return log_cache_.has_value() ? log_cache_->GetAuxData(seqnum) : std::nullopt;
+bool EngineBase::HasIndexFor(const View::Sequencer* sequencer_node,
+                             uint32_t user_logspace, uint64_t user_tag) const {
+    if (!absl::GetFlag(FLAGS_slog_partition_index)) {
+        return sequencer_node->IsIndexEngineNode(node_id_);
+    }
+    return IndexPartitionNode(sequencer_node, user_logspace, user_tag) == node_id_;
+}
+
+uint16_t EngineBase::IndexPartitionNode(const View::Sequencer* sequencer_node,
+                                        uint32_t user_logspace, uint64_t user_tag) const {
+    const View::NodeIdVec& index_engine_nodes = sequencer_node->GetIndexEngineNodes();
+    size_t partition = log_utils::IndexPartitionOf(
+        user_logspace, user_tag, index_engine_nodes.size());
+    return index_engine_nodes.at(partition);
+}
+
+bool EngineBase::InSameIndexPartition(const View::Sequencer* sequencer_node,
+                                      uint32_t user_logspace,
+                                      const UserTagVec& user_tags) const {
+    if (!absl::GetFlag(FLAGS_slog_partition_index) || user_tags.empty()) {
+        return true;
+    }
+    uint16_t engine_id = IndexPartitionNode(sequencer_node, user_logspace, user_tags.at(0));
+    for (uint64_t user_tag : user_tags) {
+        if (IndexPartitionNode(sequencer_node, user_logspace, user_tag) != engine_id) {
+            return false;
+        }
+    }
+    return true;
 }
 
 bool EngineBase::SendIndexReadRequest(const View::Sequencer* sequencer_node,
-                                      SharedLogMessage* request) {
+                                      SharedLogMessage* request,
+                                      std::span<const char> payload) {
     static constexpr int kMaxRetries = 3;
 
     request->sequencer_id = sequencer_node->node_id();
     request->view_id = sequencer_node->view()->id();
+    request->payload_size = gsl::narrow_cast<uint32_t>(payload.size());
+    bool partitioned = absl::GetFlag(FLAGS_slog_partition_index);
     for (int i = 0; i < kMaxRetries; i++) {
-        uint16_t engine_id = sequencer_node->PickIndexEngineNode();
+        uint16_t engine_id = partitioned
+            ? IndexPartitionNode(sequencer_node, request->user_logspace, request->query_tag)
+            : sequencer_node->PickIndexEngineNode();
         if (engine_id == node_id_) {
             continue;
         }
         bool success = engine_->SendSharedLogMessage(
-            protocol::ConnType::SLOG_ENGINE_TO_ENGINE, engine_id, *request);
+            protocol::ConnType::SLOG_ENGINE_TO_ENGINE, engine_id, *request, payload);
         if (success) {
             return true;
         }
@@ -406,17 +820,228 @@ bool EngineBase::SendStorageReadRequest(const IndexQueryResult& result,
     request.origin_node_id = result.original_query.origin_node_id;
     request.hop_times = result.original_query.hop_times + 1;
     request.client_data = result.original_query.client_data;
+    // Responses of storage reads go to the origin node, thus only reads of
+    // local requests can be tracked
+    bool track_read = enable_hedged_read_ && request.origin_node_id == node_id_;
+    StorageReadShard* shard = GetStorageReadShard(request.client_data);
+    std::optional<uint16_t> failed_storage_id;
     for (int i = 0; i < kMaxRetries; i++) {
-        uint16_t storage_id = engine_node->PickStorageNode();
+        uint16_t storage_id;
+        if (track_read) {
+            absl::MutexLock lk(&shard->mu);
+            storage_id = PickStorageNode(engine_node, &shard->storage_stats,
+                                         failed_storage_id);
+            shard->reads[request.client_data] = StorageRead {
+                .request = request,
+                .engine_node = engine_node,
+                .storage_id = storage_id,
+                .send_timestamp = GetMonotonicMicroTimestamp(),
+                .hedged = false,
+                .hedged_storage_id = 0,
+                .hedged_timestamp = 0,
+                .failed_storage_id = std::nullopt
+            };
+            shard->storage_stats[storage_id].outstanding_reads++;
+        } else {
+            storage_id = PickStorageNode(engine_node, nullptr, failed_storage_id);
+        }
         bool success = engine_->SendSharedLogMessage(
             protocol::ConnType::ENGINE_TO_STORAGE, storage_id, request);
         if (success) {
             return true;
         }
+        if (track_read) {
+            absl::MutexLock lk(&shard->mu);
+            shard->reads.erase(request.client_data);
+            FinishStorageRead(shard, storage_id);
+        }
+        failed_storage_id = storage_id;
     }
     return false;
 }
 
+uint16_t EngineBase::PickStorageNode(const View::Engine* engine_node,
+                                     const StorageStatMap* storage_stats,
+                                     std::optional<uint16_t> excluded_storage_id) {
+    // Prefer storage nodes with lower latency and fewer outstanding reads,
+    // starting from the round-robin choice to break ties
+    auto score_fn = [storage_stats] (uint16_t storage_id) -> double {
+        if (storage_stats == nullptr || !storage_stats->contains(storage_id)) {
+            return 1.0;
+        }
+        const StorageNodeStat& stat = storage_stats->at(storage_id);
+        return (stat.ewma_latency_us + 1.0) * static_cast<double>(stat.outstanding_reads + 1);
+    };
+    uint16_t best_storage_id = engine_node->PickStorageNode();
+    std::optional<double> best_score;
+    if (best_storage_id != excluded_storage_id) {
+        best_score = score_fn(best_storage_id);
+    }
+    for (uint16_t storage_id : engine_node->GetStorageNodes()) {
+        if (storage_id == excluded_storage_id) {
+            continue;
+        }
+        double score = score_fn(storage_id);
+        if (!best_score.has_value() || score < *best_score) {
+            best_storage_id = storage_id;
+            best_score = score;
+        }
+    }
+    return best_storage_id;
+}
+
+void EngineBase::RecordStorageReadLatency(StorageReadShard* shard, uint16_t storage_id,
+                                          int64_t latency_us) {
+    static constexpr double kEwmaAlpha = 0.1;
+    StorageNodeStat& stat = shard->storage_stats[storage_id];
+    if (stat.ewma_latency_us == 0) {
+        stat.ewma_latency_us = static_cast<double>(latency_us);
+    } else {
+        stat.ewma_latency_us = kEwmaAlpha * static_cast<double>(latency_us)
+                             + (1 - kEwmaAlpha) * stat.ewma_latency_us;
+    }
+    if (shard->read_latency_samples.size() < kMaxReadLatencySamples) {
+        shard->read_latency_samples.push_back(latency_us);
+    } else {
+        shard->read_latency_samples[shard->next_latency_sample] = latency_us;
+        shard->next_latency_sample = (shard->next_latency_sample + 1) % kMaxReadLatencySamples;
+    }
+    shard->new_latency_samples++;
+}
+
+void EngineBase::FinishStorageRead(StorageReadShard* shard, uint16_t storage_id) {
+    StorageNodeStat& stat = shard->storage_stats[storage_id];
+    DCHECK_GT(stat.outstanding_reads, 0U);
+    stat.outstanding_reads--;
+}
+
+bool EngineBase::OnStorageReadResponse(const SharedLogMessage& response) {
+    if (!enable_hedged_read_) {
+        return true;
+    }
+    SharedLogResultType result = SharedLogMessageHelper::GetResultType(response);
+    if (result != SharedLogResultType::READ_OK && result != SharedLogResultType::DATA_LOST) {
+        return true;
+    }
+    uint64_t op_id = response.client_data;
+    uint16_t storage_id = response.origin_node_id;
+    int64_t now = GetMonotonicMicroTimestamp();
+    StorageReadShard* shard = GetStorageReadShard(op_id);
+    absl::MutexLock lk(&shard->mu);
+    if (auto iter = shard->finished_hedged_reads.find(op_id);
+            iter != shard->finished_hedged_reads.end()) {
+        auto [other_storage_id, send_timestamp] = iter->second;
+        if (storage_id == other_storage_id) {
+            HVLOG_F(1, "Drop duplicated response of hedged read (op_id {})", op_id);
+            RecordStorageReadLatency(shard, storage_id, now - send_timestamp);
+            FinishStorageRead(shard, storage_id);
+            shard->finished_hedged_reads.erase(iter);
+            return false;
+        }
+    }
+    auto iter = shard->reads.find(op_id);
+    if (iter == shard->reads.end()) {
+        return true;
+    }
+    StorageRead& read = iter->second;
+    if (storage_id == read.failed_storage_id) {
+        return false;
+    }
+    std::optional<std::pair<uint16_t, int64_t>> other_read;
+    if (storage_id == read.storage_id) {
+        RecordStorageReadLatency(shard, storage_id, now - read.send_timestamp);
+        if (read.hedged) {
+            other_read = std::make_pair(read.hedged_storage_id, read.hedged_timestamp);
+        }
+    } else if (read.hedged && storage_id == read.hedged_storage_id) {
+        RecordStorageReadLatency(shard, storage_id, now - read.hedged_timestamp);
+        other_read = std::make_pair(read.storage_id, read.send_timestamp);
+    } else {
+        return true;
+    }
+    FinishStorageRead(shard, storage_id);
+    if (read.failed_storage_id.has_value()) {
+        // The other replica already answered with an error
+        other_read.reset();
+    } else if (other_read.has_value() && result != SharedLogResultType::READ_OK) {
+        HVLOG_F(1, "Storage node {} failed hedged read (op_id {}), "
+                   "wait for storage node {}", storage_id, op_id, other_read->first);
+        read.failed_storage_id = storage_id;
+        return false;
+    }
+    shard->reads.erase(iter);
+    if (other_read.has_value()) {
+        shard->finished_hedged_reads[op_id] = *other_read;
+        shard->finished_hedged_reads_order.push_back(op_id);
+        while (shard->finished_hedged_reads_order.size() > kMaxFinishedHedgedReads) {
+            uint64_t old_op_id = shard->finished_hedged_reads_order.front();
+            shard->finished_hedged_reads_order.pop_front();
+            if (auto old_iter = shard->finished_hedged_reads.find(old_op_id);
+                    old_iter != shard->finished_hedged_reads.end()) {
+                FinishStorageRead(shard, old_iter->second.first);
+                shard->finished_hedged_reads.erase(old_iter);
+            }
+        }
+    }
+    return true;
+}
+
+void EngineBase::CheckHedgedReads() {
+    DCHECK(enable_hedged_read_);
+    std::vector<std::pair<SharedLogMessage, /* storage_id */ uint16_t>> hedged_reads;
+    std::vector</* op_id */ uint64_t> timed_out_reads;
+    for (const auto& shard : storage_read_shards_) {
+        absl::MutexLock lk(&shard->mu);
+        if (shard->new_latency_samples >= 64) {
+            std::vector<int64_t> samples = shard->read_latency_samples;
+            size_t idx = std::min(
+                static_cast<size_t>(hedged_read_percentile_ * static_cast<float>(samples.size())),
+                samples.size() - 1);
+            std::nth_element(samples.begin(), samples.begin() + idx, samples.end());
+            shard->hedged_read_delay_us = std::max<int64_t>(
+                samples[idx], absl::GetFlag(FLAGS_slog_engine_hedged_read_min_delay_us));
+            shard->new_latency_samples = 0;
+        }
+        int64_t now = GetMonotonicMicroTimestamp();
+        auto iter = shard->reads.begin();
+        while (iter != shard->reads.end()) {
+            StorageRead& read = iter->second;
+            if (now - read.send_timestamp > kStorageReadTimeoutUs) {
+                HLOG_F(WARNING, "Storage read (op_id {}) timed out", iter->first);
+                if (read.storage_id != read.failed_storage_id) {
+                    FinishStorageRead(shard.get(), read.storage_id);
+                }
+                if (read.hedged && read.hedged_storage_id != read.failed_storage_id) {
+                    FinishStorageRead(shard.get(), read.hedged_storage_id);
+                }
+                timed_out_reads.push_back(iter->first);
+                shard->reads.erase(iter++);
+                continue;
+            }
+            if (!read.hedged
+                    && now - read.send_timestamp >= shard->hedged_read_delay_us
+                    && read.engine_node->GetStorageNodes().size() > 1) {
+                read.hedged = true;
+                read.hedged_storage_id = PickStorageNode(
+                    read.engine_node, &shard->storage_stats, read.storage_id);
+                read.hedged_timestamp = now;
+                shard->storage_stats[read.hedged_storage_id].outstanding_reads++;
+                hedged_reads.push_back(std::make_pair(read.request, read.hedged_storage_id));
+            }
+            iter++;
+        }
+    }
+    for (const auto& [request, storage_id] : hedged_reads) {
+        HVLOG_F(1, "Send hedged read (op_id {}) to storage node {}",
+                request.client_data, storage_id);
+        engine_->SendSharedLogMessage(
+            protocol::ConnType::ENGINE_TO_STORAGE, storage_id, request);
+    }
+    for (uint64_t op_id : timed_out_reads) {
+        OnStorageReadTimeout(op_id);
+    }
+}
+
 void EngineBase::SendReadResponse(const IndexQuery& query,
                                   protocol::SharedLogMessage* response,
                                   std::span<const char> user_tags_payload,
@@ -454,6 +1079,16 @@ bool EngineBase::SendSequencerMessage(uint16_t sequencer_id,
         sequencer_id, *message, payload);
 }
 
+bool EngineBase::SendEngineMessage(uint16_t engine_id,
+                                   SharedLogMessage* message,
+                                   std::span<const char> payload) {
+    message->origin_node_id = node_id_;
+    message->payload_size = gsl::narrow_cast<uint32_t>(payload.size());
+    return engine_->SendSharedLogMessage(
+        protocol::ConnType::SLOG_ENGINE_TO_ENGINE,
+        engine_id, *message, payload);
+}
+
 server::IOWorker* EngineBase::SomeIOWorker() {
     return engine_->SomeIOWorker();
 }
@@ -44,13 +44,18 @@ protected:
     virtual void OnViewFrozen(const View* view) = 0;
     virtual void OnViewFinalized(const FinalizedView* finalized_view) = 0;
 
-    virtual void HandleRemoteRead(const protocol::SharedLogMessage& request) = 0;
+    virtual void HandleRemoteRead(const protocol::SharedLogMessage& request,
+                                  std::span<const char> payload) = 0;
     virtual void OnRecvNewMetaLogs(const protocol::SharedLogMessage& message,
                                    std::span<const char> payload) = 0;
     virtual void OnRecvNewIndexData(const protocol::SharedLogMessage& message,
                                     std::span<const char> payload) = 0;
     virtual void OnRecvResponse(const protocol::SharedLogMessage& message,
                                 std::span<const char> payload) = 0;
+    virtual void OnRecvTagSummary(const protocol::SharedLogMessage& message,
+                                  std::span<const char> payload) = 0;
+    virtual void OnRecvShardProgress(const protocol::SharedLogMessage& message,
+                                     std::span<const char> payload) = 0;
 
     void MessageHandler(const protocol::SharedLogMessage& message,
                         std::span<const char> payload);
@@ -64,8 +69,18 @@ protected:
         uint64_t metalog_progress;
         uint64_t query_tag;
         uint64_t seqnum;
+        uint64_t localid;
         uint64_t func_call_id;
         int64_t start_timestamp;
+        protocol::ReadConsistency read_consistency;
+        uint32_t staleness_bound;
+        bool prefetch;  // Issued by engine to fill log cache, not by functions
+        bool subscription;  // Issued by engine to deliver logs to a subscription
+        bool sub_with_data;
+        uint32_t sub_credits;
+        bool no_cache;  // Read results are not put into log cache
+        // Reads the tail of the tag in earlier views for this conditional append
+        LocalOp* cond_append_op;
         UserTagVec user_tags;
         utils::AppendableBuffer data;
     };
@@ -74,31 +89,78 @@ protected:
     virtual void HandleLocalTrim(LocalOp* op) = 0;
     virtual void HandleLocalRead(LocalOp* op) = 0;
     virtual void HandleLocalSetAuxData(LocalOp* op) = 0;
+    virtual void HandleLocalResolveLocalId(LocalOp* op) = 0;
+    virtual void HandleLocalSubscription(LocalOp* op) = 0;
 
     void LocalOpHandler(LocalOp* op);
 
+    // Called before finishing READ_NEXT ops
+    virtual void OnLocalReadFinished(const LocalOp* op, const protocol::Message& response) {}
+    LocalOp* NewPrefetchReadOp(const LocalOp* op, uint64_t seqnum);
+    // Subscription read ops respond through OnSubscriptionReadFinished,
+    // which decides whether to deliver the response
+    virtual void OnSubscriptionReadFinished(const LocalOp* op, protocol::Message* response,
+                                            std::span<const char> aux_buffer) {}
+    LocalOp* NewSubscriptionReadOp(const LocalOp* sub_op, protocol::SharedLogOpType type,
+                                   uint64_t seqnum);
+    // Tail read ops of conditional appends respond through OnCondTailReadFinished
+    virtual void OnCondTailReadFinished(const LocalOp* op,
+                                        const protocol::Message& response) {}
+    LocalOp* NewCondTailReadOp(LocalOp* cond_op, uint64_t seqnum);
+    // Called after the context of the function call is removed
+    virtual void OnFuncCallDone(uint64_t func_call_id) {}
+    // Called when no storage node responds to the read of a local op,
+    // only tracked with hedged reads enabled
+    virtual void OnStorageReadTimeout(uint64_t op_id) {}
+
     void ReplicateLogEntry(const View* view, const LogMetaData& log_metadata,
                            std::span<const uint64_t> user_tags,
                            std::span<const char> log_data);
+    // Sends batched REPLICATE records of all IO workers. Off IO workers, the
+    // batches are sent by some IO worker later.
+    void FlushReplicateBatch();
     void PropagateAuxData(const View* view, const LogMetaData& log_metadata, 
                           std::span<const char> aux_data);
 
+    // `aux_buffer` is sent only if the response is delivered to the function
     void FinishLocalOpWithResponse(LocalOp* op, protocol::Message* response,
-                                   uint64_t metalog_progress);
+                                   uint64_t metalog_progress,
+                                   std::span<const char> aux_buffer = EMPTY_CHAR_SPAN);
     void FinishLocalOpWithFailure(LocalOp* op, protocol::SharedLogResultType result,
                                   uint64_t metalog_progress = 0);
 
+    // Returns the op to the pool without responding to the function
+    void ReleaseLocalOp(LocalOp* op);
+
+    // Sends `aux_buffer` ahead of the message, if not empty
+    bool SendFuncWorkerMessage(uint16_t client_id, protocol::Message* message,
+                               std::span<const char> aux_buffer = EMPTY_CHAR_SPAN);
     bool SendFuncWorkerAuxBuffer(uint16_t client_id,
                                  uint64_t buf_id, std::span<const char> data);
 
+    // `force` bypasses the admission policy of the memory cache
     void LogCachePut(const LogMetaData& log_metadata, std::span<const uint64_t> user_tags,
-                     std::span<const char> log_data);
-    std::optional<LogEntry> LogCacheGet(uint64_t seqnum);
-    void LogCachePutAuxData(uint64_t seqnum, std::span<const char> data);
-    std::optional<std::string> LogCacheGetAuxData(uint64_t seqnum);
-
+                     std::span<const char> log_data, bool force = false);
+    std::optional<LogEntry> LogCacheGet(uint32_t user_logspace, uint64_t seqnum,
+                                        bool touch = true);
+    void LogCachePutAuxData(uint32_t user_logspace, uint64_t seqnum,
+                            std::span<const char> data);
+    std::optional<std::string> LogCacheGetAuxData(uint32_t user_logspace, uint64_t seqnum);
+    // Returns false if the entry is not in the disk cache. Otherwise reads
+    // it in background, promotes it into the memory cache, then schedules
+    // `done` on some IO worker.
+    bool LogCacheReadFromDisk(uint64_t seqnum, std::function<void()> done);
+
+    // Checks if this node can serve index queries of user_tag, which
+    // depends on the partition of user_tag if the index is partitioned
+    bool HasIndexFor(const View::Sequencer* sequencer_node,
+                     uint32_t user_logspace, uint64_t user_tag) const;
+    // Tags of a multi-tag query have to share the same index partition
+    bool InSameIndexPartition(const View::Sequencer* sequencer_node,
+                              uint32_t user_logspace, const UserTagVec& user_tags) const;
     bool SendIndexReadRequest(const View::Sequencer* sequencer_node,
-                              protocol::SharedLogMessage* request);
+                              protocol::SharedLogMessage* request,
+                              std::span<const char> payload = EMPTY_CHAR_SPAN);
     bool SendStorageReadRequest(const IndexQueryResult& result,
                                 const View::Engine* engine_node);
     void SendReadResponse(const IndexQuery& query,
@@ -112,6 +174,9 @@ protected:
     bool SendSequencerMessage(uint16_t sequencer_id,
                               protocol::SharedLogMessage* message,
                               std::span<const char> payload = EMPTY_CHAR_SPAN);
+    bool SendEngineMessage(uint16_t engine_id,
+                           protocol::SharedLogMessage* message,
+                           std::span<const char> payload = EMPTY_CHAR_SPAN);
 
     server::IOWorker* SomeIOWorker();
 
@@ -141,11 +206,101 @@ private:
         requests_for_buf_ ABSL_GUARDED_BY(request_for_buf_mu_);
 
     std::optional<LRUCache> log_cache_;
+    std::unique_ptr<DiskLogCache> disk_log_cache_;
+
+    // Coalesced REPLICATE records. All storage nodes of this engine receive
+    // the same records, so each IO worker keeps a single batch.
+    struct ReplicateBatch {
+        const View* view;
+        uint32_t    logspace_id;   // Of the first record
+        size_t      num_records;
+        std::string payload;
+    };
+    struct ReplicateBatcher {
+        absl::Mutex    mu;
+        ReplicateBatch batch ABSL_GUARDED_BY(mu);
+    };
+    bool enable_replicate_batch_;
+    size_t replicate_batch_max_bytes_;
+    // Created on start, thus read without locks
+    absl::flat_hash_map<server::IOWorker*, std::unique_ptr<ReplicateBatcher>>
+        replicate_batchers_;
+
+    // Storage reads of local requests, tracked for latencies of storage
+    // nodes and hedged to another storage node if slow. Only tracked with
+    // hedged reads enabled, in shards by op_id so that IO workers seldom
+    // contend on the read path.
+    static constexpr size_t kNumStorageReadShards = 16;
+    static constexpr absl::Duration kHedgedReadCheckInterval = absl::Microseconds(100);
+    static constexpr int64_t kStorageReadTimeoutUs = 10000000;
+    static constexpr size_t kMaxReadLatencySamples = 1024;
+    static constexpr size_t kMaxFinishedHedgedReads = 4096;
+    struct StorageRead {
+        protocol::SharedLogMessage request;
+        const View::Engine* engine_node;
+        uint16_t storage_id;
+        int64_t  send_timestamp;
+        bool     hedged;
+        uint16_t hedged_storage_id;
+        int64_t  hedged_timestamp;
+        // Replica answered with an error while the other one is outstanding
+        std::optional<uint16_t> failed_storage_id;
+    };
+    struct StorageNodeStat {
+        double ewma_latency_us;
+        size_t outstanding_reads;
+    };
+    using StorageStatMap = absl::flat_hash_map</* storage_id */ uint16_t, StorageNodeStat>;
+    struct StorageReadShard {
+        absl::Mutex mu;
+        absl::flat_hash_map</* op_id */ uint64_t, StorageRead> reads ABSL_GUARDED_BY(mu);
+        // Hedged reads with one response received, waiting for the other one
+        absl::flat_hash_map</* op_id */ uint64_t,
+                            std::pair</* storage_id */ uint16_t,
+                                      /* send_timestamp */ int64_t>>
+            finished_hedged_reads ABSL_GUARDED_BY(mu);
+        std::deque</* op_id */ uint64_t> finished_hedged_reads_order ABSL_GUARDED_BY(mu);
+        StorageStatMap storage_stats ABSL_GUARDED_BY(mu);
+        std::vector</* latency_us */ int64_t> read_latency_samples ABSL_GUARDED_BY(mu);
+        size_t next_latency_sample ABSL_GUARDED_BY(mu);
+        size_t new_latency_samples ABSL_GUARDED_BY(mu);
+        int64_t hedged_read_delay_us ABSL_GUARDED_BY(mu);
+    };
+    const float hedged_read_percentile_;
+    const bool enable_hedged_read_;
+    std::vector<std::unique_ptr<StorageReadShard>> storage_read_shards_;
 
     void SetupZKWatchers();
     void SetupTimers();
 
+    void AddToReplicateBatch(ReplicateBatcher* batcher, const View* view,
+                             const protocol::SharedLogMessage& message,
+                             std::span<const uint64_t> user_tags,
+                             std::span<const char> log_data);
+    void SendReplicateBatch(const ReplicateBatch& batch);
+
     void PopulateLogTagsAndData(LocalOp* op, std::span<const char> data);
+    // Returns false if `data` is too short for the tags of the read
+    bool PopulateQueryTags(LocalOp* op, std::span<const char> data);
+
+    // Without `storage_stats`, picks in round-robin
+    uint16_t PickStorageNode(const View::Engine* engine_node,
+                             const StorageStatMap* storage_stats,
+                             std::optional<uint16_t> excluded_storage_id = std::nullopt);
+    StorageReadShard* GetStorageReadShard(uint64_t op_id) {
+        return storage_read_shards_[op_id % kNumStorageReadShards].get();
+    }
+    void RecordStorageReadLatency(StorageReadShard* shard, uint16_t storage_id,
+                                  int64_t latency_us)
+        ABSL_EXCLUSIVE_LOCKS_REQUIRED(shard->mu);
+    void FinishStorageRead(StorageReadShard* shard, uint16_t storage_id)
+        ABSL_EXCLUSIVE_LOCKS_REQUIRED(shard->mu);
+    // Returns false for responses not to deliver: duplicated responses of
+    // hedged reads, and errors while the other replica is outstanding
+    bool OnStorageReadResponse(const protocol::SharedLogMessage& response);
+    void CheckHedgedReads();
+    uint16_t IndexPartitionNode(const View::Sequencer* sequencer_node,
+                                uint32_t user_logspace, uint64_t user_tag) const;
 
     DISALLOW_COPY_AND_ASSIGN(EngineBase);
 };
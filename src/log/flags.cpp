@@ -4,6 +4,13 @@ ABSL_FLAG(int, slog_local_cut_interval_us, 1000, "");
 ABSL_FLAG(int, slog_global_cut_interval_us, 1000, "");
 ABSL_FLAG(size_t, slog_log_space_hash_tokens, 128, "");
 ABSL_FLAG(size_t, slog_num_tail_metalog_entries, 32, "");
+ABSL_FLAG(size_t, slog_metalog_history_window, 4096,
+          "Max number of applied meta logs kept in memory, 0 for unbounded");
+ABSL_FLAG(std::string, slog_metalog_spill_dir, "",
+          "Directory for spilling unacknowledged meta logs out of the window");
+ABSL_FLAG(bool, slog_partition_index, false,
+          "Partition the index by tag across index engine nodes, "
+          "instead of keeping a full replica on each of them");
 
 ABSL_FLAG(bool, slog_enable_statecheck, false, "");
 ABSL_FLAG(int, slog_statecheck_interval_sec, 10, "");
@@ -12,10 +19,94 @@ ABSL_FLAG(bool, slog_engine_force_remote_index, false, "");
 ABSL_FLAG(float, slog_engine_prob_remote_index, 0.0f, "");
 ABSL_FLAG(bool, slog_engine_enable_cache, false, "");
 ABSL_FLAG(int, slog_engine_cache_cap_mb, 1024, "");
+ABSL_FLAG(size_t, slog_engine_cache_partitions, 0,
+          "Number of log cache partitions, each taking an equal share of capacity, "
+          "that user log spaces are hashed into. 0 for one partition per user "
+          "log space");
+ABSL_FLAG(bool, slog_engine_cache_admission, true,
+          "Admit new entries into a full log cache partition only if they are "
+          "accessed more often than the entries they evict");
+ABSL_FLAG(std::string, slog_engine_disk_cache_path, "",
+          "Directory on local disk for the second tier of log cache, "
+          "empty to disable");
+ABSL_FLAG(int, slog_engine_disk_cache_cap_mb, 16384, "");
 ABSL_FLAG(bool, slog_engine_propagate_auxdata, false, "");
+ABSL_FLAG(int, slog_engine_replicate_batch_us, 0,
+          "Window for coalescing REPLICATE messages, 0 to disable");
+ABSL_FLAG(int, slog_engine_replicate_batch_max_bytes, 65536, "");
+ABSL_FLAG(size_t, slog_engine_async_append_history, 65536,
+          "Number of finished async appends kept for resolving localids");
+ABSL_FLAG(bool, slog_engine_tag_summary, true,
+          "Skip finalized views without the queried tag in index lookups");
+ABSL_FLAG(size_t, slog_engine_index_result_cache, 4096,
+          "Max number of cached results of remote index queries, 0 to disable");
+ABSL_FLAG(float, slog_engine_hedged_read_percentile, 0.0f,
+          "Percentile of storage read latency, after which the read is also sent "
+          "to another storage node. 0 to disable hedged reads");
+ABSL_FLAG(int, slog_engine_hedged_read_min_delay_us, 500,
+          "Min delay before sending a hedged storage read");
+ABSL_FLAG(int, slog_engine_prefetch_max_depth, 16,
+          "Max number of logs prefetched into log cache for sequential READ_NEXT, "
+          "0 to disable");
 
 ABSL_FLAG(int, slog_storage_cache_cap_mb, 1024, "");
 ABSL_FLAG(std::string, slog_storage_backend, "rocksdb",
           "rocskdb, tkrzw_hash, tkrzw_tree, or tkrzw_skip");
 ABSL_FLAG(int, slog_storage_bgthread_interval_ms, 1, "");
-ABSL_FLAG(size_t, slog_storage_max_live_entries, 65536, "");
+ABSL_FLAG(int, slog_storage_flush_threads, 1,
+          "Number of background threads persisting log entries, "
+          "each in charge of a partition of log spaces");
+ABSL_FLAG(size_t, slog_storage_flush_trigger_kb, 1024,
+          "Flush a log space without waiting for the timer once its "
+          "unpersisted entries reach this size. 0 to only flush on timer");
+ABSL_FLAG(size_t, slog_storage_max_live_entries_mb, 64,
+          "Capacity in MB of live log entries kept in memory per log space");
+ABSL_FLAG(size_t, slog_storage_max_live_entries, 0,
+          "Deprecated, use slog_storage_max_live_entries_mb. If set, also caps "
+          "the number of live log entries kept in memory per log space");
+ABSL_FLAG(size_t, slog_storage_decoded_cache_entries, 16384,
+          "Capacity of the cache of decoded log entries read from DB. "
+          "0 to disable the cache and read-ahead");
+ABSL_FLAG(size_t, slog_storage_readahead_entries, 64,
+          "Number of entries fetched with one DB scan on sequential reads. "
+          "0 to disable read-ahead");
+ABSL_FLAG(bool, slog_storage_compression, false,
+          "Compress persisted log data with per log space zstd dictionaries");
+ABSL_FLAG(int, slog_storage_zstd_level, 3, "");
+ABSL_FLAG(size_t, slog_storage_zstd_dict_kb, 64, "Max size of zstd dictionaries");
+ABSL_FLAG(size_t, slog_storage_zstd_sample_kb, 4096,
+          "Size of log data sampled for training the dictionary of a log space");
+ABSL_FLAG(bool, slog_storage_persist_aux_data, false,
+          "Persist auxiliary data of logs in the storage backend. Reads "
+          "missing log cache then look up aux data in DB as well");
+ABSL_FLAG(size_t, slog_storage_max_aux_data_size, 65536,
+          "Auxiliary data larger than this is only kept in log cache. "
+          "0 for no limit");
+ABSL_FLAG(std::string, slog_storage_durability, "memory",
+          "When a replicated log counts towards shard progress: memory, "
+          "written (to the journal), or fsync (journal fsynced in groups)");
+ABSL_FLAG(std::string, slog_storage_durability_overrides, "",
+          "Durability of specific user log spaces, "
+          "as comma-separated <user_logspace>:<level>");
+ABSL_FLAG(std::string, slog_storage_journal_path, "",
+          "Directory of the journal for durability above memory, "
+          "<db_path>_journal if empty");
+ABSL_FLAG(bool, slog_storage_disable_wal, false,
+          "Skip DB write-ahead log for logs of memory durability");
+ABSL_FLAG(std::string, slog_storage_archive_path, "",
+          "Directory of segment files archiving cold log entries moved out "
+          "of DB. Empty to disable archiving");
+ABSL_FLAG(int, slog_storage_archive_interval_sec, 60,
+          "Interval of moving cold log entries to the archive");
+ABSL_FLAG(int, slog_storage_archive_age_sec, 3600,
+          "Archive all entries of a log space once finalized for this long");
+ABSL_FLAG(size_t, slog_storage_archive_hot_seqnums, 0,
+          "Archive persisted entries of active log spaces with seqnums more than "
+          "this far below the persisted position. The distance also counts entries "
+          "of other storage shards. 0 to only archive finalized log spaces");
+ABSL_FLAG(size_t, slog_storage_archive_segment_entries, 65536,
+          "Max number of log entries in one archive segment file");
+ABSL_FLAG(size_t, slog_storage_archive_block_kb, 64,
+          "Size of compressed blocks in archive segment files");
+ABSL_FLAG(size_t, slog_storage_archive_max_open_files, 256,
+          "Max number of archive segment files kept open for reads");
@@ -6,6 +6,9 @@ ABSL_DECLARE_FLAG(int, slog_local_cut_interval_us);
 ABSL_DECLARE_FLAG(int, slog_global_cut_interval_us);
 ABSL_DECLARE_FLAG(size_t, slog_log_space_hash_tokens);
 ABSL_DECLARE_FLAG(size_t, slog_num_tail_metalog_entries);
+ABSL_DECLARE_FLAG(size_t, slog_metalog_history_window);
+ABSL_DECLARE_FLAG(std::string, slog_metalog_spill_dir);
+ABSL_DECLARE_FLAG(bool, slog_partition_index);
 
 ABSL_DECLARE_FLAG(bool, slog_enable_statecheck);
 ABSL_DECLARE_FLAG(int, slog_statecheck_interval_sec);
@@ -14,9 +17,43 @@ ABSL_DECLARE_FLAG(bool, slog_engine_force_remote_index);
 ABSL_DECLARE_FLAG(float, slog_engine_prob_remote_index);
 ABSL_DECLARE_FLAG(bool, slog_engine_enable_cache);
 ABSL_DECLARE_FLAG(int, slog_engine_cache_cap_mb);
+ABSL_DECLARE_FLAG(size_t, slog_engine_cache_partitions);
+ABSL_DECLARE_FLAG(bool, slog_engine_cache_admission);
+ABSL_DECLARE_FLAG(std::string, slog_engine_disk_cache_path);
+ABSL_DECLARE_FLAG(int, slog_engine_disk_cache_cap_mb);
 ABSL_DECLARE_FLAG(bool, slog_engine_propagate_auxdata);
+ABSL_DECLARE_FLAG(int, slog_engine_replicate_batch_us);
+ABSL_DECLARE_FLAG(int, slog_engine_replicate_batch_max_bytes);
+ABSL_DECLARE_FLAG(size_t, slog_engine_async_append_history);
+ABSL_DECLARE_FLAG(bool, slog_engine_tag_summary);
+ABSL_DECLARE_FLAG(size_t, slog_engine_index_result_cache);
+ABSL_DECLARE_FLAG(float, slog_engine_hedged_read_percentile);
+ABSL_DECLARE_FLAG(int, slog_engine_hedged_read_min_delay_us);
+ABSL_DECLARE_FLAG(int, slog_engine_prefetch_max_depth);
 
 ABSL_DECLARE_FLAG(int, slog_storage_cache_cap_mb);
 ABSL_DECLARE_FLAG(std::string, slog_storage_backend);
 ABSL_DECLARE_FLAG(int, slog_storage_bgthread_interval_ms);
+ABSL_DECLARE_FLAG(int, slog_storage_flush_threads);
+ABSL_DECLARE_FLAG(size_t, slog_storage_flush_trigger_kb);
+ABSL_DECLARE_FLAG(size_t, slog_storage_max_live_entries_mb);
 ABSL_DECLARE_FLAG(size_t, slog_storage_max_live_entries);
+ABSL_DECLARE_FLAG(bool, slog_storage_persist_aux_data);
+ABSL_DECLARE_FLAG(bool, slog_storage_compression);
+ABSL_DECLARE_FLAG(int, slog_storage_zstd_level);
+ABSL_DECLARE_FLAG(size_t, slog_storage_zstd_dict_kb);
+ABSL_DECLARE_FLAG(size_t, slog_storage_zstd_sample_kb);
+ABSL_DECLARE_FLAG(size_t, slog_storage_decoded_cache_entries);
+ABSL_DECLARE_FLAG(size_t, slog_storage_readahead_entries);
+ABSL_DECLARE_FLAG(size_t, slog_storage_max_aux_data_size);
+ABSL_DECLARE_FLAG(std::string, slog_storage_durability);
+ABSL_DECLARE_FLAG(std::string, slog_storage_durability_overrides);
+ABSL_DECLARE_FLAG(std::string, slog_storage_journal_path);
+ABSL_DECLARE_FLAG(bool, slog_storage_disable_wal);
+ABSL_DECLARE_FLAG(std::string, slog_storage_archive_path);
+ABSL_DECLARE_FLAG(int, slog_storage_archive_interval_sec);
+ABSL_DECLARE_FLAG(int, slog_storage_archive_age_sec);
+ABSL_DECLARE_FLAG(size_t, slog_storage_archive_hot_seqnums);
+ABSL_DECLARE_FLAG(size_t, slog_storage_archive_segment_entries);
+ABSL_DECLARE_FLAG(size_t, slog_storage_archive_block_kb);
+ABSL_DECLARE_FLAG(size_t, slog_storage_archive_max_open_files);
@@ -34,8 +34,11 @@ protocol::SharedLogOpType IndexQuery::DirectionToOpType() const {
 Index::Index(const View* view, uint16_t sequencer_id)
     : LogSpaceBase(LogSpaceBase::kFullMode, view, sequencer_id),
       indexed_metalog_position_(0),
+      received_data_(kInitialReceivedDataSlots),
       data_received_seqnum_position_(0),
-      indexed_seqnum_position_(0) {
+      indexed_seqnum_position_(0),
+      partition_(0),
+      tag_summary_built_(false) {
     log_header_ = fmt::format("LogIndex[{}-{}]: ", view->id(), sequencer_id);
     state_ = kNormal;
 }
@@ -47,12 +50,22 @@ public:
     PerSpaceIndex(uint32_t logspace_id, uint32_t user_logspace);
     ~PerSpaceIndex() {}
 
-    void Add(uint32_t seqnum_lowhalf, uint16_t engine_id, const UserTagVec& user_tags);
+    // Without full_log, only seqnums with tags are tracked
+    void Add(uint32_t seqnum_lowhalf, uint16_t engine_id,
+             const UserTagVec& user_tags, bool full_log);
+
+    bool empty() const { return engine_ids_.empty(); }
+    std::string BuildTagFilter() const;
 
     bool FindPrev(uint64_t query_seqnum, uint64_t user_tag,
                   uint64_t* seqnum, uint16_t* engine_id) const;
     bool FindNext(uint64_t query_seqnum, uint64_t user_tag,
                   uint64_t* seqnum, uint16_t* engine_id) const;
+    // Find the nearest log across all given tags
+    bool FindPrev(uint64_t query_seqnum, const UserTagVec& user_tags,
+                  uint64_t* seqnum, uint16_t* engine_id) const;
+    bool FindNext(uint64_t query_seqnum, const UserTagVec& user_tags,
+                  uint64_t* seqnum, uint16_t* engine_id) const;
 
 private:
     uint32_t logspace_id_;
@@ -75,17 +88,31 @@ Index::PerSpaceIndex::PerSpaceIndex(uint32_t logspace_id, uint32_t user_logspace
       user_logspace_(user_logspace) {}
 
 void Index::PerSpaceIndex::Add(uint32_t seqnum_lowhalf, uint16_t engine_id,
-                               const UserTagVec& user_tags) {
+                               const UserTagVec& user_tags, bool full_log) {
+    if (!full_log && user_tags.empty()) {
+        return;
+    }
     DCHECK(!engine_ids_.contains(seqnum_lowhalf));
     engine_ids_[seqnum_lowhalf] = engine_id;
-    DCHECK(seqnums_.empty() || seqnum_lowhalf > seqnums_.back());
-    seqnums_.push_back(seqnum_lowhalf);
+    if (full_log) {
+        DCHECK(seqnums_.empty() || seqnum_lowhalf > seqnums_.back());
+        seqnums_.push_back(seqnum_lowhalf);
+    }
     for (uint64_t user_tag : user_tags) {
         DCHECK_NE(user_tag, kEmptyLogTag);
         seqnums_by_tag_[user_tag].push_back(seqnum_lowhalf);
     }
 }
 
+std::string Index::PerSpaceIndex::BuildTagFilter() const {
+    std::vector<uint64_t> user_tags;
+    user_tags.reserve(seqnums_by_tag_.size());
+    for (const auto& [user_tag, _] : seqnums_by_tag_) {
+        user_tags.push_back(user_tag);
+    }
+    return log_utils::BuildTagFilter(VECTOR_AS_SPAN(user_tags));
+}
+
 bool Index::PerSpaceIndex::FindPrev(uint64_t query_seqnum, uint64_t user_tag,
                                     uint64_t* seqnum, uint16_t* engine_id) const {
     uint32_t seqnum_lowhalf;
@@ -130,6 +157,46 @@ bool Index::PerSpaceIndex::FindNext(uint64_t query_seqnum, uint64_t user_tag,
     return true;
 }
 
+bool Index::PerSpaceIndex::FindPrev(uint64_t query_seqnum, const UserTagVec& user_tags,
+                                    uint64_t* seqnum, uint16_t* engine_id) const {
+    // Merge heads of per-tag seqnum lists, keeping the largest one
+    bool found = false;
+    for (uint64_t user_tag : user_tags) {
+        uint64_t tag_seqnum;
+        uint16_t tag_engine_id;
+        if (FindPrev(query_seqnum, user_tag, &tag_seqnum, &tag_engine_id)
+                && (!found || tag_seqnum > *seqnum)) {
+            found = true;
+            *seqnum = tag_seqnum;
+            *engine_id = tag_engine_id;
+            if (tag_seqnum == query_seqnum) {
+                break;
+            }
+        }
+    }
+    return found;
+}
+
+bool Index::PerSpaceIndex::FindNext(uint64_t query_seqnum, const UserTagVec& user_tags,
+                                    uint64_t* seqnum, uint16_t* engine_id) const {
+    // Merge heads of per-tag seqnum lists, keeping the smallest one
+    bool found = false;
+    for (uint64_t user_tag : user_tags) {
+        uint64_t tag_seqnum;
+        uint16_t tag_engine_id;
+        if (FindNext(query_seqnum, user_tag, &tag_seqnum, &tag_engine_id)
+                && (!found || tag_seqnum < *seqnum)) {
+            found = true;
+            *seqnum = tag_seqnum;
+            *engine_id = tag_engine_id;
+            if (tag_seqnum == query_seqnum) {
+                break;
+            }
+        }
+    }
+    return found;
+}
+
 bool Index::PerSpaceIndex::FindPrev(const std::vector<uint32_t>& seqnums,
                                     uint64_t query_seqnum, uint32_t* result_seqnum) const {
     if (seqnums.empty() || bits::JoinTwo32(logspace_id_, seqnums.front()) > query_seqnum) {
@@ -180,38 +247,77 @@ void Index::ProvideIndexData(const IndexDataProto& index_data) {
     DCHECK_EQ(n, index_data.user_tag_sizes_size());
     uint32_t total_tags = absl::c_accumulate(index_data.user_tag_sizes(), 0U);
     DCHECK_EQ(static_cast<int>(total_tags), index_data.user_tags_size());
+    DCHECK_EQ(index_data.cond_entries_size(), index_data.cond_tail_seqnums_size());
+    partition_ = index_data.partition();
     auto tag_iter = index_data.user_tags().begin();
+    int cond_idx = 0;
     for (int i = 0; i < n; i++) {
+        bool cond_append = false;
+        uint64_t cond_tail_seqnum = kInvalidLogSeqNum;
+        if (cond_idx < index_data.cond_entries_size()
+                && index_data.cond_entries(cond_idx) == static_cast<uint32_t>(i)) {
+            cond_append = true;
+            cond_tail_seqnum = index_data.cond_tail_seqnums(cond_idx);
+            cond_idx++;
+        }
         size_t num_tags = index_data.user_tag_sizes(i);
         uint32_t seqnum = index_data.seqnum_halves(i);
         if (seqnum < indexed_seqnum_position_) {
             tag_iter += num_tags;
             continue;
         }
-        if (received_data_.count(seqnum) == 0) {
-            received_data_[seqnum] = IndexData {
-                .engine_id     = gsl::narrow_cast<uint16_t>(index_data.engine_ids(i)),
-                .user_logspace = index_data.user_logspaces(i),
-                .user_tags     = UserTagVec(tag_iter, tag_iter + num_tags)
-            };
+        if (seqnum - indexed_seqnum_position_ >= received_data_.size()) {
+            GrowReceivedData(seqnum);
+        }
+        IndexData* slot = ReceivedDataSlot(seqnum);
+        if (!slot->received) {
+            slot->received = true;
+            slot->engine_id = gsl::narrow_cast<uint16_t>(index_data.engine_ids(i));
+            slot->user_logspace = index_data.user_logspaces(i);
+            slot->user_tags.assign(tag_iter, tag_iter + num_tags);
+            slot->cond_append = cond_append;
+            slot->cond_tail_seqnum = cond_tail_seqnum;
         } else {
 #if DCHECK_IS_ON()
-            const IndexData& data = received_data_[seqnum];
+            const IndexData& data = *slot;
             DCHECK_EQ(data.engine_id,
                       gsl::narrow_cast<uint16_t>(index_data.engine_ids(i)));
             DCHECK_EQ(data.user_logspace, index_data.user_logspaces(i));
             DCHECK_EQ(data.user_tags.size(),
                       gsl::narrow_cast<size_t>(index_data.user_tag_sizes(i)));
+            DCHECK_EQ(data.cond_append, cond_append);
 #endif
         }
         tag_iter += num_tags;
     }
-    while (received_data_.count(data_received_seqnum_position_) > 0) {
+    while (data_received_seqnum_position_ - indexed_seqnum_position_ < received_data_.size()
+             && ReceivedDataSlot(data_received_seqnum_position_)->received) {
         data_received_seqnum_position_++;
     }
     AdvanceIndexProgress();
 }
 
+Index::IndexData* Index::ReceivedDataSlot(uint32_t seqnum) {
+    DCHECK_GE(seqnum, indexed_seqnum_position_);
+    DCHECK_LT(seqnum - indexed_seqnum_position_, received_data_.size());
+    return &received_data_[seqnum % received_data_.size()];
+}
+
+void Index::GrowReceivedData(uint32_t seqnum) {
+    size_t new_size = received_data_.size();
+    while (seqnum - indexed_seqnum_position_ >= new_size) {
+        new_size *= 2;
+    }
+    HVLOG_F(1, "Grow reorder buffer of index data to {} slots", new_size);
+    std::vector<IndexData> new_data(new_size);
+    for (size_t i = 0; i < received_data_.size(); i++) {
+        uint32_t slot_seqnum = indexed_seqnum_position_ + static_cast<uint32_t>(i);
+        std::swap(new_data[slot_seqnum % new_size],
+                  received_data_[slot_seqnum % received_data_.size()]);
+    }
+    received_data_ = std::move(new_data);
+}
+
 void Index::MakeQuery(const IndexQuery& query) {
     if (query.initial) {
         HVLOG(1) << "Receive initial query";
@@ -255,14 +361,41 @@ void Index::PollQueryResults(QueryResultVec* results) {
     pending_query_results_.clear();
 }
 
-void Index::OnMetaLogApplied(const MetaLogProto& meta_log_proto) {
-    if (meta_log_proto.type() == MetaLogProto::NEW_LOGS) {
-        const auto& new_logs_proto = meta_log_proto.new_logs_proto();
-        uint32_t seqnum = new_logs_proto.start_seqnum();
-        for (uint32_t delta : new_logs_proto.shard_deltas()) {
-            seqnum += delta;
+void Index::WatchTag(uint32_t user_logspace, uint64_t user_tag) {
+    tag_watches_.insert(TagWatch(user_logspace, user_tag));
+}
+
+void Index::PollFiredTagWatches(TagWatchVec* watches) {
+    if (fired_tag_watches_.empty()) {
+        return;
+    }
+    watches->insert(watches->end(), fired_tag_watches_.begin(), fired_tag_watches_.end());
+    fired_tag_watches_.clear();
+}
+
+std::optional<TagSummaryProto> Index::PollTagSummary() {
+    if (tag_summary_built_ || !finalized() || !cuts_.empty()) {
+        return std::nullopt;
+    }
+    tag_summary_built_ = true;
+    TagSummaryProto summary;
+    summary.set_logspace_id(identifier());
+    summary.set_partition(partition_);
+    for (const auto& [user_logspace, index] : index_) {
+        if (index->empty()) {
+            continue;
         }
-        cuts_.push_back(std::make_pair(meta_log_proto.metalog_seqnum(), seqnum));
+        summary.add_user_logspaces(user_logspace);
+        summary.add_tag_filters(index->BuildTagFilter());
+    }
+    HVLOG_F(1, "Tag summary built for {} user logspaces", summary.user_logspaces_size());
+    return summary;
+}
+
+void Index::OnMetaLogApplied(uint32_t metalog_seqnum, MetaLogProto::Type type) {
+    if (type == MetaLogProto::NEW_LOGS) {
+        // Seqnum position is already advanced to the end of this cut
+        cuts_.push_back(std::make_pair(metalog_seqnum, bits::LowHalf64(seqnum_position())));
     }
     AdvanceIndexProgress();
 }
@@ -284,18 +417,20 @@ void Index::AdvanceIndexProgress() {
             break;
         }
         HVLOG_F(1, "Apply IndexData until seqnum {}", bits::HexStr0x(end_seqnum));
-        auto iter = received_data_.begin();
-        while (iter != received_data_.end()) {
-            uint32_t seqnum = iter->first;
-            if (seqnum >= end_seqnum) {
-                break;
+        DCHECK_GT(end_seqnum, indexed_seqnum_position_);
+        for (uint32_t seqnum = indexed_seqnum_position_; seqnum < end_seqnum; seqnum++) {
+            IndexData* index_data = ReceivedDataSlot(seqnum);
+            DCHECK(index_data->received);
+            PerSpaceIndex* index = GetOrCreateIndex(index_data->user_logspace);
+            if (!index_data->cond_append || CheckCondAppend(index, seqnum, *index_data)) {
+                index->Add(seqnum, index_data->engine_id, index_data->user_tags,
+                           /* full_log= */ partition_ == 0);
+                if (!tag_watches_.empty()) {
+                    FireTagWatches(*index_data);
+                }
             }
-            const IndexData& index_data = iter->second;
-            GetOrCreateIndex(index_data.user_logspace)->Add(
-                seqnum, index_data.engine_id, index_data.user_tags);
-            iter = received_data_.erase(iter);
+            index_data->received = false;
         }
-        DCHECK_GT(end_seqnum, indexed_seqnum_position_);
         indexed_seqnum_position_ = end_seqnum;
         uint32_t metalog_seqnum = cuts_.front().first;
         indexed_metalog_position_ = metalog_seqnum + 1;
@@ -305,7 +440,9 @@ void Index::AdvanceIndexProgress() {
         int64_t current_timestamp = GetMonotonicMicroTimestamp();
         std::vector<std::pair<int64_t, IndexQuery>> unfinished;
         for (const auto& [start_timestamp, query] : blocking_reads_) {
-            if (!ProcessBlockingQuery(query)) {
+            if (auto result = ProcessBlockingQuery(query); result.has_value()) {
+                pending_query_results_.push_back(std::move(*result));
+            } else {
                 if (current_timestamp - start_timestamp
                         < absl::ToInt64Microseconds(kBlockingQueryTimeout)) {
                     unfinished.push_back(std::make_pair(start_timestamp, query));
@@ -337,127 +474,193 @@ Index::PerSpaceIndex* Index::GetOrCreateIndex(uint32_t user_logspace) {
     return index;
 }
 
+void Index::FireTagWatches(const IndexData& index_data) {
+    auto fire = [this, &index_data] (uint64_t user_tag) {
+        auto iter = tag_watches_.find(TagWatch(index_data.user_logspace, user_tag));
+        if (iter != tag_watches_.end()) {
+            fired_tag_watches_.push_back(*iter);
+            tag_watches_.erase(iter);
+        }
+    };
+    if (partition_ == 0) {
+        fire(kEmptyLogTag);
+    }
+    for (uint64_t user_tag : index_data.user_tags) {
+        fire(user_tag);
+    }
+}
+
+bool Index::CheckCondAppend(PerSpaceIndex* index, uint32_t seqnum,
+                            const IndexData& index_data) {
+    DCHECK(index_data.cond_append);
+    DCHECK(!index_data.user_tags.empty());
+    uint64_t cond_tag = index_data.user_tags.at(0);
+    uint64_t expected = index_data.cond_tail_seqnum;
+    uint64_t tail_seqnum;
+    uint16_t engine_id;
+    bool success;
+    if (index->FindPrev(kMaxLogSeqNum, cond_tag, &tail_seqnum, &engine_id)) {
+        success = (tail_seqnum == expected);
+    } else if (view_->id() == 0) {
+        success = (expected == kInvalidLogSeqNum);
+    } else {
+        // No entry of the tag in this view. Tails from previous views cannot
+        // be checked here, and must be verified by the appending engine.
+        success = (expected == log_utils::CondAnchorSeqNum(view_->id()));
+    }
+    HVLOG_F(1, "Conditional append (seqnum={}, tag={}, expected_tail={}) {}",
+            bits::HexStr0x(bits::JoinTwo32(identifier(), seqnum)), cond_tag,
+            bits::HexStr0x(expected), success ? "succeeded" : "failed");
+    return success;
+}
+
+bool Index::IsQueryReady(const IndexQuery& query) const {
+    if (!query.initial) {
+        return finalized();
+    }
+    uint16_t view_id = log_utils::GetViewId(query.metalog_progress);
+    if (view_id != view_->id()) {
+        return view_id < view_->id();
+    }
+    return bits::LowHalf64(query.metalog_progress) <= indexed_metalog_position_;
+}
+
+std::optional<IndexQueryResult> Index::TryProcessQuery(const IndexQuery& query) const {
+    if (!IsQueryReady(query)) {
+        return std::nullopt;
+    }
+    switch (query.direction) {
+    case IndexQuery::kReadNextB:
+        return ProcessBlockingQuery(query);
+    case IndexQuery::kReadNext:
+        return ProcessReadNext(query);
+    case IndexQuery::kReadPrev:
+        return ProcessReadPrev(query);
+    default:
+        UNREACHABLE();
+    }
+}
+
 void Index::ProcessQuery(const IndexQuery& query) {
     if (query.direction == IndexQuery::kReadNextB) {
-        bool success = ProcessBlockingQuery(query);
-        if (!success) {
+        if (auto result = ProcessBlockingQuery(query); result.has_value()) {
+            pending_query_results_.push_back(std::move(*result));
+        } else {
             blocking_reads_.push_back(std::make_pair(GetMonotonicMicroTimestamp(), query));
         }
     } else if (query.direction == IndexQuery::kReadNext) {
-        ProcessReadNext(query);
+        pending_query_results_.push_back(ProcessReadNext(query));
     } else if (query.direction == IndexQuery::kReadPrev) {
-        ProcessReadPrev(query);
+        pending_query_results_.push_back(ProcessReadPrev(query));
     }
 }
 
-void Index::ProcessReadNext(const IndexQuery& query) {
+IndexQueryResult Index::ProcessReadNext(const IndexQuery& query) const {
     DCHECK(query.direction == IndexQuery::kReadNext);
     HVLOG_F(1, "ProcessReadNext: seqnum={}, logspace={}, tag={}",
             bits::HexStr0x(query.query_seqnum), query.user_logspace, query.user_tag);
     uint16_t query_view_id = log_utils::GetViewId(query.query_seqnum);
     if (query_view_id > view_->id()) {
-        pending_query_results_.push_back(BuildNotFoundResult(query));
         HVLOG(1) << "ProcessReadNext: NotFoundResult";
-        return;
+        return BuildNotFoundResult(query);
     }
     uint64_t seqnum;
     uint16_t engine_id;
     bool found = IndexFindNext(query, &seqnum, &engine_id);
     if (query_view_id == view_->id()) {
         if (found) {
-            pending_query_results_.push_back(
-                BuildFoundResult(query, view_->id(), seqnum, engine_id));
             HVLOG_F(1, "ProcessReadNext: FoundResult: seqnum={}", seqnum);
+            return BuildFoundResult(query, view_->id(), seqnum, engine_id);
         } else {
             if (query.prev_found_result.seqnum != kInvalidLogSeqNum) {
                 const IndexFoundResult& found_result = query.prev_found_result;
-                pending_query_results_.push_back(
-                    BuildFoundResult(query, found_result.view_id,
-                                     found_result.seqnum, found_result.engine_id));
                 HVLOG_F(1, "ProcessReadNext: FoundResult (from prev_result): seqnum={}",
                         found_result.seqnum);
+                return BuildFoundResult(query, found_result.view_id,
+                                        found_result.seqnum, found_result.engine_id);
             } else {
-                pending_query_results_.push_back(BuildNotFoundResult(query));
                 HVLOG(1) << "ProcessReadNext: NotFoundResult";
+                return BuildNotFoundResult(query);
             }
         }
     } else {
-        pending_query_results_.push_back(
-            BuildContinueResult(query, found, seqnum, engine_id));
         HVLOG(1) << "ProcessReadNext: ContinueResult";
+        return BuildContinueResult(query, found, seqnum, engine_id);
     }
 }
 
-void Index::ProcessReadPrev(const IndexQuery& query) {
+IndexQueryResult Index::ProcessReadPrev(const IndexQuery& query) const {
     DCHECK(query.direction == IndexQuery::kReadPrev);
     HVLOG_F(1, "ProcessReadPrev: seqnum={}, logspace={}, tag={}",
             bits::HexStr0x(query.query_seqnum), query.user_logspace, query.user_tag);
     uint16_t query_view_id = log_utils::GetViewId(query.query_seqnum);
     if (query_view_id < view_->id()) {
-        pending_query_results_.push_back(BuildContinueResult(query, false, 0, 0));
         HVLOG(1) << "ProcessReadPrev: ContinueResult";
-        return;
+        return BuildContinueResult(query, false, 0, 0);
     }
     uint64_t seqnum;
     uint16_t engine_id;
     bool found = IndexFindPrev(query, &seqnum, &engine_id);
     if (found) {
-        pending_query_results_.push_back(
-            BuildFoundResult(query, view_->id(), seqnum, engine_id));
         HVLOG_F(1, "ProcessReadPrev: FoundResult: seqnum={}", seqnum);
-    } else if (view_->id() > 0) {
-        pending_query_results_.push_back(BuildContinueResult(query, false, 0, 0));
+        return BuildFoundResult(query, view_->id(), seqnum, engine_id);
+    } else if (view_->id() > 0 && !query.cond_check) {
         HVLOG(1) << "ProcessReadPrev: ContinueResult";
+        return BuildContinueResult(query, false, 0, 0);
     } else {
-        pending_query_results_.push_back(BuildNotFoundResult(query));
         HVLOG(1) << "ProcessReadPrev: NotFoundResult";
+        return BuildNotFoundResult(query);
     }
 }
 
-bool Index::ProcessBlockingQuery(const IndexQuery& query) {
+std::optional<IndexQueryResult> Index::ProcessBlockingQuery(const IndexQuery& query) const {
     DCHECK(query.direction == IndexQuery::kReadNextB && query.initial);
     uint16_t query_view_id = log_utils::GetViewId(query.query_seqnum);
     if (query_view_id > view_->id()) {
-        pending_query_results_.push_back(BuildNotFoundResult(query));
-        return true;
+        return BuildNotFoundResult(query);
     }
     uint64_t seqnum;
     uint16_t engine_id;
     bool found = IndexFindNext(query, &seqnum, &engine_id);
     if (query_view_id == view_->id()) {
         if (found) {
-            pending_query_results_.push_back(
-                BuildFoundResult(query, view_->id(), seqnum, engine_id));
+            return BuildFoundResult(query, view_->id(), seqnum, engine_id);
         }
-        return found;
+        return std::nullopt;
     } else {
-        pending_query_results_.push_back(
-            BuildContinueResult(query, found, seqnum, engine_id));
-        return true;
+        return BuildContinueResult(query, found, seqnum, engine_id);
     }
 }
 
-bool Index::IndexFindNext(const IndexQuery& query, uint64_t* seqnum, uint16_t* engine_id) {
+bool Index::IndexFindNext(const IndexQuery& query,
+                          uint64_t* seqnum, uint16_t* engine_id) const {
     DCHECK(query.direction == IndexQuery::kReadNext
             || query.direction == IndexQuery::kReadNextB);
     if (!index_.contains(query.user_logspace)) {
         return false;
     }
-    return GetOrCreateIndex(query.user_logspace)->FindNext(
-        query.query_seqnum, query.user_tag, seqnum, engine_id);
+    const PerSpaceIndex* index = index_.at(query.user_logspace).get();
+    if (!query.user_tags.empty()) {
+        return index->FindNext(query.query_seqnum, query.user_tags, seqnum, engine_id);
+    }
+    return index->FindNext(query.query_seqnum, query.user_tag, seqnum, engine_id);
 }
 
-bool Index::IndexFindPrev(const IndexQuery& query, uint64_t* seqnum, uint16_t* engine_id) {
+bool Index::IndexFindPrev(const IndexQuery& query,
+                          uint64_t* seqnum, uint16_t* engine_id) const {
     DCHECK(query.direction == IndexQuery::kReadPrev);
     if (!index_.contains(query.user_logspace)) {
         return false;
     }
-    return GetOrCreateIndex(query.user_logspace)->FindPrev(
-        query.query_seqnum, query.user_tag, seqnum, engine_id);
+    const PerSpaceIndex* index = index_.at(query.user_logspace).get();
+    if (!query.user_tags.empty()) {
+        return index->FindPrev(query.query_seqnum, query.user_tags, seqnum, engine_id);
+    }
+    return index->FindPrev(query.query_seqnum, query.user_tag, seqnum, engine_id);
 }
 
 IndexQueryResult Index::BuildFoundResult(const IndexQuery& query, uint16_t view_id,
-                                         uint64_t seqnum, uint16_t engine_id) {
+                                         uint64_t seqnum, uint16_t engine_id) const {
     return IndexQueryResult {
         .state = IndexQueryResult::kFound,
         .metalog_progress = query.initial ? index_metalog_progress()
@@ -472,7 +675,7 @@ IndexQueryResult Index::BuildFoundResult(const IndexQuery& query, uint16_t view_
     };
 }
 
-IndexQueryResult Index::BuildNotFoundResult(const IndexQuery& query) {
+IndexQueryResult Index::BuildNotFoundResult(const IndexQuery& query) const {
     return IndexQueryResult {
         .state = IndexQueryResult::kEmpty,
         .metalog_progress = query.initial ? index_metalog_progress()
@@ -488,7 +691,7 @@ IndexQueryResult Index::BuildNotFoundResult(const IndexQuery& query) {
 }
 
 IndexQueryResult Index::BuildContinueResult(const IndexQuery& query, bool found,
-                                            uint64_t seqnum, uint16_t engine_id) {
+                                            uint64_t seqnum, uint16_t engine_id) const {
     DCHECK(view_->id() > 0);
     IndexQueryResult result = {
         .state = IndexQueryResult::kContinue,
@@ -17,10 +17,16 @@ struct IndexQuery {
     uint16_t origin_node_id;
     uint16_t hop_times;
     bool     initial;
+    bool     cond_check;  // Check the result of a conditional append
+    bool     seqnum_only; // Log data is not needed, for local queries only
+    bool     no_cache;    // Read does not fill log cache, for local queries only
     uint64_t client_data;
 
     uint32_t user_logspace;
     uint64_t user_tag;
+    // Tag set of multi-tag queries, matching logs with any of the tags.
+    // user_tag is set to the first tag, which decides the index partition
+    UserTagVec user_tags;
     uint64_t query_seqnum;
     uint64_t metalog_progress;
 
@@ -50,10 +56,24 @@ public:
     void ProvideIndexData(const IndexDataProto& index_data);
 
     void MakeQuery(const IndexQuery& query);
+    // Read-only path of MakeQuery, safe under shared access. Returns nullopt
+    // if the query cannot be answered yet, which needs MakeQuery to queue it
+    std::optional<IndexQueryResult> TryProcessQuery(const IndexQuery& query) const;
 
     using QueryResultVec = absl::InlinedVector<IndexQueryResult, 4>;
     void PollQueryResults(QueryResultVec* results);
 
+    // One-shot watch on a tag, fired once a log with the tag gets indexed.
+    // kEmptyLogTag watches all logs of user_logspace
+    using TagWatch = std::pair</* user_logspace */ uint32_t, /* user_tag */ uint64_t>;
+    using TagWatchVec = absl::InlinedVector<TagWatch, 4>;
+    void WatchTag(uint32_t user_logspace, uint64_t user_tag);
+    void PollFiredTagWatches(TagWatchVec* watches);
+
+    // Returns the summary of tags once, after the index is finalized
+    // and all index data is applied
+    std::optional<TagSummaryProto> PollTagSummary();
+
 private:
     class PerSpaceIndex;
     absl::flat_hash_map</* user_logspace */ uint32_t,
@@ -67,41 +87,60 @@ private:
                           IndexQuery>> blocking_reads_;
     QueryResultVec pending_query_results_;
 
+    absl::flat_hash_set<TagWatch> tag_watches_;
+    TagWatchVec fired_tag_watches_;
+
     std::deque<std::pair</* metalog_seqnum */ uint32_t,
                          /* end_seqnum */ uint32_t>> cuts_;
     uint32_t indexed_metalog_position_;
 
     struct IndexData {
+        bool       received;
         uint16_t   engine_id;
         uint32_t   user_logspace;
         UserTagVec user_tags;
+        bool       cond_append;
+        uint64_t   cond_tail_seqnum;
     };
-    std::map</* seqnum */ uint32_t, IndexData> received_data_;
+    // Reorder buffer of received index data, as a ring indexed by seqnum
+    // starting from indexed_seqnum_position_. Slots are reused, so tag
+    // storage of previous entries is kept for new ones.
+    static constexpr size_t kInitialReceivedDataSlots = 1024;
+    std::vector<IndexData> received_data_;
     uint32_t data_received_seqnum_position_;
     uint32_t indexed_seqnum_position_;
+    // Set if the index is partitioned by tag, where partition 0 also
+    // serves full-log queries
+    uint32_t partition_;
+    bool tag_summary_built_;
 
     uint64_t index_metalog_progress() const {
         return bits::JoinTwo32(identifier(), indexed_metalog_position_);
     }
 
-    void OnMetaLogApplied(const MetaLogProto& meta_log_proto) override;
+    void OnMetaLogApplied(uint32_t metalog_seqnum, MetaLogProto::Type type) override;
     void OnFinalized(uint32_t metalog_position) override;
     void AdvanceIndexProgress();
     PerSpaceIndex* GetOrCreateIndex(uint32_t user_logspace);
+    bool CheckCondAppend(PerSpaceIndex* index, uint32_t seqnum, const IndexData& index_data);
+    void FireTagWatches(const IndexData& index_data);
+    IndexData* ReceivedDataSlot(uint32_t seqnum);
+    void GrowReceivedData(uint32_t seqnum);
 
+    bool IsQueryReady(const IndexQuery& query) const;
     void ProcessQuery(const IndexQuery& query);
-    void ProcessReadNext(const IndexQuery& query);
-    void ProcessReadPrev(const IndexQuery& query);
-    bool ProcessBlockingQuery(const IndexQuery& query);
+    IndexQueryResult ProcessReadNext(const IndexQuery& query) const;
+    IndexQueryResult ProcessReadPrev(const IndexQuery& query) const;
+    std::optional<IndexQueryResult> ProcessBlockingQuery(const IndexQuery& query) const;
 
-    bool IndexFindNext(const IndexQuery& query, uint64_t* seqnum, uint16_t* engine_id);
-    bool IndexFindPrev(const IndexQuery& query, uint64_t* seqnum, uint16_t* engine_id);
+    bool IndexFindNext(const IndexQuery& query, uint64_t* seqnum, uint16_t* engine_id) const;
+    bool IndexFindPrev(const IndexQuery& query, uint64_t* seqnum, uint16_t* engine_id) const;
 
     IndexQueryResult BuildFoundResult(const IndexQuery& query, uint16_t view_id,
-                                      uint64_t seqnum, uint16_t engine_id);
-    IndexQueryResult BuildNotFoundResult(const IndexQuery& query);
+                                      uint64_t seqnum, uint16_t engine_id) const;
+    IndexQueryResult BuildNotFoundResult(const IndexQuery& query) const;
     IndexQueryResult BuildContinueResult(const IndexQuery& query, bool found,
-                                         uint64_t seqnum, uint16_t engine_id);
+                                         uint64_t seqnum, uint16_t engine_id) const;
 
     DISALLOW_COPY_AND_ASSIGN(Index);
 };
@@ -0,0 +1,384 @@
+#include "log/journal.h"
+
+#include "common/time.h"
+#include "utils/fs.h"
+
+#include <dirent.h>
+
+#define log_header_ "LogJournal: "
+
+namespace faas {
+namespace log {
+
+bool ParseDurabilityLevel(std::string_view str, DurabilityLevel* level) {
+    if (str == "memory") {
+        *level = DurabilityLevel::kMemory;
+    } else if (str == "written") {
+        *level = DurabilityLevel::kWritten;
+    } else if (str == "fsync") {
+        *level = DurabilityLevel::kFsync;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::string_view DurabilityLevelName(DurabilityLevel level) {
+    switch (level) {
+    case DurabilityLevel::kMemory:
+        return "memory";
+    case DurabilityLevel::kWritten:
+        return "written";
+    case DurabilityLevel::kFsync:
+        return "fsync";
+    default:
+        UNREACHABLE();
+    }
+}
+
+namespace {
+static constexpr uint32_t kRecordMagic = 0x4a524e4c;  // "JRNL"
+
+struct RecordHeader {
+    uint32_t magic;
+    uint32_t logspace_id;
+    uint32_t size;  // Of LogMetaData, tags and data following the header
+};
+
+static constexpr std::string_view kSegmentPrefix = "segment_";
+}  // namespace
+
+LogJournal::LogJournal(std::string_view dir_path, size_t segment_size, DurableCallback cb)
+    : dir_path_(dir_path),
+      segment_size_(segment_size),
+      durable_cb_(std::move(cb)),
+      stopping_(false),
+      pending_sync_(false),
+      next_segment_id_(0),
+      current_fd_(-1),
+      current_size_(0),
+      num_groups_(0),
+      num_entries_(0),
+      num_fsyncs_(0),
+      fsync_time_us_(0),
+      journal_thread_("Journal", [this] { this->JournalThreadMain(); }) {
+    DCHECK_GT(segment_size, 0U);
+}
+
+LogJournal::~LogJournal() {}
+
+void LogJournal::Start() {
+    if (!fs_utils::IsDirectory(dir_path_)) {
+        CHECK(fs_utils::MakeDirectory(dir_path_))
+            << "Failed to create journal directory " << dir_path_;
+    }
+    // Segments left by previous runs are kept for recovery, new segments
+    // follow them
+    std::vector<uint32_t> old_segment_ids;
+    DIR* dir = opendir(dir_path_.c_str());
+    PCHECK(dir != nullptr) << "Failed to open journal directory " << dir_path_;
+    while (struct dirent* entry = readdir(dir)) {
+        std::string_view name(entry->d_name);
+        uint32_t id;
+        if (absl::StartsWith(name, kSegmentPrefix)
+                && absl::SimpleAtoi(name.substr(kSegmentPrefix.size()), &id)) {
+            old_segment_ids.push_back(id);
+        }
+    }
+    closedir(dir);
+    std::sort(old_segment_ids.begin(), old_segment_ids.end());
+    if (!old_segment_ids.empty()) {
+        HLOG_F(INFO, "{} segments left by previous runs in {}",
+               old_segment_ids.size(), dir_path_);
+        absl::MutexLock lk(&index_mu_);
+        for (uint32_t id : old_segment_ids) {
+            segments_.push_back(Segment {
+                .id = id,
+                .path = fs_utils::JoinPath(
+                    dir_path_, fmt::format("{}{}", kSegmentPrefix, id)),
+                .num_live_entries = 0
+            });
+        }
+        next_segment_id_ = old_segment_ids.back() + 1;
+    }
+    CHECK(NewSegment());
+    journal_thread_.Start();
+}
+
+void LogJournal::Stop() {
+    {
+        absl::MutexLock lk(&mu_);
+        stopping_ = true;
+        cv_.Signal();
+    }
+    journal_thread_.Join();
+    if (current_fd_ != -1) {
+        PCHECK(close(current_fd_) == 0) << "Failed to close segment file";
+        current_fd_ = -1;
+    }
+}
+
+void LogJournal::Recover(const RecoverCallback& cb) {
+    std::vector<Segment> old_segments;
+    {
+        absl::MutexLock lk(&index_mu_);
+        DCHECK(!segments_.empty());
+        old_segments.assign(segments_.begin(), segments_.end() - 1);
+    }
+    size_t num_entries = 0;
+    for (const Segment& segment : old_segments) {
+        num_entries += RecoverSegment(segment, cb);
+    }
+    if (!old_segments.empty()) {
+        HLOG_F(INFO, "Recovered {} entries from {} segments",
+               num_entries, old_segments.size());
+    }
+    // Segments without entries need no DB sync before removal
+    ReclaimSegments();
+}
+
+size_t LogJournal::RecoverSegment(const Segment& segment, const RecoverCallback& cb) {
+    std::string contents;
+    if (!fs_utils::ReadContents(segment.path, &contents)) {
+        HLOG_F(ERROR, "Failed to read segment file {}", segment.path);
+        return 0;
+    }
+    std::span<const char> data = STRING_AS_SPAN(contents);
+    EntryKeyVec entries;
+    while (data.size() >= sizeof(RecordHeader)) {
+        RecordHeader header;
+        memcpy(&header, data.data(), sizeof(RecordHeader));
+        if (header.magic != kRecordMagic || header.size < sizeof(LogMetaData)
+                || data.size() < sizeof(RecordHeader) + header.size) {
+            break;
+        }
+        std::span<const char> record = data.subspan(sizeof(RecordHeader), header.size);
+        LogMetaData metadata;
+        memcpy(&metadata, record.data(), sizeof(LogMetaData));
+        size_t tags_size = metadata.num_tags * sizeof(uint64_t);
+        if (sizeof(LogMetaData) + tags_size + metadata.data_size != header.size) {
+            break;
+        }
+        UserTagVec user_tags(metadata.num_tags);
+        memcpy(user_tags.data(), record.data() + sizeof(LogMetaData), tags_size);
+        cb(header.logspace_id, metadata, VECTOR_AS_SPAN(user_tags),
+           record.subspan(sizeof(LogMetaData) + tags_size));
+        entries.emplace_back(header.logspace_id, metadata.localid);
+        data = data.subspan(sizeof(RecordHeader) + header.size);
+    }
+    if (!data.empty()) {
+        // Torn write of the last group before crash
+        HLOG_F(WARNING, "Ignore {} trailing bytes of segment file {}",
+               data.size(), segment.path);
+    }
+    absl::MutexLock lk(&index_mu_);
+    for (Segment& item : segments_) {
+        if (item.id == segment.id) {
+            for (const EntryKey& key : entries) {
+                entry_segments_[key] = item.id;
+            }
+            item.num_live_entries += entries.size();
+            break;
+        }
+    }
+    return entries.size();
+}
+
+void LogJournal::Append(uint32_t logspace_id, const LogMetaData& log_metadata,
+                        std::span<const uint64_t> user_tags, std::span<const char> log_data,
+                        bool sync) {
+    DCHECK_EQ(log_metadata.num_tags, user_tags.size());
+    DCHECK_EQ(log_metadata.data_size, log_data.size());
+    RecordHeader header = {
+        .magic = kRecordMagic,
+        .logspace_id = logspace_id,
+        .size = gsl::narrow_cast<uint32_t>(
+            sizeof(LogMetaData) + user_tags.size_bytes() + log_data.size())
+    };
+    absl::MutexLock lk(&mu_);
+    pending_buf_.append(reinterpret_cast<const char*>(&header), sizeof(RecordHeader));
+    pending_buf_.append(reinterpret_cast<const char*>(&log_metadata), sizeof(LogMetaData));
+    pending_buf_.append(reinterpret_cast<const char*>(user_tags.data()),
+                        user_tags.size_bytes());
+    pending_buf_.append(log_data.data(), log_data.size());
+    pending_entries_.emplace_back(logspace_id, log_metadata.localid);
+    pending_sync_ |= sync;
+    cv_.Signal();
+}
+
+void LogJournal::Release(const EntryKey& key) {
+    Release(std::span<const EntryKey>(&key, 1));
+}
+
+void LogJournal::Release(std::span<const EntryKey> keys) {
+    absl::MutexLock lk(&index_mu_);
+    for (const EntryKey& key : keys) {
+        auto iter = entry_segments_.find(key);
+        if (iter == entry_segments_.end()) {
+            continue;
+        }
+        uint32_t segment_id = iter->second;
+        entry_segments_.erase(iter);
+        for (Segment& segment : segments_) {
+            if (segment.id == segment_id) {
+                DCHECK_GT(segment.num_live_entries, 0U);
+                segment.num_live_entries--;
+                break;
+            }
+        }
+    }
+}
+
+void LogJournal::ReleaseLogSpace(uint32_t logspace_id) {
+    absl::MutexLock lk(&index_mu_);
+    // Entries may still be in the group being written
+    released_logspaces_.insert(logspace_id);
+    absl::erase_if(entry_segments_, [this, logspace_id] (const auto& item) {
+        if (item.first.first != logspace_id) {
+            return false;
+        }
+        for (Segment& segment : segments_) {
+            if (segment.id == item.second) {
+                segment.num_live_entries--;
+                break;
+            }
+        }
+        return true;
+    });
+}
+
+bool LogJournal::HasReclaimableSegments() {
+    absl::MutexLock lk(&index_mu_);
+    return segments_.size() > 1 && segments_.front().num_live_entries == 0;
+}
+
+void LogJournal::ReclaimSegments() {
+    absl::MutexLock lk(&index_mu_);
+    // Removed in order, so that segments left on disk always form a suffix
+    while (segments_.size() > 1 && segments_.front().num_live_entries == 0) {
+        HVLOG_F(1, "Remove segment {}", segments_.front().id);
+        if (!fs_utils::Remove(segments_.front().path)) {
+            HLOG_F(ERROR, "Failed to remove segment file {}", segments_.front().path);
+        }
+        segments_.pop_front();
+    }
+}
+
+bool LogJournal::NewSegment() {
+    uint32_t id;
+    {
+        absl::MutexLock lk(&index_mu_);
+        id = next_segment_id_++;
+    }
+    std::string path = fs_utils::JoinPath(
+        dir_path_, fmt::format("{}{}", kSegmentPrefix, id));
+    auto fd = fs_utils::Create(path);
+    if (!fd.has_value()) {
+        return false;
+    }
+    if (current_fd_ != -1) {
+        // Entries of the previous segment may not be fsynced yet
+        PCHECK(fdatasync(current_fd_) == 0) << "Failed to sync segment file";
+        PCHECK(close(current_fd_) == 0) << "Failed to close segment file";
+    }
+    current_fd_ = *fd;
+    current_size_ = 0;
+    absl::MutexLock lk(&index_mu_);
+    segments_.push_back(Segment {
+        .id = id,
+        .path = std::move(path),
+        .num_live_entries = 0
+    });
+    return true;
+}
+
+void LogJournal::JournalThreadMain() {
+    std::string buf;
+    EntryKeyVec entries;
+    while (true) {
+        bool sync;
+        {
+            absl::MutexLock lk(&mu_);
+            while (pending_entries_.empty() && !stopping_) {
+                cv_.Wait(&mu_);
+            }
+            if (pending_entries_.empty()) {
+                break;
+            }
+            // Appends during the write of this group form the next one
+            buf.swap(pending_buf_);
+            entries.swap(pending_entries_);
+            sync = pending_sync_;
+            pending_sync_ = false;
+        }
+        if (current_size_ + buf.size() > segment_size_ && current_size_ > 0) {
+            CHECK(NewSegment()) << "Failed to create journal segment";
+        }
+        int64_t start_timestamp = GetMonotonicMicroTimestamp();
+        CHECK(WriteGroup(STRING_AS_SPAN(buf), sync)) << "Failed to write journal";
+        int64_t elapsed_time = GetMonotonicMicroTimestamp() - start_timestamp;
+        {
+            absl::MutexLock lk(&index_mu_);
+            Segment& segment = segments_.back();
+            for (const EntryKey& key : entries) {
+                if (released_logspaces_.contains(key.first)) {
+                    continue;
+                }
+                entry_segments_[key] = segment.id;
+                segment.num_live_entries++;
+            }
+        }
+        current_size_ += buf.size();
+        durable_cb_(entries);
+        ReportStatIfNeeded(entries.size(), sync, elapsed_time);
+        buf.clear();
+        entries.clear();
+    }
+}
+
+bool LogJournal::WriteGroup(std::span<const char> data, bool sync) {
+    while (!data.empty()) {
+        ssize_t ret = write(current_fd_, data.data(), data.size());
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            PLOG(ERROR) << "Failed to write segment file";
+            return false;
+        }
+        data = data.subspan(static_cast<size_t>(ret));
+    }
+    if (sync && fdatasync(current_fd_) != 0) {
+        PLOG(ERROR) << "Failed to sync segment file";
+        return false;
+    }
+    return true;
+}
+
+void LogJournal::ReportStatIfNeeded(size_t num_entries, bool fsynced,
+                                    int64_t fsync_time_us) {
+    absl::MutexLock lk(&mu_);
+    num_groups_++;
+    num_entries_ += num_entries;
+    if (fsynced) {
+        num_fsyncs_++;
+        fsync_time_us_ += gsl::narrow_cast<uint64_t>(fsync_time_us);
+    }
+    if (!stat_timer_.Check()) {
+        return;
+    }
+    int duration_ms;
+    stat_timer_.MarkReport(&duration_ms);
+    HLOG_F(INFO, "Journal statistics in last {}ms: groups={}, entries={}, "
+                 "entries_per_group={:.1f}, fsyncs={}, avg_fsync_write_time={}us",
+           duration_ms, num_groups_, num_entries_,
+           num_groups_ > 0 ? static_cast<double>(num_entries_) / num_groups_ : 0.0,
+           num_fsyncs_, num_fsyncs_ > 0 ? fsync_time_us_ / num_fsyncs_ : 0);
+    num_groups_ = 0;
+    num_entries_ = 0;
+    num_fsyncs_ = 0;
+    fsync_time_us_ = 0;
+}
+
+}  // namespace log
+}  // namespace faas
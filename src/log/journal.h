@@ -0,0 +1,108 @@
+#pragma once
+
+#include "log/common.h"
+#include "common/stat.h"
+#include "base/thread.h"
+
+namespace faas {
+namespace log {
+
+// When a replicated log entry counts towards shard progress of the
+// storage node, thus acknowledged to the sequencer
+enum class DurabilityLevel {
+    kMemory,   // Once stored in memory, relying on replication
+    kWritten,  // Once written to the journal, surviving process crashes
+    kFsync     // Once the journal is fsynced, surviving machine crashes
+};
+
+bool ParseDurabilityLevel(std::string_view str, DurabilityLevel* level);
+std::string_view DurabilityLevelName(DurabilityLevel level);
+
+// Journal of log entries received by a storage node, written before they
+// count towards shard progress, for log spaces with durability above memory.
+// Appends are written by a background thread in groups, and each group
+// is fsynced once when any of its entries requires so. A segment file is
+// removed after all its entries are persisted in DB, and the DB is synced.
+class LogJournal {
+public:
+    using EntryKey = std::pair</* logspace_id */ uint32_t, /* localid */ uint64_t>;
+    using EntryKeyVec = std::vector<EntryKey>;
+    // Called from the journal thread with entries that became durable
+    using DurableCallback = std::function<void(const EntryKeyVec&)>;
+    using RecoverCallback = std::function<void(/* logspace_id */ uint32_t,
+                                               const LogMetaData&,
+                                               std::span<const uint64_t> /* user_tags */,
+                                               std::span<const char> /* log_data */)>;
+
+    LogJournal(std::string_view dir_path, size_t segment_size, DurableCallback cb);
+    ~LogJournal();
+
+    void Start();
+    void Stop();
+
+    // Reads entries in segments left by previous runs, called after Start
+    // and before any append. Recovered entries are kept until released.
+    void Recover(const RecoverCallback& cb);
+
+    void Append(uint32_t logspace_id, const LogMetaData& log_metadata,
+                std::span<const uint64_t> user_tags, std::span<const char> log_data,
+                bool sync);
+
+    // Released entries no longer need the journal, once the DB is synced
+    void Release(const EntryKey& key);
+    void Release(std::span<const EntryKey> keys);
+    // Entries of the log space appended later are not registered either
+    void ReleaseLogSpace(uint32_t logspace_id);
+    bool HasReclaimableSegments();
+    // Must be called after syncing the DB
+    void ReclaimSegments();
+
+private:
+    std::string dir_path_;
+    size_t segment_size_;
+    DurableCallback durable_cb_;
+
+    absl::Mutex mu_;
+    absl::CondVar cv_;
+    bool stopping_                ABSL_GUARDED_BY(mu_);
+    std::string pending_buf_      ABSL_GUARDED_BY(mu_);
+    EntryKeyVec pending_entries_  ABSL_GUARDED_BY(mu_);
+    bool pending_sync_            ABSL_GUARDED_BY(mu_);
+
+    struct Segment {
+        uint32_t id;
+        std::string path;
+        size_t num_live_entries;
+    };
+    absl::Mutex index_mu_;
+    uint32_t next_segment_id_     ABSL_GUARDED_BY(index_mu_);
+    // Ordered by id, the last one being appended
+    std::deque<Segment> segments_ ABSL_GUARDED_BY(index_mu_);
+    absl::flat_hash_map<EntryKey, /* segment_id */ uint32_t>
+        entry_segments_           ABSL_GUARDED_BY(index_mu_);
+    absl::flat_hash_set</* logspace_id */ uint32_t>
+        released_logspaces_       ABSL_GUARDED_BY(index_mu_);
+
+    // Only accessed by the journal thread
+    int current_fd_;
+    size_t current_size_;
+
+    uint64_t num_groups_          ABSL_GUARDED_BY(mu_);
+    uint64_t num_entries_         ABSL_GUARDED_BY(mu_);
+    uint64_t num_fsyncs_          ABSL_GUARDED_BY(mu_);
+    uint64_t fsync_time_us_       ABSL_GUARDED_BY(mu_);
+    stat::ReportTimer stat_timer_ ABSL_GUARDED_BY(mu_);
+
+    base::Thread journal_thread_;
+
+    bool NewSegment();
+    size_t RecoverSegment(const Segment& segment, const RecoverCallback& cb);
+    void JournalThreadMain();
+    bool WriteGroup(std::span<const char> data, bool sync);
+    void ReportStatIfNeeded(size_t num_entries, bool fsynced, int64_t fsync_time_us);
+
+    DISALLOW_COPY_AND_ASSIGN(LogJournal);
+};
+
+}  // namespace log
+}  // namespace faas
@@ -1,5 +1,6 @@
 #include "log/log_space.h"
 
+#include "common/time.h"
 #include "log/flags.h"
 
 namespace faas {
@@ -125,6 +126,16 @@ void MetaLogPrimary::UpdateMetaLogReplicatedPosition() {
     replicated_metalog_position_ = progress;
 }
 
+uint32_t MetaLogPrimary::metalog_low_water_mark() const {
+    // Meta logs are propagated once replicated, so entries below the slowest
+    // replica are no longer needed
+    uint32_t low_water_mark = replicated_metalog_position_;
+    for (const auto& [sequencer_id, progress] : metalog_progresses_) {
+        low_water_mark = std::min(low_water_mark, progress);
+    }
+    return metalog_progresses_.empty() ? metalog_position_ : low_water_mark;
+}
+
 uint32_t MetaLogPrimary::GetShardReplicatedPosition(uint16_t engine_id) const {
     uint32_t min_value = std::numeric_limits<uint32_t>::max();
     const View::Engine* engine_node = view_->GetEngineNode(engine_id);
@@ -147,26 +158,98 @@ MetaLogBackup::~MetaLogBackup() {}
 
 LogProducer::LogProducer(uint16_t engine_id, const View* view, uint16_t sequencer_id)
     : LogSpaceBase(LogSpaceBase::kLiteMode, view, sequencer_id),
-      next_localid_(bits::JoinTwo32(engine_id, 0)) {
+      engine_id_(engine_id),
+      next_localid_(bits::JoinTwo32(engine_id, 0)),
+      replicated_position_(0),
+      oldest_timestamped_position_(0) {
     AddInterestedShard(engine_id);
+    for (uint16_t storage_id : view_->GetEngineNode(engine_id)->GetStorageNodes()) {
+        storage_progresses_[storage_id] = 0;
+    }
     log_header_ = fmt::format("LogProducer[{}-{}]: ", view->id(), sequencer_id);
     state_ = kNormal;
 }
 
 LogProducer::~LogProducer() {}
 
-void LogProducer::LocalAppend(void* caller_data, uint64_t* localid) {
+void LogProducer::LocalAppend(void* caller_data, uint64_t* localid, bool async) {
     DCHECK(!pending_appends_.contains(next_localid_));
     HVLOG_F(1, "LocalAppend with localid {}", bits::HexStr0x(next_localid_));
     pending_appends_[next_localid_] = caller_data;
+    if (async) {
+        async_appends_.insert(next_localid_);
+    }
     *localid = next_localid_++;
 }
 
+void LogProducer::UpdateStorageProgress(uint16_t storage_id, uint32_t localid_position) {
+    if (!storage_progresses_.contains(storage_id)) {
+        HLOG_F(FATAL, "Storage node {} does not store my shard", storage_id);
+    }
+    if (localid_position <= storage_progresses_[storage_id]) {
+        return;
+    }
+    storage_progresses_[storage_id] = localid_position;
+    uint32_t new_position = std::numeric_limits<uint32_t>::max();
+    for (const auto& [id, progress] : storage_progresses_) {
+        new_position = std::min(new_position, progress);
+    }
+    if (new_position <= replicated_position_) {
+        return;
+    }
+    if (!async_appends_.empty()) {
+        for (uint32_t pos = replicated_position_; pos < new_position; pos++) {
+            uint64_t localid = bits::JoinTwo32(engine_id_, pos);
+            if (async_appends_.contains(localid) && pending_appends_.contains(localid)
+                    && pending_appends_[localid] != nullptr) {
+                AckAsyncAppend(localid);
+            }
+        }
+    }
+    replicated_position_ = new_position;
+}
+
+void LogProducer::AckAsyncAppend(uint64_t localid) {
+    DCHECK(async_appends_.contains(localid));
+    HVLOG_F(1, "Async append with localid {} replicated", bits::HexStr0x(localid));
+    pending_append_results_.push_back(AppendResult {
+        .seqnum = kInvalidLogSeqNum,
+        .localid = localid,
+        .metalog_progress = 0,
+        .caller_data = pending_appends_[localid],
+        .replicated = true
+    });
+    // The caller is done with this append, later results do not refer to it
+    pending_appends_[localid] = nullptr;
+}
+
 void LogProducer::PollAppendResults(AppendResultVec* results) {
     *results = std::move(pending_append_results_);
     pending_append_results_.clear();
 }
 
+uint32_t LogProducer::MetaLogPositionAt(int64_t timestamp) const {
+    // Timestamps are monotonic, find the last one not after `timestamp`
+    auto iter = absl::c_upper_bound(
+        applied_timestamps_, timestamp,
+        [] (int64_t value, const std::pair<int64_t, uint32_t>& item) {
+            return value < item.first;
+        });
+    if (iter == applied_timestamps_.begin()) {
+        return oldest_timestamped_position_;
+    }
+    return std::prev(iter)->second;
+}
+
+void LogProducer::OnMetaLogApplied(uint32_t metalog_seqnum, MetaLogProto::Type type) {
+    applied_timestamps_.push_back(std::make_pair(
+        GetMonotonicMicroTimestamp(), metalog_seqnum + 1));
+    if (applied_timestamps_.size() > kMaxAppliedTimestamps) {
+        oldest_timestamped_position_ = applied_timestamps_.front().second;
+        applied_timestamps_.pop_front();
+    }
+}
+
 void LogProducer::OnNewLogs(uint32_t metalog_seqnum,
                             uint64_t start_seqnum, uint64_t start_localid,
                             uint32_t delta) {
@@ -177,11 +260,19 @@ void LogProducer::OnNewLogs(uint32_t metalog_seqnum,
             HLOG_F(FATAL, "Cannot find pending log entry for localid {}",
                    bits::HexStr0x(localid));
         }
+        if (async_appends_.contains(localid)) {
+            // Included in a cut implies replicated
+            if (pending_appends_[localid] != nullptr) {
+                AckAsyncAppend(localid);
+            }
+            async_appends_.erase(localid);
+        }
         pending_append_results_.push_back(AppendResult {
             .seqnum = seqnum,
             .localid = localid,
             .metalog_progress = bits::JoinTwo32(identifier(), metalog_seqnum + 1),
-            .caller_data = pending_appends_[localid]
+            .caller_data = pending_appends_[localid],
+            .replicated = false
         });
         pending_appends_.erase(localid);
     }
@@ -193,17 +284,29 @@ void LogProducer::OnFinalized(uint32_t metalog_position) {
             .seqnum = kInvalidLogSeqNum,
             .localid = localid,
             .metalog_progress = 0,
-            .caller_data = caller_data
+            .caller_data = caller_data,
+            .replicated = false
         });
     }
     pending_appends_.clear();
+    async_appends_.clear();
 }
 
+namespace {
+static constexpr size_t kMemTableChunkSize = size_t{1} << 20;
+}  // namespace
+
 LogStorage::LogStorage(uint16_t storage_id, const View* view, uint16_t sequencer_id)
     : LogSpaceBase(LogSpaceBase::kLiteMode, view, sequencer_id),
       storage_node_(view_->GetStorageNode(storage_id)),
       shard_progrss_dirty_(false),
-      persisted_seqnum_position_(0) {
+      persisted_seqnum_position_(0),
+      unpersisted_bytes_(0),
+      restored_(false),
+      num_lost_entries_(0),
+      memtable_(absl::GetFlag(FLAGS_slog_storage_max_live_entries_mb) << 20,
+                kMemTableChunkSize,
+                absl::GetFlag(FLAGS_slog_storage_max_live_entries)) {
     for (uint16_t engine_id : storage_node_->GetSourceEngineNodes()) {
         AddInterestedShard(engine_id);
         shard_progrsses_[engine_id] = 0;
@@ -216,7 +319,7 @@ LogStorage::LogStorage(uint16_t storage_id, const View* view, uint16_t sequencer
 LogStorage::~LogStorage() {}
 
 bool LogStorage::Store(const LogMetaData& log_metadata, std::span<const uint64_t> user_tags,
-                       std::span<const char> log_data) {
+                       std::span<const char> log_data, bool durable) {
     uint64_t localid = log_metadata.localid;
     DCHECK_EQ(size_t{log_metadata.data_size}, log_data.size());
     uint16_t engine_id = gsl::narrow_cast<uint16_t>(bits::HighHalf64(localid));
@@ -227,30 +330,54 @@ bool LogStorage::Store(const LogMetaData& log_metadata, std::span<const uint64_t
                storage_node_->node_id(), engine_id);
         return false;
     }
-    pending_log_entries_[localid].reset(new LogEntry {
-        .metadata = log_metadata,
-        .user_tags = UserTagVec(user_tags.begin(), user_tags.end()),
-        .data = std::string(log_data.data(), log_data.size()),
-    });
-    AdvanceShardProgress(engine_id);
+    if (engines_to_resync_.erase(engine_id) > 0
+            && bits::LowHalf64(localid) > shard_progrsses_[engine_id]) {
+        // Entries replicated between the checkpoint and restart are lost
+        HLOG_F(WARNING, "Skip {} log entries of engine {} lost with restart",
+               bits::LowHalf64(localid) - shard_progrsses_[engine_id], engine_id);
+        shard_progrsses_[engine_id] = bits::LowHalf64(localid);
+        shard_progrss_dirty_ = true;
+    }
+    memtable_.AddPending(log_metadata, user_tags, log_data, durable);
+    if (durable) {
+        AdvanceShardProgress(engine_id);
+    }
     return true;
 }
 
+void LogStorage::LogEntriesDurable(std::span<const uint64_t> localids) {
+    absl::InlinedVector<uint16_t, 4> engine_ids;
+    for (uint64_t localid : localids) {
+        if (!memtable_.MarkPendingDurable(localid)) {
+            // Discarded with the log space finalized
+            continue;
+        }
+        uint16_t engine_id = gsl::narrow_cast<uint16_t>(bits::HighHalf64(localid));
+        if (std::find(engine_ids.begin(), engine_ids.end(), engine_id) == engine_ids.end()) {
+            engine_ids.push_back(engine_id);
+        }
+    }
+    for (uint16_t engine_id : engine_ids) {
+        AdvanceShardProgress(engine_id);
+    }
+}
+
 void LogStorage::ReadAt(const protocol::SharedLogMessage& request) {
     DCHECK_EQ(request.logspace_id, identifier());
     uint64_t seqnum = bits::JoinTwo32(request.logspace_id, request.seqnum_lowhalf);
-    if (seqnum >= seqnum_position()) {
+    // Persisted position can be ahead when restored
+    if (seqnum >= seqnum_position() && seqnum >= persisted_seqnum_position_) {
         pending_read_requests_.insert(std::make_pair(seqnum, request));
         return;
     }
     ReadResult result = {
         .status = ReadResult::kFailed,
-        .log_entry = nullptr,
+        .log_entry = std::nullopt,
         .original_request = request
     };
-    if (live_log_entries_.contains(seqnum)) {
+    if (auto log_entry = memtable_.Get(seqnum); log_entry.has_value()) {
         result.status = ReadResult::kOK;
-        result.log_entry = live_log_entries_[seqnum];
+        result.log_entry = std::move(log_entry);
     } else if (seqnum < persisted_seqnum_position_) {
         result.status = ReadResult::kLookupDB;
     } else {
@@ -260,28 +387,22 @@ void LogStorage::ReadAt(const protocol::SharedLogMessage& request) {
 }
 
 bool LogStorage::GrabLogEntriesForPersistence(
-        std::vector<std::shared_ptr<const LogEntry>>* log_entries,
+        std::vector<LogEntryView>* log_entries,
         uint64_t* new_position) const {
-    if (live_seqnums_.empty() || live_seqnums_.back() < persisted_seqnum_position_) {
+    if (memtable_.empty() || memtable_.last_seqnum() < persisted_seqnum_position_) {
         return false;
     }
-    auto iter = absl::c_lower_bound(live_seqnums_, persisted_seqnum_position_);
-    DCHECK(iter != live_seqnums_.end());
-    DCHECK_GE(*iter, persisted_seqnum_position_);
-    log_entries->clear();
-    while (iter != live_seqnums_.end()) {
-        uint64_t seqnum = *(iter++);
-        DCHECK(live_log_entries_.contains(seqnum));
-        log_entries->push_back(live_log_entries_.at(seqnum));
-    }
+    memtable_.GetFrom(persisted_seqnum_position_, log_entries);
     DCHECK(!log_entries->empty());
-    *new_position = live_seqnums_.back() + 1;
+    *new_position = memtable_.last_seqnum() + 1;
     return true;
 }
 
-void LogStorage::LogEntriesPersisted(uint64_t new_position) {
+void LogStorage::LogEntriesPersisted(uint64_t new_position, size_t persisted_bytes) {
     persisted_seqnum_position_ = new_position;
-    ShrinkLiveEntriesIfNeeded();
+    DCHECK_GE(unpersisted_bytes_, persisted_bytes);
+    unpersisted_bytes_ -= persisted_bytes;
+    memtable_.Shrink(persisted_seqnum_position_);
 }
 
 void LogStorage::PollReadResults(ReadResultVec* results) {
@@ -300,14 +421,129 @@ std::optional<IndexDataProto> LogStorage::PollIndexData() {
     return data;
 }
 
-std::optional<std::vector<uint32_t>> LogStorage::GrabShardProgressForSending() {
+StorageCheckpointProto LogStorage::MakeCheckpoint() const {
+    StorageCheckpointProto checkpoint;
+    checkpoint.set_logspace_id(identifier());
+    checkpoint.set_metalog_position(metalog_position());
+    checkpoint.set_seqnum_position(bits::LowHalf64(seqnum_position()));
+    checkpoint.set_persisted_seqnum_position(bits::LowHalf64(persisted_seqnum_position_));
+    for (uint16_t engine_id : storage_node_->GetSourceEngineNodes()) {
+        checkpoint.add_engine_ids(engine_id);
+        checkpoint.add_shard_cuts(shard_cut(engine_id));
+        checkpoint.add_shard_progresses(shard_progrsses_.at(engine_id));
+    }
+    checkpoint.set_finalized(finalized() && persisted_seqnum_position_ >= seqnum_position());
+    std::vector<LogEntryView> unpersisted;
+    memtable_.GetFrom(persisted_seqnum_position_, &unpersisted);
+    for (const LogEntryView& log_entry : unpersisted) {
+        uint32_t seqnum = bits::LowHalf64(log_entry.metadata.seqnum);
+        uint64_t localid = log_entry.metadata.localid;
+        int n = checkpoint.unpersisted_lengths_size();
+        if (n > 0) {
+            uint32_t length = checkpoint.unpersisted_lengths(n - 1);
+            if (checkpoint.unpersisted_seqnums(n - 1) + length == seqnum
+                    && checkpoint.unpersisted_localids(n - 1) + length == localid) {
+                checkpoint.set_unpersisted_lengths(n - 1, length + 1);
+                continue;
+            }
+        }
+        checkpoint.add_unpersisted_seqnums(seqnum);
+        checkpoint.add_unpersisted_localids(localid);
+        checkpoint.add_unpersisted_lengths(1);
+    }
+    return checkpoint;
+}
+
+void LogStorage::RestoreFromCheckpoint(const StorageCheckpointProto& checkpoint,
+                                       uint64_t persisted_position) {
+    DCHECK(!restored_);
+    absl::flat_hash_map</* engine_id */ uint16_t, /* localid */ uint32_t> shard_cuts;
+    for (int i = 0; i < checkpoint.engine_ids_size(); i++) {
+        uint16_t engine_id = gsl::narrow_cast<uint16_t>(checkpoint.engine_ids(i));
+        if (!storage_node_->IsSourceEngineNode(engine_id)) {
+            HLOG_F(ERROR, "Engine {} in checkpoint is not a source engine", engine_id);
+            continue;
+        }
+        shard_cuts[engine_id] = checkpoint.shard_cuts(i);
+        shard_progrsses_[engine_id] = checkpoint.shard_progresses(i);
+    }
+    RestorePosition(checkpoint.metalog_position(), checkpoint.seqnum_position(), shard_cuts);
+    persisted_seqnum_position_ = persisted_position;
+    for (int i = 0; i < checkpoint.unpersisted_lengths_size(); i++) {
+        uint64_t seqnum = bits::JoinTwo32(identifier(), checkpoint.unpersisted_seqnums(i));
+        uint64_t localid = checkpoint.unpersisted_localids(i);
+        for (uint32_t j = 0; j < checkpoint.unpersisted_lengths(i); j++) {
+            // Entries found in DB beyond the checkpoint are persisted
+            if (seqnum + j >= persisted_seqnum_position_) {
+                unpersisted_seqnums_[localid + j] = seqnum + j;
+            }
+        }
+    }
+    for (uint16_t engine_id : storage_node_->GetSourceEngineNodes()) {
+        engines_to_resync_.insert(engine_id);
+    }
+    // Progress reported before restart is sent again
+    shard_progrss_dirty_ = true;
+    restored_ = true;
+    HLOG_F(INFO, "Restored from checkpoint: persisted_position={}",
+           bits::HexStr0x(persisted_seqnum_position_));
+}
+
+bool LogStorage::RecoverFromJournal(const LogEntry& log_entry) {
+    DCHECK(restored_);
+    uint64_t localid = log_entry.metadata.localid;
+    uint16_t engine_id = gsl::narrow_cast<uint16_t>(bits::HighHalf64(localid));
+    if (!storage_node_->IsSourceEngineNode(engine_id)) {
+        return false;
+    }
+    if (bits::LowHalf64(localid) >= shard_cut(engine_id)) {
+        memtable_.AddPending(log_entry.metadata, VECTOR_AS_SPAN(log_entry.user_tags),
+                             STRING_AS_SPAN(log_entry.data));
+        AdvanceShardProgress(engine_id);
+        return true;
+    }
+    auto iter = unpersisted_seqnums_.find(localid);
+    if (iter == unpersisted_seqnums_.end() || memtable_.ContainsPending(localid)) {
+        return false;
+    }
+    memtable_.AddPending(log_entry.metadata, VECTOR_AS_SPAN(log_entry.user_tags),
+                         STRING_AS_SPAN(log_entry.data));
+    recovered_live_.emplace_back(iter->second, localid);
+    return true;
+}
+
+void LogStorage::FinishRecovery() {
+    DCHECK(restored_);
+    // The ring of live entries is ordered by seqnum
+    std::sort(recovered_live_.begin(), recovered_live_.end());
+    for (const auto& [seqnum, localid] : recovered_live_) {
+        LogEntryView log_entry;
+        CHECK(memtable_.Finalize(localid, seqnum, &log_entry));
+        unpersisted_bytes_ += log_entry.user_tags.size_bytes() + log_entry.data.size();
+    }
+    if (!recovered_live_.empty()) {
+        HLOG_F(INFO, "Recovered {} live entries with seqnums up to {}",
+               recovered_live_.size(), bits::HexStr0x(recovered_live_.back().first));
+    }
+    unpersisted_seqnums_.clear();
+    recovered_live_.clear();
+}
+
+std::optional<std::vector<uint32_t>> LogStorage::GrabShardProgressForSending(
+        std::vector<uint16_t>* updated_engines) {
     if (!shard_progrss_dirty_) {
         return std::nullopt;
     }
     std::vector<uint32_t> progress;
     progress.reserve(storage_node_->GetSourceEngineNodes().size());
     for (uint16_t engine_id : storage_node_->GetSourceEngineNodes()) {
-        progress.push_back(shard_progrsses_[engine_id]);
+        uint32_t engine_progress = shard_progrsses_[engine_id];
+        progress.push_back(engine_progress);
+        if (updated_engines != nullptr
+                && engine_progrsses_sent_[engine_id] != engine_progress) {
+            engine_progrsses_sent_[engine_id] = engine_progress;
+            updated_engines->push_back(engine_id);
+        }
     }
     shard_progrss_dirty_ = false;
     return progress;
@@ -321,7 +557,7 @@ void LogStorage::OnNewLogs(uint32_t metalog_seqnum,
         HLOG_F(WARNING, "Read request for seqnum {} has past", bits::HexStr0x(iter->first));
         pending_read_results_.push_back(ReadResult {
             .status = ReadResult::kFailed,
-            .log_entry = nullptr,
+            .log_entry = std::nullopt,
             .original_request = iter->second
         });
         iter = pending_read_requests_.erase(iter);
@@ -329,36 +565,51 @@ void LogStorage::OnNewLogs(uint32_t metalog_seqnum,
     for (size_t i = 0; i < delta; i++) {
         uint64_t seqnum = start_seqnum + i;
         uint64_t localid = start_localid + i;
-        if (!pending_log_entries_.contains(localid)) {
-            HLOG_F(FATAL, "Cannot find pending log entry for localid {}",
-                   bits::HexStr0x(localid));
+        // Move the pending entry into the ring of live entries
+        LogEntryView log_entry;
+        if (!memtable_.Finalize(localid, seqnum, &log_entry)) {
+            if (!restored_) {
+                HLOG_F(FATAL, "Cannot find pending log entry for localid {}",
+                       bits::HexStr0x(localid));
+            }
+            // Pending entries not in the journal are lost with restart
+            HVLOG_F(1, "Log entry (seqnum={}, localid={}) lost with restart",
+                    bits::HexStr0x(seqnum), bits::HexStr0x(localid));
+            num_lost_entries_++;
+            while (iter != pending_read_requests_.end() && iter->first == seqnum) {
+                pending_read_results_.push_back(ReadResult {
+                    .status = ReadResult::kFailed,
+                    .log_entry = std::nullopt,
+                    .original_request = iter->second
+                });
+                iter = pending_read_requests_.erase(iter);
+            }
+            continue;
         }
-        // Build the log entry for live_log_entries_
-        LogEntry* log_entry = pending_log_entries_[localid].release();
-        pending_log_entries_.erase(localid);
         HVLOG_F(1, "Finalize the log entry (seqnum={}, localid={})",
                 bits::HexStr0x(seqnum), bits::HexStr0x(localid));
-        log_entry->metadata.seqnum = seqnum;
-        std::shared_ptr<const LogEntry> log_entry_ptr(log_entry);
         // Add the new entry to index data
         index_data_.add_seqnum_halves(bits::LowHalf64(seqnum));
         index_data_.add_engine_ids(bits::HighHalf64(localid));
-        index_data_.add_user_logspaces(log_entry->metadata.user_logspace);
+        index_data_.add_user_logspaces(log_entry.metadata.user_logspace);
         index_data_.add_user_tag_sizes(
-            gsl::narrow_cast<uint32_t>(log_entry->user_tags.size()));
+            gsl::narrow_cast<uint32_t>(log_entry.user_tags.size()));
         index_data_.mutable_user_tags()->Add(
-            log_entry->user_tags.begin(), log_entry->user_tags.end());
-        // Update live_seqnums_ and live_log_entries_
-        DCHECK(live_seqnums_.empty() || seqnum > live_seqnums_.back());
-        live_seqnums_.push_back(seqnum);
-        live_log_entries_[seqnum] = log_entry_ptr;
-        DCHECK_EQ(live_seqnums_.size(), live_log_entries_.size());
-        ShrinkLiveEntriesIfNeeded();
+            log_entry.user_tags.begin(), log_entry.user_tags.end());
+        if (log_entry.metadata.cond_append) {
+            index_data_.add_cond_entries(
+                gsl::narrow_cast<uint32_t>(index_data_.seqnum_halves_size() - 1));
+            index_data_.add_cond_tail_seqnums(log_entry.metadata.cond_tail_seqnum);
+        }
+        if (seqnum >= persisted_seqnum_position_) {
+            unpersisted_bytes_ += log_entry.user_tags.size_bytes() + log_entry.data.size();
+        }
+        memtable_.Shrink(persisted_seqnum_position_);
         // Check if we have read request on it
         while (iter != pending_read_requests_.end() && iter->first == seqnum) {
             pending_read_results_.push_back(ReadResult {
                 .status = ReadResult::kOK,
-                .log_entry = log_entry_ptr,
+                .log_entry = log_entry,
                 .original_request = iter->second
             });
             iter = pending_read_requests_.erase(iter);
@@ -367,9 +618,12 @@ void LogStorage::OnNewLogs(uint32_t metalog_seqnum,
 }
 
 void LogStorage::OnFinalized(uint32_t metalog_position) {
-    if (!pending_log_entries_.empty()) {
-        HLOG_F(WARNING, "{} pending log entries discarded", pending_log_entries_.size());
-        pending_log_entries_.clear();
+    if (num_lost_entries_ > 0) {
+        HLOG_F(WARNING, "{} log entries lost with restart", num_lost_entries_);
+    }
+    if (memtable_.num_pending() > 0) {
+        HLOG_F(WARNING, "{} pending log entries discarded", memtable_.num_pending());
+        memtable_.ClearPending();
     }
     if (!pending_read_requests_.empty()) {
         HLOG_F(FATAL, "There are {} pending reads", pending_read_requests_.size());
@@ -378,7 +632,7 @@ void LogStorage::OnFinalized(uint32_t metalog_position) {
 
 void LogStorage::AdvanceShardProgress(uint16_t engine_id) {
     uint32_t current = shard_progrsses_[engine_id];
-    while (pending_log_entries_.contains(bits::JoinTwo32(engine_id, current))) {
+    while (memtable_.IsPendingDurable(bits::JoinTwo32(engine_id, current))) {
         current++;
     }
     if (current > shard_progrsses_[engine_id]) {
@@ -391,15 +645,5 @@ void LogStorage::AdvanceShardProgress(uint16_t engine_id) {
     }
 }
 
-void LogStorage::ShrinkLiveEntriesIfNeeded() {
-    size_t max_size = absl::GetFlag(FLAGS_slog_storage_max_live_entries);
-    while (live_seqnums_.size() > max_size
-             && live_seqnums_.front() < persisted_seqnum_position_) {
-        live_log_entries_.erase(live_seqnums_.front());
-        live_seqnums_.pop_front();
-        DCHECK_EQ(live_seqnums_.size(), live_log_entries_.size());
-    }
-}
-
 }  // namespace log
 }  // namespace faas
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "log/log_space_base.h"
+#include "log/memtable.h"
 
 namespace faas {
 namespace log {
@@ -34,6 +35,8 @@ private:
                         uint32_t> metalog_progresses_;
     uint32_t replicated_metalog_position_;
 
+    uint32_t metalog_low_water_mark() const override;
+
     uint32_t GetShardReplicatedPosition(uint16_t engine_id) const;
     void UpdateMetaLogReplicatedPosition();
 
@@ -56,23 +59,45 @@ public:
     LogProducer(uint16_t engine_id, const View* view, uint16_t sequencer_id);
     ~LogProducer();
 
-    void LocalAppend(void* caller_data, uint64_t* localid);
+    // Async appends are acknowledged once replicated to all storage nodes,
+    // before getting the seqnum
+    void LocalAppend(void* caller_data, uint64_t* localid, bool async = false);
+    void UpdateStorageProgress(uint16_t storage_id, uint32_t localid_position);
 
     struct AppendResult {
         uint64_t seqnum;   // seqnum == kInvalidLogSeqNum indicates failure
         uint64_t localid;
         uint64_t metalog_progress;
-        void*    caller_data;
+        void*    caller_data;  // nullptr for acknowledged async appends
+        bool     replicated;   // Async append replicated, seqnum not yet known
     };
     using AppendResultVec = absl::InlinedVector<AppendResult, 4>;
     void PollAppendResults(AppendResultVec* results);
 
+    // Metalog position applied by the given time. For old timestamps out of
+    // the recorded history, returns a position no smaller than the real one
+    uint32_t MetaLogPositionAt(int64_t timestamp) const;
+
 private:
+    const uint16_t engine_id_;
     uint64_t next_localid_;
     absl::flat_hash_map</* localid */ uint64_t,
                         /* caller_data */ void*> pending_appends_;
     AppendResultVec pending_append_results_;
 
+    absl::flat_hash_set</* localid */ uint64_t> async_appends_;
+    absl::flat_hash_map</* storage_id */ uint16_t,
+                        /* localid */ uint32_t> storage_progresses_;
+    uint32_t replicated_position_;
+
+    static constexpr size_t kMaxAppliedTimestamps = 4096;
+    std::deque<std::pair</* timestamp */ int64_t,
+                         /* metalog_position */ uint32_t>> applied_timestamps_;
+    uint32_t oldest_timestamped_position_;
+
+    void AckAsyncAppend(uint64_t localid);
+
+    void OnMetaLogApplied(uint32_t metalog_seqnum, MetaLogProto::Type type) override;
     void OnNewLogs(uint32_t metalog_seqnum,
                    uint64_t start_seqnum, uint64_t start_localid,
                    uint32_t delta) override;
@@ -87,26 +112,46 @@ public:
     LogStorage(uint16_t storage_id, const View* view, uint16_t sequencer_id);
     ~LogStorage();
 
+    // Entries not `durable` count towards shard progress after LogEntriesDurable
     bool Store(const LogMetaData& log_metadata, std::span<const uint64_t> user_tags,
-               std::span<const char> log_data);
+               std::span<const char> log_data, bool durable = true);
+    void LogEntriesDurable(std::span<const uint64_t> localids);
     void ReadAt(const protocol::SharedLogMessage& request);
 
     bool GrabLogEntriesForPersistence(
-            std::vector<std::shared_ptr<const LogEntry>>* log_entries,
+            std::vector<LogEntryView>* log_entries,
             uint64_t* new_position) const;
-    void LogEntriesPersisted(uint64_t new_position);
+    void LogEntriesPersisted(uint64_t new_position, size_t persisted_bytes);
+    size_t unpersisted_bytes() const { return unpersisted_bytes_; }
+    uint64_t persisted_seqnum_position() const { return persisted_seqnum_position_; }
 
     struct ReadResult {
         enum Status { kOK, kLookupDB, kFailed };
         Status status;
-        std::shared_ptr<const LogEntry> log_entry;
+        std::optional<LogEntryView> log_entry;
         protocol::SharedLogMessage original_request;
     };
     using ReadResultVec = absl::InlinedVector<ReadResult, 4>;
     void PollReadResults(ReadResultVec* results);
 
     std::optional<IndexDataProto> PollIndexData();
-    std::optional<std::vector<uint32_t>> GrabShardProgressForSending();
+    // Also gives source engines whose own progress changed since last sent
+    std::optional<std::vector<uint32_t>> GrabShardProgressForSending(
+        std::vector<uint16_t>* updated_engines = nullptr);
+
+    // State to persist along with entries below persisted_seqnum_position
+    StorageCheckpointProto MakeCheckpoint() const;
+    // Restores state of a previous run, where entries below
+    // `persisted_position` are found in DB. Entries not persisted are lost,
+    // unless recovered from the journal.
+    void RestoreFromCheckpoint(const StorageCheckpointProto& checkpoint,
+                               uint64_t persisted_position);
+    // Entries without seqnums before restart become pending again, while
+    // those with seqnums recorded by the checkpoint become live once
+    // FinishRecovery is called. Returns false if the entry is persisted.
+    bool RecoverFromJournal(const LogEntry& log_entry);
+    void FinishRecovery();
+    bool restored() const { return restored_; }
 
 private:
     const View::Storage* storage_node_;
@@ -114,16 +159,22 @@ private:
     bool shard_progrss_dirty_;
     absl::flat_hash_map</* engine_id */ uint16_t,
                         /* localid */ uint32_t> shard_progrsses_;
+    // Progress last sent to each source engine
+    absl::flat_hash_map</* engine_id */ uint16_t,
+                        /* localid */ uint32_t> engine_progrsses_sent_;
 
     uint64_t persisted_seqnum_position_;
-    std::deque<uint64_t> live_seqnums_;
-    absl::flat_hash_map</* seqnum */ uint64_t,
-                        std::shared_ptr<const LogEntry>>
-        live_log_entries_;
-
-    absl::flat_hash_map</* localid */ uint64_t,
-                        std::unique_ptr<LogEntry>>
-        pending_log_entries_;
+    size_t unpersisted_bytes_;
+
+    bool restored_;
+    // Engines yet to replicate entries since restored
+    absl::flat_hash_set</* engine_id */ uint16_t> engines_to_resync_;
+    size_t num_lost_entries_;
+    // Seqnums of unpersisted entries recorded by the checkpoint
+    absl::flat_hash_map</* localid */ uint64_t, /* seqnum */ uint64_t> unpersisted_seqnums_;
+    std::vector<std::pair</* seqnum */ uint64_t, /* localid */ uint64_t>> recovered_live_;
+    // Both pending entries (without seqnums) and live entries
+    LogMemTable memtable_;
 
     std::multimap</* seqnum */ uint64_t,
                   protocol::SharedLogMessage> pending_read_requests_;
@@ -137,7 +188,6 @@ private:
     void OnFinalized(uint32_t metalog_position) override;
 
     void AdvanceShardProgress(uint16_t engine_id);
-    void ShrinkLiveEntriesIfNeeded();
 
     DISALLOW_COPY_AND_ASSIGN(LogStorage);
 };
@@ -1,6 +1,10 @@
 #include "log/log_space_base.h"
 
+#include "log/flags.h"
 #include "utils/bits.h"
+#include "utils/fs.h"
+
+#include <fcntl.h>
 
 namespace faas {
 namespace log {
@@ -13,17 +17,60 @@ LogSpaceBase::LogSpaceBase(Mode mode, const View* view, uint16_t sequencer_id)
       metalog_position_(0),
       log_header_(fmt::format("LogSpace[{}-{}]: ", view->id(), sequencer_id)),
       shard_progrsses_(view->num_engine_nodes(), 0),
-      seqnum_position_(0) {}
+      seqnum_position_(0),
+      resync_shard_cuts_(false),
+      metalog_history_window_(absl::GetFlag(FLAGS_slog_metalog_history_window)),
+      applied_metalogs_start_(0),
+      spill_fd_(-1),
+      spill_file_size_(0),
+      spilled_metalogs_start_(0) {
+    if (metalog_history_window_ > 0) {
+        // Tail entries are always needed when freezing
+        metalog_history_window_ = std::max(
+            metalog_history_window_,
+            absl::GetFlag(FLAGS_slog_num_tail_metalog_entries));
+    }
+}
 
-LogSpaceBase::~LogSpaceBase() {}
+LogSpaceBase::~LogSpaceBase() {
+    if (spill_fd_ != -1) {
+        PCHECK(close(spill_fd_) == 0);
+    }
+}
 
 void LogSpaceBase::AddInterestedShard(uint16_t engine_id) {
     DCHECK(state_ == kCreated);
+    interested_shards_.insert(ShardIndex(engine_id));
+}
+
+size_t LogSpaceBase::ShardIndex(uint16_t engine_id) const {
     const View::NodeIdVec& engine_node_ids = view_->GetEngineNodes();
     size_t idx = static_cast<size_t>(
         absl::c_find(engine_node_ids, engine_id) - engine_node_ids.begin());
     DCHECK_LT(idx, engine_node_ids.size());
-    interested_shards_.insert(idx);
+    return idx;
+}
+
+uint32_t LogSpaceBase::shard_cut(uint16_t engine_id) const {
+    return shard_progrsses_[ShardIndex(engine_id)];
+}
+
+void LogSpaceBase::RestorePosition(
+        uint32_t metalog_position, uint32_t seqnum_position,
+        const absl::flat_hash_map<uint16_t, uint32_t>& shard_cuts) {
+    DCHECK(mode_ == kLiteMode);
+    DCHECK(pending_metalogs_.empty());
+    DCHECK_EQ(metalog_position_, 0U);
+    metalog_position_ = metalog_position;
+    seqnum_position_ = seqnum_position;
+    applied_metalogs_start_ = metalog_position;
+    spilled_metalogs_start_ = metalog_position;
+    for (const auto& [engine_id, cut] : shard_cuts) {
+        shard_progrsses_[ShardIndex(engine_id)] = cut;
+    }
+    resync_shard_cuts_ = true;
+    HLOG_F(INFO, "Restore position: metalog_position={}, seqnum_position={}",
+           metalog_position, bits::HexStr0x(seqnum_position));
 }
 
 std::optional<MetaLogProto> LogSpaceBase::GetMetaLog(uint32_t pos) const {
@@ -31,7 +78,14 @@ std::optional<MetaLogProto> LogSpaceBase::GetMetaLog(uint32_t pos) const {
     if (pos >= metalog_position_) {
         return std::nullopt;
     }
-    return *applied_metalogs_.at(pos);
+    if (pos >= applied_metalogs_start_) {
+        return *applied_metalogs_.at(pos - applied_metalogs_start_);
+    }
+    if (pos >= spilled_metalogs_start_) {
+        return ReadSpilledMetaLog(pos);
+    }
+    HLOG_F(ERROR, "Meta log at position {} already truncated", pos);
+    return std::nullopt;
 }
 
 bool LogSpaceBase::ProvideMetaLog(const MetaLogProto& meta_log) {
@@ -53,6 +107,54 @@ bool LogSpaceBase::ProvideMetaLog(const MetaLogProto& meta_log) {
     return metalog_position_ > prev_metalog_position;
 }
 
+bool LogSpaceBase::ProvideNewLogs(const FlatNewLogs& new_logs) {
+    DCHECK(state_ == kNormal || state_ == kFrozen);
+    DCHECK_EQ(new_logs.logspace_id(), identifier());
+    DCHECK_EQ(new_logs.num_shards(), view_->num_engine_nodes());
+    uint32_t seqnum = new_logs.metalog_seqnum();
+    if (seqnum < metalog_position_) {
+        return false;
+    }
+    uint32_t prev_metalog_position = metalog_position_;
+    if (!pending_metalogs_.empty() || !CanApplyNewLogs(seqnum, new_logs)) {
+        MetaLogProto* meta_log = metalog_pool_.Get();
+        new_logs.CopyTo(meta_log);
+        pending_metalogs_[seqnum] = meta_log;
+        AdvanceMetaLogProgress();
+        return metalog_position_ > prev_metalog_position;
+    }
+    ApplyNewLogs(seqnum, new_logs);
+    if (mode_ == kFullMode) {
+        // Pooled messages are reused, so copying into history does not allocate
+        MetaLogProto* meta_log = metalog_pool_.Get();
+        new_logs.CopyTo(meta_log);
+        DCHECK_EQ(size_t{metalog_position_ - applied_metalogs_start_},
+                  applied_metalogs_.size());
+        applied_metalogs_.push_back(meta_log);
+    }
+    metalog_position_ = seqnum + 1;
+    OnMetaLogApplied(seqnum, MetaLogProto::NEW_LOGS);
+    if (mode_ == kFullMode) {
+        TruncateMetaLogHistory();
+    }
+    return true;
+}
+
+bool LogSpaceBase::ProvideMetaLogs(const log_utils::MetaLogsPayload& metalogs) {
+    DCHECK_EQ(metalogs.logspace_id(), identifier());
+    uint32_t prev_metalog_position = metalog_position_;
+    if (metalogs.flat()) {
+        for (const FlatNewLogs& new_logs : metalogs.flat_new_logs()) {
+            ProvideNewLogs(new_logs);
+        }
+    } else {
+        for (const MetaLogProto& meta_log : metalogs.metalogs_proto().metalogs()) {
+            ProvideMetaLog(meta_log);
+        }
+    }
+    return metalog_position_ > prev_metalog_position;
+}
+
 void LogSpaceBase::Freeze() {
     DCHECK(state_ == kNormal);
     state_ = kFrozen;
@@ -96,12 +198,19 @@ void LogSpaceBase::SerializeToProto(MetaLogsProto* meta_logs_proto) {
     DCHECK(state_ == kFinalized && mode_ == kFullMode);
     meta_logs_proto->Clear();
     meta_logs_proto->set_logspace_id(identifier());
+    // Truncated history is not included
+    for (uint32_t pos = spilled_metalogs_start_; pos < applied_metalogs_start_; pos++) {
+        auto metalog = ReadSpilledMetaLog(pos);
+        CHECK(metalog.has_value());
+        meta_logs_proto->add_metalogs()->CopyFrom(*metalog);
+    }
     for (const MetaLogProto* metalog : applied_metalogs_) {
         meta_logs_proto->add_metalogs()->CopyFrom(*metalog);
     }
 }
 
 void LogSpaceBase::AdvanceMetaLogProgress() {
+    uint32_t prev_metalog_position = metalog_position_;
     auto iter = pending_metalogs_.begin();
     while (iter != pending_metalogs_.end()) {
         if (iter->first < metalog_position_) {
@@ -118,38 +227,49 @@ void LogSpaceBase::AdvanceMetaLogProgress() {
             metalog_pool_.Return(meta_log);
             break;
         case kFullMode:
-            DCHECK_EQ(size_t{metalog_position_}, applied_metalogs_.size());
+            DCHECK_EQ(size_t{metalog_position_ - applied_metalogs_start_},
+                      applied_metalogs_.size());
             applied_metalogs_.push_back(meta_log);
             break;
         default:
             UNREACHABLE();
         }
         metalog_position_ = meta_log->metalog_seqnum() + 1;
-        OnMetaLogApplied(*meta_log);
+        OnMetaLogApplied(meta_log->metalog_seqnum(), meta_log->type());
         iter = pending_metalogs_.erase(iter);
     }
+    if (mode_ == kFullMode && metalog_position_ > prev_metalog_position) {
+        TruncateMetaLogHistory();
+    }
 }
 
 bool LogSpaceBase::CanApplyMetaLog(const MetaLogProto& meta_log) {
+    switch (meta_log.type()) {
+    case MetaLogProto::NEW_LOGS:
+        return CanApplyNewLogs(meta_log.metalog_seqnum(), meta_log.new_logs_proto());
+    default:
+        DCHECK(mode_ == kFullMode);
+        return meta_log.metalog_seqnum() == metalog_position_;
+    }
+}
+
+template<class T>
+bool LogSpaceBase::CanApplyNewLogs(uint32_t metalog_seqnum, const T& new_logs) {
     switch (mode_) {
     case kLiteMode:
-        switch (meta_log.type()) {
-        case MetaLogProto::NEW_LOGS:
-            for (size_t shard_idx : interested_shards_) {
-                uint32_t shard_start = meta_log.new_logs_proto().shard_starts(
-                    static_cast<int>(shard_idx));
-                DCHECK_GE(shard_start, shard_progrsses_[shard_idx]);
-                if (shard_start > shard_progrsses_[shard_idx]) {
-                    return false;
-                }
-            }
+        if (resync_shard_cuts_) {
             return true;
-        default:
-            break;
         }
-        break;
+        for (size_t shard_idx : interested_shards_) {
+            uint32_t shard_start = new_logs.shard_starts(static_cast<int>(shard_idx));
+            DCHECK_GE(shard_start, shard_progrsses_[shard_idx]);
+            if (shard_start > shard_progrsses_[shard_idx]) {
+                return false;
+            }
+        }
+        return true;
     case kFullMode:
-        return meta_log.metalog_seqnum() == metalog_position_;
+        return metalog_seqnum == metalog_position_;
     default:
         break;
     }
@@ -159,27 +279,7 @@ bool LogSpaceBase::CanApplyMetaLog(const MetaLogProto& meta_log) {
 void LogSpaceBase::ApplyMetaLog(const MetaLogProto& meta_log) {
     switch (meta_log.type()) {
     case MetaLogProto::NEW_LOGS:
-        {
-            const auto& new_logs = meta_log.new_logs_proto();
-            const View::NodeIdVec& engine_node_ids = view_->GetEngineNodes();
-            uint32_t start_seqnum = new_logs.start_seqnum();
-            HVLOG_F(1, "Apply NEW_LOGS meta log: metalog_seqnum={}, start_seqnum={}",
-                    meta_log.metalog_seqnum(), start_seqnum);
-            for (size_t i = 0; i < engine_node_ids.size(); i++) {
-                uint32_t shard_start = new_logs.shard_starts(static_cast<int>(i));
-                uint32_t delta = new_logs.shard_deltas(static_cast<int>(i));
-                uint64_t start_localid = bits::JoinTwo32(engine_node_ids[i], shard_start);
-                if (mode_ == kFullMode || interested_shards_.contains(i)) {
-                    OnNewLogs(meta_log.metalog_seqnum(),
-                              bits::JoinTwo32(identifier(), start_seqnum),
-                              start_localid, delta);
-                }
-                shard_progrsses_[i] = shard_start + delta;
-                start_seqnum += delta;
-            }
-            DCHECK_GT(start_seqnum, seqnum_position_);
-            seqnum_position_ = start_seqnum;
-        }
+        ApplyNewLogs(meta_log.metalog_seqnum(), meta_log.new_logs_proto());
         break;
     case MetaLogProto::TRIM:
         DCHECK(mode_ == kFullMode);
@@ -195,5 +295,131 @@ void LogSpaceBase::ApplyMetaLog(const MetaLogProto& meta_log) {
     }
 }
 
+template<class T>
+void LogSpaceBase::ApplyNewLogs(uint32_t metalog_seqnum, const T& new_logs) {
+    const View::NodeIdVec& engine_node_ids = view_->GetEngineNodes();
+    uint32_t start_seqnum = new_logs.start_seqnum();
+    HVLOG_F(1, "Apply NEW_LOGS meta log: metalog_seqnum={}, start_seqnum={}",
+            metalog_seqnum, start_seqnum);
+    if (resync_shard_cuts_) {
+        for (size_t shard_idx : interested_shards_) {
+            uint32_t shard_start = new_logs.shard_starts(static_cast<int>(shard_idx));
+            if (shard_start > shard_progrsses_[shard_idx]) {
+                HLOG_F(WARNING, "Skip {} log entries of engine {} missed before restart",
+                       shard_start - shard_progrsses_[shard_idx],
+                       engine_node_ids[shard_idx]);
+            }
+        }
+        resync_shard_cuts_ = false;
+    }
+    for (size_t i = 0; i < engine_node_ids.size(); i++) {
+        uint32_t shard_start = new_logs.shard_starts(static_cast<int>(i));
+        uint32_t delta = new_logs.shard_deltas(static_cast<int>(i));
+        uint64_t start_localid = bits::JoinTwo32(engine_node_ids[i], shard_start);
+        if (mode_ == kFullMode || interested_shards_.contains(i)) {
+            OnNewLogs(metalog_seqnum,
+                      bits::JoinTwo32(identifier(), start_seqnum),
+                      start_localid, delta);
+        }
+        shard_progrsses_[i] = shard_start + delta;
+        start_seqnum += delta;
+    }
+    DCHECK_GT(start_seqnum, seqnum_position_);
+    seqnum_position_ = start_seqnum;
+}
+
+void LogSpaceBase::TruncateMetaLogHistory() {
+    if (metalog_history_window_ == 0) {
+        return;
+    }
+    uint32_t low_water_mark = std::min(metalog_low_water_mark(), metalog_position_);
+    while (spilled_metalogs_start_ < std::min(low_water_mark, applied_metalogs_start_)) {
+        spilled_metalog_offsets_.pop_front();
+        spilled_metalogs_start_++;
+    }
+    if (spilled_metalog_offsets_.empty() && spill_file_size_ > 0) {
+        // All spilled entries are acknowledged, reclaim the spill file
+        PCHECK(ftruncate(spill_fd_, 0) == 0);
+        spill_file_size_ = 0;
+    }
+    while (applied_metalogs_.size() > metalog_history_window_) {
+        MetaLogProto* meta_log = applied_metalogs_.front();
+        if (applied_metalogs_start_ >= low_water_mark) {
+            // Not acknowledged yet, have to keep it somewhere
+            if (!SpillMetaLog(*meta_log)) {
+                break;
+            }
+        } else {
+            DCHECK(spilled_metalog_offsets_.empty());
+            spilled_metalogs_start_ = applied_metalogs_start_ + 1;
+        }
+        applied_metalogs_.pop_front();
+        applied_metalogs_start_++;
+        metalog_pool_.Return(meta_log);
+    }
+}
+
+bool LogSpaceBase::SpillMetaLog(const MetaLogProto& meta_log) {
+    if (spill_fd_ == -1) {
+        std::string spill_dir = absl::GetFlag(FLAGS_slog_metalog_spill_dir);
+        if (spill_dir.empty()) {
+            return false;
+        }
+        std::string path = fs_utils::JoinPath(
+            spill_dir, fmt::format("metalog_{}_{}", getpid(), bits::HexStr(identifier())));
+        int fd = open(path.c_str(), O_CREAT | O_RDWR | O_TRUNC | O_CLOEXEC,
+                      __FAAS_FILE_CREAT_MODE);
+        if (fd == -1) {
+            PLOG_F(ERROR, "Failed to create spill file {}", path);
+            return false;
+        }
+        // Spill file is private to this process
+        fs_utils::Remove(path);
+        spill_fd_ = fd;
+        HLOG_F(INFO, "Spill truncated meta logs to {}", path);
+    }
+    std::string buffer;
+    uint32_t size = gsl::narrow_cast<uint32_t>(meta_log.ByteSizeLong());
+    buffer.resize(sizeof(uint32_t) + size);
+    memcpy(buffer.data(), &size, sizeof(uint32_t));
+    CHECK(meta_log.SerializeToArray(buffer.data() + sizeof(uint32_t),
+                                    static_cast<int>(size)));
+    ssize_t ret = pwrite(spill_fd_, buffer.data(), buffer.size(),
+                         static_cast<off_t>(spill_file_size_));
+    if (ret != static_cast<ssize_t>(buffer.size())) {
+        PLOG(ERROR) << "Failed to write spill file";
+        return false;
+    }
+    DCHECK_EQ(size_t{applied_metalogs_start_ - spilled_metalogs_start_},
+              spilled_metalog_offsets_.size());
+    spilled_metalog_offsets_.push_back(spill_file_size_);
+    spill_file_size_ += buffer.size();
+    return true;
+}
+
+std::optional<MetaLogProto> LogSpaceBase::ReadSpilledMetaLog(uint32_t pos) const {
+    DCHECK(spilled_metalogs_start_ <= pos && pos < applied_metalogs_start_);
+    size_t idx = static_cast<size_t>(pos - spilled_metalogs_start_);
+    uint64_t offset = spilled_metalog_offsets_.at(idx);
+    uint64_t end = (idx + 1 < spilled_metalog_offsets_.size())
+                       ? spilled_metalog_offsets_.at(idx + 1)
+                       : spill_file_size_;
+    std::string buffer(end - offset, 0);
+    ssize_t ret = pread(spill_fd_, buffer.data(), buffer.size(), static_cast<off_t>(offset));
+    if (ret != static_cast<ssize_t>(buffer.size())) {
+        PLOG(ERROR) << "Failed to read spill file";
+        return std::nullopt;
+    }
+    uint32_t size;
+    memcpy(&size, buffer.data(), sizeof(uint32_t));
+    DCHECK_EQ(size_t{size} + sizeof(uint32_t), buffer.size());
+    MetaLogProto meta_log;
+    if (!meta_log.ParseFromArray(buffer.data() + sizeof(uint32_t), static_cast<int>(size))) {
+        HLOG_F(ERROR, "Failed to parse spilled meta log at position {}", pos);
+        return std::nullopt;
+    }
+    return meta_log;
+}
+
 }  // namespace log
 }  // namespace faas
@@ -2,6 +2,7 @@
 
 #include "log/common.h"
 #include "log/view.h"
+#include "log/utils.h"
 #include "utils/lockable_ptr.h"
 #include "utils/object_pool.h"
 #include "utils/bits.h"
@@ -26,6 +27,9 @@ public:
 
     // Return true if metalog_position changed
     bool ProvideMetaLog(const MetaLogProto& meta_log_proto);
+    // Applied in place if it is the next one to apply
+    bool ProvideNewLogs(const FlatNewLogs& new_logs);
+    bool ProvideMetaLogs(const log_utils::MetaLogsPayload& metalogs);
 
     bool frozen() const { return state_ == kFrozen; }
     bool finalized() const { return state_ == kFinalized; }
@@ -43,6 +47,15 @@ protected:
     LogSpaceBase(Mode mode, const View* view, uint16_t sequencer_id);
     void AddInterestedShard(uint16_t engine_id);
 
+    // Localid position of the shard with seqnums assigned
+    uint32_t shard_cut(uint16_t engine_id) const;
+    // Restores positions saved by a previous run, before any meta log is
+    // provided. Meta logs missed since then are skipped by the first meta log
+    // applied, which is only supported in lite mode.
+    void RestorePosition(uint32_t metalog_position, uint32_t seqnum_position,
+                         const absl::flat_hash_map</* engine_id */ uint16_t,
+                                                   /* localid */ uint32_t>& shard_cuts);
+
     using OffsetVec = absl::FixedArray<uint32_t>;
     virtual void OnNewLogs(uint32_t metalog_seqnum,
                            uint64_t start_seqnum, uint64_t start_localid,
@@ -50,9 +63,13 @@ protected:
     virtual void OnTrim(uint32_t metalog_seqnum,
                         uint32_t user_logspace, uint64_t user_tag,
                         uint64_t trim_seqnum) {}
-    virtual void OnMetaLogApplied(const MetaLogProto& meta_log_proto) {}
+    virtual void OnMetaLogApplied(uint32_t metalog_seqnum, MetaLogProto::Type type) {}
     virtual void OnFinalized(uint32_t metalog_position) {} 
 
+    // Applied metalogs below the low-water mark are acknowledged by all
+    // consumers, thus can be dropped from the history
+    virtual uint32_t metalog_low_water_mark() const { return metalog_position_; }
+
     Mode mode_;
     State state_;
     const View* view_;
@@ -64,14 +81,34 @@ private:
     absl::flat_hash_set<size_t> interested_shards_;
     absl::FixedArray<uint32_t> shard_progrsses_;
     uint32_t seqnum_position_;
+    bool resync_shard_cuts_;
 
     utils::ProtobufMessagePool<MetaLogProto> metalog_pool_;
-    std::vector<MetaLogProto*> applied_metalogs_;
     std::map</* metalog_seqnum */ uint32_t, MetaLogProto*> pending_metalogs_;
 
+    // In-memory history covers [applied_metalogs_start_, metalog_position_),
+    // spilled history covers [spilled_metalogs_start_, applied_metalogs_start_)
+    size_t metalog_history_window_;
+    uint32_t applied_metalogs_start_;
+    std::deque<MetaLogProto*> applied_metalogs_;
+
+    int spill_fd_;
+    uint64_t spill_file_size_;
+    uint32_t spilled_metalogs_start_;
+    std::deque</* file_offset */ uint64_t> spilled_metalog_offsets_;
+
+    size_t ShardIndex(uint16_t engine_id) const;
     void AdvanceMetaLogProgress();
     bool CanApplyMetaLog(const MetaLogProto& meta_log);
     void ApplyMetaLog(const MetaLogProto& meta_log);
+    template<class T>
+    bool CanApplyNewLogs(uint32_t metalog_seqnum, const T& new_logs);
+    template<class T>
+    void ApplyNewLogs(uint32_t metalog_seqnum, const T& new_logs);
+
+    void TruncateMetaLogHistory();
+    bool SpillMetaLog(const MetaLogProto& meta_log);
+    std::optional<MetaLogProto> ReadSpilledMetaLog(uint32_t pos) const;
 
     DISALLOW_COPY_AND_ASSIGN(LogSpaceBase);
 };
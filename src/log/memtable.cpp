@@ -0,0 +1,203 @@
+#include "log/memtable.h"
+
+#define log_header_ "LogMemTable: "
+
+namespace faas {
+namespace log {
+
+namespace {
+static constexpr size_t kInitialRingSize = 1024;
+
+static inline size_t AlignedSize(size_t size) {
+    return (size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+}
+}  // namespace
+
+LogMemTable::LogMemTable(size_t capacity, size_t chunk_size, size_t max_entries)
+    : capacity_(capacity),
+      chunk_size_(chunk_size),
+      max_entries_(max_entries),
+      live_bytes_(0),
+      current_chunk_(nullptr),
+      ring_(kInitialRingSize),
+      ring_head_(0),
+      ring_size_(0) {}
+
+LogMemTable::~LogMemTable() {}
+
+void LogMemTable::AddPending(const LogMetaData& log_metadata,
+                             std::span<const uint64_t> user_tags,
+                             std::span<const char> log_data, bool durable) {
+    DCHECK_EQ(log_metadata.num_tags, user_tags.size());
+    DCHECK_EQ(log_metadata.data_size, log_data.size());
+    if (pending_.contains(log_metadata.localid)) {
+        Release(pending_.at(log_metadata.localid));
+    }
+    Slot slot = Allocate(log_metadata);
+    slot.durable = durable;
+    char* ptr = slot.chunk->buf.get() + slot.offset;
+    if (!user_tags.empty()) {
+        memcpy(ptr, user_tags.data(), user_tags.size() * sizeof(uint64_t));
+        ptr += user_tags.size() * sizeof(uint64_t);
+    }
+    if (!log_data.empty()) {
+        memcpy(ptr, log_data.data(), log_data.size());
+    }
+    pending_[log_metadata.localid] = slot;
+}
+
+bool LogMemTable::MarkPendingDurable(uint64_t localid) {
+    auto iter = pending_.find(localid);
+    if (iter == pending_.end()) {
+        return false;
+    }
+    iter->second.durable = true;
+    return true;
+}
+
+bool LogMemTable::Finalize(uint64_t localid, uint64_t seqnum, LogEntryView* view) {
+    auto iter = pending_.find(localid);
+    if (iter == pending_.end()) {
+        return false;
+    }
+    Slot slot = iter->second;
+    pending_.erase(iter);
+    DCHECK(empty() || seqnum > last_seqnum());
+    slot.metadata.seqnum = seqnum;
+    RingPushBack(slot);
+    live_bytes_ += EntrySize(slot.metadata);
+    if (view != nullptr) {
+        *view = MakeView(slot);
+    }
+    return true;
+}
+
+void LogMemTable::ClearPending() {
+    for (const auto& [localid, slot] : pending_) {
+        Release(slot);
+    }
+    pending_.clear();
+}
+
+uint64_t LogMemTable::first_seqnum() const {
+    DCHECK(!empty());
+    return RingAt(0).metadata.seqnum;
+}
+
+uint64_t LogMemTable::last_seqnum() const {
+    DCHECK(!empty());
+    return RingAt(ring_size_ - 1).metadata.seqnum;
+}
+
+std::optional<LogEntryView> LogMemTable::Get(uint64_t seqnum) const {
+    size_t idx = LowerBound(seqnum);
+    if (idx == ring_size_ || RingAt(idx).metadata.seqnum != seqnum) {
+        return std::nullopt;
+    }
+    return MakeView(RingAt(idx));
+}
+
+void LogMemTable::GetFrom(uint64_t start_seqnum, std::vector<LogEntryView>* views) const {
+    views->clear();
+    size_t idx = LowerBound(start_seqnum);
+    views->reserve(ring_size_ - idx);
+    for (; idx < ring_size_; idx++) {
+        views->push_back(MakeView(RingAt(idx)));
+    }
+}
+
+void LogMemTable::Shrink(uint64_t seqnum_limit) {
+    while ((live_bytes_ > capacity_ || (max_entries_ > 0 && ring_size_ > max_entries_))
+               && !empty() && first_seqnum() < seqnum_limit) {
+        RingPopFront();
+    }
+}
+
+size_t LogMemTable::LowerBound(uint64_t seqnum) const {
+    size_t lo = 0;
+    size_t hi = ring_size_;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (RingAt(mid).metadata.seqnum < seqnum) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+void LogMemTable::RingPushBack(const Slot& slot) {
+    if (ring_size_ == ring_.size()) {
+        std::vector<Slot> new_ring(ring_.size() * 2);
+        for (size_t i = 0; i < ring_size_; i++) {
+            new_ring[i] = RingAt(i);
+        }
+        ring_.swap(new_ring);
+        ring_head_ = 0;
+    }
+    ring_[(ring_head_ + ring_size_) & (ring_.size() - 1)] = slot;
+    ring_size_++;
+}
+
+void LogMemTable::RingPopFront() {
+    DCHECK(!empty());
+    const Slot& slot = RingAt(0);
+    live_bytes_ -= EntrySize(slot.metadata);
+    Release(slot);
+    ring_head_ = (ring_head_ + 1) & (ring_.size() - 1);
+    ring_size_--;
+}
+
+LogMemTable::Slot LogMemTable::Allocate(const LogMetaData& log_metadata) {
+    size_t size = AlignedSize(EntrySize(log_metadata));
+    if (current_chunk_ == nullptr || current_chunk_->used + size > current_chunk_->size) {
+        if (current_chunk_ != nullptr && current_chunk_->num_entries == 0) {
+            chunks_.erase(current_chunk_);
+        }
+        auto chunk = std::make_shared<Chunk>();
+        chunk->size = std::max(chunk_size_, size);
+        chunk->buf.reset(new char[chunk->size]);
+        chunk->used = 0;
+        chunk->num_entries = 0;
+        current_chunk_ = chunk.get();
+        chunks_[current_chunk_] = std::move(chunk);
+        HVLOG_F(1, "Allocate new chunk of size {}, {} chunks in use",
+                current_chunk_->size, chunks_.size());
+    }
+    Slot slot = {
+        .metadata = log_metadata,
+        .chunk = current_chunk_,
+        .offset = current_chunk_->used,
+        .durable = true
+    };
+    current_chunk_->used += size;
+    current_chunk_->num_entries++;
+    return slot;
+}
+
+void LogMemTable::Release(const Slot& slot) {
+    Chunk* chunk = slot.chunk;
+    DCHECK_GT(chunk->num_entries, 0U);
+    chunk->num_entries--;
+    if (chunk->num_entries == 0 && chunk != current_chunk_) {
+        // Views may still hold the chunk
+        chunks_.erase(chunk);
+    }
+}
+
+LogEntryView LogMemTable::MakeView(const Slot& slot) const {
+    const char* ptr = slot.chunk->buf.get() + slot.offset;
+    size_t num_tags = slot.metadata.num_tags;
+    return LogEntryView {
+        .metadata = slot.metadata,
+        .user_tags = std::span<const uint64_t>(
+            reinterpret_cast<const uint64_t*>(ptr), num_tags),
+        .data = std::span<const char>(
+            ptr + num_tags * sizeof(uint64_t), slot.metadata.data_size),
+        .chunk = slot.chunk->shared_from_this()
+    };
+}
+
+}  // namespace log
+}  // namespace faas
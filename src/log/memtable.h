@@ -0,0 +1,106 @@
+#pragma once
+
+#include "log/common.h"
+
+namespace faas {
+namespace log {
+
+// Zero-copy view of a log entry in LogMemTable. It keeps the arena chunk
+// holding the entry alive, thus remains valid after the entry is dropped.
+struct LogEntryView {
+    LogMetaData metadata;
+    std::span<const uint64_t> user_tags;
+    std::span<const char> data;
+    std::shared_ptr<const void> chunk;
+};
+
+// Live log entries of LogStorage. Tags and data of entries are copied into
+// a bump-allocated arena of chunks. Once assigned seqnums, entries are kept
+// in a ring of slots ordered by seqnum. A chunk is freed after all its
+// entries are dropped and no view refers to it.
+// LogMemTable is NOT thread-safe
+class LogMemTable {
+public:
+    // `capacity` is in bytes of tags and data of entries with seqnums,
+    // `max_entries` caps their number as well, 0 for no cap
+    LogMemTable(size_t capacity, size_t chunk_size, size_t max_entries = 0);
+    ~LogMemTable();
+
+    size_t num_pending() const { return pending_.size(); }
+    bool ContainsPending(uint64_t localid) const {
+        return pending_.contains(localid);
+    }
+    // Pending entries not `durable` are expected to be marked later
+    bool IsPendingDurable(uint64_t localid) const {
+        auto iter = pending_.find(localid);
+        return iter != pending_.end() && iter->second.durable;
+    }
+    void AddPending(const LogMetaData& log_metadata,
+                    std::span<const uint64_t> user_tags,
+                    std::span<const char> log_data, bool durable = true);
+    bool MarkPendingDurable(uint64_t localid);
+    // Move the pending entry of `localid` into the ring
+    bool Finalize(uint64_t localid, uint64_t seqnum, LogEntryView* view);
+    void ClearPending();
+
+    bool empty() const { return ring_size_ == 0; }
+    size_t size() const { return ring_size_; }
+    size_t live_bytes() const { return live_bytes_; }
+    uint64_t first_seqnum() const;
+    uint64_t last_seqnum() const;
+
+    std::optional<LogEntryView> Get(uint64_t seqnum) const;
+    // Views of all entries with seqnum >= `start_seqnum`
+    void GetFrom(uint64_t start_seqnum, std::vector<LogEntryView>* views) const;
+    // Drop oldest entries with seqnum < `seqnum_limit`, until within capacity
+    void Shrink(uint64_t seqnum_limit);
+
+private:
+    struct Chunk : public std::enable_shared_from_this<Chunk> {
+        std::unique_ptr<char[]> buf;
+        size_t size;
+        size_t used;
+        size_t num_entries;
+    };
+    struct Slot {
+        LogMetaData metadata;
+        Chunk*      chunk;
+        size_t      offset;
+        bool        durable;  // Meaningful only for pending entries
+    };
+
+    const size_t capacity_;
+    const size_t chunk_size_;
+    const size_t max_entries_;
+    size_t live_bytes_;
+
+    Chunk* current_chunk_;
+    absl::flat_hash_map<Chunk*, std::shared_ptr<Chunk>> chunks_;
+
+    absl::flat_hash_map</* localid */ uint64_t, Slot> pending_;
+
+    // Size of `ring_` is always a power of 2
+    std::vector<Slot> ring_;
+    size_t ring_head_;
+    size_t ring_size_;
+
+    const Slot& RingAt(size_t idx) const {
+        return ring_[(ring_head_ + idx) & (ring_.size() - 1)];
+    }
+    // Index of the first slot with seqnum >= `seqnum`
+    size_t LowerBound(uint64_t seqnum) const;
+    void RingPushBack(const Slot& slot);
+    void RingPopFront();
+
+    static size_t EntrySize(const LogMetaData& metadata) {
+        return metadata.num_tags * sizeof(uint64_t) + metadata.data_size;
+    }
+    Slot Allocate(const LogMetaData& log_metadata);
+    void Release(const Slot& slot);
+    LogEntryView MakeView(const Slot& slot) const;
+
+    DISALLOW_COPY_AND_ASSIGN(LogMemTable);
+};
+
+}  // namespace log
+}  // namespace faas
@@ -233,8 +233,8 @@ void Sequencer::OnRecvNewMetaLogs(const SharedLogMessage& message,
                                   std::span<const char> payload) {
     DCHECK(SharedLogMessageHelper::GetOpType(message) == SharedLogOpType::METALOGS);
     uint32_t logspace_id = message.logspace_id;
-    MetaLogsProto metalogs_proto = log_utils::MetaLogsFromPayload(payload);
-    DCHECK_EQ(metalogs_proto.logspace_id(), logspace_id);
+    log_utils::MetaLogsPayload metalogs(message, payload);
+    DCHECK_EQ(metalogs.logspace_id(), logspace_id);
     uint32_t old_metalog_position;
     uint32_t new_metalog_position;
     {
@@ -246,9 +246,7 @@ void Sequencer::OnRecvNewMetaLogs(const SharedLogMessage& message,
             auto locked_logspace = logspace_ptr.Lock();
             RETURN_IF_LOGSPACE_INACTIVE(locked_logspace);
             old_metalog_position = locked_logspace->metalog_position();
-            for (const MetaLogProto& metalog_proto : metalogs_proto.metalogs()) {
-                locked_logspace->ProvideMetaLog(metalog_proto);
-            }
+            locked_logspace->ProvideMetaLogs(metalogs);
             new_metalog_position = locked_logspace->metalog_position();
         }
     }
@@ -1,6 +1,7 @@
 #include "log/sequencer_base.h"
 
 #include "log/flags.h"
+#include "log/utils.h"
 #include "server/constants.h"
 #include "utils/bits.h"
 
@@ -80,11 +81,17 @@ void SequencerBase::MessageHandler(const SharedLogMessage& message,
 }
 
 namespace {
-static std::string SerializedMetaLogs(const MetaLogProto& metalog) {
+static std::string SerializedMetaLogs(const MetaLogProto& metalog,
+                                      SharedLogMessage* message) {
+    std::string serialized;
+    if (metalog.type() == MetaLogProto::NEW_LOGS) {
+        log_utils::EncodeFlatNewLogs(metalog, &serialized);
+        message->flags |= protocol::kFlatMetaLogsFlag;
+        return serialized;
+    }
     MetaLogsProto metalogs_proto;
     metalogs_proto.set_logspace_id(metalog.logspace_id());
     metalogs_proto.add_metalogs()->CopyFrom(metalog);
-    std::string serialized;
     CHECK(metalogs_proto.SerializeToString(&serialized));
     return serialized;
 }
@@ -94,7 +101,7 @@ void SequencerBase::ReplicateMetaLog(const View* view, const MetaLogProto& metal
     uint32_t logspace_id = metalog.logspace_id();
     DCHECK_EQ(bits::LowHalf32(logspace_id), my_node_id());
     SharedLogMessage message = SharedLogMessageHelper::NewMetaLogsMessage(logspace_id);
-    std::string payload = SerializedMetaLogs(metalog);
+    std::string payload = SerializedMetaLogs(metalog, &message);
     message.origin_node_id = node_id_;
     message.payload_size = gsl::narrow_cast<uint32_t>(payload.size());
     const View::Sequencer* sequencer_node = view->GetSequencerNode(my_node_id());
@@ -137,7 +144,7 @@ void SequencerBase::PropagateMetaLog(const View* view, const MetaLogProto& metal
         UNREACHABLE();
     }
     SharedLogMessage message = SharedLogMessageHelper::NewMetaLogsMessage(metalog.logspace_id());
-    std::string payload = SerializedMetaLogs(metalog);
+    std::string payload = SerializedMetaLogs(metalog, &message);
     message.origin_node_id = node_id_;
     message.payload_size = gsl::narrow_cast<uint32_t>(payload.size());
     for (uint16_t engine_id : engine_nodes) {
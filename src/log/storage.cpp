@@ -1,10 +1,9 @@
 #include "log/storage.h"
 
+#include "common/time.h"
 #include "log/flags.h"
 #include "log/utils.h"
 #include "utils/bits.h"
-#include "utils/io.h"
-#include "utils/timerfd.h"
 
 namespace faas {
 namespace log {
@@ -17,7 +16,25 @@ Storage::Storage(uint16_t node_id)
     : StorageBase(node_id),
       log_header_(fmt::format("Storage[{}-N]: ", node_id)),
       current_view_(nullptr),
-      view_finalized_(false) {}
+      view_finalized_(false),
+      flush_trigger_bytes_(absl::GetFlag(FLAGS_slog_storage_flush_trigger_kb) << 10),
+      readahead_entries_(absl::GetFlag(FLAGS_slog_storage_readahead_entries)),
+      persist_aux_data_(absl::GetFlag(FLAGS_slog_storage_persist_aux_data)),
+      max_aux_data_size_(absl::GetFlag(FLAGS_slog_storage_max_aux_data_size)),
+      archive_interval_us_(int64_t{absl::GetFlag(FLAGS_slog_storage_archive_interval_sec)}
+                           * 1000000),
+      archive_age_us_(int64_t{absl::GetFlag(FLAGS_slog_storage_archive_age_sec)} * 1000000),
+      archive_hot_seqnums_(gsl::narrow_cast<uint32_t>(
+          absl::GetFlag(FLAGS_slog_storage_archive_hot_seqnums))) {
+    for (size_t i = 0; i < num_background_threads(); i++) {
+        flush_workers_.push_back(std::make_unique<FlushWorker>());
+        flush_workers_.back()->triggered = false;
+    }
+    size_t decoded_cache_cap = absl::GetFlag(FLAGS_slog_storage_decoded_cache_entries);
+    if (decoded_cache_cap > 0) {
+        decoded_log_cache_.emplace(decoded_cache_cap);
+    }
+}
 
 Storage::~Storage() {}
 
@@ -36,8 +53,10 @@ void Storage::OnViewCreated(const View* view) {
                 if (!view->is_active_phylog(sequencer_id)) {
                     continue;
                 }
-                storage_collection_.InstallLogSpace(std::make_unique<LogStorage>(
-                    my_node_id(), view, sequencer_id));
+                auto storage = CreateLogStorage(view, sequencer_id);
+                if (storage != nullptr) {
+                    storage_collection_.InstallLogSpace(std::move(storage));
+                }
             }
         }
         future_requests_.OnNewView(view, contains_myself ? &ready_requests : nullptr);
@@ -98,6 +117,49 @@ void Storage::OnViewFinalized(const FinalizedView* finalized_view) {
     }
 }
 
+std::unique_ptr<LogStorage> Storage::CreateLogStorage(const View* view,
+                                                      uint16_t sequencer_id) {
+    auto storage = std::make_unique<LogStorage>(my_node_id(), view, sequencer_id);
+    uint32_t logspace_id = storage->identifier();
+    std::optional<StorageCheckpointProto> checkpoint = GetCheckpointFromDB(logspace_id);
+    std::vector<LogEntry> recovered_entries = TakeRecoveredEntries(logspace_id);
+    if (checkpoint.has_value() && checkpoint->finalized()) {
+        HLOG_F(INFO, "Log space {} finalized and persisted before restart",
+               bits::HexStr0x(logspace_id));
+        ReleaseJournalLogSpace(logspace_id);
+        // Its age counts from restart
+        AddColdLogSpace(logspace_id, bits::JoinTwo32(
+            logspace_id, checkpoint->persisted_seqnum_position()));
+        return nullptr;
+    }
+    if (!checkpoint.has_value() && recovered_entries.empty()) {
+        return storage;
+    }
+    if (!checkpoint.has_value()) {
+        // Restart before the first flush
+        checkpoint.emplace();
+        checkpoint->set_logspace_id(logspace_id);
+    }
+    int64_t start_timestamp = GetMonotonicMicroTimestamp();
+    uint64_t persisted_position = FindDBTail(
+        bits::JoinTwo32(logspace_id, checkpoint->persisted_seqnum_position()));
+    storage->RestoreFromCheckpoint(*checkpoint, persisted_position);
+    size_t num_recovered = 0;
+    for (const LogEntry& log_entry : recovered_entries) {
+        if (storage->RecoverFromJournal(log_entry)) {
+            num_recovered++;
+        } else {
+            ReleaseJournalEntry(logspace_id, log_entry.metadata.localid);
+        }
+    }
+    storage->FinishRecovery();
+    HLOG_F(INFO, "Restore log space {}: persisted_position={}, "
+                 "recovered_entries={}, took {}us",
+           bits::HexStr0x(logspace_id), bits::HexStr0x(persisted_position),
+           num_recovered, GetMonotonicMicroTimestamp() - start_timestamp);
+    return storage;
+}
+
 #define ONHOLD_IF_FROM_FUTURE_VIEW(MESSAGE_VAR, PAYLOAD_VAR)        \
     do {                                                            \
         if (current_view_ == nullptr                                \
@@ -153,6 +215,10 @@ void Storage::HandleReadAtRequest(const SharedLogMessage& request) {
 void Storage::HandleReplicateRequest(const SharedLogMessage& message,
                                      std::span<const char> payload) {
     DCHECK(SharedLogMessageHelper::GetOpType(message) == SharedLogOpType::REPLICATE);
+    if ((message.flags & protocol::kReplicateBatchFlag) != 0) {
+        HandleReplicateBatch(message, payload);
+        return;
+    }
     LogMetaData metadata = log_utils::GetMetaDataFromMessage(message);
     std::span<const uint64_t> user_tags;
     std::span<const char> log_data;
@@ -166,21 +232,81 @@ void Storage::HandleReplicateRequest(const SharedLogMessage& message,
         {
             auto locked_storage = storage_ptr.Lock();
             RETURN_IF_LOGSPACE_FINALIZED(locked_storage);
-            if (!locked_storage->Store(metadata, user_tags, log_data)) {
+            bool durable = (GetDurabilityLevel(metadata.user_logspace)
+                              == DurabilityLevel::kMemory);
+            if (!locked_storage->Store(metadata, user_tags, log_data, durable)) {
+                HLOG(ERROR) << "Failed to store log entry";
+            } else if (!durable) {
+                AppendToJournal(message.logspace_id, metadata, user_tags, log_data);
+            }
+        }
+    }
+}
+
+void Storage::HandleReplicateBatch(const SharedLogMessage& message,
+                                   std::span<const char> payload) {
+    DCHECK((message.flags & protocol::kReplicateBatchFlag) != 0);
+    log_utils::ReplicateRecordVec records = log_utils::SplitReplicateBatch(payload);
+    HVLOG_F(1, "Receive replicate batch of {} records from engine {}",
+            records.size(), message.origin_node_id);
+    absl::ReaderMutexLock view_lk(&view_mu_);
+    ONHOLD_IF_FROM_FUTURE_VIEW(message, payload);
+    IGNORE_IF_FROM_PAST_VIEW(message);
+    size_t idx = 0;
+    while (idx < records.size()) {
+        // Consecutive records of the same log space are stored under one lock
+        uint32_t logspace_id = records[idx].first.logspace_id;
+        auto storage_ptr = storage_collection_.GetLogSpaceChecked(logspace_id);
+        auto locked_storage = storage_ptr.Lock();
+        for (; idx < records.size() && records[idx].first.logspace_id == logspace_id; idx++) {
+            const auto& [record, record_payload] = records[idx];
+            DCHECK_EQ(record.view_id, message.view_id);
+            if (locked_storage->finalized()) {
+                HLOG_F(WARNING, "LogSpace {} is finalized", bits::HexStr0x(logspace_id));
+                continue;
+            }
+            LogMetaData metadata = log_utils::GetMetaDataFromMessage(record);
+            std::span<const uint64_t> user_tags;
+            std::span<const char> log_data;
+            log_utils::SplitPayloadForMessage(record, record_payload, &user_tags, &log_data,
+                                              /* aux_data= */ nullptr);
+            bool durable = (GetDurabilityLevel(metadata.user_logspace)
+                              == DurabilityLevel::kMemory);
+            if (!locked_storage->Store(metadata, user_tags, log_data, durable)) {
                 HLOG(ERROR) << "Failed to store log entry";
+            } else if (!durable) {
+                AppendToJournal(logspace_id, metadata, user_tags, log_data);
             }
         }
     }
 }
 
+void Storage::OnJournalEntriesDurable(const LogJournal::EntryKeyVec& entries) {
+    absl::flat_hash_map</* logspace_id */ uint32_t, std::vector<uint64_t>> localids;
+    for (const auto& [logspace_id, localid] : entries) {
+        localids[logspace_id].push_back(localid);
+    }
+    absl::ReaderMutexLock view_lk(&view_mu_);
+    for (const auto& [logspace_id, logspace_localids] : localids) {
+        auto storage_ptr = storage_collection_.GetLogSpace(logspace_id);
+        if (storage_ptr.is_null()) {
+            continue;
+        }
+        // Shard progress is sent by the timer
+        auto locked_storage = storage_ptr.Lock();
+        locked_storage->LogEntriesDurable(VECTOR_AS_SPAN(logspace_localids));
+    }
+}
+
 void Storage::OnRecvNewMetaLogs(const SharedLogMessage& message,
                                 std::span<const char> payload) {
     DCHECK(SharedLogMessageHelper::GetOpType(message) == SharedLogOpType::METALOGS);
-    MetaLogsProto metalogs_proto = log_utils::MetaLogsFromPayload(payload);
-    DCHECK_EQ(metalogs_proto.logspace_id(), message.logspace_id);
+    log_utils::MetaLogsPayload metalogs(message, payload);
+    DCHECK_EQ(metalogs.logspace_id(), message.logspace_id);
     const View* view = nullptr;
     LogStorage::ReadResultVec results;
     std::optional<IndexDataProto> index_data;
+    bool need_flush = false;
     {
         absl::ReaderMutexLock view_lk(&view_mu_);
         ONHOLD_IF_FROM_FUTURE_VIEW(message, payload);
@@ -190,13 +316,16 @@ void Storage::OnRecvNewMetaLogs(const SharedLogMessage& message,
         {
             auto locked_storage = storage_ptr.Lock();
             RETURN_IF_LOGSPACE_FINALIZED(locked_storage);
-            for (const MetaLogProto& metalog_proto : metalogs_proto.metalogs()) {
-                locked_storage->ProvideMetaLog(metalog_proto);
-            }
+            locked_storage->ProvideMetaLogs(metalogs);
             locked_storage->PollReadResults(&results);
             index_data = locked_storage->PollIndexData();
+            need_flush = flush_trigger_bytes_ > 0
+                      && locked_storage->unpersisted_bytes() >= flush_trigger_bytes_;
         }
     }
+    if (need_flush) {
+        TriggerFlush(message.logspace_id);
+    }
     ProcessReadResults(results);
     if (index_data.has_value()) {
         SendIndexData(DCHECK_NOTNULL(view), *index_data);
@@ -207,7 +336,17 @@ void Storage::OnRecvLogAuxData(const protocol::SharedLogMessage& message,
                                std::span<const char> payload) {
     DCHECK(SharedLogMessageHelper::GetOpType(message) == SharedLogOpType::SET_AUXDATA);
     uint64_t seqnum = bits::JoinTwo32(message.logspace_id, message.seqnum_lowhalf);
-    LogCachePutAuxData(seqnum, payload);
+    LogCachePutAuxData(message.user_logspace, seqnum, payload);
+    if (!persist_aux_data_) {
+        return;
+    }
+    if (max_aux_data_size_ > 0 && payload.size() > max_aux_data_size_) {
+        HVLOG_F(1, "Aux data of log {} too large to persist: size={}",
+                bits::HexStr0x(seqnum), payload.size());
+        return;
+    }
+    absl::MutexLock lk(&aux_data_mu_);
+    pending_aux_data_[seqnum] = std::string(payload.data(), payload.size());
 }
 
 #undef ONHOLD_IF_FROM_FUTURE_VIEW
@@ -227,7 +366,7 @@ void Storage::ProcessReadResults(const LogStorage::ReadResultVec& results) {
             response.user_metalog_progress = request.user_metalog_progress;
             SendEngineLogResult(request, &response,
                                 VECTOR_AS_CHAR_SPAN(result.log_entry->user_tags),
-                                STRING_AS_SPAN(result.log_entry->data));
+                                result.log_entry->data);
             break;
         case LogStorage::ReadResult::kLookupDB:
             ProcessReadFromDB(request);
@@ -246,15 +385,14 @@ void Storage::ProcessReadResults(const LogStorage::ReadResultVec& results) {
 
 void Storage::ProcessReadFromDB(const SharedLogMessage& request) {
     uint64_t seqnum = bits::JoinTwo32(request.logspace_id, request.seqnum_lowhalf);
-    LogEntryProto log_entry;
-    if (auto tmp = GetLogEntryFromDB(seqnum); tmp.has_value()) {
-        log_entry = std::move(*tmp);
-    } else {
+    std::shared_ptr<const LogEntryProto> log_entry_ptr = ReadLogEntryFromDB(request);
+    if (log_entry_ptr == nullptr) {
         HLOG_F(ERROR, "Failed to read log data (seqnum={})", bits::HexStr0x(seqnum));
         SharedLogMessage response = SharedLogMessageHelper::NewDataLostResponse();
         SendEngineResponse(request, &response);
         return;
     }
+    const LogEntryProto& log_entry = *log_entry_ptr;
     SharedLogMessage response = SharedLogMessageHelper::NewReadOkResponse();
     log_utils::PopulateMetaDataToMessage(log_entry, &response);
     DCHECK_EQ(response.logspace_id, request.logspace_id);
@@ -263,8 +401,69 @@ void Storage::ProcessReadFromDB(const SharedLogMessage& request) {
     std::span<const char> user_tags_data(
         reinterpret_cast<const char*>(log_entry.user_tags().data()),
         static_cast<size_t>(log_entry.user_tags().size()) * sizeof(uint64_t));
+    // Entries are cached compressed, and decompressed for each read
+    std::string decompressed_data;
+    std::span<const char> log_data = STRING_AS_SPAN(log_entry.data());
+    if (log_entry.dict_version() > 0) {
+        if (!DecompressLogData(log_entry, &decompressed_data)) {
+            HLOG_F(ERROR, "Failed to decompress log data (seqnum={})", bits::HexStr0x(seqnum));
+            response = SharedLogMessageHelper::NewDataLostResponse();
+            SendEngineResponse(request, &response);
+            return;
+        }
+        log_data = STRING_AS_SPAN(decompressed_data);
+    }
     SendEngineLogResult(request, &response, user_tags_data,
-                        STRING_AS_SPAN(log_entry.data()));
+                        log_data, /* lookup_db= */ true);
+}
+
+std::shared_ptr<const LogEntryProto> Storage::ReadLogEntryFromDB(
+        const SharedLogMessage& request) {
+    uint64_t seqnum = bits::JoinTwo32(request.logspace_id, request.seqnum_lowhalf);
+    bool sequential = IsSequentialDBRead(request);
+    if (decoded_log_cache_.has_value()) {
+        if (auto log_entry = decoded_log_cache_->Get(seqnum); log_entry != nullptr) {
+            return log_entry;
+        }
+        std::vector<LogEntryProto> log_entries;
+        if (sequential && readahead_entries_ > 0
+                && ScanLogEntriesFromDB(seqnum, readahead_entries_, &log_entries)) {
+            HVLOG_F(1, "Read ahead {} log entries from seqnum {}",
+                    log_entries.size(), bits::HexStr0x(seqnum));
+            std::shared_ptr<const LogEntryProto> result = nullptr;
+            for (LogEntryProto& log_entry : log_entries) {
+                auto ptr = std::make_shared<const LogEntryProto>(std::move(log_entry));
+                if (ptr->seqnum() == seqnum) {
+                    result = ptr;
+                }
+                decoded_log_cache_->Put(std::move(ptr));
+            }
+            return result;
+        }
+    }
+    std::optional<LogEntryProto> log_entry = GetLogEntryFromDB(seqnum);
+    if (!log_entry.has_value()) {
+        return nullptr;
+    }
+    auto ptr = std::make_shared<const LogEntryProto>(std::move(*log_entry));
+    if (decoded_log_cache_.has_value()) {
+        decoded_log_cache_->Put(ptr);
+    }
+    return ptr;
+}
+
+bool Storage::IsSequentialDBRead(const SharedLogMessage& request) {
+    uint64_t seqnum = bits::JoinTwo32(request.logspace_id, request.seqnum_lowhalf);
+    auto key = std::make_pair(request.logspace_id, request.origin_node_id);
+    absl::MutexLock lk(&readahead_mu_);
+    auto iter = last_db_reads_.find(key);
+    if (iter == last_db_reads_.end()) {
+        last_db_reads_[key] = seqnum;
+        return false;
+    }
+    bool sequential = seqnum > iter->second;
+    iter->second = seqnum;
+    return sequential;
 }
 
 void Storage::ProcessRequests(const std::vector<SharedLogRequest>& requests) {
@@ -276,9 +475,18 @@ void Storage::ProcessRequests(const std::vector<SharedLogRequest>& requests) {
 void Storage::SendEngineLogResult(const protocol::SharedLogMessage& request,
                                   protocol::SharedLogMessage* response,
                                   std::span<const char> tags_data,
-                                  std::span<const char> log_data) {
+                                  std::span<const char> log_data,
+                                  bool lookup_db) {
     uint64_t seqnum = bits::JoinTwo32(response->logspace_id, response->seqnum_lowhalf);
-    std::optional<std::string> cached_aux_data = LogCacheGetAuxData(seqnum);
+    std::optional<std::string> cached_aux_data = LogCacheGetAuxData(
+        request.user_logspace, seqnum);
+    if (!cached_aux_data.has_value() && lookup_db && persist_aux_data_) {
+        cached_aux_data = GetPersistedAuxData(seqnum);
+        if (cached_aux_data.has_value()) {
+            LogCachePutAuxData(request.user_logspace, seqnum,
+                               STRING_AS_SPAN(*cached_aux_data));
+        }
+    }
     std::span<const char> aux_data;
     if (cached_aux_data.has_value()) {
 /*
@@ -300,45 +508,74 @@ void Storage::SendEngineLogResult(const protocol::SharedLogMessage& request,
     SendEngineResponse(request, response, tags_data, log_data, aux_data);
 }
 
-void Storage::BackgroundThreadMain() {
-    int timerfd = io_utils::CreateTimerFd();
-    CHECK(timerfd != -1) << "Failed to create timerfd";
-    io_utils::FdUnsetNonblocking(timerfd);
+void Storage::BackgroundThreadMain(size_t thread_idx) {
+    FlushWorker* worker = flush_workers_.at(thread_idx).get();
     absl::Duration interval = absl::Milliseconds(
         absl::GetFlag(FLAGS_slog_storage_bgthread_interval_ms));
-    CHECK(io_utils::SetupTimerFdPeriodic(timerfd, absl::Milliseconds(100), interval))
-        << "Failed to setup timerfd with interval " << interval;
     bool running = true;
     while (running) {
-        uint64_t exp;
-        ssize_t nread = read(timerfd, &exp, sizeof(uint64_t));
-        if (nread < 0) {
-            PLOG(FATAL) << "Failed to read on timerfd";
+        {
+            // Wake up on timer, or when some log space has enough bytes to flush
+            absl::MutexLock lk(&worker->mu);
+            if (!worker->triggered) {
+                worker->cv.WaitWithTimeout(&worker->mu, interval);
+            }
+            worker->triggered = false;
+        }
+        FlushLogEntries(thread_idx);
+        if (thread_idx == 0) {
+            FlushAuxData();
         }
-        CHECK_EQ(gsl::narrow_cast<size_t>(nread), sizeof(uint64_t));
-        FlushLogEntries();
         // TODO: cleanup outdated LogSpace
         running = state_.load(std::memory_order_acquire) != kStopping;
     }
 }
 
+size_t Storage::FlushWorkerIdx(uint32_t logspace_id) const {
+    return absl::Hash<uint32_t>{}(logspace_id) % flush_workers_.size();
+}
+
+void Storage::TriggerFlush(uint32_t logspace_id) {
+    FlushWorker* worker = flush_workers_.at(FlushWorkerIdx(logspace_id)).get();
+    absl::MutexLock lk(&worker->mu);
+    if (!worker->triggered) {
+        worker->triggered = true;
+        worker->cv.Signal();
+    }
+}
+
 void Storage::SendShardProgressIfNeeded() {
     std::vector<std::pair<uint32_t, std::vector<uint32_t>>> progress_to_send;
+    // Source engines use their own progress to acknowledge async appends,
+    // sent only when it changed
+    std::vector<std::tuple</* logspace_id */ uint32_t, /* engine_id */ uint16_t,
+                           /* progress */ uint32_t>> engine_progress_to_send;
     {
         absl::ReaderMutexLock view_lk(&view_mu_);
         if (current_view_ == nullptr || view_finalized_) {
             return;
         }
+        const View::NodeIdVec& source_engines =
+            current_view_->GetStorageNode(my_node_id())->GetSourceEngineNodes();
         storage_collection_.ForEachActiveLogSpace(
             current_view_,
-            [&progress_to_send] (uint32_t logspace_id,
-                                 LockablePtr<LogStorage> storage_ptr) {
+            [&] (uint32_t logspace_id, LockablePtr<LogStorage> storage_ptr) {
                 auto locked_storage = storage_ptr.Lock();
                 if (!locked_storage->frozen() && !locked_storage->finalized()) {
-                    auto progress = locked_storage->GrabShardProgressForSending();
-                    if (progress.has_value()) {
-                        progress_to_send.emplace_back(logspace_id, std::move(*progress));
+                    std::vector<uint16_t> updated_engines;
+                    auto progress = locked_storage->GrabShardProgressForSending(
+                        &updated_engines);
+                    if (!progress.has_value()) {
+                        return;
+                    }
+                    DCHECK_EQ(source_engines.size(), progress->size());
+                    for (uint16_t engine_id : updated_engines) {
+                        size_t idx = static_cast<size_t>(
+                            absl::c_find(source_engines, engine_id) - source_engines.begin());
+                        engine_progress_to_send.emplace_back(
+                            logspace_id, engine_id, progress->at(idx));
                     }
+                    progress_to_send.emplace_back(logspace_id, std::move(*progress));
                 }
             }
         );
@@ -349,21 +586,35 @@ void Storage::SendShardProgressIfNeeded() {
         SendSequencerMessage(bits::LowHalf32(logspace_id), &message,
                              VECTOR_AS_CHAR_SPAN(entry.second));
     }
+    for (const auto& [logspace_id, engine_id, progress] : engine_progress_to_send) {
+        SharedLogMessage message = SharedLogMessageHelper::NewShardProgressMessage(logspace_id);
+        SendEngineMessage(engine_id, &message,
+                          std::span<const char>(reinterpret_cast<const char*>(&progress),
+                                                sizeof(uint32_t)));
+    }
 }
 
-void Storage::FlushLogEntries() {
-    std::vector<std::shared_ptr<const LogEntry>> log_entires;
-    std::vector<std::pair<LockablePtr<LogStorage>, uint64_t>> storages;
+void Storage::FlushLogEntries(size_t worker_idx) {
+    std::vector<LogEntryView> log_entires;
+    std::vector<std::tuple<LockablePtr<LogStorage>, /* new_position */ uint64_t,
+                           /* bytes */ size_t>> storages;
     {
         absl::ReaderMutexLock view_lk(&view_mu_);
         storage_collection_.ForEachActiveLogSpace(
-            [&log_entires, &storages] (uint32_t logspace_id,
-                                       LockablePtr<LogStorage> storage_ptr) {
+            [this, worker_idx, &log_entires, &storages] (uint32_t logspace_id,
+                                                        LockablePtr<LogStorage> storage_ptr) {
+                if (FlushWorkerIdx(logspace_id) != worker_idx) {
+                    return;
+                }
                 auto locked_storage = storage_ptr.ReaderLock();
-                std::vector<std::shared_ptr<const LogEntry>> tmp;
+                std::vector<LogEntryView> tmp;
                 uint64_t new_position;
                 if (locked_storage->GrabLogEntriesForPersistence(&tmp, &new_position)) {
-                    storages.emplace_back(storage_ptr, new_position);
+                    size_t bytes = 0;
+                    for (const LogEntryView& log_entry : tmp) {
+                        bytes += log_entry.user_tags.size_bytes() + log_entry.data.size();
+                    }
+                    storages.emplace_back(storage_ptr, new_position, bytes);
                     log_entires.insert(log_entires.end(), tmp.begin(), tmp.end());
                 }
             }
@@ -374,25 +625,39 @@ void Storage::FlushLogEntries() {
         return;
     }
     HVLOG_F(1, "Will flush {} log entries", log_entires.size());
+    absl::flat_hash_set</* logspace_id */ uint32_t> wal_skipped_logspaces;
     for (size_t i = 0; i < log_entires.size(); i++) {
-        PutLogEntryToDB(*log_entires[i]);
+        if (PutLogEntryToDB(log_entires[i])) {
+            wal_skipped_logspaces.insert(bits::HighHalf64(log_entires[i].metadata.seqnum));
+        }
     }
+    ReleaseJournalEntries(VECTOR_AS_SPAN(log_entires));
 
-    std::vector<uint32_t> finalized_logspaces;
-    for (auto& [storage_ptr, new_position] : storages) {
+    std::vector<std::pair</* logspace_id */ uint32_t, /* end_seqnum */ uint64_t>>
+        finalized_logspaces;
+    std::vector<StorageCheckpointProto> checkpoints;
+    for (auto& [storage_ptr, new_position, bytes] : storages) {
         auto locked_storage = storage_ptr.Lock();
-        locked_storage->LogEntriesPersisted(new_position);
+        locked_storage->LogEntriesPersisted(new_position, bytes);
+        checkpoints.push_back(locked_storage->MakeCheckpoint());
         if (locked_storage->finalized()
                 && new_position >= locked_storage->seqnum_position()) {
-            finalized_logspaces.push_back(locked_storage->identifier());
+            finalized_logspaces.emplace_back(locked_storage->identifier(), new_position);
         }
     }
+    for (const StorageCheckpointProto& checkpoint : checkpoints) {
+        PutCheckpointToDB(checkpoint,
+                          wal_skipped_logspaces.contains(checkpoint.logspace_id()));
+    }
 
     if (!finalized_logspaces.empty()) {
         absl::MutexLock view_lk(&view_mu_);
-        for (uint32_t logspace_id : finalized_logspaces) {
+        for (const auto& [logspace_id, end_seqnum] : finalized_logspaces) {
             if (storage_collection_.FinalizeLogSpace(logspace_id)) {
                 HLOG_F(INFO, "Finalize storage log space {}", bits::HexStr0x(logspace_id));
+                // Including entries discarded without seqnums
+                ReleaseJournalLogSpace(logspace_id);
+                AddColdLogSpace(logspace_id, end_seqnum);
             } else {
                 HLOG_F(ERROR, "Storage log space {} not active, cannot finalize",
                        bits::HexStr0x(logspace_id));
@@ -401,5 +666,116 @@ void Storage::FlushLogEntries() {
     }
 }
 
+void Storage::AddColdLogSpace(uint32_t logspace_id, uint64_t end_seqnum) {
+    if (!archive_enabled()) {
+        return;
+    }
+    absl::MutexLock lk(&archive_mu_);
+    cold_logspaces_[logspace_id] = std::make_pair(GetMonotonicMicroTimestamp(), end_seqnum);
+}
+
+void Storage::ArchiveThreadMain() {
+    absl::Duration interval = absl::Milliseconds(
+        absl::GetFlag(FLAGS_slog_storage_bgthread_interval_ms));
+    int64_t last_archive_timestamp = 0;
+    while (state_.load(std::memory_order_acquire) != kStopping) {
+        // Wakes up often enough to notice stopping
+        absl::SleepFor(interval);
+        int64_t current_timestamp = GetMonotonicMicroTimestamp();
+        if (current_timestamp >= last_archive_timestamp + archive_interval_us_) {
+            last_archive_timestamp = current_timestamp;
+            ArchiveColdLogEntries();
+        }
+    }
+}
+
+void Storage::ArchiveColdLogEntries() {
+    int64_t current_timestamp = GetMonotonicMicroTimestamp();
+    std::vector<std::pair</* end_seqnum */ uint64_t, /* partial_segment */ bool>> tasks;
+    if (archive_hot_seqnums_ > 0) {
+        absl::ReaderMutexLock view_lk(&view_mu_);
+        storage_collection_.ForEachActiveLogSpace(
+            [this, &tasks] (uint32_t logspace_id, LockablePtr<LogStorage> storage_ptr) {
+                uint64_t position = storage_ptr.ReaderLock()->persisted_seqnum_position();
+                if (bits::LowHalf64(position) > archive_hot_seqnums_) {
+                    tasks.emplace_back(position - archive_hot_seqnums_, false);
+                }
+            }
+        );
+    }
+    {
+        absl::MutexLock lk(&archive_mu_);
+        for (auto iter = cold_logspaces_.begin(); iter != cold_logspaces_.end();) {
+            const auto& [finalized_timestamp, end_seqnum] = iter->second;
+            if (current_timestamp - finalized_timestamp >= archive_age_us_) {
+                tasks.emplace_back(end_seqnum, true);
+                cold_logspaces_.erase(iter++);
+            } else {
+                ++iter;
+            }
+        }
+    }
+    for (const auto& [end_seqnum, partial_segment] : tasks) {
+        ArchiveLogEntries(end_seqnum, partial_segment);
+    }
+}
+
+std::optional<std::string> Storage::GetPersistedAuxData(uint64_t seqnum) {
+    {
+        absl::MutexLock lk(&aux_data_mu_);
+        if (pending_aux_data_.contains(seqnum)) {
+            return pending_aux_data_.at(seqnum);
+        }
+        if (flushing_aux_data_.contains(seqnum)) {
+            return flushing_aux_data_.at(seqnum);
+        }
+    }
+    return GetAuxDataFromDB(seqnum);
+}
+
+void Storage::FlushAuxData() {
+    absl::flat_hash_map</* logspace_id */ uint32_t, DBInterface::AuxDataBatch> batches;
+    {
+        absl::MutexLock lk(&aux_data_mu_);
+        if (pending_aux_data_.empty()) {
+            return;
+        }
+        DCHECK(flushing_aux_data_.empty());
+        flushing_aux_data_.swap(pending_aux_data_);
+        for (const auto& [seqnum, data] : flushing_aux_data_) {
+            batches[bits::HighHalf64(seqnum)].emplace_back(bits::LowHalf64(seqnum), data);
+        }
+        HVLOG_F(1, "Will flush aux data of {} logs", flushing_aux_data_.size());
+    }
+    std::vector</* logspace_id */ uint32_t> uninstalled_logspaces;
+    for (const auto& [logspace_id, batch] : batches) {
+        if (!PutAuxDataToDB(logspace_id, batch)) {
+            uninstalled_logspaces.push_back(logspace_id);
+        }
+    }
+    // Log spaces of future views are installed once their view gets created,
+    // until then their aux data stays buffered
+    uint16_t current_view_id = 0;
+    {
+        absl::ReaderMutexLock view_lk(&view_mu_);
+        if (current_view_ != nullptr) {
+            current_view_id = current_view_->id();
+        }
+    }
+    absl::MutexLock lk(&aux_data_mu_);
+    for (uint32_t logspace_id : uninstalled_logspaces) {
+        if (bits::HighHalf32(logspace_id) <= current_view_id) {
+            HLOG_F(WARNING, "Log space {} not installed, drop aux data of {} logs",
+                   bits::HexStr0x(logspace_id), batches[logspace_id].size());
+            continue;
+        }
+        for (auto& [key, data] : batches[logspace_id]) {
+            // Newer aux data received during the flush wins
+            pending_aux_data_.try_emplace(bits::JoinTwo32(logspace_id, key), std::move(data));
+        }
+    }
+    flushing_aux_data_.clear();
+}
+
 }  // namespace log
 }  // namespace faas
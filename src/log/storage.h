@@ -23,12 +23,60 @@ private:
 
     log_utils::FutureRequests future_requests_;
 
+    // Log spaces are partitioned among background threads for persistence,
+    // so entries of a log space are always persisted in order by one thread
+    struct FlushWorker {
+        absl::Mutex   mu;
+        absl::CondVar cv;
+        bool          triggered ABSL_GUARDED_BY(mu);
+    };
+    const size_t flush_trigger_bytes_;
+    std::vector<std::unique_ptr<FlushWorker>> flush_workers_;
+
+    // Decoded entries read from DB. Sequential DB reads of an engine on
+    // a log space fetch following entries into the cache with one scan.
+    std::optional<DecodedLogCache> decoded_log_cache_;
+    const size_t readahead_entries_;
+    absl::Mutex readahead_mu_;
+    absl::flat_hash_map<std::pair</* logspace_id */ uint32_t, /* engine_id */ uint16_t>,
+                        /* seqnum */ uint64_t>
+        last_db_reads_             ABSL_GUARDED_BY(readahead_mu_);
+
+    // Aux data not yet persisted, written to DB in batches by the background
+    // thread. Entries being written stay visible in flushing_aux_data_.
+    const bool persist_aux_data_;
+    const size_t max_aux_data_size_;
+    absl::Mutex aux_data_mu_;
+    absl::flat_hash_map</* seqnum */ uint64_t, std::string>
+        pending_aux_data_          ABSL_GUARDED_BY(aux_data_mu_);
+    absl::flat_hash_map</* seqnum */ uint64_t, std::string>
+        flushing_aux_data_         ABSL_GUARDED_BY(aux_data_mu_);
+
+    // Persisted entries moved to the archive by the archive thread, off the
+    // flush path. Finalized log spaces are fully archived once old enough,
+    // while active ones keep entries within a seqnum distance of the
+    // persisted position in DB.
+    const int64_t archive_interval_us_;
+    const int64_t archive_age_us_;
+    const uint32_t archive_hot_seqnums_;
+    absl::Mutex archive_mu_;
+    absl::flat_hash_map</* logspace_id */ uint32_t,
+                        std::pair</* finalized_timestamp */ int64_t,
+                                  /* end_seqnum */ uint64_t>>
+        cold_logspaces_            ABSL_GUARDED_BY(archive_mu_);
+
     void OnViewCreated(const View* view) override;
     void OnViewFinalized(const FinalizedView* finalized_view) override;
+    // Restores the log space persisted before restart. Returns nullptr if
+    // all its entries are persisted, so that reads are served from DB.
+    std::unique_ptr<LogStorage> CreateLogStorage(const View* view, uint16_t sequencer_id);
 
     void HandleReadAtRequest(const protocol::SharedLogMessage& request) override;
     void HandleReplicateRequest(const protocol::SharedLogMessage& message,
                                 std::span<const char> payload) override;
+    void HandleReplicateBatch(const protocol::SharedLogMessage& message,
+                              std::span<const char> payload);
+    void OnJournalEntriesDurable(const LogJournal::EntryKeyVec& entries) override;
     void OnRecvNewMetaLogs(const protocol::SharedLogMessage& message,
                            std::span<const char> payload) override;
     void OnRecvLogAuxData(const protocol::SharedLogMessage& message,
@@ -36,16 +84,27 @@ private:
 
     void ProcessReadResults(const LogStorage::ReadResultVec& results);
     void ProcessReadFromDB(const protocol::SharedLogMessage& request);
+    std::shared_ptr<const LogEntryProto> ReadLogEntryFromDB(
+        const protocol::SharedLogMessage& request);
+    bool IsSequentialDBRead(const protocol::SharedLogMessage& request);
     void ProcessRequests(const std::vector<SharedLogRequest>& requests);
 
     void SendEngineLogResult(const protocol::SharedLogMessage& request,
                              protocol::SharedLogMessage* response,
                              std::span<const char> tags_data,
-                             std::span<const char> log_data);
+                             std::span<const char> log_data,
+                             bool lookup_db = false);
+    std::optional<std::string> GetPersistedAuxData(uint64_t seqnum);
 
-    void BackgroundThreadMain() override;
+    void BackgroundThreadMain(size_t thread_idx) override;
     void SendShardProgressIfNeeded() override;
-    void FlushLogEntries();
+    size_t FlushWorkerIdx(uint32_t logspace_id) const;
+    void TriggerFlush(uint32_t logspace_id);
+    void FlushLogEntries(size_t worker_idx);
+    void FlushAuxData();
+    void AddColdLogSpace(uint32_t logspace_id, uint64_t end_seqnum);
+    void ArchiveThreadMain() override;
+    void ArchiveColdLogEntries();
 
     DISALLOW_COPY_AND_ASSIGN(Storage);
 };
@@ -1,6 +1,8 @@
 #include "log/storage_base.h"
 
+#include "common/time.h"
 #include "log/flags.h"
+#include "log/utils.h"
 #include "server/constants.h"
 #include "utils/fs.h"
 
@@ -19,24 +21,71 @@ using server::IngressConnection;
 using server::EgressHub;
 using server::NodeWatcher;
 
+namespace {
+static constexpr size_t kJournalSegmentSize = size_t{64} << 20;
+// Minimal interval of DB flushes for checkpoints of entries written without WAL
+static constexpr absl::Duration kWalLessCheckpointInterval = absl::Seconds(1);
+static constexpr size_t kDBTailScanBatch = 1024;
+}  // namespace
+
 StorageBase::StorageBase(uint16_t node_id)
     : ServerBase(fmt::format("storage_{}", node_id)),
       node_id_(node_id),
       db_(nullptr),
-      background_thread_("BG", [this] { this->BackgroundThreadMain(); }) {}
+      compress_log_data_(absl::GetFlag(FLAGS_slog_storage_compression)),
+      default_durability_(DurabilityLevel::kMemory),
+      disable_wal_(absl::GetFlag(FLAGS_slog_storage_disable_wal)),
+      archive_segment_entries_(absl::GetFlag(FLAGS_slog_storage_archive_segment_entries)) {
+    int num_threads = std::max(1, absl::GetFlag(FLAGS_slog_storage_flush_threads));
+    for (int i = 0; i < num_threads; i++) {
+        size_t thread_idx = gsl::narrow_cast<size_t>(i);
+        background_threads_.push_back(std::make_unique<base::Thread>(
+            fmt::format("BG-{}", i),
+            [this, thread_idx] { this->BackgroundThreadMain(thread_idx); }));
+    }
+}
 
 StorageBase::~StorageBase() {}
 
 void StorageBase::StartInternal() {
+    if (absl::GetFlag(FLAGS_slog_storage_max_live_entries) > 0) {
+        HLOG(WARNING) << "slog_storage_max_live_entries is deprecated, "
+                         "use slog_storage_max_live_entries_mb instead";
+    }
     SetupDB();
+    SetupDurability();
+    SetupArchive();
+    // Ready before log spaces get installed, which loads their dictionaries
+    log_compressor_.reset(new LogCompressor(
+        absl::GetFlag(FLAGS_slog_storage_zstd_level),
+        absl::GetFlag(FLAGS_slog_storage_zstd_dict_kb) << 10,
+        absl::GetFlag(FLAGS_slog_storage_zstd_sample_kb) << 10,
+        [this] (uint32_t logspace_id, uint32_t dict_version, std::span<const char> dict) {
+            PutCompressionDictToDB(logspace_id, dict_version, dict);
+        }));
+    log_compressor_->Start();
     SetupZKWatchers();
     SetupTimers();
     log_cache_.emplace(absl::GetFlag(FLAGS_slog_storage_cache_cap_mb));
-    background_thread_.Start();
+    for (const auto& thread : background_threads_) {
+        thread->Start();
+    }
+    if (archive_thread_ != nullptr) {
+        archive_thread_->Start();
+    }
 }
 
 void StorageBase::StopInternal() {
-    background_thread_.Join();
+    for (const auto& thread : background_threads_) {
+        thread->Join();
+    }
+    if (archive_thread_ != nullptr) {
+        archive_thread_->Join();
+    }
+    log_compressor_->Stop();
+    if (journal_ != nullptr) {
+        journal_->Stop();
+    }
 }
 
 void StorageBase::SetupDB() {
@@ -54,16 +103,84 @@ void StorageBase::SetupDB() {
     }
 }
 
+void StorageBase::SetupDurability() {
+    std::string level_str = absl::GetFlag(FLAGS_slog_storage_durability);
+    if (!ParseDurabilityLevel(level_str, &default_durability_)) {
+        HLOG(FATAL) << "Unknown durability level: " << level_str;
+    }
+    bool need_journal = (default_durability_ != DurabilityLevel::kMemory);
+    std::string overrides = absl::GetFlag(FLAGS_slog_storage_durability_overrides);
+    for (std::string_view item : absl::StrSplit(overrides, ',', absl::SkipEmpty())) {
+        std::vector<std::string_view> parts = absl::StrSplit(item, ':');
+        uint32_t user_logspace;
+        DurabilityLevel level;
+        if (parts.size() != 2 || !absl::SimpleAtoi(parts[0], &user_logspace)
+                || !ParseDurabilityLevel(parts[1], &level)) {
+            HLOG(FATAL) << "Invalid durability override: " << item;
+        }
+        durability_overrides_[user_logspace] = level;
+        need_journal |= (level != DurabilityLevel::kMemory);
+    }
+    HLOG_F(INFO, "Durability level {}, with {} overrides",
+           DurabilityLevelName(default_durability_), durability_overrides_.size());
+    if (!need_journal) {
+        return;
+    }
+    std::string journal_path = absl::GetFlag(FLAGS_slog_storage_journal_path);
+    if (journal_path.empty()) {
+        journal_path = fmt::format("{}_journal", db_path_);
+    }
+    journal_.reset(new LogJournal(
+        journal_path, kJournalSegmentSize,
+        [this] (const LogJournal::EntryKeyVec& entries) {
+            OnJournalEntriesDurable(entries);
+        }));
+    journal_->Start();
+    journal_->Recover(
+        [this] (uint32_t logspace_id, const LogMetaData& log_metadata,
+                std::span<const uint64_t> user_tags, std::span<const char> log_data) {
+            absl::MutexLock lk(&recovered_mu_);
+            recovered_entries_[logspace_id].push_back(LogEntry {
+                .metadata = log_metadata,
+                .user_tags = UserTagVec(user_tags.begin(), user_tags.end()),
+                .data = std::string(log_data.data(), log_data.size())
+            });
+        });
+}
+
+void StorageBase::SetupArchive() {
+    std::string archive_path = absl::GetFlag(FLAGS_slog_storage_archive_path);
+    if (archive_path.empty()) {
+        return;
+    }
+    if (absl::GetFlag(FLAGS_slog_storage_backend) == "tkrzw_hash") {
+        HLOG(FATAL) << "Archiving requires a storage backend ordered by seqnum";
+    }
+    CHECK_GT(archive_segment_entries_, 0U);
+    archive_.reset(new LogArchive(
+        archive_path,
+        absl::GetFlag(FLAGS_slog_storage_archive_block_kb) << 10,
+        absl::GetFlag(FLAGS_slog_storage_archive_max_open_files),
+        absl::GetFlag(FLAGS_slog_storage_zstd_level)));
+    archive_->Start();
+    archive_thread_ = std::make_unique<base::Thread>(
+        "Archive", [this] { this->ArchiveThreadMain(); });
+}
+
 void StorageBase::SetupZKWatchers() {
     view_watcher_.SetViewCreatedCallback(
         [this] (const View* view) {
-            this->OnViewCreated(view);
-            // TODO: This is not always safe, try fix it
+            // Installed first, as log spaces are restored from DB
             for (uint16_t sequencer_id : view->GetSequencerNodes()) {
                 if (view->is_active_phylog(sequencer_id)) {
-                    db_->InstallLogSpace(bits::JoinTwo16(view->id(), sequencer_id));
+                    uint32_t logspace_id = bits::JoinTwo16(view->id(), sequencer_id);
+                    db_->InstallLogSpace(logspace_id);
+                    LoadCompressionDictFromDB(logspace_id);
+                    RemoveArchivedEntriesFromDB(logspace_id);
                 }
             }
+            DropRecoveredEntriesBefore(view->id());
+            this->OnViewCreated(view);
         }
     );
     view_watcher_.SetViewFinalizedCallback(
@@ -103,22 +220,45 @@ void StorageBase::MessageHandler(const SharedLogMessage& message,
 }
 
 namespace {
-static inline std::string SerializedLogEntry(const LogEntry& log_entry) {
+static inline std::string SerializedLogEntry(const LogEntryView& log_entry,
+                                             LogCompressor* compressor) {
     LogEntryProto log_entry_proto;
     log_entry_proto.set_user_logspace(log_entry.metadata.user_logspace);
     log_entry_proto.set_seqnum(log_entry.metadata.seqnum);
     log_entry_proto.set_localid(log_entry.metadata.localid);
     log_entry_proto.mutable_user_tags()->Add(
         log_entry.user_tags.begin(), log_entry.user_tags.end());
-    log_entry_proto.set_data(log_entry.data);
+    uint32_t dict_version = 0;
+    if (compressor != nullptr) {
+        uint32_t logspace_id = bits::HighHalf64(log_entry.metadata.seqnum);
+        dict_version = compressor->Compress(
+            logspace_id, log_entry.data, log_entry_proto.mutable_data());
+    }
+    if (dict_version > 0) {
+        log_entry_proto.set_dict_version(dict_version);
+    } else {
+        log_entry_proto.set_data(log_entry.data.data(), log_entry.data.size());
+    }
     std::string data;
     CHECK(log_entry_proto.SerializeToString(&data));
     return data;
 }
+
+static inline std::string DictMetaName(uint32_t dict_version) {
+    return fmt::format("zstd_dict_{}", dict_version);
+}
+
+// Version of the dictionary compressing new entries of the log space
+static constexpr std::string_view kLatestDictMetaName = "zstd_dict_latest";
+
+static constexpr std::string_view kCheckpointMetaName = "storage_checkpoint";
 }  // namespace
 
 std::optional<LogEntryProto> StorageBase::GetLogEntryFromDB(uint64_t seqnum) {
     auto data = db_->Get(bits::HighHalf64(seqnum), bits::LowHalf64(seqnum));
+    if (!data.has_value() && archive_ != nullptr) {
+        data = archive_->Get(bits::HighHalf64(seqnum), bits::LowHalf64(seqnum));
+    }
     if (!data.has_value()) {
         return std::nullopt;
     }
@@ -129,20 +269,309 @@ std::optional<LogEntryProto> StorageBase::GetLogEntryFromDB(uint64_t seqnum) {
     return log_entry_proto;
 }
 
-void StorageBase::PutLogEntryToDB(const LogEntry& log_entry) {
+bool StorageBase::ScanLogEntriesFromDB(uint64_t start_seqnum, size_t max_entries,
+                                       std::vector<LogEntryProto>* log_entries) {
+    uint32_t logspace_id = bits::HighHalf64(start_seqnum);
+    uint32_t start_key = bits::LowHalf64(start_seqnum);
+    DBInterface::KeyValueVec records;
+    if (archive_ != nullptr && start_key < archive_->archived_position(logspace_id)) {
+        archive_->Scan(logspace_id, start_key, max_entries, &records);
+    } else if (!db_->Scan(logspace_id, start_key, max_entries, &records)) {
+        return false;
+    }
+    log_entries->clear();
+    log_entries->reserve(records.size());
+    for (const auto& [key, data] : records) {
+        LogEntryProto log_entry_proto;
+        if (!log_entry_proto.ParseFromString(data)) {
+            HLOG(FATAL) << "Failed to parse LogEntryProto";
+        }
+        log_entries->push_back(std::move(log_entry_proto));
+    }
+    return true;
+}
+
+bool StorageBase::PutLogEntryToDB(const LogEntryView& log_entry) {
     uint64_t seqnum = log_entry.metadata.seqnum;
-    std::string data = SerializedLogEntry(log_entry);
-    db_->Put(bits::HighHalf64(seqnum), bits::LowHalf64(seqnum), STRING_AS_SPAN(data));
+    LogCompressor* compressor = nullptr;
+    if (compress_log_data_) {
+        compressor = log_compressor_.get();
+        compressor->AddSample(bits::HighHalf64(seqnum), log_entry.data);
+    }
+    std::string data = SerializedLogEntry(log_entry, compressor);
+    bool disable_wal = disable_wal_ && GetDurabilityLevel(
+        log_entry.metadata.user_logspace) == DurabilityLevel::kMemory;
+    db_->Put(bits::HighHalf64(seqnum), bits::LowHalf64(seqnum), STRING_AS_SPAN(data),
+             disable_wal);
+    return disable_wal;
+}
+
+DurabilityLevel StorageBase::GetDurabilityLevel(uint32_t user_logspace) const {
+    if (auto iter = durability_overrides_.find(user_logspace);
+            iter != durability_overrides_.end()) {
+        return iter->second;
+    }
+    return default_durability_;
+}
+
+void StorageBase::AppendToJournal(uint32_t logspace_id, const LogMetaData& log_metadata,
+                                  std::span<const uint64_t> user_tags,
+                                  std::span<const char> log_data) {
+    DurabilityLevel level = GetDurabilityLevel(log_metadata.user_logspace);
+    DCHECK(level != DurabilityLevel::kMemory);
+    DCHECK(journal_ != nullptr);
+    journal_->Append(logspace_id, log_metadata, user_tags, log_data,
+                     /* sync= */ level == DurabilityLevel::kFsync);
+}
+
+void StorageBase::ReleaseJournalEntries(std::span<const LogEntryView> log_entries) {
+    if (journal_ == nullptr) {
+        return;
+    }
+    // Entries of log spaces with memory durability are never journaled
+    LogJournal::EntryKeyVec keys;
+    for (const LogEntryView& log_entry : log_entries) {
+        if (GetDurabilityLevel(log_entry.metadata.user_logspace) != DurabilityLevel::kMemory) {
+            keys.emplace_back(bits::HighHalf64(log_entry.metadata.seqnum),
+                              log_entry.metadata.localid);
+        }
+    }
+    if (!keys.empty()) {
+        journal_->Release(VECTOR_AS_SPAN(keys));
+    }
+    if (journal_->HasReclaimableSegments()) {
+        // Entries of reclaimed segments must be durable in DB
+        db_->Sync();
+        journal_->ReclaimSegments();
+    }
+}
+
+void StorageBase::ReleaseJournalEntry(uint32_t logspace_id, uint64_t localid) {
+    if (journal_ != nullptr) {
+        journal_->Release(std::make_pair(logspace_id, localid));
+    }
+}
+
+void StorageBase::ReleaseJournalLogSpace(uint32_t logspace_id) {
+    if (journal_ != nullptr) {
+        journal_->ReleaseLogSpace(logspace_id);
+    }
 }
 
-void StorageBase::LogCachePutAuxData(uint64_t seqnum, std::span<const char> data) {
+std::vector<LogEntry> StorageBase::TakeRecoveredEntries(uint32_t logspace_id) {
+    absl::MutexLock lk(&recovered_mu_);
+    std::vector<LogEntry> log_entries;
+    if (auto iter = recovered_entries_.find(logspace_id); iter != recovered_entries_.end()) {
+        log_entries = std::move(iter->second);
+        recovered_entries_.erase(iter);
+    }
+    return log_entries;
+}
+
+void StorageBase::DropRecoveredEntriesBefore(uint16_t view_id) {
+    std::vector<uint32_t> logspace_ids;
+    {
+        absl::MutexLock lk(&recovered_mu_);
+        for (auto iter = recovered_entries_.begin(); iter != recovered_entries_.end();) {
+            if (bits::HighHalf32(iter->first) < view_id) {
+                logspace_ids.push_back(iter->first);
+                recovered_entries_.erase(iter++);
+            } else {
+                ++iter;
+            }
+        }
+    }
+    // Log spaces of earlier views are never created again
+    for (uint32_t logspace_id : logspace_ids) {
+        HLOG_F(WARNING, "Drop recovered entries of obsolete log space {}",
+               bits::HexStr0x(logspace_id));
+        ReleaseJournalLogSpace(logspace_id);
+    }
+}
+
+std::optional<std::string> StorageBase::GetAuxDataFromDB(uint64_t seqnum) {
+    return db_->GetAuxData(bits::HighHalf64(seqnum), bits::LowHalf64(seqnum));
+}
+
+bool StorageBase::PutAuxDataToDB(uint32_t logspace_id,
+                                 const DBInterface::AuxDataBatch& batch) {
+    return db_->PutAuxDataBatch(logspace_id, batch);
+}
+
+std::optional<StorageCheckpointProto> StorageBase::GetCheckpointFromDB(uint32_t logspace_id) {
+    auto data = db_->GetMeta(logspace_id, kCheckpointMetaName);
+    if (!data.has_value()) {
+        return std::nullopt;
+    }
+    StorageCheckpointProto checkpoint;
+    if (!checkpoint.ParseFromString(*data)) {
+        HLOG_F(ERROR, "Failed to parse checkpoint of log space {}",
+               bits::HexStr0x(logspace_id));
+        return std::nullopt;
+    }
+    return checkpoint;
+}
+
+void StorageBase::PutCheckpointToDB(const StorageCheckpointProto& checkpoint,
+                                    bool wal_skipped) {
+    uint32_t logspace_id = checkpoint.logspace_id();
+    CheckpointState* state;
+    {
+        absl::MutexLock lk(&checkpoint_mu_);
+        auto& ptr = checkpoint_states_[logspace_id];
+        if (ptr == nullptr) {
+            ptr = std::make_unique<CheckpointState>();
+        }
+        state = ptr.get();
+    }
+    absl::MutexLock lk(&state->mu);
+    const StorageCheckpointProto& last = state->last_checkpoint;
+    if (last.finalized()
+            || checkpoint.persisted_seqnum_position() < last.persisted_seqnum_position()
+            || checkpoint.metalog_position() < last.metalog_position()) {
+        HVLOG_F(1, "Drop outdated checkpoint of log space {}", bits::HexStr0x(logspace_id));
+        return;
+    }
+    state->wal_skipped |= wal_skipped;
+    if (state->wal_skipped) {
+        // The checkpoint is written with WAL, thus entries written without
+        // WAL have to reach disk first, or it can get ahead of DB after crashes
+        int64_t now = GetMonotonicMicroTimestamp();
+        if (!checkpoint.finalized() && now - state->last_db_flush_timestamp
+                < absl::ToInt64Microseconds(kWalLessCheckpointInterval)) {
+            // Recovery finds entries beyond the previous checkpoint
+            return;
+        }
+        db_->Flush(logspace_id);
+        state->wal_skipped = false;
+        state->last_db_flush_timestamp = now;
+    }
+    std::string data;
+    CHECK(checkpoint.SerializeToString(&data));
+    db_->PutMeta(logspace_id, kCheckpointMetaName, STRING_AS_SPAN(data));
+    state->last_checkpoint = checkpoint;
+}
+
+uint64_t StorageBase::FindDBTail(uint64_t start_seqnum) {
+    // Checkpoints can be skipped or written out of order, so entries of
+    // several flushes may be found beyond the checkpoint. Keys have gaps, as
+    // the storage node holds only shards of its source engines.
+    uint32_t logspace_id = bits::HighHalf64(start_seqnum);
+    uint32_t key = bits::LowHalf64(start_seqnum);
+    DBInterface::KeyValueVec records;
+    while (db_->Scan(logspace_id, key, kDBTailScanBatch, &records)) {
+        if (records.empty()) {
+            return bits::JoinTwo32(logspace_id, key);
+        }
+        key = records.back().first + 1;
+        records.clear();
+    }
+    // Without ordered scans, only consecutive entries can be found
+    uint64_t seqnum = bits::JoinTwo32(logspace_id, key);
+    while (db_->Get(bits::HighHalf64(seqnum), bits::LowHalf64(seqnum)).has_value()) {
+        seqnum++;
+    }
+    return seqnum;
+}
+
+void StorageBase::RemoveArchivedEntriesFromDB(uint32_t logspace_id) {
+    if (archive_ == nullptr) {
+        return;
+    }
+    // Entries archived right before a crash can be left in DB
+    uint32_t position = archive_->archived_position(logspace_id);
+    if (position > 0) {
+        db_->DeleteRange(logspace_id, 0, position);
+    }
+}
+
+void StorageBase::ArchiveLogEntries(uint64_t end_seqnum, bool partial_segment) {
+    DCHECK(archive_ != nullptr);
+    uint32_t logspace_id = bits::HighHalf64(end_seqnum);
+    uint32_t end_key = bits::LowHalf64(end_seqnum);
+    while (state_.load(std::memory_order_acquire) != kStopping) {
+        uint32_t start_key = archive_->archived_position(logspace_id);
+        if (start_key >= end_key) {
+            return;
+        }
+        DBInterface::KeyValueVec records;
+        if (!db_->Scan(logspace_id, start_key, archive_segment_entries_, &records)) {
+            HLOG(ERROR) << "Storage backend cannot scan entries for archiving";
+            return;
+        }
+        while (!records.empty() && records.back().first >= end_key) {
+            records.pop_back();
+        }
+        if (records.empty()
+                || (!partial_segment && records.size() < archive_segment_entries_)) {
+            return;
+        }
+        if (!archive_->WriteSegment(logspace_id, records)) {
+            return;
+        }
+        db_->DeleteRange(logspace_id, records.front().first, records.back().first + 1);
+    }
+}
+
+void StorageBase::PutCompressionDictToDB(uint32_t logspace_id, uint32_t dict_version,
+                                         std::span<const char> dict) {
+    // The dictionary is written before becoming the latest one, thus a
+    // version is never reused once entries are compressed with it
+    db_->PutMeta(logspace_id, DictMetaName(dict_version), dict);
+    std::string version_str = fmt::format("{}", dict_version);
+    db_->PutMeta(logspace_id, kLatestDictMetaName, STRING_AS_SPAN(version_str));
+}
+
+void StorageBase::LoadCompressionDictFromDB(uint32_t logspace_id) {
+    auto version_str = db_->GetMeta(logspace_id, kLatestDictMetaName);
+    if (!version_str.has_value()) {
+        return;
+    }
+    uint32_t dict_version;
+    if (!absl::SimpleAtoi(*version_str, &dict_version) || dict_version == 0) {
+        HLOG_F(FATAL, "Invalid latest dictionary version of log space {}: {}",
+               bits::HexStr0x(logspace_id), *version_str);
+    }
+    auto dict = db_->GetMeta(logspace_id, DictMetaName(dict_version));
+    if (!dict.has_value()) {
+        HLOG_F(FATAL, "Cannot find dictionary version {} of log space {}",
+               dict_version, bits::HexStr0x(logspace_id));
+    }
+    HLOG_F(INFO, "Load dictionary version {} of log space {}",
+           dict_version, bits::HexStr0x(logspace_id));
+    log_compressor_->InstallDict(logspace_id, dict_version, STRING_AS_SPAN(*dict),
+                                 /* current= */ true);
+}
+
+bool StorageBase::DecompressLogData(const LogEntryProto& log_entry, std::string* data) {
+    DCHECK_GT(log_entry.dict_version(), 0U);
+    uint32_t logspace_id = bits::HighHalf64(log_entry.seqnum());
+    uint32_t dict_version = log_entry.dict_version();
+    if (!log_compressor_->HasDict(logspace_id, dict_version)) {
+        // Dictionaries trained before restart are loaded on demand
+        auto dict = db_->GetMeta(logspace_id, DictMetaName(dict_version));
+        if (!dict.has_value()) {
+            HLOG_F(ERROR, "Cannot find dictionary version {} of log space {}",
+                   dict_version, bits::HexStr0x(logspace_id));
+            return false;
+        }
+        log_compressor_->InstallDict(logspace_id, dict_version, STRING_AS_SPAN(*dict));
+    }
+    return log_compressor_->Decompress(
+        logspace_id, dict_version, STRING_AS_SPAN(log_entry.data()), data);
+}
+
+void StorageBase::LogCachePutAuxData(uint32_t user_logspace, uint64_t seqnum,
+                                     std::span<const char> data) {
     if (log_cache_.has_value()) {
-        log_cache_->PutAuxData(seqnum, data);
+        log_cache_->PutAuxData(user_logspace, seqnum, data);
     }
 }
 
-std::optional<std::string> StorageBase::LogCacheGetAuxData(uint64_t seqnum) {
-    return log_cache_.has_value() ? log_cache_->GetAuxData(seqnum) : std::nullopt;
+std::optional<std::string> StorageBase::LogCacheGetAuxData(uint32_t user_logspace,
+                                                           uint64_t seqnum) {
+    return log_cache_.has_value() ? log_cache_->GetAuxData(user_logspace, seqnum)
+                                  : std::nullopt;
 }
 
 void StorageBase::SendIndexData(const View* view,
@@ -151,18 +580,59 @@ void StorageBase::SendIndexData(const View* view,
     DCHECK_EQ(view->id(), bits::HighHalf32(logspace_id));
     const View::Sequencer* sequencer_node = view->GetSequencerNode(
         bits::LowHalf32(logspace_id));
-    std::string serialized_data;
-    CHECK(index_data_proto.SerializeToString(&serialized_data));
+    const View::NodeIdVec& index_engine_nodes = sequencer_node->GetIndexEngineNodes();
     SharedLogMessage message = SharedLogMessageHelper::NewIndexDataMessage(
         logspace_id);
     message.origin_node_id = node_id_;
-    message.payload_size = gsl::narrow_cast<uint32_t>(serialized_data.size());
-    for (uint16_t engine_id : sequencer_node->GetIndexEngineNodes()) {
+    std::string serialized_data;
+    if (!absl::GetFlag(FLAGS_slog_partition_index) || index_engine_nodes.size() == 1) {
+        CHECK(index_data_proto.SerializeToString(&serialized_data));
+        message.payload_size = gsl::narrow_cast<uint32_t>(serialized_data.size());
+        for (uint16_t engine_id : index_engine_nodes) {
+            SendSharedLogMessage(protocol::ConnType::STORAGE_TO_ENGINE,
+                                 engine_id, message, STRING_AS_SPAN(serialized_data));
+        }
+        return;
+    }
+    for (size_t i = 0; i < index_engine_nodes.size(); i++) {
+        IndexDataProto partition_data = PartitionIndexData(
+            index_data_proto, i, index_engine_nodes.size());
+        CHECK(partition_data.SerializeToString(&serialized_data));
+        message.payload_size = gsl::narrow_cast<uint32_t>(serialized_data.size());
         SendSharedLogMessage(protocol::ConnType::STORAGE_TO_ENGINE,
-                             engine_id, message, STRING_AS_SPAN(serialized_data));
+                             index_engine_nodes[i], message, STRING_AS_SPAN(serialized_data));
     }
 }
 
+IndexDataProto StorageBase::PartitionIndexData(const IndexDataProto& index_data_proto,
+                                               size_t partition, size_t num_partitions) {
+    // Entries are kept even without tags of this partition, as the index
+    // needs all seqnums to advance its progress
+    IndexDataProto partition_data;
+    partition_data.set_logspace_id(index_data_proto.logspace_id());
+    partition_data.set_partition(gsl::narrow_cast<uint32_t>(partition));
+    partition_data.mutable_seqnum_halves()->CopyFrom(index_data_proto.seqnum_halves());
+    partition_data.mutable_engine_ids()->CopyFrom(index_data_proto.engine_ids());
+    partition_data.mutable_user_logspaces()->CopyFrom(index_data_proto.user_logspaces());
+    DCHECK_EQ(index_data_proto.cond_entries_size(), 0)
+        << "Conditional appends are not supported by partitioned index";
+    auto tag_iter = index_data_proto.user_tags().begin();
+    for (int i = 0; i < index_data_proto.seqnum_halves_size(); i++) {
+        uint32_t user_logspace = index_data_proto.user_logspaces(i);
+        uint32_t num_tags = 0;
+        for (uint32_t j = 0; j < index_data_proto.user_tag_sizes(i); j++) {
+            uint64_t user_tag = *(tag_iter++);
+            if (log_utils::IndexPartitionOf(user_logspace, user_tag,
+                                            num_partitions) == partition) {
+                partition_data.add_user_tags(user_tag);
+                num_tags++;
+            }
+        }
+        partition_data.add_user_tag_sizes(num_tags);
+    }
+    return partition_data;
+}
+
 bool StorageBase::SendSequencerMessage(uint16_t sequencer_id,
                                        SharedLogMessage* message,
                                        std::span<const char> payload) {
@@ -172,6 +642,15 @@ bool StorageBase::SendSequencerMessage(uint16_t sequencer_id,
                                 sequencer_id, *message, payload);
 }
 
+bool StorageBase::SendEngineMessage(uint16_t engine_id,
+                                    SharedLogMessage* message,
+                                    std::span<const char> payload) {
+    message->origin_node_id = node_id_;
+    message->payload_size = gsl::narrow_cast<uint32_t>(payload.size());
+    return SendSharedLogMessage(protocol::ConnType::STORAGE_TO_ENGINE,
+                                engine_id, *message, payload);
+}
+
 bool StorageBase::SendEngineResponse(const SharedLogMessage& request,
                                      SharedLogMessage* response,
                                      std::span<const char> payload1,
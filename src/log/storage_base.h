@@ -6,6 +6,10 @@
 #include "log/view_watcher.h"
 #include "log/db.h"
 #include "log/cache.h"
+#include "log/archive.h"
+#include "log/compression.h"
+#include "log/journal.h"
+#include "log/memtable.h"
 #include "server/server_base.h"
 #include "server/ingress_connection.h"
 #include "server/egress_hub.h"
@@ -34,21 +38,62 @@ protected:
     virtual void OnRecvLogAuxData(const protocol::SharedLogMessage& message,
                                   std::span<const char> payload) = 0;
 
-    virtual void BackgroundThreadMain() = 0;
+    size_t num_background_threads() const { return background_threads_.size(); }
+    virtual void BackgroundThreadMain(size_t thread_idx) = 0;
     virtual void SendShardProgressIfNeeded() = 0;
 
-    void LogCachePutAuxData(uint64_t seqnum, std::span<const char> data);
-    std::optional<std::string> LogCacheGetAuxData(uint64_t seqnum);
+    DurabilityLevel GetDurabilityLevel(uint32_t user_logspace) const;
+    bool journal_enabled() const { return journal_ != nullptr; }
+    // Durability of the entry is reported by OnJournalEntriesDurable
+    void AppendToJournal(uint32_t logspace_id, const LogMetaData& log_metadata,
+                         std::span<const uint64_t> user_tags, std::span<const char> log_data);
+    virtual void OnJournalEntriesDurable(const LogJournal::EntryKeyVec& entries) = 0;
+    // Called after entries are persisted in DB, or the log space is done with
+    void ReleaseJournalEntries(std::span<const LogEntryView> log_entries);
+    void ReleaseJournalEntry(uint32_t logspace_id, uint64_t localid);
+    void ReleaseJournalLogSpace(uint32_t logspace_id);
+    // Entries of the log space recovered from the journal on startup
+    std::vector<LogEntry> TakeRecoveredEntries(uint32_t logspace_id);
+
+    void LogCachePutAuxData(uint32_t user_logspace, uint64_t seqnum,
+                            std::span<const char> data);
+    std::optional<std::string> LogCacheGetAuxData(uint32_t user_logspace, uint64_t seqnum);
 
     void MessageHandler(const protocol::SharedLogMessage& message,
                         std::span<const char> payload);
     std::optional<LogEntryProto> GetLogEntryFromDB(uint64_t seqnum);
-    void PutLogEntryToDB(const LogEntry& log_entry);
+    // Returns false if the DB backend cannot scan entries in seqnum order
+    bool ScanLogEntriesFromDB(uint64_t start_seqnum, size_t max_entries,
+                              std::vector<LogEntryProto>* log_entries);
+    // Returns true if the entry is written without WAL
+    bool PutLogEntryToDB(const LogEntryView& log_entry);
+    // Decompress data of the log entry read from DB
+    bool DecompressLogData(const LogEntryProto& log_entry, std::string* data);
+    std::optional<std::string> GetAuxDataFromDB(uint64_t seqnum);
+    bool PutAuxDataToDB(uint32_t logspace_id, const DBInterface::AuxDataBatch& batch);
+    std::optional<StorageCheckpointProto> GetCheckpointFromDB(uint32_t logspace_id);
+    // `wal_skipped` if entries of the checkpoint are written without WAL.
+    // Checkpoints older than the last written one are dropped.
+    void PutCheckpointToDB(const StorageCheckpointProto& checkpoint, bool wal_skipped);
+    // Returns the seqnum following the last entry from `start_seqnum` in DB
+    uint64_t FindDBTail(uint64_t start_seqnum);
+
+    bool archive_enabled() const { return archive_ != nullptr; }
+    // Runs on its own thread if archiving is enabled
+    virtual void ArchiveThreadMain() = 0;
+    // Moves persisted entries below `end_seqnum` from DB to the archive.
+    // Unless `partial_segment` is set, only full segments are archived.
+    void ArchiveLogEntries(uint64_t end_seqnum, bool partial_segment);
 
     void SendIndexData(const View* view, const IndexDataProto& index_data_proto);
+    static IndexDataProto PartitionIndexData(const IndexDataProto& index_data_proto,
+                                             size_t partition, size_t num_partitions);
     bool SendSequencerMessage(uint16_t sequencer_id,
                               protocol::SharedLogMessage* message,
                               std::span<const char> payload);
+    bool SendEngineMessage(uint16_t engine_id,
+                           protocol::SharedLogMessage* message,
+                           std::span<const char> payload);
     bool SendEngineResponse(const protocol::SharedLogMessage& request,
                             protocol::SharedLogMessage* response,
                             std::span<const char> payload1 = EMPTY_CHAR_SPAN,
@@ -63,7 +108,7 @@ private:
     std::string db_path_;
     std::unique_ptr<DBInterface> db_;
 
-    base::Thread background_thread_;
+    std::vector<std::unique_ptr<base::Thread>> background_threads_;
 
     absl::flat_hash_map</* id */ int, std::unique_ptr<server::IngressConnection>>
         ingress_conns_;
@@ -74,10 +119,50 @@ private:
 
     std::optional<LRUCache> log_cache_;
 
+    // Always present for decompression, compression is enabled by flag
+    bool compress_log_data_;
+    std::unique_ptr<LogCompressor> log_compressor_;
+
+    DurabilityLevel default_durability_;
+    absl::flat_hash_map</* user_logspace */ uint32_t, DurabilityLevel>
+        durability_overrides_;
+    const bool disable_wal_;
+
+    struct CheckpointState {
+        absl::Mutex mu;
+        StorageCheckpointProto last_checkpoint ABSL_GUARDED_BY(mu);
+        // Entries written without WAL since the last DB flush
+        bool wal_skipped ABSL_GUARDED_BY(mu) = false;
+        int64_t last_db_flush_timestamp ABSL_GUARDED_BY(mu) = 0;
+    };
+    absl::Mutex checkpoint_mu_;
+    absl::flat_hash_map</* logspace_id */ uint32_t, std::unique_ptr<CheckpointState>>
+        checkpoint_states_ ABSL_GUARDED_BY(checkpoint_mu_);
+    // Present if any user log space needs durability above memory
+    std::unique_ptr<LogJournal> journal_;
+
+    // Cold entries moved out of DB, present if enabled by flag
+    std::unique_ptr<LogArchive> archive_;
+    const size_t archive_segment_entries_;
+    std::unique_ptr<base::Thread> archive_thread_;
+
+    absl::Mutex recovered_mu_;
+    absl::flat_hash_map</* logspace_id */ uint32_t, std::vector<LogEntry>>
+        recovered_entries_ ABSL_GUARDED_BY(recovered_mu_);
+
     void SetupDB();
+    void SetupDurability();
+    void SetupArchive();
+    void RemoveArchivedEntriesFromDB(uint32_t logspace_id);
+    void DropRecoveredEntriesBefore(uint16_t view_id);
     void SetupZKWatchers();
     void SetupTimers();
 
+    void PutCompressionDictToDB(uint32_t logspace_id, uint32_t dict_version,
+                                std::span<const char> dict);
+    // Installs the dictionary compressing new entries in previous runs
+    void LoadCompressionDictFromDB(uint32_t logspace_id);
+
     void StartInternal() override;
     void StopInternal() override;
     void OnConnectionClose(server::ConnectionBase* connection) override;
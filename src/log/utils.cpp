@@ -1,6 +1,7 @@
 #include "log/utils.h"
 
 #include "utils/bits.h"
+#include "utils/hash.h"
 
 namespace faas {
 namespace log_utils {
@@ -17,6 +18,12 @@ uint16_t GetViewId(uint64_t value) {
     return bits::HighHalf32(bits::HighHalf64(value));
 }
 
+uint64_t CondAnchorSeqNum(uint16_t view_id) {
+    // Never a valid seqnum, as no sequencer takes the maximal node id
+    return bits::JoinTwo32(bits::JoinTwo16(view_id, std::numeric_limits<uint16_t>::max()),
+                           std::numeric_limits<uint32_t>::max());
+}
+
 FutureRequests::FutureRequests()
     : next_view_id_(0) {}
 
@@ -67,18 +74,82 @@ MetaLogsProto MetaLogsFromPayload(std::span<const char> payload) {
     return metalogs_proto;
 }
 
+void EncodeFlatNewLogs(const MetaLogProto& metalog, std::string* payload) {
+    DCHECK(metalog.type() == MetaLogProto::NEW_LOGS);
+    const auto& new_logs_proto = metalog.new_logs_proto();
+    size_t num_shards = static_cast<size_t>(new_logs_proto.shard_starts_size());
+    DCHECK_EQ(num_shards, static_cast<size_t>(new_logs_proto.shard_deltas_size()));
+    size_t offset = payload->size();
+    payload->resize(offset + log::FlatNewLogs::EncodedSize(num_shards));
+    uint32_t header[] = {
+        metalog.logspace_id(),
+        metalog.metalog_seqnum(),
+        new_logs_proto.start_seqnum(),
+        gsl::narrow_cast<uint32_t>(num_shards)
+    };
+    static_assert(sizeof(header) == log::FlatNewLogs::kHeaderFields * sizeof(uint32_t));
+    char* ptr = payload->data() + offset;
+    memcpy(ptr, header, sizeof(header));
+    ptr += sizeof(header);
+    memcpy(ptr, new_logs_proto.shard_starts().data(), num_shards * sizeof(uint32_t));
+    ptr += num_shards * sizeof(uint32_t);
+    memcpy(ptr, new_logs_proto.shard_deltas().data(), num_shards * sizeof(uint32_t));
+}
+
+FlatNewLogsVec FlatNewLogsFromPayload(std::span<const char> payload) {
+    FlatNewLogsVec results;
+    size_t header_size = log::FlatNewLogs::EncodedSize(0);
+    size_t pos = 0;
+    while (pos < payload.size()) {
+        if (pos + header_size > payload.size()) {
+            LOG(FATAL) << "Truncated FlatNewLogs header";
+        }
+        log::FlatNewLogs new_logs(payload.data() + pos);
+        pos += new_logs.encoded_size();
+        if (pos > payload.size()) {
+            LOG(FATAL) << "Truncated FlatNewLogs body";
+        }
+        if (!results.empty() && new_logs.logspace_id() != results[0].logspace_id()) {
+            LOG(FATAL) << "Meta logs in one payload must have the same logspace_id";
+        }
+        results.push_back(new_logs);
+    }
+    if (results.empty()) {
+        LOG(FATAL) << "Empty FlatNewLogs payload";
+    }
+    return results;
+}
+
+MetaLogsPayload::MetaLogsPayload(const SharedLogMessage& message,
+                                 std::span<const char> payload)
+    : flat_((message.flags & protocol::kFlatMetaLogsFlag) != 0) {
+    if (flat_) {
+        flat_new_logs_ = FlatNewLogsFromPayload(payload);
+        logspace_id_ = flat_new_logs_[0].logspace_id();
+    } else {
+        metalogs_proto_ = MetaLogsFromPayload(payload);
+        logspace_id_ = metalogs_proto_.logspace_id();
+    }
+}
+
 LogMetaData GetMetaDataFromMessage(const SharedLogMessage& message) {
     size_t total_size = message.payload_size;
     size_t num_tags = message.num_tags;
     size_t aux_data_size = message.aux_data_size;
     DCHECK_LT(num_tags * sizeof(uint64_t) + aux_data_size, total_size);
     size_t log_data_size = total_size - num_tags * sizeof(uint64_t) - aux_data_size;
+    // Flags share the same field with op_result in responses
+    bool cond_append = protocol::SharedLogMessageHelper::GetOpType(message)
+                           == protocol::SharedLogOpType::REPLICATE
+                    && (message.flags & protocol::kCondAppendFlag) != 0;
     return LogMetaData {
         .user_logspace = message.user_logspace,
         .seqnum = bits::JoinTwo32(message.logspace_id, message.seqnum_lowhalf),
         .localid = message.localid,
         .num_tags = num_tags,
-        .data_size = log_data_size
+        .data_size = log_data_size,
+        .cond_append = cond_append,
+        .cond_tail_seqnum = cond_append ? message.cond_tail_seqnum : log::kInvalidLogSeqNum
     };
 }
 
@@ -116,12 +187,107 @@ void SplitPayloadForMessage(const protocol::SharedLogMessage& message,
     }
 }
 
+namespace {
+static inline size_t ReplicateRecordPadding(size_t size) {
+    return (sizeof(uint64_t) - size % sizeof(uint64_t)) % sizeof(uint64_t);
+}
+}  // namespace
+
+void AppendReplicateRecord(const SharedLogMessage& record,
+                           std::span<const uint64_t> user_tags,
+                           std::span<const char> log_data,
+                           std::string* batch_payload) {
+    DCHECK_EQ(size_t{record.payload_size},
+              user_tags.size() * sizeof(uint64_t) + log_data.size());
+    batch_payload->append(reinterpret_cast<const char*>(&record), sizeof(SharedLogMessage));
+    batch_payload->append(reinterpret_cast<const char*>(user_tags.data()),
+                          user_tags.size() * sizeof(uint64_t));
+    batch_payload->append(log_data.data(), log_data.size());
+    batch_payload->append(ReplicateRecordPadding(record.payload_size), '\0');
+}
+
+ReplicateRecordVec SplitReplicateBatch(std::span<const char> batch_payload) {
+    ReplicateRecordVec records;
+    size_t pos = 0;
+    while (pos < batch_payload.size()) {
+        if (pos + sizeof(SharedLogMessage) > batch_payload.size()) {
+            LOG(FATAL) << "Truncated replicate record header";
+        }
+        SharedLogMessage record;
+        memcpy(&record, batch_payload.data() + pos, sizeof(SharedLogMessage));
+        pos += sizeof(SharedLogMessage);
+        size_t payload_size = record.payload_size;
+        if (pos + payload_size > batch_payload.size()) {
+            LOG(FATAL) << "Truncated replicate record payload";
+        }
+        records.push_back(std::make_pair(record, batch_payload.subspan(pos, payload_size)));
+        pos += payload_size + ReplicateRecordPadding(payload_size);
+    }
+    return records;
+}
+
+namespace {
+constexpr size_t   kTagFilterBitsPerTag = 10;
+constexpr size_t   kTagFilterNumProbes  = 6;
+constexpr uint64_t kTagFilterSeed2      = 0x9e3779b97f4a7c15ULL;
+
+// Double hashing: probe i is at (h1 + i * h2) mod num_bits
+template<class Fn>
+void ForEachTagFilterProbe(size_t num_bits, uint64_t user_tag, Fn&& fn) {
+    uint64_t h1 = hash::xxHash64(user_tag);
+    uint64_t h2 = hash::xxHash64(user_tag, kTagFilterSeed2) | 1;
+    for (size_t i = 0; i < kTagFilterNumProbes; i++) {
+        fn((h1 + i * h2) % num_bits);
+    }
+}
+}  // namespace
+
+std::string BuildTagFilter(std::span<const uint64_t> user_tags) {
+    size_t num_bytes = std::max<size_t>(
+        8, (user_tags.size() * kTagFilterBitsPerTag + 7) / 8);
+    std::string filter(num_bytes, '\0');
+    for (uint64_t user_tag : user_tags) {
+        ForEachTagFilterProbe(num_bytes * 8, user_tag, [&filter] (size_t bit) {
+            filter[bit / 8] = static_cast<char>(
+                static_cast<uint8_t>(filter[bit / 8]) | (1U << (bit % 8)));
+        });
+    }
+    return filter;
+}
+
+bool TagFilterMayContain(std::string_view filter, uint64_t user_tag) {
+    if (filter.empty()) {
+        return false;
+    }
+    bool contains = true;
+    ForEachTagFilterProbe(filter.size() * 8, user_tag, [filter, &contains] (size_t bit) {
+        if ((static_cast<uint8_t>(filter[bit / 8]) & (1U << (bit % 8))) == 0) {
+            contains = false;
+        }
+    });
+    return contains;
+}
+
+size_t IndexPartitionOf(uint32_t user_logspace, uint64_t user_tag,
+                        size_t num_partitions) {
+    DCHECK_GT(num_partitions, 0U);
+    if (user_tag == log::kEmptyLogTag) {
+        return 0;
+    }
+    return hash::xxHash64(user_tag, /* seed= */ user_logspace) % num_partitions;
+}
+
 void PopulateMetaDataToMessage(const LogMetaData& metadata, SharedLogMessage* message) {
     message->logspace_id = bits::HighHalf64(metadata.seqnum);
     message->user_logspace = metadata.user_logspace;
     message->seqnum_lowhalf = bits::LowHalf64(metadata.seqnum);
     message->num_tags = gsl::narrow_cast<uint16_t>(metadata.num_tags);
     message->localid = metadata.localid;
+    if (metadata.cond_append) {
+        DCHECK_GT(metadata.num_tags, 0U);
+        message->flags |= protocol::kCondAppendFlag;
+        message->cond_tail_seqnum = metadata.cond_tail_seqnum;
+    }
 }
 
 void PopulateMetaDataToMessage(const LogEntryProto& log_entry, SharedLogMessage* message) {
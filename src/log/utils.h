@@ -10,6 +10,10 @@ namespace log_utils {
 
 uint16_t GetViewId(uint64_t value);
 
+// Expected tail of a conditional append, once the appending engine verified
+// the tail of the tag in all views before `view_id`
+uint64_t CondAnchorSeqNum(uint16_t view_id);
+
 // Used for on-holding requests for future views
 class FutureRequests {
 public:
@@ -57,6 +61,34 @@ private:
 
 log::MetaLogsProto MetaLogsFromPayload(std::span<const char> payload);
 
+// Only NEW_LOGS meta logs can be encoded in flat format
+void EncodeFlatNewLogs(const log::MetaLogProto& metalog, std::string* payload);
+using FlatNewLogsVec = absl::InlinedVector<log::FlatNewLogs, 4>;
+FlatNewLogsVec FlatNewLogsFromPayload(std::span<const char> payload);
+
+// Payload of METALOGS message, which is in flat format if kFlatMetaLogsFlag
+// is set. Flat entries point into the payload, so it must outlive this object.
+class MetaLogsPayload {
+public:
+    MetaLogsPayload(const protocol::SharedLogMessage& message,
+                    std::span<const char> payload);
+    ~MetaLogsPayload() {}
+
+    uint32_t logspace_id() const { return logspace_id_; }
+    bool flat() const { return flat_; }
+
+    const FlatNewLogsVec& flat_new_logs() const { return flat_new_logs_; }
+    const log::MetaLogsProto& metalogs_proto() const { return metalogs_proto_; }
+
+private:
+    bool flat_;
+    uint32_t logspace_id_;
+    FlatNewLogsVec flat_new_logs_;
+    log::MetaLogsProto metalogs_proto_;
+
+    DISALLOW_COPY_AND_ASSIGN(MetaLogsPayload);
+};
+
 log::LogMetaData GetMetaDataFromMessage(const protocol::SharedLogMessage& message);
 void SplitPayloadForMessage(const protocol::SharedLogMessage& message,
                             std::span<const char> payload,
@@ -64,6 +96,25 @@ void SplitPayloadForMessage(const protocol::SharedLogMessage& message,
                             std::span<const char>* log_data,
                             std::span<const char>* aux_data);
 
+// Multi-record REPLICATE payload: each record is a SharedLogMessage followed
+// by its payload, padded to 8 bytes so that user tags stay aligned
+void AppendReplicateRecord(const protocol::SharedLogMessage& record,
+                           std::span<const uint64_t> user_tags,
+                           std::span<const char> log_data,
+                           std::string* batch_payload);
+using ReplicateRecordVec = absl::InlinedVector<
+    std::pair<protocol::SharedLogMessage, std::span<const char>>, 8>;
+ReplicateRecordVec SplitReplicateBatch(std::span<const char> batch_payload);
+
+// Bloom filter of user tags, used in TagSummaryProto
+std::string BuildTagFilter(std::span<const uint64_t> user_tags);
+bool TagFilterMayContain(std::string_view filter, uint64_t user_tag);
+
+// Partition of the index holding user_tag, if the index is partitioned by tag.
+// Full-log queries (with kEmptyLogTag) are served by partition 0.
+size_t IndexPartitionOf(uint32_t user_logspace, uint64_t user_tag,
+                        size_t num_partitions);
+
 void PopulateMetaDataToMessage(const log::LogMetaData& metadata,
                                protocol::SharedLogMessage* message);
 void PopulateMetaDataToMessage(const log::LogEntryProto& log_entry,
@@ -21,6 +21,8 @@ constexpr int kSLogLocalCutTimerTypeId      = kTimerTypeId + 1;
 constexpr int kSLogStateCheckTimerTypeId    = kTimerTypeId + 2;
 constexpr int kSendShardProgressTimerId     = kTimerTypeId + 3;
 constexpr int kMetaLogCutTimerId            = kTimerTypeId + 3;
+constexpr int kReplicateBatchTimerId        = kTimerTypeId + 4;
+constexpr int kHedgedReadTimerId            = kTimerTypeId + 5;
 
 // Used by Gateway
 constexpr int kHttpConnectionTypeId         = 0x20 << 16;
@@ -48,13 +48,19 @@ const (
 
 // SharedLogOpType enum
 const (
-	SharedLogOpType_INVALID     uint16 = 0x00
-	SharedLogOpType_APPEND      uint16 = 0x01
-	SharedLogOpType_READ_NEXT   uint16 = 0x02
-	SharedLogOpType_READ_PREV   uint16 = 0x03
-	SharedLogOpType_TRIM        uint16 = 0x04
-	SharedLogOpType_SET_AUXDATA uint16 = 0x05
-	SharedLogOpType_READ_NEXT_B uint16 = 0x06
+	SharedLogOpType_INVALID         uint16 = 0x00
+	SharedLogOpType_APPEND          uint16 = 0x01
+	SharedLogOpType_READ_NEXT       uint16 = 0x02
+	SharedLogOpType_READ_PREV       uint16 = 0x03
+	SharedLogOpType_TRIM            uint16 = 0x04
+	SharedLogOpType_SET_AUXDATA     uint16 = 0x05
+	SharedLogOpType_READ_NEXT_B     uint16 = 0x06
+	SharedLogOpType_ASYNC_APPEND    uint16 = 0x07
+	SharedLogOpType_RESOLVE_LOCALID uint16 = 0x08
+	SharedLogOpType_COND_APPEND     uint16 = 0x09
+	SharedLogOpType_SUBSCRIBE       uint16 = 0x0a
+	SharedLogOpType_UNSUBSCRIBE     uint16 = 0x0b
+	SharedLogOpType_SUB_CREDITS     uint16 = 0x0c
 )
 
 // SharedLogResultType enum
@@ -72,9 +78,19 @@ const (
 	SharedLogResultType_EMPTY       uint16 = 0x32
 	SharedLogResultType_DATA_LOST   uint16 = 0x33
 	SharedLogResultType_TRIM_FAILED uint16 = 0x34
+	SharedLogResultType_COND_FAILED uint16 = 0x35
+)
+
+// ReadConsistency enum
+const (
+	ReadConsistency_STRICT            uint16 = 0
+	ReadConsistency_BOUNDED_POSITIONS uint16 = 1
+	ReadConsistency_BOUNDED_MICROS    uint16 = 2
+	ReadConsistency_LOCAL_LATEST      uint16 = 3
 )
 
 const MaxLogSeqnum = uint64(0xffff000000000000)
+const InvalidLogSeqnum = uint64(0xffffffffffffffff)
 
 const MessageTypeBits = 4
 
@@ -94,6 +110,8 @@ const (
 	FLAG_UseFifoForNestedCall      uint32 = (1 << 1)
 	FLAG_kAsyncInvokeFunc          uint32 = (1 << 2)
 	FLAG_kUseAuxBuffer             uint32 = (1 << 3)
+	FLAG_kSubscribeWithData        uint32 = (1 << 4)
+	FLAG_kReadNoCache              uint32 = (1 << 5)
 )
 
 func GetFlagsFromMessage(buffer []byte) uint32 {
@@ -117,6 +135,10 @@ func GetLogSeqNumFromMessage(buffer []byte) uint64 {
 	return binary.LittleEndian.Uint64(buffer[8:16])
 }
 
+func GetLogLocalIdFromMessage(buffer []byte) uint64 {
+	return binary.LittleEndian.Uint64(buffer[8:16])
+}
+
 func GetLogNumTagsFromMessage(buffer []byte) int {
 	return int(binary.LittleEndian.Uint16(buffer[36:38]))
 }
@@ -221,6 +243,31 @@ func NewSharedLogAppendMessage(currentCallId uint64, myClientId uint16, numTags
 	return buffer
 }
 
+func NewSharedLogAsyncAppendMessage(currentCallId uint64, myClientId uint16, numTags uint16, clientData uint64) []byte {
+	buffer := NewSharedLogAppendMessage(currentCallId, myClientId, numTags, clientData)
+	binary.LittleEndian.PutUint16(buffer[32:34], SharedLogOpType_ASYNC_APPEND)
+	return buffer
+}
+
+func NewSharedLogCondAppendMessage(currentCallId uint64, myClientId uint16, numTags uint16, condTag uint64, condTailSeqNum uint64, clientData uint64) []byte {
+	buffer := NewSharedLogAppendMessage(currentCallId, myClientId, numTags, clientData)
+	binary.LittleEndian.PutUint16(buffer[32:34], SharedLogOpType_COND_APPEND)
+	binary.LittleEndian.PutUint64(buffer[40:48], condTag)
+	binary.LittleEndian.PutUint64(buffer[8:16], condTailSeqNum)
+	return buffer
+}
+
+func NewSharedLogResolveLocalIdMessage(currentCallId uint64, myClientId uint16, localId uint64, clientData uint64) []byte {
+	buffer := NewEmptyMessage()
+	tmp := (currentCallId << MessageTypeBits) + uint64(MessageType_SHARED_LOG_OP)
+	binary.LittleEndian.PutUint64(buffer[0:8], tmp)
+	binary.LittleEndian.PutUint16(buffer[32:34], SharedLogOpType_RESOLVE_LOCALID)
+	binary.LittleEndian.PutUint16(buffer[34:36], myClientId)
+	binary.LittleEndian.PutUint64(buffer[48:56], clientData)
+	binary.LittleEndian.PutUint64(buffer[8:16], localId)
+	return buffer
+}
+
 func NewSharedLogReadMessage(currentCallId uint64, myClientId uint16, tag uint64, seqNum uint64, direction int, block bool, clientData uint64) []byte {
 	buffer := NewEmptyMessage()
 	tmp := (currentCallId << MessageTypeBits) + uint64(MessageType_SHARED_LOG_OP)
@@ -241,6 +288,64 @@ func NewSharedLogReadMessage(currentCallId uint64, myClientId uint16, tag uint64
 	return buffer
 }
 
+func NewSharedLogSubscribeMessage(currentCallId uint64, myClientId uint16, tag uint64, seqNum uint64, credits uint32, withData bool, clientData uint64) []byte {
+	buffer := NewEmptyMessage()
+	tmp := (currentCallId << MessageTypeBits) + uint64(MessageType_SHARED_LOG_OP)
+	binary.LittleEndian.PutUint64(buffer[0:8], tmp)
+	if withData {
+		binary.LittleEndian.PutUint32(buffer[28:32], FLAG_kSubscribeWithData)
+	}
+	binary.LittleEndian.PutUint16(buffer[32:34], SharedLogOpType_SUBSCRIBE)
+	binary.LittleEndian.PutUint16(buffer[34:36], myClientId)
+	binary.LittleEndian.PutUint64(buffer[40:48], tag)
+	binary.LittleEndian.PutUint64(buffer[48:56], clientData)
+	binary.LittleEndian.PutUint64(buffer[8:16], seqNum)
+	binary.LittleEndian.PutUint32(buffer[56:60], credits)
+	return buffer
+}
+
+func NewSharedLogSubCreditsMessage(currentCallId uint64, myClientId uint16, credits uint32, clientData uint64) []byte {
+	buffer := NewEmptyMessage()
+	tmp := (currentCallId << MessageTypeBits) + uint64(MessageType_SHARED_LOG_OP)
+	binary.LittleEndian.PutUint64(buffer[0:8], tmp)
+	binary.LittleEndian.PutUint16(buffer[32:34], SharedLogOpType_SUB_CREDITS)
+	binary.LittleEndian.PutUint16(buffer[34:36], myClientId)
+	binary.LittleEndian.PutUint64(buffer[48:56], clientData)
+	binary.LittleEndian.PutUint32(buffer[56:60], credits)
+	return buffer
+}
+
+func NewSharedLogUnsubscribeMessage(currentCallId uint64, myClientId uint16, clientData uint64) []byte {
+	buffer := NewEmptyMessage()
+	tmp := (currentCallId << MessageTypeBits) + uint64(MessageType_SHARED_LOG_OP)
+	binary.LittleEndian.PutUint64(buffer[0:8], tmp)
+	binary.LittleEndian.PutUint16(buffer[32:34], SharedLogOpType_UNSUBSCRIBE)
+	binary.LittleEndian.PutUint16(buffer[34:36], myClientId)
+	binary.LittleEndian.PutUint64(buffer[48:56], clientData)
+	return buffer
+}
+
+// Turns a read message into a multi-tag read, taking the first tag for its index partition
+func SetLogTagsInReadMessage(buffer []byte, tags []uint64) {
+	binary.LittleEndian.PutUint64(buffer[40:48], tags[0])
+	binary.LittleEndian.PutUint16(buffer[36:38], uint16(len(tags)))
+	FillInlineDataInMessage(buffer, BuildLogTagsBuffer(tags))
+}
+
+func SetReadConsistencyInMessage(buffer []byte, consistency uint16, stalenessBound uint32) {
+	binary.LittleEndian.PutUint16(buffer[56:58], consistency)
+	binary.LittleEndian.PutUint32(buffer[60:64], stalenessBound)
+}
+
+func SetReadNoCacheInMessage(buffer []byte) {
+	flags := binary.LittleEndian.Uint32(buffer[28:32])
+	binary.LittleEndian.PutUint32(buffer[28:32], flags|FLAG_kReadNoCache)
+}
+
+func GetLogMetaLogProgressFromMessage(buffer []byte) uint64 {
+	return binary.LittleEndian.Uint64(buffer[56:64])
+}
+
 func NewSharedLogSetAuxDataMessage(currentCallId uint64, myClientId uint16, seqNum uint64, clientData uint64) []byte {
 	buffer := NewEmptyMessage()
 	tmp := (currentCallId << MessageTypeBits) + uint64(MessageType_SHARED_LOG_OP)
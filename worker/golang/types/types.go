@@ -9,6 +9,16 @@ type LogEntry struct {
 	Tags    []uint64
 	Data    []byte
 	AuxData []byte
+	// Metalog progress of the index serving the read
+	MetaLogProgress uint64
+}
+
+// Logs of a tag pushed by the engine as they are indexed
+type LogSubscription interface {
+	// Wait for the next log in seqnum order. Only SeqNum and MetaLogProgress
+	// are set if the subscription does not carry data
+	Next(ctx context.Context) (*LogEntry, error)
+	Unsubscribe() error
 }
 
 type Environment interface {
@@ -21,6 +31,15 @@ type Environment interface {
 	// Shared log operations
 	// Append a new log entry, tags must be non-zero
 	SharedLogAppend(ctx context.Context, tags []uint64, data []byte) ( /* seqnum */ uint64, error)
+	// Append a new log entry, returning once it is replicated on storage nodes,
+	// before its seqnum is assigned
+	SharedLogAsyncAppend(ctx context.Context, tags []uint64, data []byte) ( /* localid */ uint64, error)
+	// Wait for the seqnum of a log entry appended by SharedLogAsyncAppend
+	SharedLogResolveLocalId(ctx context.Context, localId uint64) ( /* seqnum */ uint64, error)
+	// Append a new log entry only if the last log with `condTag` has seqnum `condTailSeqNum`
+	// (protocol.InvalidLogSeqnum for no logs), `condTag` must be one of `tags`.
+	// The returned bool tells if the condition holds when the log is ordered
+	SharedLogCondAppend(ctx context.Context, tags []uint64, data []byte, condTag uint64, condTailSeqNum uint64) ( /* seqnum */ uint64, bool, error)
 	// Read the first log with `tag` whose seqnum >= given `seqNum`
 	// `tag`==0 means considering log with any tag, including empty tag
 	SharedLogReadNext(ctx context.Context, tag uint64, seqNum uint64) (*LogEntry, error)
@@ -30,6 +49,19 @@ type Environment interface {
 	SharedLogReadPrev(ctx context.Context, tag uint64, seqNum uint64) (*LogEntry, error)
 	// Alias for ReadPrev(tag, MaxSeqNum)
 	SharedLogCheckTail(ctx context.Context, tag uint64) (*LogEntry, error)
+	// ReadNext (`direction` > 0) or ReadPrev (`direction` < 0) allowed to see a stale
+	// index, given by `consistency` (protocol.ReadConsistency_*) and `stalenessBound`,
+	// in metalog positions or microseconds
+	SharedLogReadWithConsistency(ctx context.Context, tag uint64, seqNum uint64, direction int, consistency uint16, stalenessBound uint32) (*LogEntry, error)
+	// ReadNext (`direction` > 0) or ReadPrev (`direction` < 0) without filling the engine's
+	// log cache, intended for one-pass scans such as replays
+	SharedLogReadNoCache(ctx context.Context, tag uint64, seqNum uint64, direction int) (*LogEntry, error)
+	// ReadNext (`direction` > 0) or ReadPrev (`direction` < 0) for the nearest log with
+	// any of `tags`. With a partitioned index, all tags must fall in the same partition
+	SharedLogReadWithTags(ctx context.Context, tags []uint64, seqNum uint64, direction int) (*LogEntry, error)
+	// Subscribe to logs with `tag` whose seqnum >= given `seqNum`. The engine pushes
+	// at most `window` logs ahead of Next calls. Without `withData`, only seqnums are pushed
+	SharedLogSubscribe(ctx context.Context, tag uint64, seqNum uint64, window uint32, withData bool) (LogSubscription, error)
 	// Set auxiliary data for log entry of given `seqNum`
 	SharedLogSetAuxData(ctx context.Context, seqNum uint64, auxData []byte) error
 }
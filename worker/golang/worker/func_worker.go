@@ -38,9 +38,10 @@ type FuncWorker struct {
 	engineConn           net.Conn
 	newFuncCallChan      chan []byte
 	inputPipe            *os.File
-	outputPipe           *os.File                 // protected by mux
-	outgoingFuncCalls    map[uint64](chan []byte) // protected by mux
-	outgoingLogOps       map[uint64](chan []byte) // protected by mux
+	outputPipe           *os.File                    // protected by mux
+	outgoingFuncCalls    map[uint64](chan []byte)    // protected by mux
+	outgoingLogOps       map[uint64](chan []byte)    // protected by mux
+	logSubscriptions     map[uint64]*logSubscription // protected by mux
 	handler              types.FuncHandler
 	grpcHandler          types.GrpcFuncHandler
 	nextCallId           uint32
@@ -72,6 +73,7 @@ func NewFuncWorker(funcId uint16, clientId uint16, factory types.FuncHandlerFact
 		newFuncCallChan:      make(chan []byte, 4),
 		outgoingFuncCalls:    make(map[uint64](chan []byte)),
 		outgoingLogOps:       make(map[uint64](chan []byte)),
+		logSubscriptions:     make(map[uint64]*logSubscription),
 		nextCallId:           0,
 		nextLogOpId:          0,
 		currentCall:          0,
@@ -118,6 +120,13 @@ func (w *FuncWorker) Run() {
 			if ch, exists := w.outgoingLogOps[id]; exists {
 				ch <- message
 				delete(w.outgoingLogOps, id)
+			} else if sub, exists := w.logSubscriptions[id]; exists {
+				sub.messages <- message
+				result := protocol.GetSharedLogResultTypeFromMessage(message)
+				if result != protocol.SharedLogResultType_READ_OK {
+					// The engine removed the failed subscription
+					w.closeLogSubscription(sub, fmt.Errorf("Subscription failed with err code: 0x%x", result))
+				}
 			}
 			w.mux.Unlock()
 		} else {
@@ -246,6 +255,7 @@ func (w *FuncWorker) executeFunc(dispatchFuncMessage []byte) {
 	}
 	processingTime := common.GetMonotonicMicroTimestamp() - startTimestamp
 	atomic.StoreUint64(&w.currentCall, 0)
+	w.closeLogSubscriptionsOfCall(funcCall.FullCallId())
 	if err != nil {
 		log.Printf("[ERROR] FuncCall failed with error: %v", err)
 	}
@@ -623,6 +633,153 @@ func (w *FuncWorker) SharedLogAppend(ctx context.Context, tags []uint64, data []
 	}
 }
 
+func (w *FuncWorker) SharedLogAsyncAppend(ctx context.Context, tags []uint64, data []byte) (uint64, error) {
+	if len(data) == 0 {
+		return 0, fmt.Errorf("Data cannot be empty")
+	}
+	tags, err := checkAndDuplicateTags(tags)
+	if err != nil {
+		return 0, err
+	}
+
+	id := atomic.AddUint64(&w.nextLogOpId, 1)
+	currentCallId := atomic.LoadUint64(&w.currentCall)
+	message := protocol.NewSharedLogAsyncAppendMessage(currentCallId, w.clientId, uint16(len(tags)), id)
+
+	var encodedData []byte
+	if len(tags) == 0 {
+		encodedData = data
+	} else {
+		tagBuffer := protocol.BuildLogTagsBuffer(tags)
+		encodedData = bytes.Join([][]byte{tagBuffer, data}, nil /* sep */)
+	}
+
+	if len(encodedData) <= protocol.MessageInlineDataSize {
+		protocol.FillInlineDataInMessage(message, encodedData)
+	} else {
+		auxBuf := &AuxBuffer{
+			id:   w.GenerateUniqueID(),
+			data: encodedData,
+		}
+		w.auxBufSendChan <- auxBuf
+		protocol.FillAuxBufferDataInfo(message, auxBuf.id)
+	}
+
+	w.mux.Lock()
+	outputChan := make(chan []byte, 1)
+	w.outgoingLogOps[id] = outputChan
+	_, err = w.outputPipe.Write(message)
+	w.mux.Unlock()
+	if err != nil {
+		return 0, err
+	}
+
+	response := <-outputChan
+	result := protocol.GetSharedLogResultTypeFromMessage(response)
+	if result == protocol.SharedLogResultType_LOCALID {
+		return protocol.GetLogLocalIdFromMessage(response), nil
+	} else {
+		return 0, fmt.Errorf("Failed to append log")
+	}
+}
+
+func (w *FuncWorker) SharedLogCondAppend(ctx context.Context, tags []uint64, data []byte, condTag uint64, condTailSeqNum uint64) (uint64, bool, error) {
+	if len(data) == 0 {
+		return 0, false, fmt.Errorf("Data cannot be empty")
+	}
+	tags, err := checkAndDuplicateTags(tags)
+	if err != nil {
+		return 0, false, err
+	}
+	hasCondTag := false
+	for _, tag := range tags {
+		if tag == condTag {
+			hasCondTag = true
+			break
+		}
+	}
+	if !hasCondTag {
+		return 0, false, fmt.Errorf("Condition tag %d is not a tag of the log", condTag)
+	}
+
+	sleepDuration := 5 * time.Millisecond
+	remainingRetries := 4
+
+	for {
+		id := atomic.AddUint64(&w.nextLogOpId, 1)
+		currentCallId := atomic.LoadUint64(&w.currentCall)
+		message := protocol.NewSharedLogCondAppendMessage(currentCallId, w.clientId, uint16(len(tags)), condTag, condTailSeqNum, id)
+
+		tagBuffer := protocol.BuildLogTagsBuffer(tags)
+		encodedData := bytes.Join([][]byte{tagBuffer, data}, nil /* sep */)
+
+		if len(encodedData) <= protocol.MessageInlineDataSize {
+			protocol.FillInlineDataInMessage(message, encodedData)
+		} else {
+			auxBuf := &AuxBuffer{
+				id:   w.GenerateUniqueID(),
+				data: encodedData,
+			}
+			w.auxBufSendChan <- auxBuf
+			protocol.FillAuxBufferDataInfo(message, auxBuf.id)
+		}
+
+		w.mux.Lock()
+		outputChan := make(chan []byte, 1)
+		w.outgoingLogOps[id] = outputChan
+		_, err = w.outputPipe.Write(message)
+		w.mux.Unlock()
+		if err != nil {
+			return 0, false, err
+		}
+
+		response := <-outputChan
+		result := protocol.GetSharedLogResultTypeFromMessage(response)
+		if result == protocol.SharedLogResultType_APPEND_OK {
+			return protocol.GetLogSeqNumFromMessage(response), true, nil
+		} else if result == protocol.SharedLogResultType_COND_FAILED {
+			return 0, false, nil
+		} else if result == protocol.SharedLogResultType_DISCARDED {
+			log.Printf("[ERROR] Conditional append discarded, will retry")
+			if remainingRetries > 0 {
+				time.Sleep(sleepDuration)
+				sleepDuration *= 2
+				remainingRetries--
+				continue
+			} else {
+				return 0, false, fmt.Errorf("Failed to append log")
+			}
+		} else {
+			return 0, false, fmt.Errorf("Failed to append log")
+		}
+	}
+}
+
+func (w *FuncWorker) SharedLogResolveLocalId(ctx context.Context, localId uint64) (uint64, error) {
+	id := atomic.AddUint64(&w.nextLogOpId, 1)
+	currentCallId := atomic.LoadUint64(&w.currentCall)
+	message := protocol.NewSharedLogResolveLocalIdMessage(currentCallId, w.clientId, localId, id)
+
+	w.mux.Lock()
+	outputChan := make(chan []byte, 1)
+	w.outgoingLogOps[id] = outputChan
+	_, err := w.outputPipe.Write(message)
+	w.mux.Unlock()
+	if err != nil {
+		return 0, err
+	}
+
+	response := <-outputChan
+	result := protocol.GetSharedLogResultTypeFromMessage(response)
+	if result == protocol.SharedLogResultType_APPEND_OK {
+		return protocol.GetLogSeqNumFromMessage(response), nil
+	} else if result == protocol.SharedLogResultType_DISCARDED {
+		return 0, fmt.Errorf("Log with localid %#016x is discarded", localId)
+	} else {
+		return 0, fmt.Errorf("Failed to resolve localid %#016x", localId)
+	}
+}
+
 func (w *FuncWorker) buildLogEntryFromReadResponse(response []byte) *types.LogEntry {
 	seqNum := protocol.GetLogSeqNumFromMessage(response)
 	numTags := protocol.GetLogNumTagsFromMessage(response)
@@ -653,6 +810,8 @@ func (w *FuncWorker) buildLogEntryFromReadResponse(response []byte) *types.LogEn
 		Tags:    tags,
 		Data:    encodedData[logDataStart : logDataStart+logDataSize],
 		AuxData: encodedData[logDataStart+logDataSize:],
+
+		MetaLogProgress: protocol.GetLogMetaLogProgressFromMessage(response),
 	}
 }
 
@@ -722,6 +881,43 @@ func (w *FuncWorker) SharedLogCheckTail(ctx context.Context, tag uint64) (*types
 	return w.SharedLogReadPrev(ctx, tag, protocol.MaxLogSeqnum)
 }
 
+// Implement types.Environment
+func (w *FuncWorker) SharedLogReadWithConsistency(ctx context.Context, tag uint64, seqNum uint64, direction int, consistency uint16, stalenessBound uint32) (*types.LogEntry, error) {
+	id := atomic.AddUint64(&w.nextLogOpId, 1)
+	currentCallId := atomic.LoadUint64(&w.currentCall)
+	message := protocol.NewSharedLogReadMessage(currentCallId, w.clientId, tag, seqNum, direction, false /* block */, id)
+	protocol.SetReadConsistencyInMessage(message, consistency, stalenessBound)
+	return w.sharedLogReadCommon(ctx, message, id)
+}
+
+// Implement types.Environment
+func (w *FuncWorker) SharedLogReadNoCache(ctx context.Context, tag uint64, seqNum uint64, direction int) (*types.LogEntry, error) {
+	id := atomic.AddUint64(&w.nextLogOpId, 1)
+	currentCallId := atomic.LoadUint64(&w.currentCall)
+	message := protocol.NewSharedLogReadMessage(currentCallId, w.clientId, tag, seqNum, direction, false /* block */, id)
+	protocol.SetReadNoCacheInMessage(message)
+	return w.sharedLogReadCommon(ctx, message, id)
+}
+
+// Implement types.Environment
+func (w *FuncWorker) SharedLogReadWithTags(ctx context.Context, tags []uint64, seqNum uint64, direction int) (*types.LogEntry, error) {
+	tags, err := checkAndDuplicateTags(tags)
+	if err != nil {
+		return nil, err
+	}
+	if len(tags) == 0 {
+		return nil, fmt.Errorf("Tags cannot be empty")
+	}
+	if len(tags)*protocol.SharedLogTagByteSize > protocol.MessageInlineDataSize {
+		return nil, fmt.Errorf("Too many tags (%d) for one read", len(tags))
+	}
+	id := atomic.AddUint64(&w.nextLogOpId, 1)
+	currentCallId := atomic.LoadUint64(&w.currentCall)
+	message := protocol.NewSharedLogReadMessage(currentCallId, w.clientId, tags[0], seqNum, direction, false /* block */, id)
+	protocol.SetLogTagsInReadMessage(message, tags)
+	return w.sharedLogReadCommon(ctx, message, id)
+}
+
 // Implement types.Environment
 func (w *FuncWorker) SharedLogSetAuxData(ctx context.Context, seqNum uint64, auxData []byte) error {
 	if len(auxData) == 0 {
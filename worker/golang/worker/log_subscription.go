@@ -0,0 +1,130 @@
+package worker
+
+import (
+	"context"
+	"fmt"
+	"sync/atomic"
+
+	"cs.utexas.edu/zjia/faas/protocol"
+	"cs.utexas.edu/zjia/faas/types"
+)
+
+type logSubscription struct {
+	w        *FuncWorker
+	id       uint64
+	callId   uint64
+	window   uint32
+	withData bool
+	// Pushed logs not yet returned by Next, at most window plus a final failure.
+	// Closed once the subscription is removed, after which Next returns err.
+	messages chan []byte
+	err      error // protected by w.mux until messages is closed
+	consumed uint32
+}
+
+// Removes the subscription, so that Next returns err once pushed logs are
+// consumed. Must be called with w.mux held.
+func (w *FuncWorker) closeLogSubscription(sub *logSubscription, err error) {
+	if _, exists := w.logSubscriptions[sub.id]; !exists {
+		return
+	}
+	delete(w.logSubscriptions, sub.id)
+	sub.err = err
+	close(sub.messages)
+}
+
+// Removes subscriptions of the function call, which the engine drops
+// once the call is done
+func (w *FuncWorker) closeLogSubscriptionsOfCall(callId uint64) {
+	w.mux.Lock()
+	for _, sub := range w.logSubscriptions {
+		if sub.callId == callId {
+			w.closeLogSubscription(sub, fmt.Errorf("Subscription ended with function call"))
+		}
+	}
+	w.mux.Unlock()
+}
+
+// Implement types.Environment
+func (w *FuncWorker) SharedLogSubscribe(ctx context.Context, tag uint64, seqNum uint64, window uint32, withData bool) (types.LogSubscription, error) {
+	if window == 0 {
+		return nil, fmt.Errorf("Window of subscription cannot be zero")
+	}
+	id := atomic.AddUint64(&w.nextLogOpId, 1)
+	currentCallId := atomic.LoadUint64(&w.currentCall)
+	sub := &logSubscription{
+		w:        w,
+		id:       id,
+		callId:   currentCallId,
+		window:   window,
+		withData: withData,
+		messages: make(chan []byte, window+1),
+		consumed: 0,
+	}
+	message := protocol.NewSharedLogSubscribeMessage(currentCallId, w.clientId, tag, seqNum, window, withData, id)
+
+	w.mux.Lock()
+	w.logSubscriptions[id] = sub
+	_, err := w.outputPipe.Write(message)
+	if err != nil {
+		delete(w.logSubscriptions, id)
+	}
+	w.mux.Unlock()
+	if err != nil {
+		return nil, err
+	}
+	return sub, nil
+}
+
+// Implement types.LogSubscription
+func (s *logSubscription) Next(ctx context.Context) (*types.LogEntry, error) {
+	var response []byte
+	var ok bool
+	select {
+	case <-ctx.Done():
+		return nil, ctx.Err()
+	case response, ok = <-s.messages:
+	}
+	if !ok {
+		return nil, s.err
+	}
+	result := protocol.GetSharedLogResultTypeFromMessage(response)
+	if result != protocol.SharedLogResultType_READ_OK {
+		return nil, fmt.Errorf("Subscription failed with err code: 0x%x", result)
+	}
+	// Return credits in batches of half the window
+	s.consumed++
+	if s.consumed >= (s.window+1)/2 {
+		message := protocol.NewSharedLogSubCreditsMessage(s.callId, s.w.clientId, s.consumed, s.id)
+		s.consumed = 0
+		s.w.mux.Lock()
+		_, err := s.w.outputPipe.Write(message)
+		if err != nil {
+			// Without credits the engine stops pushing logs
+			s.w.closeLogSubscription(s, err)
+		}
+		s.w.mux.Unlock()
+		if err != nil {
+			return nil, err
+		}
+	}
+	// Logs found by remote indices may come with data anyway
+	if !s.withData && protocol.GetAuxBufferIdFromMessage(response) == protocol.InvalidAuxBufferId &&
+		len(protocol.GetInlineDataFromMessage(response)) == 0 {
+		return &types.LogEntry{
+			SeqNum:          protocol.GetLogSeqNumFromMessage(response),
+			MetaLogProgress: protocol.GetLogMetaLogProgressFromMessage(response),
+		}, nil
+	}
+	return s.w.buildLogEntryFromReadResponse(response), nil
+}
+
+// Implement types.LogSubscription
+func (s *logSubscription) Unsubscribe() error {
+	message := protocol.NewSharedLogUnsubscribeMessage(s.callId, s.w.clientId, s.id)
+	s.w.mux.Lock()
+	s.w.closeLogSubscription(s, fmt.Errorf("Subscription closed"))
+	_, err := s.w.outputPipe.Write(message)
+	s.w.mux.Unlock()
+	return err
+}